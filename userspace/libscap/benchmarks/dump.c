@@ -0,0 +1,212 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Compares the throughput of scap_dump() writing through gzwrite() on the
+// dumping thread and through the background writer, optionally with
+// O_DIRECT, for every compression mode. The events are prepared in memory
+// first, so only the dumper is measured. The files are written to dir.
+//
+// usage: scap-bench-dump [size_mb] [dir]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <scap.h>
+
+#define DEFAULT_SIZE_MB 4096
+// Size of the events kept in memory, written again and again
+#define POOL_SIZE (64 * 1024 * 1024)
+
+static uint64_t g_rand_state = 88172645463325252ULL;
+
+static uint64_t next_rand()
+{
+	g_rand_state ^= g_rand_state << 13;
+	g_rand_state ^= g_rand_state >> 7;
+	g_rand_state ^= g_rand_state << 17;
+	return g_rand_state;
+}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//
+// Fill pool with read exit events with text-like payloads, that compress
+// about as well as real captures. Returns the number of events.
+//
+static uint64_t make_events(uint8_t* pool, uint64_t size)
+{
+	static const char words[][12] = {"open", "/etc", "/usr/lib", "read", "GET /", "200 OK", "\n", "cgroup"};
+	char error[SCAP_LASTERR_SIZE];
+	uint8_t payload[512];
+	uint64_t used = 0;
+	uint64_t nevts = 0;
+	uint64_t ts = 1000000000ULL;
+
+	while(true)
+	{
+		uint32_t len = 0;
+		uint32_t target = 16 + next_rand() % (sizeof(payload) - 32);
+		scap_sized_buffer evt_buf = {pool + used, size - used};
+		scap_const_sized_buffer data;
+		size_t evt_size;
+		scap_evt* evt;
+
+		while(len < target)
+		{
+			const char* w = words[next_rand() % 8];
+			size_t wlen = strlen(w);
+			memcpy(payload + len, w, wlen);
+			len += wlen;
+		}
+
+		data.buf = payload;
+		data.size = len;
+		if(scap_event_encode_params(evt_buf, &evt_size, error, PPME_SYSCALL_READ_X, 2, (int64_t)len, data) != SCAP_SUCCESS)
+		{
+			// The pool is full
+			break;
+		}
+
+		evt = (scap_evt*)(pool + used);
+		ts += 1 + next_rand() % 5000;
+		evt->ts = ts;
+		evt->tid = 1000 + next_rand() % 64;
+		used += evt->len;
+		nevts++;
+	}
+
+	return nevts;
+}
+
+static void write_capture(const char* name, const char* fname, compression_mode compress, uint32_t flags,
+			  const uint8_t* pool, uint64_t nevts, uint64_t size)
+{
+	char error[SCAP_LASTERR_SIZE];
+	scap_open_args oargs;
+	scap_dumper_t* d;
+	uint64_t written = 0;
+	uint64_t n = 0;
+	uint64_t start;
+	double secs;
+	int32_t rc;
+	scap_t* h;
+
+	memset(&oargs, 0, sizeof(oargs));
+	oargs.mode = SCAP_MODE_NODRIVER;
+	h = scap_open(oargs, error, &rc);
+	if(h == NULL)
+	{
+		fprintf(stderr, "can't open the inspector: %s\n", error);
+		return;
+	}
+
+	start = now_ns();
+	d = scap_dump_open_ex(h, fname, compress, true, flags);
+	if(d == NULL)
+	{
+		fprintf(stderr, "can't open %s: %s\n", fname, scap_getlasterr(h));
+		scap_close(h);
+		return;
+	}
+
+	while(written < size)
+	{
+		uint64_t off = 0;
+		uint64_t j;
+
+		for(j = 0; j < nevts && written < size; j++)
+		{
+			scap_evt* evt = (scap_evt*)(pool + off);
+			if(scap_dump(h, d, evt, j % 8, 0) != SCAP_SUCCESS)
+			{
+				fprintf(stderr, "can't write the event: %s\n", scap_getlasterr(h));
+				scap_dump_close(d);
+				scap_close(h);
+				unlink(fname);
+				return;
+			}
+
+			off += evt->len;
+			written += evt->len;
+			n++;
+		}
+	}
+
+	scap_dump_close(d);
+	secs = (now_ns() - start) / 1e9;
+	scap_close(h);
+	unlink(fname);
+
+	printf("%-32s %12" PRIu64 " evts %10.1f MB/s %10.2f Mevt/s\n",
+	       name, n, written / secs / (1024 * 1024), n / secs / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+	static const struct
+	{
+		const char* name;
+		compression_mode compress;
+		uint32_t flags;
+	} runs[] = {
+		{"none, gzwrite", SCAP_COMPRESSION_NONE, SCAP_DOF_NONE},
+		{"none, background", SCAP_COMPRESSION_NONE, SCAP_DOF_BACKGROUND_WRITE},
+		{"none, background, direct", SCAP_COMPRESSION_NONE, SCAP_DOF_BACKGROUND_WRITE | SCAP_DOF_DIRECT_IO},
+		{"gzip, gzwrite", SCAP_COMPRESSION_GZIP, SCAP_DOF_NONE},
+		{"gzip, background", SCAP_COMPRESSION_GZIP, SCAP_DOF_BACKGROUND_WRITE},
+		{"chunked, inline", SCAP_COMPRESSION_GZIP_CHUNKED, SCAP_DOF_NONE},
+		{"chunked, background", SCAP_COMPRESSION_GZIP_CHUNKED, SCAP_DOF_BACKGROUND_WRITE},
+		{"chunked, background, direct", SCAP_COMPRESSION_GZIP_CHUNKED, SCAP_DOF_BACKGROUND_WRITE | SCAP_DOF_DIRECT_IO},
+	};
+	uint64_t size_mb = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_SIZE_MB;
+	const char* dir = argc > 2 ? argv[2] : "/tmp";
+	char fname[4096];
+	uint8_t* pool;
+	uint64_t nevts;
+	uint32_t j;
+
+	pool = (uint8_t*)malloc(POOL_SIZE);
+	if(pool == NULL)
+	{
+		fprintf(stderr, "can't allocate the events\n");
+		return 1;
+	}
+
+	nevts = make_events(pool, POOL_SIZE);
+	snprintf(fname, sizeof(fname), "%s/scap-bench-dump.scap", dir);
+
+	printf("writing %" PRIu64 " MB of events\n", size_mb);
+	for(j = 0; j < sizeof(runs) / sizeof(runs[0]); j++)
+	{
+		write_capture(runs[j].name, fname, runs[j].compress, runs[j].flags, pool, nevts, size_mb * 1024 * 1024);
+	}
+
+	free(pool);
+	return 0;
+}
@@ -0,0 +1,215 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Compares the throughput of scap_next() on gzip captures inflated on the
+// reading thread, by one background thread and, for chunked files, by
+// several background threads. The synthetic capture is written to dir,
+// both with SCAP_COMPRESSION_GZIP and SCAP_COMPRESSION_GZIP_CHUNKED.
+//
+// usage: scap-bench-gzread [size_mb] [dir] [threads]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <scap.h>
+
+#define DEFAULT_SIZE_MB 10240
+
+static uint64_t g_rand_state = 88172645463325252ULL;
+
+static uint64_t next_rand()
+{
+	g_rand_state ^= g_rand_state << 13;
+	g_rand_state ^= g_rand_state >> 7;
+	g_rand_state ^= g_rand_state << 17;
+	return g_rand_state;
+}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//
+// Write read exit events with text-like payloads, that compress about as
+// well as real captures, until size bytes of events have been written
+//
+static int write_capture(const char* fname, compression_mode compress, uint64_t size)
+{
+	static const char words[][12] = {"open", "/etc", "/usr/lib", "read", "GET /", "200 OK", "\n", "cgroup"};
+	char error[SCAP_LASTERR_SIZE];
+	uint8_t payload[512];
+	uint8_t buf[1024];
+	scap_open_args oargs;
+	scap_dumper_t* d;
+	uint64_t written = 0;
+	uint64_t ts = 1000000000ULL;
+	int32_t rc;
+	scap_t* h;
+
+	// Same events in every file
+	g_rand_state = 88172645463325252ULL;
+
+	memset(&oargs, 0, sizeof(oargs));
+	oargs.mode = SCAP_MODE_NODRIVER;
+	h = scap_open(oargs, error, &rc);
+	if(h == NULL)
+	{
+		fprintf(stderr, "can't open the inspector: %s\n", error);
+		return -1;
+	}
+
+	d = scap_dump_open(h, fname, compress, true);
+	if(d == NULL)
+	{
+		fprintf(stderr, "can't open %s: %s\n", fname, scap_getlasterr(h));
+		scap_close(h);
+		return -1;
+	}
+
+	while(written < size)
+	{
+		uint32_t len = 0;
+		uint32_t target = 16 + next_rand() % (sizeof(payload) - 32);
+		scap_sized_buffer evt_buf = {buf, sizeof(buf)};
+		scap_const_sized_buffer data;
+		size_t evt_size;
+		scap_evt* evt;
+
+		while(len < target)
+		{
+			const char* w = words[next_rand() % 8];
+			size_t wlen = strlen(w);
+			memcpy(payload + len, w, wlen);
+			len += wlen;
+		}
+
+		data.buf = payload;
+		data.size = len;
+		if(scap_event_encode_params(evt_buf, &evt_size, error, PPME_SYSCALL_READ_X, 2, (int64_t)len, data) != SCAP_SUCCESS)
+		{
+			fprintf(stderr, "can't encode the event: %s\n", error);
+			break;
+		}
+
+		evt = (scap_evt*)buf;
+		ts += 1 + next_rand() % 5000;
+		evt->ts = ts;
+		evt->tid = 1000 + next_rand() % 64;
+		if(scap_dump(h, d, evt, next_rand() % 8, 0) != SCAP_SUCCESS)
+		{
+			fprintf(stderr, "can't write the event: %s\n", scap_getlasterr(h));
+			break;
+		}
+
+		written += evt->len;
+	}
+
+	scap_dump_close(d);
+	scap_close(h);
+	return written < size ? -1 : 0;
+}
+
+static void read_capture(const char* name, const char* fname, uint32_t nthreads)
+{
+	char error[SCAP_LASTERR_SIZE];
+	scap_open_args oargs;
+	uint64_t nevts = 0;
+	uint64_t bytes = 0;
+	uint64_t start;
+	double secs;
+	int32_t rc;
+	scap_t* h;
+
+	memset(&oargs, 0, sizeof(oargs));
+	oargs.mode = SCAP_MODE_CAPTURE;
+	oargs.fname = fname;
+	oargs.decompression_threads = nthreads;
+
+	start = now_ns();
+	h = scap_open(oargs, error, &rc);
+	if(h == NULL)
+	{
+		fprintf(stderr, "can't open %s: %s\n", fname, error);
+		return;
+	}
+
+	while(true)
+	{
+		scap_evt* evt;
+		uint16_t cpuid;
+
+		rc = scap_next(h, &evt, &cpuid);
+		if(rc != SCAP_SUCCESS)
+		{
+			break;
+		}
+
+		nevts++;
+		bytes += evt->len;
+	}
+
+	if(rc != SCAP_EOF)
+	{
+		fprintf(stderr, "%s: %s\n", fname, scap_getlasterr(h));
+	}
+
+	scap_close(h);
+	secs = (now_ns() - start) / 1e9;
+
+	printf("%-28s %12" PRIu64 " evts %10.1f MB/s %10.2f Mevt/s\n",
+	       name, nevts, bytes / secs / (1024 * 1024), nevts / secs / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t size_mb = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_SIZE_MB;
+	const char* dir = argc > 2 ? argv[2] : "/tmp";
+	uint32_t nthreads = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : SCAP_DECOMPRESSION_AUTO;
+	char gz[4096];
+	char chunked[4096];
+
+	snprintf(gz, sizeof(gz), "%s/scap-bench-gzread.scap.gz", dir);
+	snprintf(chunked, sizeof(chunked), "%s/scap-bench-gzread-chunked.scap.gz", dir);
+
+	printf("writing %" PRIu64 " MB of events\n", size_mb);
+	if(write_capture(gz, SCAP_COMPRESSION_GZIP, size_mb * 1024 * 1024) != 0 ||
+	   write_capture(chunked, SCAP_COMPRESSION_GZIP_CHUNKED, size_mb * 1024 * 1024) != 0)
+	{
+		unlink(gz);
+		unlink(chunked);
+		return 1;
+	}
+
+	read_capture("gzip, inline", gz, SCAP_DECOMPRESSION_INLINE);
+	read_capture("gzip, prefetch", gz, nthreads);
+	read_capture("chunked, inline", chunked, SCAP_DECOMPRESSION_INLINE);
+	read_capture("chunked, parallel", chunked, nthreads);
+
+	unlink(gz);
+	unlink(chunked);
+	return 0;
+}
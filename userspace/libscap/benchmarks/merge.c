@@ -0,0 +1,231 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Compares the linear scan that scap_next() used to perform over the devices
+// with the heap based merge, on simulated per-CPU rings.
+//
+// usage: scap-bench-merge [events_per_ring]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <scap.h>
+#include <scap_merge.h>
+
+typedef struct sim_ring
+{
+	uint64_t* m_ts;
+	uint32_t m_nevts;
+	uint32_t m_pos;
+} sim_ring;
+
+static uint64_t g_rand_state = 88172645463325252ULL;
+
+static uint64_t next_rand()
+{
+	g_rand_state ^= g_rand_state << 13;
+	g_rand_state ^= g_rand_state >> 7;
+	g_rand_state ^= g_rand_state << 17;
+	return g_rand_state;
+}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void fill_rings(sim_ring* rings, uint32_t nrings, uint32_t nevts)
+{
+	uint32_t j, k;
+
+	for(j = 0; j < nrings; j++)
+	{
+		uint64_t ts = next_rand() % 1000;
+
+		rings[j].m_nevts = nevts;
+		rings[j].m_pos = 0;
+		for(k = 0; k < nevts; k++)
+		{
+			ts += 1 + next_rand() % 2000;
+			rings[j].m_ts[k] = ts;
+		}
+	}
+}
+
+static void rewind_rings(sim_ring* rings, uint32_t nrings)
+{
+	uint32_t j;
+
+	for(j = 0; j < nrings; j++)
+	{
+		rings[j].m_pos = 0;
+	}
+}
+
+static uint64_t run_linear(sim_ring* rings, uint32_t nrings, uint64_t* checksum)
+{
+	uint64_t nevts = 0;
+	uint64_t sum = 0;
+
+	while(true)
+	{
+		uint64_t min_ts = 0xffffffffffffffffLL;
+		uint32_t picked = 65535;
+		uint32_t j;
+
+		for(j = 0; j < nrings; j++)
+		{
+			if(rings[j].m_pos == rings[j].m_nevts)
+			{
+				continue;
+			}
+
+			if(rings[j].m_ts[rings[j].m_pos] < min_ts)
+			{
+				min_ts = rings[j].m_ts[rings[j].m_pos];
+				picked = j;
+			}
+		}
+
+		if(picked == 65535)
+		{
+			break;
+		}
+
+		rings[picked].m_pos++;
+		sum = (sum ^ (min_ts + picked)) * 1099511628211ULL;
+		nevts++;
+	}
+
+	*checksum = sum;
+	return nevts;
+}
+
+static uint64_t run_heap(sim_ring* rings, uint32_t nrings, scap_merge_heap* heap, uint64_t* checksum)
+{
+	uint64_t nevts = 0;
+	uint64_t sum = 0;
+	uint32_t j;
+
+	scap_merge_clear(heap);
+	for(j = 0; j < nrings; j++)
+	{
+		if(rings[j].m_nevts > 0)
+		{
+			scap_merge_append(heap, rings[j].m_ts[0], j);
+		}
+	}
+	scap_merge_build(heap);
+
+	while(!scap_merge_empty(heap))
+	{
+		const scap_merge_entry* top = scap_merge_top(heap);
+		sim_ring* ring = &rings[top->dev];
+
+		sum = (sum ^ (top->ts + top->dev)) * 1099511628211ULL;
+		nevts++;
+
+		ring->m_pos++;
+		if(ring->m_pos == ring->m_nevts)
+		{
+			scap_merge_pop(heap);
+		}
+		else
+		{
+			scap_merge_replace_top(heap, ring->m_ts[ring->m_pos]);
+		}
+	}
+
+	*checksum = sum;
+	return nevts;
+}
+
+int main(int argc, char** argv)
+{
+	static const uint32_t nrings_list[] = {8, 16, 32, 64, 128, 256};
+	uint32_t nevts_per_ring = 20000;
+	uint32_t j, k;
+
+	if(argc > 1)
+	{
+		nevts_per_ring = (uint32_t)atoi(argv[1]);
+	}
+
+	printf("%8s %14s %14s %10s\n", "rings", "linear ns/evt", "heap ns/evt", "speedup");
+
+	for(j = 0; j < sizeof(nrings_list) / sizeof(nrings_list[0]); j++)
+	{
+		uint32_t nrings = nrings_list[j];
+		sim_ring* rings = (sim_ring*)calloc(nrings, sizeof(sim_ring));
+		scap_merge_heap heap;
+		uint64_t linear_sum, heap_sum;
+		uint64_t linear_n, heap_n;
+		uint64_t t0, t1, t2;
+
+		if(rings == NULL || scap_merge_init(&heap, nrings) != SCAP_SUCCESS)
+		{
+			fprintf(stderr, "allocation failed\n");
+			return EXIT_FAILURE;
+		}
+
+		for(k = 0; k < nrings; k++)
+		{
+			rings[k].m_ts = (uint64_t*)malloc(nevts_per_ring * sizeof(uint64_t));
+			if(rings[k].m_ts == NULL)
+			{
+				fprintf(stderr, "allocation failed\n");
+				return EXIT_FAILURE;
+			}
+		}
+
+		fill_rings(rings, nrings, nevts_per_ring);
+
+		t0 = now_ns();
+		linear_n = run_linear(rings, nrings, &linear_sum);
+		t1 = now_ns();
+		rewind_rings(rings, nrings);
+		heap_n = run_heap(rings, nrings, &heap, &heap_sum);
+		t2 = now_ns();
+
+		if(linear_n != heap_n || linear_sum != heap_sum)
+		{
+			fprintf(stderr, "merge mismatch with %u rings\n", nrings);
+			return EXIT_FAILURE;
+		}
+
+		printf("%8u %14.2f %14.2f %9.2fx\n",
+		       nrings,
+		       (double)(t1 - t0) / linear_n,
+		       (double)(t2 - t1) / heap_n,
+		       (double)(t1 - t0) / (double)(t2 - t1));
+
+		for(k = 0; k < nrings; k++)
+		{
+			free(rings[k].m_ts);
+		}
+		free(rings);
+		scap_merge_free(&heap);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,163 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Rewrite a trace file in the current format, in a single pass. Events of
+// old captures, that have no parameter count in their header, are
+// converted by the reader and written back as V2 blocks, so that they
+// don't need to be converted every time the file is read.
+//
+// Every section of a merged file is written with its own state, as a
+// checkpoint.
+//
+// usage: scap-convert [-z] <input> <output>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <scap.h>
+#include "../../../../driver/ppm_events_public.h"
+
+extern const struct ppm_event_info g_event_info[];
+
+static void usage()
+{
+	fprintf(stderr, "usage: scap-convert [-z] <input> <output>\n"
+			"  -z  gzip the output\n");
+}
+
+int main(int argc, char** argv)
+{
+	char error[SCAP_LASTERR_SIZE];
+	compression_mode compress = SCAP_COMPRESSION_NONE;
+	bool new_section = false;
+	uint64_t nevts = 0;
+	uint64_t nsections = 1;
+	scap_dumper_t* d;
+	int32_t res;
+	scap_t* h;
+	int opt;
+
+	while((opt = getopt(argc, argv, "z")) != -1)
+	{
+		switch(opt)
+		{
+		case 'z':
+			compress = SCAP_COMPRESSION_GZIP;
+			break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(argc - optind != 2)
+	{
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	h = scap_open_offline(argv[optind], error, &res);
+	if(h == NULL)
+	{
+		fprintf(stderr, "can't open %s: %s\n", argv[optind], error);
+		return EXIT_FAILURE;
+	}
+
+	//
+	// The state read from the first section of the input is written as is
+	//
+	d = scap_dump_open(h, argv[optind + 1], compress, false);
+	if(d == NULL)
+	{
+		fprintf(stderr, "can't open %s: %s\n", argv[optind + 1], scap_getlasterr(h));
+		scap_close(h);
+		return EXIT_FAILURE;
+	}
+
+	while(true)
+	{
+		scap_evt* evt;
+		uint16_t cpuid;
+		uint32_t flags;
+
+		res = scap_next(h, &evt, &cpuid);
+		if(res == SCAP_UNEXPECTED_BLOCK)
+		{
+			//
+			// Start of the next section of a merged file, load its state.
+			// It's written before the next event, whose timestamp is the
+			// one of the checkpoint.
+			//
+			res = scap_restart_capture(h);
+			if(res != SCAP_SUCCESS)
+			{
+				break;
+			}
+			new_section = true;
+			continue;
+		}
+		else if(res != SCAP_SUCCESS)
+		{
+			break;
+		}
+
+		if(new_section)
+		{
+			if(scap_dump_checkpoint(h, d, evt->ts) != SCAP_SUCCESS)
+			{
+				res = SCAP_FAILURE;
+				break;
+			}
+			new_section = false;
+			nsections++;
+		}
+
+		flags = scap_event_get_dump_flags(h);
+		if(g_event_info[evt->type].flags & EF_LARGE_PAYLOAD)
+		{
+			flags |= SCAP_DF_LARGE;
+		}
+
+		if(scap_dump(h, d, evt, cpuid, flags) != SCAP_SUCCESS)
+		{
+			res = SCAP_FAILURE;
+			break;
+		}
+
+		nevts++;
+	}
+
+	if(res != SCAP_EOF)
+	{
+		fprintf(stderr, "conversion failed: %s\n", scap_getlasterr(h));
+		scap_dump_close(d);
+		scap_close(h);
+		return EXIT_FAILURE;
+	}
+
+	scap_dump_close(d);
+	scap_close(h);
+
+	printf("%" PRIu64 " events, %" PRIu64 " sections written to %s\n", nevts, nsections, argv[optind + 1]);
+	return EXIT_SUCCESS;
+}
@@ -21,6 +21,9 @@ limitations under the License.
 
 #include "settings.h"
 #include "plugin_info.h"
+#include "scap_merge.h"
+#include "scap_prefetch.h"
+#include "scap_writer.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -36,6 +39,7 @@ typedef struct wh_t wh_t;
 #include <crtdbg.h>
 #endif
 #include <assert.h>
+#include <string.h>
 #if defined(USE_ZLIB) && !defined(UDIG)
 #include <zlib.h>
 #else
@@ -62,12 +66,19 @@ inline const char *gzerror(FILE *F, int *E) {*E = ferror(F); return "error readi
 #endif
 #define BUFFER_EMPTY_WAIT_TIME_US_MAX (30 * 1000)
 #define BUFFER_EMPTY_THRESHOLD_B 20000
+// How long SCAP_WAIT_HYBRID spins before starting to sleep
+#define BUFFER_EMPTY_SPIN_TIME_US 200
 
 //
 // Process flags
 //
 #define PF_CLONING 1
 
+//
+// How long the sockets read by scap_proc_read_fds() are reused
+//
+#define SCAP_LAZY_SOCKETS_MAX_AGE_NS (1000 * 1000 * 1000ULL)
+
 //
 // ebpf defs
 //
@@ -110,13 +121,24 @@ typedef struct scap_tid
 
 typedef enum ppm_reader_type
 {
-	RT_FILE = 0
+	RT_FILE = 0,
+	RT_MMAP = 1,
+	RT_PREFETCH = 2,
 } ppm_reader_type;
 
 struct scap_reader
 {
 	ppm_reader_type m_type;
 	gzFile m_file;
+	// RT_MMAP: the whole file is mapped, m_pos is the read position
+	int m_fd;
+	uint8_t* m_map;
+	uint64_t m_map_size;
+	uint64_t m_pos;
+	// Pages before this offset have been handed back to the kernel
+	uint64_t m_released;
+	// RT_PREFETCH: gzip file inflated by background threads
+	scap_prefetch* m_prefetch;
 };
 
 //
@@ -127,9 +149,21 @@ struct scap
 	scap_mode_t m_mode;
 	scap_device* m_devs;
 	uint32_t m_ndevs;
+	// Devices ordered by the timestamp of their next event
+	scap_merge_heap m_merge;
+	// If true, live events are only ordered within each device (see scap_open_args)
+	bool m_relaxed_ordering;
+	// With relaxed ordering, the device the next events are taken from
+	uint32_t m_next_dev;
+	// Storage for the events returned by scap_next_batch()
+	scap_evt** m_batch_evts;
+	uint32_t m_batch_evts_size;
+	scap_evt* m_batch_single_evt;
 	scap_reader_t* m_reader;
 	char* m_reader_evt_buf;
 	size_t m_reader_evt_buf_size;
+	// nparams + 1 of the last v1 event of each type, 0 if none was read yet
+	uint16_t m_v1_nparams[PPM_EVENT_MAX];
 
 	uint32_t m_last_evt_dump_flags;
 	char m_lasterr[SCAP_LASTERR_SIZE];
@@ -145,11 +179,25 @@ struct scap
 	scap_machine_info m_machine_info;
 	scap_userlist* m_userlist;
 	uint64_t m_buffer_empty_wait_time_us;
+	scap_wait_policy m_wait_policy;
+	// Monotonic time at which the buffers were first found empty, 0 if they aren't
+	uint64_t m_buffer_empty_since_ns;
+	// Used by SCAP_WAIT_POLL, allocated on first use
+	struct pollfd* m_pollfds;
 	proc_entry_callback m_proc_callback;
 	void* m_proc_callback_context;
 	struct ppm_proclist_info* m_driver_procinfo;
 	bool refresh_proc_table_when_saving;
 	uint32_t m_fd_lookup_limit;
+	// Threads scanning /proc, see scap_open_args
+	uint32_t m_proc_scan_threads;
+	scap_proc_scan_stats m_proc_scan_stats;
+	// fd tables read on demand by scap_proc_read_fds(), see scap_open_args
+	bool m_lazy_fd_tables;
+	// Sockets of the network namespaces read by scap_proc_read_fds(),
+	// reused until they are older than SCAP_LAZY_SOCKETS_MAX_AGE_NS
+	struct scap_ns_socket_list* m_lazy_sockets_by_ns;
+	uint64_t m_lazy_sockets_ts;
 	uint64_t m_unexpected_block_readsize;
 	uint32_t m_ncpus;
 	uint8_t m_cgroup_version;
@@ -233,6 +281,29 @@ struct scap_dumper
 	uint8_t* m_targetbuf;
 	uint8_t* m_targetbufcurpos;
 	uint8_t* m_targetbufend;
+	// SCAP_COMPRESSION_GZIP_CHUNKED: data not compressed yet, and buffer
+	// for its compressed chunk. m_f is open in transparent mode.
+	// With m_writer, m_chunk is the writer buffer being filled, for any
+	// compression, and m_f is NULL.
+	scap_writer* m_writer;
+	uint8_t* m_chunk;
+	uint32_t m_chunklen;
+	uint8_t* m_cchunk;
+	size_t m_cchunk_size;
+	// Uncompressed bytes written before m_chunk
+	int64_t m_chunk_base;
+	compression_mode m_compress;
+	bool m_skip_proc_scan;
+	uint64_t m_nevts;
+	// Checkpoints, see scap_dump_enable_index(). m_fname is NULL if the
+	// dumper can't have an index.
+	char* m_fname;
+	bool m_index_enabled;
+	scap_index_entry* m_index;
+	uint32_t m_index_size;
+	uint32_t m_index_capacity;
+	uint64_t m_checkpoint_interval_ns;
+	uint64_t m_last_checkpoint_ts;
 };
 
 struct scap_ns_socket_list
@@ -282,6 +353,8 @@ void scap_fd_print_fd_table(scap_t *handle, scap_fdinfo* fds);
 // Free an fd table and set it to NULL when done
 void scap_fd_free_table(scap_t* handle, scap_fdinfo** fds);
 void scap_fd_free_ns_sockets_list(scap_t* handle, struct scap_ns_socket_list** sockets);
+// Free the sockets cached by scap_proc_read_fds()
+void scap_proc_free_lazy_sockets(scap_t* handle);
 // Free a process' fd table
 void scap_fd_free_proc_fd_table(scap_t* handle, scap_threadinfo* pi);
 // Convert an fd entry's info into a string
@@ -307,6 +380,8 @@ int32_t scap_fd_scan_fd_dir(scap_t* handle, char * procdir, scap_threadinfo* pi,
 int32_t scap_fd_read_ipv4_sockets_from_proc_fs(scap_t* handle, const char * dir, int l4proto, scap_fdinfo ** sockets);
 // read all sockets and add them to the socket table hashed by their ino
 int32_t scap_fd_read_sockets(scap_t* handle, char* procdir, struct scap_ns_socket_list* sockets, char *error);
+// get the network namespace of the process in procdir, 0 if not available
+uint64_t scap_fd_read_net_ns(const char *procdir);
 // get the device major/minor number for the requested_mount_id, looking in procdir/mountinfo if needed
 uint32_t scap_get_device_by_mount_id(scap_t *handle, const char *procdir, unsigned long requested_mount_id);
 // prints procs details for a give tid
@@ -430,6 +505,19 @@ int32_t udig_start_dropping_mode(scap_t* handle, uint32_t sampling_ratio);
 // scap_reader functions implementation
 //
 
+// Once this many bytes have been read from a memory mapped file, the pages
+// behind the read position are released
+#define READER_MMAP_RELEASE_SIZE (64 * 1024 * 1024)
+
+//
+// Map the file open in fd, starting at its current position. Returns NULL,
+// leaving fd untouched, if the file can't be mapped (e.g. it's a pipe) or
+// is compressed.
+//
+scap_reader_t *scap_reader_open_mmap(int fd);
+int scap_reader_close_mmap(scap_reader_t *r);
+void scap_reader_release_mmap(scap_reader_t *r);
+
 static inline scap_reader_t *scap_reader_open_gzfile(gzFile file)
 {
 	if (file == NULL)
@@ -442,6 +530,27 @@ static inline scap_reader_t *scap_reader_open_gzfile(gzFile file)
 	return r;
 }
 
+static inline scap_reader_t *scap_reader_open_prefetch(scap_prefetch* prefetch)
+{
+	if (prefetch == NULL)
+	{
+		return NULL;
+	}
+	scap_reader_t* r = (scap_reader_t *) malloc (sizeof (scap_reader_t));
+	r->m_type = RT_PREFETCH;
+	r->m_prefetch = prefetch;
+	return r;
+}
+
+static inline void scap_reader_consume_mmap(scap_reader_t *r, uint32_t len)
+{
+	r->m_pos += len;
+	if(r->m_pos - r->m_released > READER_MMAP_RELEASE_SIZE)
+	{
+		scap_reader_release_mmap(r);
+	}
+}
+
 static inline ppm_reader_type scap_reader_type(scap_reader_t *r)
 {
 	ASSERT(r != NULL);
@@ -455,12 +564,46 @@ static inline int scap_reader_read(scap_reader_t *r, void* buf, uint32_t len)
 	{
 		case RT_FILE:
 			return gzread(r->m_file, buf, len);
+		case RT_MMAP:
+			if(r->m_pos >= r->m_map_size)
+			{
+				return 0;
+			}
+			if(len > r->m_map_size - r->m_pos)
+			{
+				len = (uint32_t)(r->m_map_size - r->m_pos);
+			}
+			memcpy(buf, r->m_map + r->m_pos, len);
+			scap_reader_consume_mmap(r, len);
+			return len;
+		case RT_PREFETCH:
+			return scap_prefetch_read(r->m_prefetch, buf, len);
 		default:
 			ASSERT(false);
 			return 0;
 	}
 }
 
+//
+// Return a pointer to the next len bytes and move past them, without
+// copying. Returns NULL if the reader isn't memory mapped, or if there
+// are less than len bytes left.
+//
+static inline void *scap_reader_map(scap_reader_t *r, uint32_t len)
+{
+	void *ptr;
+
+	ASSERT(r != NULL);
+	if(r->m_type != RT_MMAP || r->m_pos >= r->m_map_size || len > r->m_map_size - r->m_pos)
+	{
+		return NULL;
+	}
+
+	ptr = r->m_map + r->m_pos;
+	scap_reader_consume_mmap(r, len);
+	return ptr;
+}
+
 static inline int64_t scap_reader_offset(scap_reader_t *r)
 {
 	ASSERT(r != NULL);
@@ -468,6 +611,10 @@ static inline int64_t scap_reader_offset(scap_reader_t *r)
 	{
 		case RT_FILE:
 			return gzoffset(r->m_file);
+		case RT_MMAP:
+			return r->m_pos;
+		case RT_PREFETCH:
+			return scap_prefetch_offset(r->m_prefetch);
 		default:
 			ASSERT(false);
 			return -1;
@@ -481,6 +628,10 @@ static inline int64_t scap_reader_tell(scap_reader_t *r)
 	{
 		case RT_FILE:
 			return gztell(r->m_file);
+		case RT_MMAP:
+			return r->m_pos;
+		case RT_PREFETCH:
+			return scap_prefetch_tell(r->m_prefetch);
 		default:
 			ASSERT(false);
 			return -1;
@@ -494,6 +645,19 @@ static inline int64_t scap_reader_seek(scap_reader_t *r, int64_t offset, int whe
 	{
 		case RT_FILE:
 			return gzseek(r->m_file, offset, whence);
+		case RT_MMAP:
+		{
+			int64_t base = whence == SEEK_SET ? 0 :
+				       whence == SEEK_CUR ? (int64_t)r->m_pos : (int64_t)r->m_map_size;
+			if(base + offset < 0 || base + offset > (int64_t)r->m_map_size)
+			{
+				return -1;
+			}
+			r->m_pos = base + offset;
+			return r->m_pos;
+		}
+		case RT_PREFETCH:
+			return scap_prefetch_seek(r->m_prefetch, offset, whence);
 		default:
 			ASSERT(false);
 			return -1;
@@ -507,6 +671,11 @@ static inline const char *scap_reader_error(scap_reader_t *r, int *errnum)
 	{
 		case RT_FILE:
 			return gzerror(r->m_file, errnum);
+		case RT_MMAP:
+			*errnum = 0;
+			return "";
+		case RT_PREFETCH:
+			return scap_prefetch_error(r->m_prefetch, errnum);
 		default:
 			ASSERT(false);
 			*errnum = -1;
@@ -521,6 +690,10 @@ static inline int scap_reader_close(scap_reader_t *r)
 	{
 		case RT_FILE:
 			return gzclose(r->m_file);
+		case RT_MMAP:
+			return scap_reader_close_mmap(r);
+		case RT_PREFETCH:
+			return scap_prefetch_close(r->m_prefetch);
 		default:
 			ASSERT(false);
 			return -1;
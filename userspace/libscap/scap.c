@@ -115,7 +115,10 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 			   bool import_users,
 			   const char *bpf_probe,
 			   const char **suppressed_comms,
-			   interesting_ppm_sc_set *ppm_sc_of_interest)
+			   interesting_ppm_sc_set *ppm_sc_of_interest,
+			   scap_wait_policy wait_policy,
+			   uint32_t proc_scan_threads,
+			   bool lazy_fd_tables)
 {
 	snprintf(error, SCAP_LASTERR_SIZE, "live capture not supported on %s", PLATFORM_NAME);
 	*rc = SCAP_NOT_SUPPORTED;
@@ -128,7 +131,9 @@ scap_t* scap_open_udig_int(char *error, int32_t *rc,
 			   proc_entry_callback proc_callback,
 			   void* proc_callback_context,
 			   bool import_users,
-			   const char **suppressed_comms)
+			   const char **suppressed_comms,
+			   uint32_t proc_scan_threads,
+			   bool lazy_fd_tables)
 {
 	snprintf(error, SCAP_LASTERR_SIZE, "udig capture not supported on %s", PLATFORM_NAME);
 	*rc = SCAP_NOT_SUPPORTED;
@@ -164,7 +169,10 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 			   bool import_users,
 			   const char *bpf_probe,
 			   const char **suppressed_comms,
-			   interesting_ppm_sc_set *ppm_sc_of_interest)
+			   interesting_ppm_sc_set *ppm_sc_of_interest,
+			   scap_wait_policy wait_policy,
+			   uint32_t proc_scan_threads,
+			   bool lazy_fd_tables)
 {
 	uint32_t j;
 	char filename[SCAP_MAX_PATH_SIZE];
@@ -187,6 +195,7 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 	//
 	handle->m_mode = SCAP_MODE_LIVE;
 	handle->m_udig = false;
+	handle->m_wait_policy = wait_policy;
 
 	//
 	// While in theory we could always rely on the scap caller to properly
@@ -266,6 +275,14 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 
 	handle->m_ndevs = ndevs;
 
+	if(scap_merge_init(&handle->m_merge, ndevs) != SCAP_SUCCESS)
+	{
+		scap_close(handle);
+		snprintf(error, SCAP_LASTERR_SIZE, "error allocating the device merge heap");
+		*rc = SCAP_FAILURE;
+		return NULL;
+	}
+
 	//
 	// Extract machine information
 	//
@@ -280,6 +297,10 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 	handle->m_machine_info.reserved4 = 0;
 	handle->m_driver_procinfo = NULL;
 	handle->m_fd_lookup_limit = 0;
+	handle->m_proc_scan_threads = proc_scan_threads;
+	handle->m_lazy_fd_tables = lazy_fd_tables;
+	handle->m_lazy_sockets_by_ns = NULL;
+	handle->m_lazy_sockets_ts = 0;
 
 #ifdef CYGWING_AGENT
 	handle->m_whh = NULL;
@@ -622,7 +643,9 @@ scap_t* scap_open_udig_int(char *error, int32_t *rc,
 			   proc_entry_callback proc_callback,
 			   void* proc_callback_context,
 			   bool import_users,
-			   const char **suppressed_comms)
+			   const char **suppressed_comms,
+			   uint32_t proc_scan_threads,
+			   bool lazy_fd_tables)
 {
 	char filename[SCAP_MAX_PATH_SIZE];
 	scap_t* handle = NULL;
@@ -664,6 +687,14 @@ scap_t* scap_open_udig_int(char *error, int32_t *rc,
 	handle->m_devs[0].m_fd = -1;
 	handle->m_devs[0].m_bufinfo_fd = -1;
 
+	if(scap_merge_init(&handle->m_merge, handle->m_ndevs) != SCAP_SUCCESS)
+	{
+		scap_close(handle);
+		snprintf(error, SCAP_LASTERR_SIZE, "error allocating the device merge heap");
+		*rc = SCAP_FAILURE;
+		return NULL;
+	}
+
 	//
 	// Extract machine information
 	//
@@ -682,6 +713,10 @@ scap_t* scap_open_udig_int(char *error, int32_t *rc,
 	handle->m_machine_info.reserved4 = 0;
 	handle->m_driver_procinfo = NULL;
 	handle->m_fd_lookup_limit = 0;
+	handle->m_proc_scan_threads = proc_scan_threads;
+	handle->m_lazy_fd_tables = lazy_fd_tables;
+	handle->m_lazy_sockets_by_ns = NULL;
+	handle->m_lazy_sockets_ts = 0;
 
 	//
 	// Create the interface list
@@ -852,6 +887,11 @@ scap_t* scap_open_offline_int(scap_reader_t* reader,
 	handle->m_proc_callback_context = proc_callback_context;
 	handle->m_devs = NULL;
 	handle->m_ndevs = 0;
+	handle->m_relaxed_ordering = false;
+	handle->m_batch_evts = NULL;
+	handle->m_batch_evts_size = 0;
+	handle->m_wait_policy = SCAP_WAIT_BACKOFF;
+	handle->m_pollfds = NULL;
 	handle->m_proclist = NULL;
 	handle->m_dev_list = NULL;
 	handle->m_evtcnt = 0;
@@ -862,6 +902,11 @@ scap_t* scap_open_offline_int(scap_reader_t* reader,
 	handle->m_driver_procinfo = NULL;
 	handle->refresh_proc_table_when_saving = true;
 	handle->m_fd_lookup_limit = 0;
+	handle->m_proc_scan_threads = 0;
+	handle->m_lazy_fd_tables = false;
+	handle->m_lazy_sockets_by_ns = NULL;
+	handle->m_lazy_sockets_ts = 0;
+	memset(&handle->m_proc_scan_stats, 0, sizeof(handle->m_proc_scan_stats));
 #if CYGWING_AGENT || _WIN32
 	handle->m_whh = NULL;
 	handle->m_win_buf_handle = NULL;
@@ -881,6 +926,7 @@ scap_t* scap_open_offline_int(scap_reader_t* reader,
 		return NULL;
 	}
 	handle->m_reader_evt_buf_size = READER_BUF_SIZE;
+	memset(handle->m_v1_nparams, 0, sizeof(handle->m_v1_nparams));
 
 	handle->m_reader = reader;
 	handle->m_unexpected_block_readsize = 0;
@@ -935,43 +981,173 @@ scap_t* scap_open_offline_int(scap_reader_t* reader,
 	return handle;
 }
 
-scap_t* scap_open_offline(const char* fname, char *error, int32_t* rc)
+//
+// Open the reader for a capture file, given either its name or, if fd is
+// not 0, an open descriptor. Uncompressed regular files are memory mapped,
+// everything else goes through zlib, either on the reading thread or, if
+// decompression_threads asks for it, on background threads.
+//
+static scap_reader_t* scap_open_reader(const char* fname, int fd, uint32_t decompression_threads, char *error)
 {
-	gzFile gzfile = gzopen(fname, "rb");
+	gzFile gzfile;
+
+#ifndef _WIN32
+	int mfd = fd != 0 ? fd : open(fname, O_RDONLY | O_CLOEXEC);
+	if(mfd >= 0)
+	{
+		scap_reader_t* reader = scap_reader_open_mmap(mfd);
+		if(reader != NULL)
+		{
+			return reader;
+		}
+
+#ifdef USE_ZLIB
+		if(decompression_threads != SCAP_DECOMPRESSION_INLINE)
+		{
+			return scap_reader_open_prefetch(scap_prefetch_open(mfd, decompression_threads, error));
+		}
+#endif
+
+		if(mfd != fd)
+		{
+			close(mfd);
+		}
+	}
+#endif
+
+	if(fd != 0)
+	{
+		gzfile = gzdopen(fd, "rb");
+	}
+	else
+	{
+		gzfile = gzopen(fname, "rb");
+	}
+
 	if(gzfile == NULL)
 	{
-		snprintf(error, SCAP_LASTERR_SIZE, "can't open file %s", fname);
+		if(fd != 0)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't open fd %d", fd);
+		}
+		else
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't open file %s", fname);
+		}
+		return NULL;
+	}
+
+	return scap_reader_open_gzfile(gzfile);
+}
+
+//
+// Open the reader of a capture file that has an index, at checkpoint
+// start_checkpoint if not zero, otherwise at the last checkpoint before
+// start_ts. Chunked files are inflated starting from the checkpoint, others
+// are read from the start and seeked by scap_open_offline_int through
+// start_offset.
+//
+static scap_reader_t* scap_open_reader_at_checkpoint(const char* fname, uint32_t decompression_threads, uint64_t start_ts, uint32_t start_checkpoint, uint64_t* start_offset, char *error)
+{
+	scap_index_entry* entries;
+	scap_index_entry entry;
+	uint32_t nentries;
+	compression_mode compress;
+
+	if(fname == NULL)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "starting from a checkpoint requires the capture file name");
+		return NULL;
+	}
+
+	if(scap_read_index(fname, &entries, &nentries, &compress, error) != SCAP_SUCCESS)
+	{
+		return NULL;
+	}
+
+	if(start_checkpoint >= nentries)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "checkpoint %u not found, the index of %s has %u", start_checkpoint, fname, nentries);
+		free(entries);
+		return NULL;
+	}
+
+	if(start_checkpoint == 0)
+	{
+		start_checkpoint = scap_index_find(entries, nentries, start_ts);
+	}
+
+	entry = entries[start_checkpoint];
+	free(entries);
+	*start_offset = entry.offset;
+
+#if defined(USE_ZLIB) && !defined(_WIN32)
+	if(compress == SCAP_COMPRESSION_GZIP_CHUNKED &&
+	   decompression_threads != SCAP_DECOMPRESSION_INLINE &&
+	   entry.offset != 0)
+	{
+		scap_prefetch* prefetch;
+		int fd = open(fname, O_RDONLY | O_CLOEXEC);
+		if(fd < 0 || lseek(fd, entry.file_offset, SEEK_SET) < 0)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't open file %s", fname);
+			if(fd >= 0)
+			{
+				close(fd);
+			}
+			return NULL;
+		}
+
+		prefetch = scap_prefetch_open(fd, decompression_threads, error);
+		if(prefetch == NULL)
+		{
+			return NULL;
+		}
+
+		scap_prefetch_set_tell(prefetch, entry.offset);
+		return scap_reader_open_prefetch(prefetch);
+	}
+#endif
+
+	return scap_open_reader(fname, 0, decompression_threads, error);
+}
+
+scap_t* scap_open_offline(const char* fname, char *error, int32_t* rc)
+{
+	scap_reader_t* reader = scap_open_reader(fname, 0, SCAP_DECOMPRESSION_INLINE, error);
+	if(reader == NULL)
+	{
 		*rc = SCAP_FAILURE;
 		return NULL;
 	}
-	scap_reader_t* reader = scap_reader_open_gzfile(gzfile);
 
 	return scap_open_offline_int(reader, error, rc, NULL, NULL, true, 0, NULL);
 }
 
 scap_t* scap_open_offline_fd(int fd, char *error, int32_t *rc)
 {
-	gzFile gzfile = gzdopen(fd, "rb");
-	if(gzfile == NULL)
+	scap_reader_t* reader = scap_open_reader(NULL, fd, SCAP_DECOMPRESSION_INLINE, error);
+	if(reader == NULL)
 	{
-		snprintf(error, SCAP_LASTERR_SIZE, "can't open fd %d", fd);
 		*rc = SCAP_FAILURE;
 		return NULL;
 	}
-	scap_reader_t* reader = scap_reader_open_gzfile(gzfile);
 
 	return scap_open_offline_int(reader, error, rc, NULL, NULL, true, 0, NULL);
 }
 
 scap_t* scap_open_live(char *error, int32_t *rc)
 {
-	return scap_open_live_int(error, rc, NULL, NULL, true, NULL, NULL, NULL);
+	return scap_open_live_int(error, rc, NULL, NULL, true, NULL, NULL, NULL, SCAP_WAIT_BACKOFF, 0, false);
 }
 
 scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
 			       proc_entry_callback proc_callback,
 			       void* proc_callback_context,
-			       bool import_users)
+			       bool import_users,
+			       uint32_t proc_scan_threads,
+			       bool lazy_fd_tables,
+			       bool skip_proc_scan)
 {
 #if !defined(HAS_CAPTURE)
 	snprintf(error, SCAP_LASTERR_SIZE, "live capture not supported on %s", PLATFORM_NAME);
@@ -1017,6 +1193,10 @@ scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
 	handle->m_machine_info.reserved4 = 0;
 	handle->m_driver_procinfo = NULL;
 	handle->m_fd_lookup_limit = SCAP_NODRIVER_MAX_FD_LOOKUP; // fd lookup is limited here because is very expensive
+	handle->m_proc_scan_threads = proc_scan_threads;
+	handle->m_lazy_fd_tables = lazy_fd_tables;
+	handle->m_lazy_sockets_by_ns = NULL;
+	handle->m_lazy_sockets_ts = 0;
 
 	//
 	// If this is part of the windows agent, open the windows HAL
@@ -1070,8 +1250,13 @@ scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
 	handle->refresh_proc_table_when_saving = true;
 
 	//
-	// Create the process list
+	// Create the process list, unless the caller fills it on its own
 	//
+	if(skip_proc_scan)
+	{
+		return handle;
+	}
+
 	error[0] = '\0';
 	snprintf(filename, sizeof(filename), "%s/proc", scap_get_host_root());
 	char proc_scan_err[SCAP_LASTERR_SIZE];
@@ -1133,6 +1318,11 @@ scap_t* scap_open_plugin_int(char *error, int32_t *rc, scap_source_plugin * inpu
 	snprintf(handle->m_fake_kernel_proc.exe, SCAP_MAX_PATH_SIZE, "kernel");
 	handle->m_fake_kernel_proc.args[0] = 0;
 	handle->refresh_proc_table_when_saving = true;
+	handle->m_proc_scan_threads = 0;
+	handle->m_lazy_fd_tables = false;
+	handle->m_lazy_sockets_by_ns = NULL;
+	handle->m_lazy_sockets_ts = 0;
+	memset(&handle->m_proc_scan_stats, 0, sizeof(handle->m_proc_scan_stats));
 
 	handle->m_input_plugin = input_plugin;
 
@@ -1168,55 +1358,65 @@ scap_t* scap_open(scap_open_args args, char *error, int32_t *rc)
 	{
 	case SCAP_MODE_CAPTURE:
 	{
-		gzFile gzfile;
+		scap_reader_t* reader;
+		uint64_t start_offset = args.start_offset;
 
-		if(args.fd != 0)
+		if(args.start_ts != 0 || args.start_checkpoint != 0)
 		{
-			gzfile = gzdopen(args.fd, "rb");
+			reader = scap_open_reader_at_checkpoint(args.fd != 0 ? NULL : args.fname, args.decompression_threads,
+								args.start_ts, args.start_checkpoint, &start_offset, error);
 		}
 		else
 		{
-			gzfile = gzopen(args.fname, "rb");
+			reader = scap_open_reader(args.fname, args.fd, args.decompression_threads, error);
 		}
 
-		if(gzfile == NULL)
+		if(reader == NULL)
 		{
-			if(args.fd != 0)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "can't open fd %d", args.fd);
-			}
-			else
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "can't open file %s", args.fname);
-			}
 			*rc = SCAP_FAILURE;
 			return NULL;
 		}
 
-		scap_reader_t* reader = scap_reader_open_gzfile(gzfile);
 		return scap_open_offline_int(reader, error, rc,
 					     args.proc_callback, args.proc_callback_context,
-					     args.import_users, args.start_offset,
+					     args.import_users, start_offset,
 					     args.suppressed_comms);
 	}
 	case SCAP_MODE_LIVE:
 #ifndef CYGWING_AGENT
+	{
+		scap_t* handle;
+
 		if(args.udig)
 		{
-			return scap_open_udig_int(error, rc, args.proc_callback,
+			handle = scap_open_udig_int(error, rc, args.proc_callback,
 						args.proc_callback_context,
 						args.import_users,
-						args.suppressed_comms);
+						args.suppressed_comms,
+						args.proc_scan_threads,
+						args.lazy_fd_tables);
 		}
 		else
 		{
-			return scap_open_live_int(error, rc, args.proc_callback,
+			handle = scap_open_live_int(error, rc, args.proc_callback,
 						args.proc_callback_context,
 						args.import_users,
 						args.bpf_probe,
 						args.suppressed_comms,
-						&args.ppm_sc_of_interest);
+						&args.ppm_sc_of_interest,
+						args.wait_policy,
+						args.proc_scan_threads,
+						args.lazy_fd_tables);
+		}
+
+		if(handle != NULL)
+		{
+			handle->m_relaxed_ordering = args.relaxed_ordering;
+			handle->m_wait_policy = args.wait_policy;
 		}
+
+		return handle;
+	}
 #else
 		snprintf(error,	SCAP_LASTERR_SIZE, "scap_open: live mode currently not supported on Windows.");
 		*rc = SCAP_NOT_SUPPORTED;
@@ -1225,7 +1425,10 @@ scap_t* scap_open(scap_open_args args, char *error, int32_t *rc)
 	case SCAP_MODE_NODRIVER:
 		return scap_open_nodriver_int(error, rc, args.proc_callback,
 					      args.proc_callback_context,
-					      args.import_users);
+					      args.import_users,
+					      args.proc_scan_threads,
+					      args.lazy_fd_tables,
+					      args.skip_proc_scan);
 	case SCAP_MODE_PLUGIN:
 		return scap_open_plugin_int(error, rc, args.input_plugin, args.input_plugin_params);
 	case SCAP_MODE_NONE:
@@ -1281,6 +1484,9 @@ static inline void scap_deinit_state(scap_t* handle)
 		handle->m_proclist = NULL;
 	}
 
+	// Free the sockets cached for the on-demand fd reads
+	scap_proc_free_lazy_sockets(handle);
+
 	// Free the device table
 	if(handle->m_dev_list != NULL)
 	{
@@ -1392,6 +1598,10 @@ void scap_close(scap_t* handle)
 			//
 			free(handle->m_devs);
 		}
+
+		scap_merge_free(&handle->m_merge);
+		free(handle->m_batch_evts);
+		free(handle->m_pollfds);
 #endif // HAS_CAPTURE
 	}
 	else if(handle->m_mode == SCAP_MODE_PLUGIN)
@@ -1593,6 +1803,18 @@ static uint64_t buf_size_used(scap_t* handle, uint32_t cpu)
 	return read_size;
 }
 
+static inline scap_evt* scap_dev_head_evt(scap_t* handle, scap_device* dev)
+{
+#ifndef _WIN32
+	if(handle->m_bpf)
+	{
+		return scap_bpf_evt_from_perf_sample(dev->m_sn_next_event);
+	}
+#endif
+
+	return (scap_evt *) dev->m_sn_next_event;
+}
+
 static bool are_buffers_empty(scap_t* handle)
 {
 	uint32_t j;
@@ -1608,6 +1830,112 @@ static bool are_buffers_empty(scap_t* handle)
 	return true;
 }
 
+static uint64_t get_monotonic_time_ns()
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (uint64_t)(now.QuadPart * (1000000000.0 / freq.QuadPart));
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * (uint64_t) 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static void sleep_with_backoff(scap_t* handle)
+{
+#ifdef _WIN32
+	Sleep((DWORD)handle->m_buffer_empty_wait_time_us / 1000);
+#else
+	usleep(handle->m_buffer_empty_wait_time_us);
+#endif
+	handle->m_buffer_empty_wait_time_us = MIN(handle->m_buffer_empty_wait_time_us * 2,
+						  BUFFER_EMPTY_WAIT_TIME_US_MAX);
+}
+
+#ifndef _WIN32
+//
+// Block until one of the perf buffers crosses its wakeup watermark, or the
+// current backoff time expires
+//
+static int32_t poll_devices(scap_t* handle)
+{
+	uint32_t j;
+	int timeout_ms;
+
+	if(handle->m_pollfds == NULL)
+	{
+		handle->m_pollfds = (struct pollfd*)calloc(handle->m_ndevs, sizeof(struct pollfd));
+		if(handle->m_pollfds == NULL)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the poll descriptors");
+			return SCAP_FAILURE;
+		}
+
+		for(j = 0; j < handle->m_ndevs; j++)
+		{
+			handle->m_pollfds[j].fd = handle->m_devs[j].m_fd;
+			handle->m_pollfds[j].events = POLLIN;
+		}
+	}
+
+	timeout_ms = (int)((handle->m_buffer_empty_wait_time_us + 999) / 1000);
+	if(poll(handle->m_pollfds, handle->m_ndevs, timeout_ms) < 0 && errno != EINTR)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "poll on the devices failed: %s", scap_strerror(handle, errno));
+		return SCAP_FAILURE;
+	}
+
+	handle->m_buffer_empty_wait_time_us = MIN(handle->m_buffer_empty_wait_time_us * 2,
+						  BUFFER_EMPTY_WAIT_TIME_US_MAX);
+	return SCAP_SUCCESS;
+}
+#endif
+
+//
+// Wait for new data according to the wait policy of the handle
+//
+static int32_t wait_for_data(scap_t* handle)
+{
+	uint64_t now;
+
+	switch(handle->m_wait_policy)
+	{
+	case SCAP_WAIT_BUSY_POLL:
+		return SCAP_SUCCESS;
+	case SCAP_WAIT_POLL:
+#ifndef _WIN32
+		if(handle->m_bpf)
+		{
+			return poll_devices(handle);
+		}
+#endif
+		// The kernel module and udig devices can't be polled
+		/* FALLTHROUGH */
+	case SCAP_WAIT_HYBRID:
+		now = get_monotonic_time_ns();
+		if(handle->m_buffer_empty_since_ns == 0)
+		{
+			handle->m_buffer_empty_since_ns = now;
+		}
+
+		if(now - handle->m_buffer_empty_since_ns < BUFFER_EMPTY_SPIN_TIME_US * 1000)
+		{
+			return SCAP_SUCCESS;
+		}
+		/* FALLTHROUGH */
+	case SCAP_WAIT_BACKOFF:
+	default:
+		sleep_with_backoff(handle);
+		return SCAP_SUCCESS;
+	}
+}
+
 int32_t refill_read_buffers(scap_t* handle)
 {
 	uint32_t j;
@@ -1615,22 +1943,23 @@ int32_t refill_read_buffers(scap_t* handle)
 
 	if(are_buffers_empty(handle))
 	{
-#ifdef _WIN32
-		Sleep((DWORD)handle->m_buffer_empty_wait_time_us / 1000);
-#else
-		usleep(handle->m_buffer_empty_wait_time_us);
-#endif
-		handle->m_buffer_empty_wait_time_us = MIN(handle->m_buffer_empty_wait_time_us * 2,
-							  BUFFER_EMPTY_WAIT_TIME_US_MAX);
+		int32_t res = wait_for_data(handle);
+		if(res != SCAP_SUCCESS)
+		{
+			return res;
+		}
 	}
 	else
 	{
 		handle->m_buffer_empty_wait_time_us = BUFFER_EMPTY_WAIT_TIME_US_START;
+		handle->m_buffer_empty_since_ns = 0;
 	}
 
 	//
-	// Refill our data for each of the devices
+	// Refill our data for each of the devices, and rebuild the merge heap
+	// from the events now sitting at the head of each of them
 	//
+	scap_merge_clear(&handle->m_merge);
 
 	for(j = 0; j < ndevs; j++)
 	{
@@ -1645,8 +1974,26 @@ int32_t refill_read_buffers(scap_t* handle)
 		{
 			return res;
 		}
+
+		if(dev->m_sn_len == 0)
+		{
+			//
+			// Nothing from this device was handed out, so we can
+			// release what we read (e.g. lost samples) right away
+			//
+			if(dev->m_lastreadsize > 0)
+			{
+				scap_advance_tail(handle, j);
+			}
+
+			continue;
+		}
+
+		scap_merge_append(&handle->m_merge, scap_dev_head_evt(handle, dev)->ts, j);
 	}
 
+	scap_merge_build(&handle->m_merge);
+
 	//
 	// Note: we might return a spurious timeout here in case the previous loop extracted valid data to parse.
 	//       It's ok, since this is rare and the caller will just call us again after receiving a
@@ -1655,123 +2002,204 @@ int32_t refill_read_buffers(scap_t* handle)
 	return SCAP_TIMEOUT;
 }
 
-#endif // HAS_CAPTURE
+//
+// If the previous event drained its device, the caller is done with it
+// now, so we can free the resources for the producer rather than
+// sitting on them.
+//
+static inline void release_drained_dev(scap_t* handle)
+{
+	scap_merge_heap* merge = &handle->m_merge;
 
-#ifndef _WIN32
-static inline int32_t scap_next_live(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
-#else
-static int32_t scap_next_live(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
-#endif
+	if(merge->m_drained_dev != SCAP_MERGE_NO_DEV)
+	{
+		scap_device* dev = &handle->m_devs[merge->m_drained_dev];
+		if(dev->m_sn_len == 0 && dev->m_lastreadsize > 0)
+		{
+			scap_advance_tail(handle, merge->m_drained_dev);
+		}
+		merge->m_drained_dev = SCAP_MERGE_NO_DEV;
+	}
+}
+
+//
+// All the buffers have been consumed. Release them, then check if
+// there's enough data to keep going or if we should wait.
+//
+static inline int32_t release_and_refill(scap_t* handle)
 {
-#if !defined(HAS_CAPTURE) || defined(CYGWING_AGENT)
-	//
-	// this should be prevented at open time
-	//
-	ASSERT(false);
-	return SCAP_FAILURE;
-#else
 	uint32_t j;
-	uint64_t max_ts = 0xffffffffffffffffLL;
-	scap_evt* pe = NULL;
-	uint32_t ndevs = handle->m_ndevs;
-
-	*pcpuid = 65535;
 
-	for(j = 0; j < ndevs; j++)
+	for(j = 0; j < handle->m_ndevs; j++)
 	{
-		scap_device* dev = &(handle->m_devs[j]);
-
-		if(dev->m_sn_len == 0)
+		if(handle->m_devs[j].m_lastreadsize > 0)
 		{
-			//
-			// If we don't have data from this ring, but we are
-			// still occupying, free the resources for the
-			// producer rather than sitting on them.
-			//
-			if(dev->m_lastreadsize > 0)
-			{
-				scap_advance_tail(handle, j);
-			}
-
-			continue;
+			scap_advance_tail(handle, j);
 		}
+	}
 
-		if(handle->m_bpf)
-		{
+	return refill_read_buffers(handle);
+}
+
+//
+// Move the head of the given device past the event pe
+//
+static inline void advance_head(scap_t* handle, uint32_t devid, scap_evt* pe)
+{
+	scap_device* dev = &handle->m_devs[devid];
+
+	if(handle->m_bpf)
+	{
 #ifndef _WIN32
-			pe = scap_bpf_evt_from_perf_sample(dev->m_sn_next_event);
+		scap_bpf_advance_to_evt(handle, devid, true,
+					dev->m_sn_next_event,
+					&dev->m_sn_next_event,
+					&dev->m_sn_len);
 #endif
-		}
-		else
-		{
-			pe = (scap_evt *) dev->m_sn_next_event;
-		}
+	}
+	else
+	{
+		ASSERT(dev->m_sn_len >= pe->len);
+		dev->m_sn_len -= pe->len;
+		dev->m_sn_next_event += pe->len;
+	}
+}
+
+static inline int32_t check_head_evt(scap_t* handle, scap_device* dev, scap_evt* pe)
+{
+	if(pe->len > dev->m_sn_len)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "scap_next buffer corruption");
 
 		//
-		// We want to consume the event with the lowest timestamp
+		// if you get the following assertion, first recompile the driver and libscap
 		//
-		if(pe->ts < max_ts)
-		{
-			if(pe->len > dev->m_sn_len)
-			{
-				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "scap_next buffer corruption");
+		ASSERT(false);
+		return SCAP_FAILURE;
+	}
 
-				//
-				// if you get the following assertion, first recompile the driver and libscap
-				//
-				ASSERT(false);
-				return SCAP_FAILURE;
-			}
+	return SCAP_SUCCESS;
+}
+
+//
+// With relaxed ordering, the devices are served one at a time in round
+// robin, and each of them is drained before moving to the next one.
+// Returns false if no device has data left.
+//
+static inline bool pick_relaxed_dev(scap_t* handle, OUT uint32_t* pdevid)
+{
+	uint32_t ndevs = handle->m_ndevs;
+	uint32_t j;
+
+	for(j = 0; j < ndevs; j++)
+	{
+		uint32_t devid = (handle->m_next_dev + j) % ndevs;
 
-			*pevent = pe;
-			*pcpuid = j;
-			max_ts = pe->ts;
+		if(handle->m_devs[devid].m_sn_len > 0)
+		{
+			*pdevid = devid;
+			handle->m_next_dev = devid;
+			return true;
 		}
 	}
 
+	return false;
+}
+
+static int32_t scap_next_live_relaxed(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
+{
+	scap_device* dev;
+	scap_evt* pe;
+	uint32_t j;
+
+	release_drained_dev(handle);
+
+	if(!pick_relaxed_dev(handle, &j))
+	{
+		*pcpuid = 65535;
+		return release_and_refill(handle);
+	}
+
+	dev = &handle->m_devs[j];
+	pe = scap_dev_head_evt(handle, dev);
+	if(check_head_evt(handle, dev, pe) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	*pevent = pe;
+	*pcpuid = j;
+
+	advance_head(handle, j, pe);
+	if(dev->m_sn_len == 0)
+	{
+		handle->m_merge.m_drained_dev = j;
+		handle->m_next_dev = (j + 1) % handle->m_ndevs;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+static int32_t scap_next_live_batch(scap_t* handle, OUT scap_evt_batch* batch)
+{
+	scap_device* dev;
+	uint32_t nevts = 0;
+	uint32_t j;
+
+	release_drained_dev(handle);
+
+	if(!pick_relaxed_dev(handle, &j))
+	{
+		batch->cpuid = 65535;
+		return release_and_refill(handle);
+	}
+
 	//
-	// Check which buffer has been picked
+	// Hand out everything the device has. The events stay in the ring
+	// buffer, and its tail is released only at the next call.
 	//
-	if(*pcpuid != 65535)
+	dev = &handle->m_devs[j];
+	while(dev->m_sn_len > 0)
 	{
-		struct scap_device *dev = &handle->m_devs[*pcpuid];
-
-		//
-		// Update the pointers.
-		//
-		if(handle->m_bpf)
+		scap_evt* pe = scap_dev_head_evt(handle, dev);
+		if(check_head_evt(handle, dev, pe) != SCAP_SUCCESS)
 		{
-#ifndef _WIN32
-			scap_bpf_advance_to_evt(handle, *pcpuid, true,
-						dev->m_sn_next_event,
-						&dev->m_sn_next_event,
-						&dev->m_sn_len);
-#endif
+			return SCAP_FAILURE;
 		}
-		else
+
+		if(nevts == handle->m_batch_evts_size)
 		{
-			ASSERT(dev->m_sn_len >= (*pevent)->len);
-			dev->m_sn_len -= (*pevent)->len;
-			dev->m_sn_next_event += (*pevent)->len;
+			uint32_t new_size = nevts ? nevts * 2 : 1024;
+			scap_evt** new_evts = (scap_evt**)realloc(handle->m_batch_evts, new_size * sizeof(scap_evt*));
+			if(new_evts == NULL)
+			{
+				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the event batch");
+				return SCAP_FAILURE;
+			}
+
+			handle->m_batch_evts = new_evts;
+			handle->m_batch_evts_size = new_size;
 		}
 
-		return SCAP_SUCCESS;
-	}
-	else
-	{
-		//
-		// All the buffers have been consumed. Check if there's enough data to keep going or
-		// if we should wait.
-		//
-		return refill_read_buffers(handle);
+		handle->m_batch_evts[nevts++] = pe;
+		advance_head(handle, j, pe);
 	}
-#endif
+
+	handle->m_merge.m_drained_dev = j;
+	handle->m_next_dev = (j + 1) % handle->m_ndevs;
+
+	batch->cpuid = j;
+	batch->evts = handle->m_batch_evts;
+	batch->nevts = nevts;
+	return SCAP_SUCCESS;
 }
 
+#endif // HAS_CAPTURE
+
 #ifndef _WIN32
-static inline int32_t scap_next_udig(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
+static inline int32_t scap_next_live(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
 #else
-static int32_t scap_next_udig(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
+static int32_t scap_next_live(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
 #endif
 {
 #if !defined(HAS_CAPTURE) || defined(CYGWING_AGENT)
@@ -1781,79 +2209,82 @@ static int32_t scap_next_udig(scap_t* handle, OUT scap_evt** pevent, OUT uint16_
 	ASSERT(false);
 	return SCAP_FAILURE;
 #else
+	scap_merge_heap* merge = &handle->m_merge;
+	scap_device* dev;
+	scap_evt* pe;
 	uint32_t j;
-	uint64_t max_ts = 0xffffffffffffffffLL;
-	scap_evt* pe = NULL;
-	uint32_t ndevs = handle->m_ndevs;
-
-	*pcpuid = 65535;
 
-	for(j = 0; j < ndevs; j++)
+	if(handle->m_relaxed_ordering)
 	{
-		scap_device* dev = &(handle->m_devs[j]);
+		return scap_next_live_relaxed(handle, pevent, pcpuid);
+	}
 
-		if(dev->m_sn_len == 0)
-		{
-			//
-			// If we don't have data from this ring, but we are
-			// still occupying, free the resources for the
-			// producer rather than sitting on them.
-			//
-			if(dev->m_lastreadsize > 0)
-			{
-				scap_advance_tail(handle, j);
-			}
+	release_drained_dev(handle);
 
-			continue;
-		}
+	//
+	// Skip the devices whose buffers have been flushed behind our back
+	// (e.g. by scap_set_snaplen)
+	//
+	while(!scap_merge_empty(merge) &&
+	      handle->m_devs[scap_merge_top(merge)->dev].m_sn_len == 0)
+	{
+		scap_merge_pop(merge);
+	}
 
-		pe = (scap_evt *) dev->m_sn_next_event;
+	if(scap_merge_empty(merge))
+	{
+		*pcpuid = 65535;
+		return release_and_refill(handle);
+	}
 
-		//
-		// We want to consume the event with the lowest timestamp
-		//
-		if(pe->ts < max_ts)
-		{
-			if(pe->len > dev->m_sn_len)
-			{
-				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "scap_next buffer corruption");
+	//
+	// We want to consume the event with the lowest timestamp, which is the
+	// one at the head of the device on top of the heap
+	//
+	j = scap_merge_top(merge)->dev;
+	dev = &handle->m_devs[j];
+	pe = scap_dev_head_evt(handle, dev);
+	if(check_head_evt(handle, dev, pe) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
 
-				//
-				// if you get the following assertion, first recompile the driver and libscap
-				//
-				ASSERT(false);
-				return SCAP_FAILURE;
-			}
+	*pevent = pe;
+	*pcpuid = j;
 
-			*pevent = pe;
-			*pcpuid = j;
-			max_ts = pe->ts;
-		}
-	}
+	advance_head(handle, j, pe);
 
 	//
-	// Check which buffer has been picked
+	// Move the device to its new position in the heap
 	//
-	if(*pcpuid != 65535)
+	if(dev->m_sn_len == 0)
 	{
-		struct scap_device *dev = &handle->m_devs[*pcpuid];
-		ASSERT(dev->m_sn_len >= (*pevent)->len);
-		dev->m_sn_len -= (*pevent)->len;
-		dev->m_sn_next_event += (*pevent)->len;
-
-		return SCAP_SUCCESS;
+		scap_merge_pop(merge);
+		merge->m_drained_dev = j;
 	}
 	else
 	{
-		//
-		// All the buffers have been consumed. Check if there's enough data to keep going or
-		// if we should wait.
-		//
-		return refill_read_buffers(handle);
+		scap_merge_replace_top(merge, scap_dev_head_evt(handle, dev)->ts);
 	}
+
+	return SCAP_SUCCESS;
 #endif
 }
 
+#ifndef _WIN32
+static inline int32_t scap_next_udig(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
+#else
+static int32_t scap_next_udig(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
+#endif
+{
+	//
+	// udig devices expose the same ring buffer layout as the kernel module
+	// ones, so they go through the same merge
+	//
+	ASSERT(!handle->m_bpf);
+	return scap_next_live(handle, pevent, pcpuid);
+}
+
 #ifndef _WIN32
 static int32_t scap_next_nodriver(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
 {
@@ -2082,6 +2513,69 @@ int32_t scap_next(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
 	return res;
 }
 
+int32_t scap_next_batch(scap_t* handle, OUT scap_evt_batch* batch)
+{
+	int32_t res;
+	uint32_t j;
+	uint32_t nkept = 0;
+
+	batch->evts = NULL;
+	batch->nevts = 0;
+
+	if(handle->m_mode != SCAP_MODE_LIVE || !handle->m_relaxed_ordering)
+	{
+		//
+		// Sources that must be merged in order are returned one event at a time
+		//
+		res = scap_next(handle, &handle->m_batch_single_evt, &batch->cpuid);
+		if(res == SCAP_SUCCESS)
+		{
+			batch->evts = &handle->m_batch_single_evt;
+			batch->nevts = 1;
+		}
+		return res;
+	}
+
+#if !defined(HAS_CAPTURE) || defined(CYGWING_AGENT)
+	ASSERT(false);
+	return SCAP_FAILURE;
+#else
+	res = scap_next_live_batch(handle, batch);
+	if(res != SCAP_SUCCESS)
+	{
+		return res;
+	}
+
+	//
+	// Drop the suppressed events from the batch, the same way scap_next() does
+	//
+	for(j = 0; j < batch->nevts; j++)
+	{
+		bool suppressed;
+
+		if((res = scap_check_suppressed(handle, batch->evts[j], &suppressed)) != SCAP_SUCCESS)
+		{
+			batch->nevts = 0;
+			return res;
+		}
+
+		if(suppressed)
+		{
+			handle->m_num_suppressed_evts++;
+		}
+		else
+		{
+			batch->evts[nkept++] = batch->evts[j];
+		}
+	}
+
+	batch->nevts = nkept;
+	handle->m_evtcnt += nkept;
+
+	return nkept > 0 ? SCAP_SUCCESS : SCAP_TIMEOUT;
+#endif
+}
+
 //
 // Return the process list for the given handle
 //
@@ -2131,6 +2625,12 @@ int32_t scap_get_stats(scap_t* handle, OUT scap_stats* stats)
 	return SCAP_SUCCESS;
 }
 
+int32_t scap_get_proc_scan_stats(scap_t* handle, OUT scap_proc_scan_stats* stats)
+{
+	*stats = handle->m_proc_scan_stats;
+	return SCAP_SUCCESS;
+}
+
 //
 // Stop capturing the events
 //
@@ -121,6 +121,25 @@ typedef struct scap_stats
 	uint64_t n_tids_suppressed; ///< Number of threads currently being suppressed.
 }scap_stats;
 
+/*!
+  \brief Statistics about the last scan of /proc, done when the capture
+  is opened and when the process table is refreshed. Only n_workers and
+  total_ns are set when the scan runs on the calling thread only.
+*/
+typedef struct scap_proc_scan_stats
+{
+	uint32_t n_workers; ///< Number of threads that read /proc. 1 if the scan ran on the calling thread only.
+	uint64_t n_threads; ///< Number of threads read, including the main thread of each process.
+	uint64_t n_fds; ///< Number of file descriptors read.
+	uint64_t n_net_ns; ///< Number of network namespaces whose sockets were read.
+	uint64_t list_ns; ///< Time spent listing the processes, in nanoseconds.
+	uint64_t threads_ns; ///< Time spent reading the processes and their threads.
+	uint64_t sockets_ns; ///< Time spent reading the sockets of the network namespaces.
+	uint64_t fds_ns; ///< Time spent reading the file descriptors of the processes.
+	uint64_t merge_ns; ///< Time spent adding the threads to the process table, or passing them to the proc callback.
+	uint64_t total_ns; ///< Total time of the scan.
+}scap_proc_scan_stats;
+
 /*!
   \brief Information about the parameter of an event
 */
@@ -329,6 +348,33 @@ typedef struct {
 	bool ppm_sc[PPM_SC_MAX];
 } interesting_ppm_sc_set;
 
+/*!
+  \brief How a live capture waits for new data when all the buffers are empty
+*/
+typedef enum scap_wait_policy
+{
+	SCAP_WAIT_BACKOFF = 0, ///< Sleep, doubling the sleep time at every empty read (default).
+	SCAP_WAIT_BUSY_POLL = 1, ///< Never sleep. Lowest latency, burns a CPU.
+	SCAP_WAIT_HYBRID = 2, ///< Spin for a short time, then sleep with backoff.
+	SCAP_WAIT_POLL = 3, ///< Block in poll() on the devices until enough data is available. Requires the eBPF probe, other drivers fall back to SCAP_WAIT_HYBRID.
+}scap_wait_policy;
+
+/*!
+  \brief Values of scap_open_args.decompression_threads that inflate gzip
+  captures on the reading thread (the default), or on a number of
+  background threads picked based on the CPUs
+*/
+#define SCAP_DECOMPRESSION_INLINE 0
+#define SCAP_DECOMPRESSION_AUTO 0xffffffff
+
+/*!
+  \brief Values of scap_open_args.proc_scan_threads that scan /proc on the
+  calling thread (the default), or on a number of threads picked based on
+  the CPUs
+*/
+#define SCAP_PROC_SCAN_SERIAL 0
+#define SCAP_PROC_SCAN_AUTO 0xffffffff
+
 typedef struct scap_open_args
 {
 	scap_mode_t mode;
@@ -348,8 +394,26 @@ typedef struct scap_open_args
 
 	scap_source_plugin* input_plugin; ///< use this to configure a source plugin that will produce the events for this capture
 	char* input_plugin_params; ///< optional parameters string for the source plugin pointed by src_plugin
+	scap_wait_policy wait_policy; ///< How live captures wait for new data when the buffers are empty.
+	bool relaxed_ordering; ///< If true, live events are returned in timestamp order only within each CPU, which avoids merging the per-CPU buffers. Required by scap_next_batch() to return more than one event at a time.
+	uint32_t decompression_threads; ///< Number of threads inflating a gzip capture file ahead of the reader. 0 (SCAP_DECOMPRESSION_INLINE) inflates on the reading thread, SCAP_DECOMPRESSION_AUTO picks it based on the CPUs.
+	uint32_t proc_scan_threads; ///< Number of threads scanning /proc when a live capture is opened and when its process table is refreshed. 0 (SCAP_PROC_SCAN_SERIAL) and 1 scan on the calling thread, SCAP_PROC_SCAN_AUTO picks it based on the CPUs.
+	bool lazy_fd_tables; ///< If true, the processes found in /proc when a live capture is opened, or when its process table is refreshed, are added without their fds, that are read later with scap_proc_read_fds().
+	bool skip_proc_scan; ///< If true, a nodriver capture starts with an empty process table instead of scanning /proc. The table can be filled later with scap_refresh_proc_table().
+	uint64_t start_ts; ///< If non zero, reading starts from the last checkpoint before this timestamp, found in the index of the capture file (see scap_dump_enable_index). The events between the checkpoint and start_ts are still returned. Requires fname.
+	uint32_t start_checkpoint; ///< If non zero, reading starts from this checkpoint, by its position in the index of the capture file (see scap_read_index), which tells apart checkpoints with the same timestamp. Overrides start_ts. Requires fname.
 }scap_open_args;
 
+/*!
+  \brief A batch of events captured on the same CPU, as returned by scap_next_batch()
+*/
+typedef struct scap_evt_batch
+{
+	uint16_t cpuid; ///< ID of the CPU where the events were captured.
+	uint32_t nevts; ///< Number of events in the batch.
+	scap_evt** evts; ///< The events, in timestamp order.
+}scap_evt_batch;
+
 
 //
 // The following stuff is byte aligned because we save it to disk.
@@ -535,7 +599,8 @@ typedef enum event_direction
 typedef enum compression_mode
 {
 	SCAP_COMPRESSION_NONE = 0,
-	SCAP_COMPRESSION_GZIP = 1
+	SCAP_COMPRESSION_GZIP = 1,
+	SCAP_COMPRESSION_GZIP_CHUNKED = 2 ///< gzip, split in independently compressed chunks that can be inflated in parallel when reading
 }compression_mode;
 
 /*!
@@ -732,6 +797,26 @@ uint64_t scap_max_buf_used(scap_t* handle);
 */
 int32_t scap_next(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid);
 
+/*!
+  \brief Get all the events currently available in the buffer of one CPU
+
+  \param handle Handle to the capture instance.
+  \param batch User-provided batch that will be initialized with the events
+    and the ID of the CPU where they were captured.
+
+  \return SCAP_SUCCESS if the call is successful and batch contains at least one event.
+   SCAP_TIMEOUT in case the read timeout expired and no event is available.
+   SCAP_EOF when the end of an offline capture is reached.
+   On Failure, SCAP_FAILURE is returned and scap_getlasterr() can be used to obtain the cause of the error.
+
+  \note Only live captures opened with relaxed_ordering return more than one
+   event per call: the CPU buffers are drained in round robin, and there is no
+   timestamp ordering across batches. For all the other captures, this is
+   equivalent to scap_next().
+  \note The events are valid until the next call to scap_next() or scap_next_batch().
+*/
+int32_t scap_next_batch(scap_t* handle, OUT scap_evt_batch* batch);
+
 /*!
   \brief Get the length of an event
 
@@ -803,6 +888,31 @@ int64_t scap_get_readfile_offset(scap_t* handle);
 */
 scap_dumper_t* scap_dump_open(scap_t *handle, const char *fname, compression_mode compress, bool skip_proc_scan);
 
+/*!
+  \brief Flags for scap_dump_open_ex
+*/
+typedef enum scap_dump_open_flags
+{
+	SCAP_DOF_NONE = 0,
+	SCAP_DOF_BACKGROUND_WRITE = 1,	///< Copy the events into large buffers, that are compressed
+									///< and written by a background thread
+	SCAP_DOF_DIRECT_IO = (1 << 1),	///< With SCAP_DOF_BACKGROUND_WRITE, write the file with O_DIRECT,
+									///< if its filesystem supports it
+}scap_dump_open_flags;
+
+/*!
+  \brief Open a trace file for writing, like \ref scap_dump_open, with a
+         combination of \ref scap_dump_open_flags. The flags are ignored
+         when writing to standard output.
+
+  \param handle Handle to the capture instance.
+  \param fname The name of the trace file.
+  \param flags A combination of \ref scap_dump_open_flags
+
+  \return Dump handle that can be used to identify this specific dump instance.
+*/
+scap_dumper_t* scap_dump_open_ex(scap_t *handle, const char *fname, compression_mode compress, bool skip_proc_scan, uint32_t flags);
+
 /*!
   \brief Open a trace file for writing, using the provided fd.
 
@@ -844,6 +954,72 @@ int64_t scap_dump_ftell(scap_dumper_t *d);
 */
 void scap_dump_flush(scap_dumper_t *d);
 
+/*!
+  \brief Keep an index of the state checkpoints written to a trace file,
+         and save it to "<fname>.idx" when the dumper is closed.
+
+  A checkpoint is a new section of the file, with the complete process,
+  fd, interface and user lists, like the ones found in merged files.
+  Reading can start from any checkpoint, see scap_open_args.start_ts and
+  scap_open_args.start_checkpoint.
+
+  \param handle Handle to the capture instance.
+  \param d The dump handle, returned by \ref scap_dump_open. Dumpers opened
+         on a file descriptor or in memory have no index.
+  \param checkpoint_interval_ns If non zero, \ref scap_dump writes a
+         checkpoint before the first event that comes this much after the
+         previous checkpoint. With 0, the checkpoints are only written by
+         \ref scap_dump_checkpoint.
+
+  \return SCAP_SUCCESS if the call is successful.
+*/
+int32_t scap_dump_enable_index(scap_t *handle, scap_dumper_t *d, uint64_t checkpoint_interval_ns);
+
+/*!
+  \brief Write a state checkpoint to a trace file, before an event with
+         timestamp ts. If the dumper was opened with skip_proc_scan, the
+         process list is written by the caller, as after \ref scap_dump_open.
+
+  \param handle Handle to the capture instance.
+  \param d The dump handle, returned by \ref scap_dump_open.
+  \param ts Timestamp of the next event that will be written.
+
+  \return SCAP_SUCCESS if the call is successful.
+*/
+int32_t scap_dump_checkpoint(scap_t *handle, scap_dumper_t *d, uint64_t ts);
+
+/*!
+  \brief A state checkpoint of a trace file, see \ref scap_dump_enable_index
+*/
+typedef struct scap_index_entry
+{
+	uint64_t ts; ///< Timestamp of the first event after the checkpoint. 0 for the beginning of the file.
+	uint64_t evtnum; ///< Number of events written before the checkpoint.
+	uint64_t offset; ///< Offset of the checkpoint in the uncompressed data, as returned by \ref scap_ftell.
+	uint64_t file_offset; ///< Offset of the checkpoint in the file. Different from offset for compressed files.
+}scap_index_entry;
+
+/*!
+  \brief Load the index of a trace file.
+
+  \param fname The name of the trace file. The index is read from "<fname>.idx".
+  \param entries Filled with an array of checkpoints, in file order, that
+         the caller must free().
+  \param nentries Filled with the number of checkpoints.
+  \param compress Filled with the compression mode of the trace file.
+  \param error Filled with the error on failure.
+
+  \return SCAP_SUCCESS if the call is successful. The call fails if the
+          index was written for another version of the file.
+*/
+int32_t scap_read_index(const char *fname, scap_index_entry **entries, uint32_t *nentries, compression_mode *compress, char *error);
+
+/*!
+  \brief Return the position in entries of the last checkpoint at or before
+         ts, or 0 if there's none.
+*/
+uint32_t scap_index_find(const scap_index_entry *entries, uint32_t nentries, uint64_t ts);
+
 /*!
   \brief Tell how many bytes would be written (a dry run of scap_dump)
 
@@ -913,6 +1089,17 @@ scap_threadinfo* scap_get_proc_table(scap_t* handle);
 */
 int32_t scap_get_stats(scap_t* handle, OUT scap_stats* stats);
 
+/*!
+  \brief Return the statistics of the last scan of /proc, see
+  \ref scap_proc_scan_stats. They are all 0 if /proc was never scanned.
+
+  \param handle Handle to the capture instance.
+  \param stats Pointer to the structure that will be filled.
+
+  \return SCAP_SUCCESS.
+*/
+int32_t scap_get_proc_scan_stats(scap_t* handle, OUT scap_proc_scan_stats* stats);
+
 /*!
   \brief This function can be used to temporarily interrupt event capture.
 
@@ -1132,6 +1319,11 @@ uint32_t scap_event_get_sentinel_begin(scap_evt* e);
 // The returned pointer must be freed via scap_proc_free by the caller.
 struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_sockets);
 
+// Read the fds of the process of the given thread from /proc into its fdlist, as
+// the scan of the processes does. Used when the capture was opened with
+// lazy_fd_tables.
+int32_t scap_proc_read_fds(scap_t* handle, struct scap_threadinfo* tinfo);
+
 // Check if the given thread exists in ;proc
 bool scap_is_thread_alive(scap_t* handle, int64_t pid, int64_t tid, const char* comm);
 
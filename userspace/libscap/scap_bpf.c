@@ -1497,6 +1497,17 @@ int32_t scap_bpf_load(scap_t *handle, const char *bpf_probe)
 		};
 		int pmu_fd;
 
+		//
+		// When the consumer blocks in poll(), wake it up as soon as there
+		// is enough data for refill_read_buffers() to consider the
+		// buffer not empty, instead of when the buffer is half full
+		//
+		if(handle->m_wait_policy == SCAP_WAIT_POLL)
+		{
+			attr.watermark = 1;
+			attr.wakeup_watermark = BUFFER_EMPTY_THRESHOLD_B;
+		}
+
 		if(j > 0)
 		{
 			char filename[SCAP_MAX_PATH_SIZE];
@@ -1879,6 +1879,27 @@ char * decode_st_mode(struct stat* sb)
     	break;
     }
 }
+//
+// Get the network namespace of the process in procdir, 0 if not available
+//
+uint64_t scap_fd_read_net_ns(const char *procdir)
+{
+	char f_name[SCAP_MAX_PATH_SIZE];
+	char link_name[SCAP_MAX_PATH_SIZE];
+	uint64_t net_ns = 0;
+	ssize_t r;
+
+	snprintf(f_name, sizeof(f_name), "%sns/net", procdir);
+	r = readlink(f_name, link_name, sizeof(link_name) - 1);
+	if(r > 0)
+	{
+		link_name[r] = '\0';
+		sscanf(link_name, "net:[%"PRIi64"]", &net_ns);
+	}
+
+	return net_ns;
+}
+
 //
 // Scan the directory containing the fd's of a proc /proc/x/fd
 //
@@ -1889,12 +1910,10 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 	int32_t res = SCAP_SUCCESS;
 	char fd_dir_name[SCAP_MAX_PATH_SIZE];
 	char f_name[SCAP_MAX_PATH_SIZE];
-	char link_name[SCAP_MAX_PATH_SIZE];
 	struct stat sb;
 	uint64_t fd;
 	scap_fdinfo *fdi = NULL;
 	uint64_t net_ns;
-	ssize_t r;
 	uint16_t fd_added = 0;
 
 	snprintf(fd_dir_name, SCAP_MAX_PATH_SIZE, "%sfd", procdir);
@@ -1905,23 +1924,7 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 		return SCAP_NOTFOUND;
 	}
 
-	//
-	// Get the network namespace of the process
-	//
-	snprintf(f_name, sizeof(f_name), "%sns/net", procdir);
-	r = readlink(f_name, link_name, sizeof(link_name));
-	if(r <= 0)
-	{
-		//
-		// No network namespace available. Assume global
-		//
-		net_ns = 0;
-	}
-	else
-	{
-		link_name[r] = '\0';
-		sscanf(link_name, "net:[%"PRIi64"]", &net_ns);
-	}
+	net_ns = scap_fd_read_net_ns(procdir);
 
 	while((dir_entry_p = readdir(dir_p)) != NULL &&
 		(handle->m_fd_lookup_limit == 0 || fd_added < handle->m_fd_lookup_limit))
@@ -0,0 +1,115 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <stdlib.h>
+#include "scap.h"
+#include "scap_merge.h"
+
+//
+// Ties are broken on the device index, so that the merge returns exactly
+// the same sequence that a linear scan of the devices would.
+//
+static inline bool entry_less(const scap_merge_entry* a, const scap_merge_entry* b)
+{
+	return a->ts < b->ts || (a->ts == b->ts && a->dev < b->dev);
+}
+
+static void sift_down(scap_merge_heap* heap, uint32_t pos)
+{
+	scap_merge_entry* entries = heap->m_entries;
+	uint32_t size = heap->m_size;
+	scap_merge_entry moving = entries[pos];
+
+	while(true)
+	{
+		uint32_t child = 2 * pos + 1;
+
+		if(child >= size)
+		{
+			break;
+		}
+
+		if(child + 1 < size && entry_less(&entries[child + 1], &entries[child]))
+		{
+			child++;
+		}
+
+		if(!entry_less(&entries[child], &moving))
+		{
+			break;
+		}
+
+		entries[pos] = entries[child];
+		pos = child;
+	}
+
+	entries[pos] = moving;
+}
+
+int32_t scap_merge_init(scap_merge_heap* heap, uint32_t capacity)
+{
+	heap->m_size = 0;
+	heap->m_capacity = capacity;
+	heap->m_drained_dev = SCAP_MERGE_NO_DEV;
+	heap->m_entries = (scap_merge_entry*)calloc(capacity > 0 ? capacity : 1, sizeof(scap_merge_entry));
+	if(heap->m_entries == NULL)
+	{
+		heap->m_capacity = 0;
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+void scap_merge_free(scap_merge_heap* heap)
+{
+	free(heap->m_entries);
+	heap->m_entries = NULL;
+	heap->m_size = 0;
+	heap->m_capacity = 0;
+}
+
+void scap_merge_build(scap_merge_heap* heap)
+{
+	uint32_t j;
+
+	for(j = heap->m_size / 2; j > 0; j--)
+	{
+		sift_down(heap, j - 1);
+	}
+}
+
+void scap_merge_replace_top(scap_merge_heap* heap, uint64_t ts)
+{
+	heap->m_entries[0].ts = ts;
+	sift_down(heap, 0);
+}
+
+void scap_merge_pop(scap_merge_heap* heap)
+{
+	if(heap->m_size == 0)
+	{
+		return;
+	}
+
+	heap->m_size--;
+	if(heap->m_size > 0)
+	{
+		heap->m_entries[0] = heap->m_entries[heap->m_size];
+		sift_down(heap, 0);
+	}
+}
@@ -0,0 +1,98 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////
+// K-way merge of the per-device event streams
+////////////////////////////////////////////////////////////////////////////
+
+//
+// Every ring buffer (one per CPU) produces events in timestamp order, and
+// scap_next() must return them in global timestamp order. Instead of scanning
+// all the devices on every call, we keep a binary min-heap keyed on the
+// timestamp of the event sitting at the head of each device. The heap is
+// rebuilt in O(ndevs) when the buffers are refilled, and each consumed event
+// costs O(log ndevs) to move the head of its device.
+//
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCAP_MERGE_NO_DEV 0xffffffff
+
+typedef struct scap_merge_entry
+{
+	uint64_t ts; ///< Timestamp of the event at the head of the device.
+	uint32_t dev; ///< Index of the device in the handle's device array.
+} scap_merge_entry;
+
+typedef struct scap_merge_heap
+{
+	scap_merge_entry* m_entries;
+	uint32_t m_size;
+	uint32_t m_capacity;
+	// Device that ran out of events with the last consumed one. Its tail
+	// can only be released once the caller is done with that event,
+	// i.e. at the next call.
+	uint32_t m_drained_dev;
+} scap_merge_heap;
+
+// Allocate a heap able to hold up to capacity devices
+int32_t scap_merge_init(scap_merge_heap* heap, uint32_t capacity);
+// Release the memory held by the heap
+void scap_merge_free(scap_merge_heap* heap);
+// Restore the heap property over all the entries appended with scap_merge_append()
+void scap_merge_build(scap_merge_heap* heap);
+// Change the timestamp of the minimum entry and move it to its new position
+void scap_merge_replace_top(scap_merge_heap* heap, uint64_t ts);
+// Remove the minimum entry
+void scap_merge_pop(scap_merge_heap* heap);
+
+static inline void scap_merge_clear(scap_merge_heap* heap)
+{
+	heap->m_size = 0;
+}
+
+static inline bool scap_merge_empty(const scap_merge_heap* heap)
+{
+	return heap->m_size == 0;
+}
+
+//
+// Append an entry without restoring the heap property: call
+// scap_merge_build() once all the devices have been added.
+//
+static inline void scap_merge_append(scap_merge_heap* heap, uint64_t ts, uint32_t dev)
+{
+	heap->m_entries[heap->m_size].ts = ts;
+	heap->m_entries[heap->m_size].dev = dev;
+	heap->m_size++;
+}
+
+static inline const scap_merge_entry* scap_merge_top(const scap_merge_heap* heap)
+{
+	return &heap->m_entries[0];
+}
+
+#ifdef __cplusplus
+}
+#endif
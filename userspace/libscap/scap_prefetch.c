@@ -0,0 +1,789 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "settings.h"
+#include "scap.h"
+#include "scap_prefetch.h"
+
+#if defined(USE_ZLIB) && !defined(_WIN32)
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <zlib.h>
+
+// Uncompressed size of the buffers filled from non chunked files
+#define PREFETCH_BUF_SIZE (1024 * 1024)
+// Upper bound of the automatic number of threads
+#define PREFETCH_MAX_AUTO_THREADS 8
+
+#define SLOT_FREE 0
+#define SLOT_FILLING 1
+#define SLOT_READY 2
+
+typedef struct prefetch_slot
+{
+	uint8_t* m_data;
+	uint32_t m_size;
+	uint32_t m_len;
+	int m_state;
+	// Position of this slot in the sequence of buffers
+	uint64_t m_seq;
+	// Offset in the compressed file after the data of this slot
+	uint64_t m_coffset;
+	bool m_eof;
+	bool m_failed;
+} prefetch_slot;
+
+struct scap_prefetch
+{
+	int m_fd;
+	// Only used for non chunked files
+	gzFile m_gz;
+	bool m_chunked;
+	off_t m_start;
+
+	uint32_t m_nthreads;
+	pthread_t* m_threads;
+	bool m_running;
+	pthread_mutex_t m_mutex;
+	pthread_cond_t m_cond;
+
+	//
+	// Shared with the threads, protected by m_mutex
+	//
+	prefetch_slot* m_slots;
+	uint32_t m_nslots;
+	// Next buffer to be filled
+	uint64_t m_next_seq;
+	// Compressed offset of the next chunk to read
+	uint64_t m_coffset;
+	// Set once the end of the file, or an error, is reached
+	bool m_input_done;
+	bool m_stop;
+	char m_lasterr[SCAP_LASTERR_SIZE];
+	int m_errnum;
+
+	//
+	// Owned by the reader
+	//
+	prefetch_slot* m_cur;
+	uint64_t m_cur_seq;
+	uint32_t m_cur_pos;
+	// Uncompressed offset of the start of m_cur
+	uint64_t m_base;
+	// Uncompressed offset of m_start
+	uint64_t m_start_base;
+};
+
+size_t scap_gzchunk_bound(size_t srclen)
+{
+	return compressBound(srclen) + SCAP_GZCHUNK_HEADER_SIZE + SCAP_GZCHUNK_TRAILER_SIZE;
+}
+
+static void put_le32(uint8_t* p, uint32_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = (v >> 24) & 0xff;
+}
+
+static uint32_t get_le32(const uint8_t* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+size_t scap_gzchunk_compress(uint8_t* dst, size_t dstlen, const uint8_t* src, size_t srclen, int level)
+{
+	static const uint8_t hdr[SCAP_GZCHUNK_HEADER_SIZE - 4] = {
+		0x1f, 0x8b, // magic
+		8, // deflate
+		4, // FEXTRA
+		0, 0, 0, 0, // mtime
+		0, // xfl
+		0xff, // os
+		8, 0, // xlen
+		'S', 'C', // subfield id
+		4, 0, // subfield len
+	};
+	z_stream zs;
+	size_t total;
+
+	if(dstlen < SCAP_GZCHUNK_HEADER_SIZE + SCAP_GZCHUNK_TRAILER_SIZE)
+	{
+		return 0;
+	}
+
+	memset(&zs, 0, sizeof(zs));
+	if(deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		return 0;
+	}
+
+	zs.next_in = (Bytef*)src;
+	zs.avail_in = (uInt)srclen;
+	zs.next_out = dst + SCAP_GZCHUNK_HEADER_SIZE;
+	zs.avail_out = (uInt)(dstlen - SCAP_GZCHUNK_HEADER_SIZE - SCAP_GZCHUNK_TRAILER_SIZE);
+
+	if(deflate(&zs, Z_FINISH) != Z_STREAM_END)
+	{
+		deflateEnd(&zs);
+		return 0;
+	}
+
+	total = SCAP_GZCHUNK_HEADER_SIZE + zs.total_out + SCAP_GZCHUNK_TRAILER_SIZE;
+	deflateEnd(&zs);
+
+	memcpy(dst, hdr, sizeof(hdr));
+	put_le32(dst + sizeof(hdr), (uint32_t)total);
+	put_le32(dst + total - SCAP_GZCHUNK_TRAILER_SIZE, crc32(0, src, (uInt)srclen));
+	put_le32(dst + total - 4, (uint32_t)srclen);
+	return total;
+}
+
+uint32_t scap_gzchunk_size(const uint8_t* hdr)
+{
+	if(hdr[0] != 0x1f || hdr[1] != 0x8b || hdr[2] != 8 || !(hdr[3] & 4) ||
+	   hdr[10] != 8 || hdr[11] != 0 ||
+	   hdr[12] != 'S' || hdr[13] != 'C' || hdr[14] != 4 || hdr[15] != 0)
+	{
+		return 0;
+	}
+
+	return get_le32(hdr + 16);
+}
+
+static ssize_t read_full(int fd, uint8_t* buf, size_t len)
+{
+	size_t done = 0;
+
+	while(done < len)
+	{
+		ssize_t res = read(fd, buf + done, len - done);
+		if(res < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(res < 0)
+		{
+			return -1;
+		}
+		if(res == 0)
+		{
+			break;
+		}
+		done += res;
+	}
+
+	return done;
+}
+
+static void set_error(scap_prefetch* p, int errnum, const char* msg)
+{
+	if(p->m_errnum == 0)
+	{
+		p->m_errnum = errnum;
+		snprintf(p->m_lasterr, SCAP_LASTERR_SIZE, "%s", msg);
+	}
+}
+
+//
+// Read the next chunk from the file. Called with the mutex held, so that
+// the chunks are read in order.
+//
+static bool read_chunk(scap_prefetch* p, uint8_t** cbuf, uint32_t* cbuf_size, uint32_t* clen, bool* eof)
+{
+	uint8_t hdr[SCAP_GZCHUNK_HEADER_SIZE];
+	ssize_t res;
+	uint32_t size;
+
+	*eof = false;
+	res = read_full(p->m_fd, hdr, sizeof(hdr));
+	if(res == 0)
+	{
+		*eof = true;
+		return true;
+	}
+
+	if(res != sizeof(hdr) || (size = scap_gzchunk_size(hdr)) < SCAP_GZCHUNK_HEADER_SIZE + SCAP_GZCHUNK_TRAILER_SIZE)
+	{
+		char msg[SCAP_LASTERR_SIZE];
+		snprintf(msg, sizeof(msg), "invalid gzip chunk at offset %" PRIu64, p->m_coffset);
+		set_error(p, Z_DATA_ERROR, msg);
+		return false;
+	}
+
+	if(size > *cbuf_size)
+	{
+		uint8_t* tmp = (uint8_t*)realloc(*cbuf, size);
+		if(tmp == NULL)
+		{
+			set_error(p, Z_MEM_ERROR, "can't allocate the gzip chunk buffer");
+			return false;
+		}
+		*cbuf = tmp;
+		*cbuf_size = size;
+	}
+
+	memcpy(*cbuf, hdr, sizeof(hdr));
+	res = read_full(p->m_fd, *cbuf + sizeof(hdr), size - sizeof(hdr));
+	if(res != (ssize_t)(size - sizeof(hdr)))
+	{
+		set_error(p, Z_DATA_ERROR, "truncated gzip chunk");
+		return false;
+	}
+
+	*clen = size;
+	p->m_coffset += size;
+	return true;
+}
+
+static bool inflate_chunk(z_stream* zs, prefetch_slot* slot, const uint8_t* cbuf, uint32_t clen, char* err)
+{
+	const uint8_t* trailer = cbuf + clen - SCAP_GZCHUNK_TRAILER_SIZE;
+	uint32_t ulen = get_le32(trailer + 4);
+
+	if(ulen > slot->m_size)
+	{
+		uint8_t* tmp = (uint8_t*)realloc(slot->m_data, ulen);
+		if(tmp == NULL)
+		{
+			snprintf(err, SCAP_LASTERR_SIZE, "can't allocate the decompression buffer");
+			return false;
+		}
+		slot->m_data = tmp;
+		slot->m_size = ulen;
+	}
+
+	inflateReset(zs);
+	zs->next_in = (Bytef*)cbuf + SCAP_GZCHUNK_HEADER_SIZE;
+	zs->avail_in = clen - SCAP_GZCHUNK_HEADER_SIZE - SCAP_GZCHUNK_TRAILER_SIZE;
+	zs->next_out = slot->m_data;
+	zs->avail_out = ulen;
+
+	if(inflate(zs, Z_FINISH) != Z_STREAM_END || zs->total_out != ulen ||
+	   crc32(0, slot->m_data, ulen) != get_le32(trailer))
+	{
+		snprintf(err, SCAP_LASTERR_SIZE, "corrupted gzip chunk");
+		return false;
+	}
+
+	slot->m_len = ulen;
+	return true;
+}
+
+static void* prefetch_thread(void* arg)
+{
+	scap_prefetch* p = (scap_prefetch*)arg;
+	uint8_t* cbuf = NULL;
+	uint32_t cbuf_size = 0;
+	z_stream zs;
+	char err[SCAP_LASTERR_SIZE];
+
+	memset(&zs, 0, sizeof(zs));
+	if(p->m_chunked && inflateInit2(&zs, -15) != Z_OK)
+	{
+		pthread_mutex_lock(&p->m_mutex);
+		set_error(p, Z_MEM_ERROR, "can't initialize zlib");
+		p->m_input_done = true;
+		pthread_cond_broadcast(&p->m_cond);
+		pthread_mutex_unlock(&p->m_mutex);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&p->m_mutex);
+	while(!p->m_stop && !p->m_input_done)
+	{
+		uint64_t seq = p->m_next_seq;
+		prefetch_slot* slot = &p->m_slots[seq % p->m_nslots];
+		uint32_t clen = 0;
+		bool eof = false;
+		bool ok = true;
+
+		//
+		// Wait for the reader to be done with the previous content of
+		// the slot
+		//
+		if(slot->m_state != SLOT_FREE)
+		{
+			pthread_cond_wait(&p->m_cond, &p->m_mutex);
+			continue;
+		}
+
+		p->m_next_seq++;
+		slot->m_state = SLOT_FILLING;
+		slot->m_seq = seq;
+		slot->m_len = 0;
+		slot->m_eof = false;
+		slot->m_failed = false;
+
+		if(p->m_chunked)
+		{
+			ok = read_chunk(p, &cbuf, &cbuf_size, &clen, &eof);
+			slot->m_coffset = p->m_coffset;
+			if(!ok || eof)
+			{
+				p->m_input_done = true;
+			}
+		}
+
+		pthread_mutex_unlock(&p->m_mutex);
+
+		err[0] = '\0';
+		if(p->m_chunked)
+		{
+			if(ok && !eof)
+			{
+				ok = inflate_chunk(&zs, slot, cbuf, clen, err);
+			}
+		}
+		else
+		{
+			//
+			// A non chunked file has a single thread, which is
+			// the only one touching m_gz
+			//
+			int res = gzread(p->m_gz, slot->m_data, slot->m_size);
+			if(res < 0)
+			{
+				int errnum;
+				snprintf(err, SCAP_LASTERR_SIZE, "%s", gzerror(p->m_gz, &errnum));
+				ok = false;
+			}
+			else
+			{
+				slot->m_len = res;
+				eof = res == 0;
+			}
+			slot->m_coffset = gzoffset(p->m_gz);
+		}
+
+		pthread_mutex_lock(&p->m_mutex);
+		if(!ok)
+		{
+			if(err[0] != '\0')
+			{
+				set_error(p, Z_DATA_ERROR, err);
+			}
+			slot->m_failed = true;
+			p->m_input_done = true;
+		}
+		else if(eof)
+		{
+			slot->m_eof = true;
+			p->m_input_done = true;
+		}
+		slot->m_state = SLOT_READY;
+		pthread_cond_broadcast(&p->m_cond);
+	}
+	pthread_mutex_unlock(&p->m_mutex);
+
+	if(p->m_chunked)
+	{
+		inflateEnd(&zs);
+	}
+	free(cbuf);
+	return NULL;
+}
+
+static int32_t start_threads(scap_prefetch* p, char* error)
+{
+	uint32_t j;
+
+	p->m_stop = false;
+	p->m_input_done = false;
+	p->m_next_seq = 0;
+	p->m_cur = NULL;
+	p->m_cur_seq = 0;
+	p->m_cur_pos = 0;
+	p->m_base = p->m_start_base;
+	for(j = 0; j < p->m_nslots; j++)
+	{
+		p->m_slots[j].m_state = SLOT_FREE;
+	}
+
+	for(j = 0; j < p->m_nthreads; j++)
+	{
+		if(pthread_create(&p->m_threads[j], NULL, prefetch_thread, p) != 0)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't create the decompression threads");
+			p->m_nthreads = j;
+			return SCAP_FAILURE;
+		}
+	}
+
+	p->m_running = true;
+	return SCAP_SUCCESS;
+}
+
+static void stop_threads(scap_prefetch* p)
+{
+	uint32_t j;
+
+	pthread_mutex_lock(&p->m_mutex);
+	p->m_stop = true;
+	pthread_cond_broadcast(&p->m_cond);
+	pthread_mutex_unlock(&p->m_mutex);
+
+	for(j = 0; j < p->m_nthreads; j++)
+	{
+		pthread_join(p->m_threads[j], NULL);
+	}
+	p->m_running = false;
+}
+
+static void free_prefetch(scap_prefetch* p)
+{
+	uint32_t j;
+
+	if(p->m_slots != NULL)
+	{
+		for(j = 0; j < p->m_nslots; j++)
+		{
+			free(p->m_slots[j].m_data);
+		}
+	}
+	free(p->m_slots);
+	free(p->m_threads);
+	pthread_mutex_destroy(&p->m_mutex);
+	pthread_cond_destroy(&p->m_cond);
+	free(p);
+}
+
+scap_prefetch* scap_prefetch_open(int fd, uint32_t nthreads, char* error)
+{
+	uint8_t hdr[SCAP_GZCHUNK_HEADER_SIZE];
+	scap_prefetch* p;
+	uint32_t j;
+
+	p = (scap_prefetch*)calloc(1, sizeof(scap_prefetch));
+	if(p == NULL)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't allocate the prefetcher");
+		return NULL;
+	}
+
+	p->m_fd = fd;
+	pthread_mutex_init(&p->m_mutex, NULL);
+	pthread_cond_init(&p->m_cond, NULL);
+
+	p->m_start = lseek(fd, 0, SEEK_CUR);
+	p->m_chunked = p->m_start >= 0 &&
+		       pread(fd, hdr, sizeof(hdr), p->m_start) == sizeof(hdr) &&
+		       scap_gzchunk_size(hdr) != 0;
+
+	if(p->m_chunked)
+	{
+		if(nthreads == SCAP_DECOMPRESSION_AUTO)
+		{
+			long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+			nthreads = ncpus > PREFETCH_MAX_AUTO_THREADS ? PREFETCH_MAX_AUTO_THREADS : (ncpus > 1 ? ncpus : 1);
+		}
+		p->m_coffset = p->m_start;
+	}
+	else
+	{
+		//
+		// Non seekable, or non chunked file: inflate it with zlib on
+		// one thread
+		//
+		nthreads = 1;
+		p->m_gz = gzdopen(fd, "rb");
+		if(p->m_gz == NULL)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't open fd %d", fd);
+			close(fd);
+			free_prefetch(p);
+			return NULL;
+		}
+	}
+
+	p->m_nthreads = nthreads;
+	// Every thread can fill a slot while the reader consumes another one
+	// and the next ones are ready
+	p->m_nslots = 2 * nthreads + 2;
+	p->m_threads = (pthread_t*)calloc(nthreads, sizeof(pthread_t));
+	p->m_slots = (prefetch_slot*)calloc(p->m_nslots, sizeof(prefetch_slot));
+	if(p->m_threads == NULL || p->m_slots == NULL)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't allocate the prefetcher");
+		scap_prefetch_close(p);
+		return NULL;
+	}
+
+	for(j = 0; j < p->m_nslots; j++)
+	{
+		p->m_slots[j].m_size = p->m_chunked ? SCAP_GZCHUNK_SIZE : PREFETCH_BUF_SIZE;
+		p->m_slots[j].m_data = (uint8_t*)malloc(p->m_slots[j].m_size);
+		if(p->m_slots[j].m_data == NULL)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't allocate the prefetcher buffers");
+			scap_prefetch_close(p);
+			return NULL;
+		}
+	}
+
+	if(start_threads(p, error) != SCAP_SUCCESS)
+	{
+		scap_prefetch_close(p);
+		return NULL;
+	}
+
+	return p;
+}
+
+void scap_prefetch_set_tell(scap_prefetch* p, int64_t offset)
+{
+	p->m_start_base = offset;
+	p->m_base = offset;
+}
+
+//
+// Make m_cur point to the next ready slot. Returns false at the end of
+// the data or on error.
+//
+static bool next_slot(scap_prefetch* p)
+{
+	prefetch_slot* slot;
+
+	pthread_mutex_lock(&p->m_mutex);
+	if(p->m_cur != NULL)
+	{
+		if(p->m_cur->m_eof || p->m_cur->m_failed)
+		{
+			pthread_mutex_unlock(&p->m_mutex);
+			return false;
+		}
+
+		p->m_base += p->m_cur->m_len;
+		p->m_cur->m_state = SLOT_FREE;
+		p->m_cur = NULL;
+		p->m_cur_seq++;
+		pthread_cond_broadcast(&p->m_cond);
+	}
+
+	slot = &p->m_slots[p->m_cur_seq % p->m_nslots];
+	while(slot->m_state != SLOT_READY || slot->m_seq != p->m_cur_seq)
+	{
+		pthread_cond_wait(&p->m_cond, &p->m_mutex);
+	}
+	pthread_mutex_unlock(&p->m_mutex);
+
+	p->m_cur = slot;
+	p->m_cur_pos = 0;
+	return !slot->m_eof && !slot->m_failed;
+}
+
+int scap_prefetch_read(scap_prefetch* p, void* buf, uint32_t len)
+{
+	uint32_t done = 0;
+
+	while(done < len)
+	{
+		uint32_t avail;
+
+		if(p->m_cur == NULL || p->m_cur_pos == p->m_cur->m_len)
+		{
+			if(!next_slot(p))
+			{
+				if(p->m_cur->m_failed && done == 0)
+				{
+					return -1;
+				}
+				break;
+			}
+			continue;
+		}
+
+		avail = p->m_cur->m_len - p->m_cur_pos;
+		if(avail > len - done)
+		{
+			avail = len - done;
+		}
+
+		memcpy((uint8_t*)buf + done, p->m_cur->m_data + p->m_cur_pos, avail);
+		p->m_cur_pos += avail;
+		done += avail;
+	}
+
+	return done;
+}
+
+int64_t scap_prefetch_offset(scap_prefetch* p)
+{
+	return p->m_cur != NULL ? (int64_t)p->m_cur->m_coffset : p->m_start;
+}
+
+int64_t scap_prefetch_tell(scap_prefetch* p)
+{
+	return p->m_base + p->m_cur_pos;
+}
+
+int64_t scap_prefetch_seek(scap_prefetch* p, int64_t offset, int whence)
+{
+	char error[SCAP_LASTERR_SIZE];
+	int64_t target;
+	uint8_t skipbuf[4096];
+
+	switch(whence)
+	{
+	case SEEK_SET:
+		target = offset;
+		break;
+	case SEEK_CUR:
+		target = scap_prefetch_tell(p) + offset;
+		break;
+	default:
+		return -1;
+	}
+
+	if(target < (int64_t)p->m_start_base)
+	{
+		return -1;
+	}
+
+	//
+	// Going back before the current buffer means decompressing again
+	// from the start of the file, as gzseek() does
+	//
+	if((uint64_t)target < p->m_base)
+	{
+		stop_threads(p);
+		if(lseek(p->m_fd, p->m_start, SEEK_SET) < 0 ||
+		   (p->m_gz != NULL && gzrewind(p->m_gz) != 0))
+		{
+			return -1;
+		}
+		p->m_coffset = p->m_start;
+		if(start_threads(p, error) != SCAP_SUCCESS)
+		{
+			return -1;
+		}
+	}
+
+	if(p->m_cur != NULL && (uint64_t)target <= p->m_base + p->m_cur->m_len)
+	{
+		p->m_cur_pos = (uint32_t)(target - p->m_base);
+		return target;
+	}
+
+	while(scap_prefetch_tell(p) < target)
+	{
+		int64_t left = target - scap_prefetch_tell(p);
+		int res = scap_prefetch_read(p, skipbuf, left < (int64_t)sizeof(skipbuf) ? (uint32_t)left : sizeof(skipbuf));
+		if(res <= 0)
+		{
+			return -1;
+		}
+	}
+
+	return target;
+}
+
+const char* scap_prefetch_error(scap_prefetch* p, int* errnum)
+{
+	*errnum = p->m_errnum;
+	return p->m_lasterr;
+}
+
+int scap_prefetch_close(scap_prefetch* p)
+{
+	int res;
+
+	if(p->m_running)
+	{
+		stop_threads(p);
+	}
+
+	if(p->m_gz != NULL)
+	{
+		res = gzclose(p->m_gz);
+	}
+	else
+	{
+		res = close(p->m_fd);
+	}
+
+	free_prefetch(p);
+	return res;
+}
+
+#else // defined(USE_ZLIB) && !defined(_WIN32)
+
+size_t scap_gzchunk_bound(size_t srclen)
+{
+	return 0;
+}
+
+size_t scap_gzchunk_compress(uint8_t* dst, size_t dstlen, const uint8_t* src, size_t srclen, int level)
+{
+	return 0;
+}
+
+uint32_t scap_gzchunk_size(const uint8_t* hdr)
+{
+	return 0;
+}
+
+scap_prefetch* scap_prefetch_open(int fd, uint32_t nthreads, char* error)
+{
+	snprintf(error, SCAP_LASTERR_SIZE, "background decompression not supported on this platform");
+	return NULL;
+}
+
+void scap_prefetch_set_tell(scap_prefetch* p, int64_t offset)
+{
+}
+
+int scap_prefetch_read(scap_prefetch* p, void* buf, uint32_t len)
+{
+	return -1;
+}
+
+int64_t scap_prefetch_offset(scap_prefetch* p)
+{
+	return -1;
+}
+
+int64_t scap_prefetch_tell(scap_prefetch* p)
+{
+	return -1;
+}
+
+int64_t scap_prefetch_seek(scap_prefetch* p, int64_t offset, int whence)
+{
+	return -1;
+}
+
+const char* scap_prefetch_error(scap_prefetch* p, int* errnum)
+{
+	*errnum = -1;
+	return "background decompression not supported on this platform";
+}
+
+int scap_prefetch_close(scap_prefetch* p)
+{
+	return -1;
+}
+
+#endif // defined(USE_ZLIB) && !defined(_WIN32)
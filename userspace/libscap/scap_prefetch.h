@@ -0,0 +1,92 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////
+// Background decompression of gzip captures
+////////////////////////////////////////////////////////////////////////////
+
+//
+// gzread() inflates on the same thread that parses the events. The
+// prefetcher moves inflate to background threads, that decompress ahead of
+// the reader into a ring of buffers.
+//
+// Files written with SCAP_COMPRESSION_GZIP_CHUNKED are a sequence of gzip
+// members that carry their compressed size in an extra field, like BGZF
+// does. They can be split without inflating them, so several members are
+// inflated in parallel. Other gzip files are inflated by a single background
+// thread. Chunked files are still valid gzip files for any other tool.
+//
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Uncompressed size of a chunk
+#define SCAP_GZCHUNK_SIZE (1024 * 1024)
+// gzip header with the extra field holding the chunk size
+#define SCAP_GZCHUNK_HEADER_SIZE 20
+// gzip trailer: crc32 and uncompressed size
+#define SCAP_GZCHUNK_TRAILER_SIZE 8
+
+typedef struct scap_prefetch scap_prefetch;
+
+//
+// Return the largest size of the chunk created from srclen bytes
+//
+size_t scap_gzchunk_bound(size_t srclen);
+
+//
+// Compress srclen bytes from src into a chunk at dst. Returns the size of
+// the chunk, or 0 on failure.
+//
+size_t scap_gzchunk_compress(uint8_t* dst, size_t dstlen, const uint8_t* src, size_t srclen, int level);
+
+//
+// If hdr, SCAP_GZCHUNK_HEADER_SIZE bytes long, is the header of a chunk,
+// return the total size of the chunk, otherwise 0.
+//
+uint32_t scap_gzchunk_size(const uint8_t* hdr);
+
+//
+// Start decompressing the gzip file open in fd, from its current position,
+// with up to nthreads threads (SCAP_DECOMPRESSION_AUTO picks a number based
+// on the CPUs). The prefetcher takes ownership of fd, that is closed on
+// failure too. Returns NULL, and fills error, on failure.
+//
+scap_prefetch* scap_prefetch_open(int fd, uint32_t nthreads, char* error);
+// Set the offset in the uncompressed data of the position fd was opened at,
+// when it's not the start of the data. Must be called before reading.
+void scap_prefetch_set_tell(scap_prefetch* p, int64_t offset);
+int scap_prefetch_read(scap_prefetch* p, void* buf, uint32_t len);
+// Return the offset in the compressed file of the data being read
+int64_t scap_prefetch_offset(scap_prefetch* p);
+// Return the offset in the uncompressed data
+int64_t scap_prefetch_tell(scap_prefetch* p);
+// Move to an offset in the uncompressed data. SEEK_END is not supported.
+int64_t scap_prefetch_seek(scap_prefetch* p, int64_t offset, int whence);
+const char* scap_prefetch_error(scap_prefetch* p, int* errnum);
+int scap_prefetch_close(scap_prefetch* p);
+
+#ifdef __cplusplus
+}
+#endif
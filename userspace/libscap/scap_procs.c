@@ -30,6 +30,8 @@ limitations under the License.
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
 #include "unixid.h"
 #endif // CYGWING_AGENT
 #endif // HAS_CAPTURE
@@ -710,29 +712,18 @@ int32_t scap_proc_fill_exe_writable(scap_t* handle, struct scap_threadinfo* tinf
 }
 
 //
-// Add a process to the list by parsing its entry under /proc
+// Find out the cgroup version from the filesystems supported by the kernel
 //
-static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procdirname, struct scap_ns_socket_list** sockets_by_ns, scap_threadinfo** procinfo, char *error)
+static int32_t scap_proc_read_cgroup_version(scap_t* handle, char* procdirname, char *error)
 {
-	char dir_name[256];
-	char target_name[SCAP_MAX_PATH_SIZE];
-	int target_res;
-	char filename[252];
-	char line[SCAP_MAX_ENV_SIZE];
-	struct scap_threadinfo* tinfo;
-	int32_t uth_status = SCAP_SUCCESS;
+	char filename[SCAP_MAX_PATH_SIZE];
+	char line[512];
 	FILE* f;
-	size_t filesize;
-	size_t exe_len;
-	bool free_tinfo = false;
-	int32_t res = SCAP_SUCCESS;
-	struct stat dirstat;
-
 
 	if (handle->m_cgroup_version == 0)
 	{
-		snprintf(dir_name, sizeof(dir_name), "%s/filesystems", procdirname);
-		f = fopen(dir_name, "r");
+		snprintf(filename, sizeof(filename), "%s/filesystems", procdirname);
+		f = fopen(filename, "r");
 		if (f)
 		{
 			while(fgets(line, sizeof(line), f) != NULL)
@@ -758,6 +749,28 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 		}
 	}
 
+	return SCAP_SUCCESS;
+}
+
+//
+// Read the entry of a thread under /proc, without its fds. *ptinfo is
+// NULL if it's a kernel thread.
+//
+static int32_t scap_proc_read_from_proc(scap_t* handle, uint32_t tid, char* procdirname, scap_threadinfo** ptinfo, char *error)
+{
+	char dir_name[256];
+	char target_name[SCAP_MAX_PATH_SIZE];
+	int target_res;
+	char filename[252];
+	char line[SCAP_MAX_ENV_SIZE];
+	struct scap_threadinfo* tinfo;
+	FILE* f;
+	size_t filesize;
+	size_t exe_len;
+	struct stat dirstat;
+
+	*ptinfo = NULL;
+
 	snprintf(dir_name, sizeof(dir_name), "%s/%u/", procdirname, tid);
 	snprintf(filename, sizeof(filename), "%sexe", dir_name);
 
@@ -850,20 +863,6 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 		fclose(f);
 	}
 
-	bool suppressed;
-	if ((res = scap_update_suppressed(handle, tinfo->comm, tid, 0, &suppressed)) != SCAP_SUCCESS)
-	{
-		snprintf(error, SCAP_LASTERR_SIZE, "can't update set of suppressed tids (%s)", handle->m_lasterr);
-		free(tinfo);
-		return res;
-	}
-
-	if (suppressed && !procinfo)
-	{
-		free(tinfo);
-		return SCAP_SUCCESS;
-	}
-
 	//
 	// Gather the command line
 	//
@@ -1046,6 +1045,42 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 		return SCAP_FAILURE;
 	}
 
+	*ptinfo = tinfo;
+	return SCAP_SUCCESS;
+}
+
+//
+// Add a process to the list by parsing its entry under /proc
+//
+static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procdirname, struct scap_ns_socket_list** sockets_by_ns, scap_threadinfo** procinfo, char *error)
+{
+	char dir_name[256];
+	struct scap_threadinfo* tinfo;
+	int32_t uth_status = SCAP_SUCCESS;
+	bool free_tinfo = false;
+	int32_t res = SCAP_SUCCESS;
+
+	if((res = scap_proc_read_cgroup_version(handle, procdirname, error)) != SCAP_SUCCESS ||
+	   (res = scap_proc_read_from_proc(handle, tid, procdirname, &tinfo, error)) != SCAP_SUCCESS ||
+	   tinfo == NULL)
+	{
+		return res;
+	}
+
+	bool suppressed;
+	if ((res = scap_update_suppressed(handle, tinfo->comm, tid, 0, &suppressed)) != SCAP_SUCCESS)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't update set of suppressed tids (%s)", handle->m_lasterr);
+		free(tinfo);
+		return res;
+	}
+
+	if (suppressed && !procinfo)
+	{
+		free(tinfo);
+		return SCAP_SUCCESS;
+	}
+
 	//
 	// if procinfo is set we assume this is a runtime lookup so no
 	// need to use the table
@@ -1077,10 +1112,12 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, char* procd
 	}
 
 	//
-	// Only add fds for processes, not threads
+	// Only add fds for processes, not threads. With lazy fd tables they're
+	// read later by scap_proc_read_fds(), unless this is a runtime lookup
 	//
-	if(tinfo->pid == tinfo->tid)
+	if(tinfo->pid == tinfo->tid && (procinfo != NULL || !handle->m_lazy_fd_tables))
 	{
+		snprintf(dir_name, sizeof(dir_name), "%s/%u/", procdirname, tid);
 		res = scap_fd_scan_fd_dir(handle, dir_name, tinfo, sockets_by_ns, error);
 	}
 
@@ -1225,9 +1262,706 @@ static int32_t _scap_proc_scan_proc_dir_impl(scap_t* handle, char* procdirname,
 	return res;
 }
 
+//
+// The parallel scan of /proc runs in phases, each one split across a
+// pool of workers that take the next item with an atomic counter:
+//  - the calling thread lists the processes
+//  - the workers read each process and its threads
+//  - the workers read the sockets of each network namespace, once
+//  - the workers read the fds of each process, sharing those sockets
+//  - the calling thread adds everything to the process table in the order
+//    of /proc, or passes it to the proc callback
+// Each worker has a private handle, with the configuration the /proc
+// readers look at and its own error buffer and mount cache, but no proc
+// callback, so the fds are collected in the fdlist of each thread.
+//
+#define PROC_SCAN_MAX_AUTO_THREADS 8
+
+typedef struct proc_scan_entry
+{
+	uint32_t m_tid;
+	int32_t m_res;
+	scap_threadinfo* m_tinfo;
+	// The other threads of the process
+	scap_threadinfo** m_tasks;
+	uint32_t m_ntasks;
+	uint32_t m_tasks_size;
+	uint64_t m_net_ns;
+	int32_t m_fd_res;
+} proc_scan_entry;
+
+typedef struct proc_scan proc_scan;
+
+typedef struct proc_scan_worker
+{
+	proc_scan* m_scan;
+	scap_t* m_handle;
+	pthread_t m_thread;
+	bool m_started;
+	// Nodes pointing to the shared socket tables, plus the ones of
+	// namespaces found after they were read
+	struct scap_ns_socket_list* m_sockets_by_ns;
+	uint64_t m_nfds;
+} proc_scan_worker;
+
+struct proc_scan
+{
+	scap_t* m_handle;
+	char* m_procdirname;
+	proc_scan_entry* m_entries;
+	uint32_t m_nentries;
+	proc_scan_worker* m_workers;
+	uint32_t m_nworkers;
+
+	//
+	// The socket tables, and the process each one is read from
+	//
+	struct scap_ns_socket_list* m_sockets_by_ns;
+	struct scap_ns_socket_list** m_net_ns;
+	uint32_t* m_net_ns_entry;
+	uint32_t m_nnet_ns;
+
+	//
+	// The phase being run
+	//
+	void (*m_fn)(proc_scan_worker* w, uint32_t idx);
+	uint32_t m_nitems;
+	uint32_t m_next;
+};
+
+static uint64_t proc_scan_now_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * (uint64_t) 1000000000 + ts.tv_nsec;
+}
+
+static void* proc_scan_worker_loop(void* arg)
+{
+	proc_scan_worker* w = (proc_scan_worker*)arg;
+	proc_scan* scan = w->m_scan;
+	uint32_t idx;
+
+	while((idx = __sync_fetch_and_add(&scan->m_next, 1)) < scan->m_nitems)
+	{
+		scan->m_fn(w, idx);
+	}
+
+	return NULL;
+}
+
+//
+// Run fn on each one of the nitems items, and return how long it took.
+// The calling thread is the first worker, so if the others can't be
+// started it still gets through all the items.
+//
+static uint64_t proc_scan_run(proc_scan* scan, void (*fn)(proc_scan_worker* w, uint32_t idx), uint32_t nitems)
+{
+	uint64_t start = proc_scan_now_ns();
+	uint32_t j;
+
+	scan->m_fn = fn;
+	scan->m_nitems = nitems;
+	scan->m_next = 0;
+
+	for(j = 1; j < scan->m_nworkers && j < nitems; j++)
+	{
+		proc_scan_worker* w = &scan->m_workers[j];
+		w->m_started = pthread_create(&w->m_thread, NULL, proc_scan_worker_loop, w) == 0;
+	}
+
+	proc_scan_worker_loop(&scan->m_workers[0]);
+
+	for(j = 1; j < scan->m_nworkers; j++)
+	{
+		proc_scan_worker* w = &scan->m_workers[j];
+		if(w->m_started)
+		{
+			pthread_join(w->m_thread, NULL);
+			w->m_started = false;
+		}
+	}
+
+	return proc_scan_now_ns() - start;
+}
+
+static void proc_scan_read_tasks(proc_scan_worker* w, proc_scan_entry* e)
+{
+	char taskdir[SCAP_MAX_PATH_SIZE];
+	char error[SCAP_LASTERR_SIZE];
+	DIR *dir_p;
+	struct dirent *dir_entry_p;
+	scap_threadinfo* tinfo;
+	uint64_t tid;
+
+	snprintf(taskdir, sizeof(taskdir), "%s/%u/task", w->m_scan->m_procdirname, e->m_tid);
+	dir_p = opendir(taskdir);
+	if(dir_p == NULL)
+	{
+		return;
+	}
+
+	while((dir_entry_p = readdir(dir_p)) != NULL)
+	{
+		if(strspn(dir_entry_p->d_name, "0123456789") != strlen(dir_entry_p->d_name))
+		{
+			continue;
+		}
+
+		tid = atoi(dir_entry_p->d_name);
+		if(tid == e->m_tid)
+		{
+			continue;
+		}
+
+		if(scap_proc_read_from_proc(w->m_handle, tid, taskdir, &tinfo, error) != SCAP_SUCCESS ||
+		   tinfo == NULL)
+		{
+			continue;
+		}
+
+		if(e->m_ntasks == e->m_tasks_size)
+		{
+			uint32_t size = e->m_tasks_size == 0 ? 8 : e->m_tasks_size * 2;
+			scap_threadinfo** tasks = (scap_threadinfo**)realloc(e->m_tasks, size * sizeof(scap_threadinfo*));
+			if(tasks == NULL)
+			{
+				free(tinfo);
+				continue;
+			}
+			e->m_tasks = tasks;
+			e->m_tasks_size = size;
+		}
+		e->m_tasks[e->m_ntasks++] = tinfo;
+	}
+
+	closedir(dir_p);
+}
+
+static void proc_scan_read_threads(proc_scan_worker* w, uint32_t idx)
+{
+	proc_scan* scan = w->m_scan;
+	proc_scan_entry* e = &scan->m_entries[idx];
+	char dir_name[SCAP_MAX_PATH_SIZE];
+	char error[SCAP_LASTERR_SIZE];
+
+	e->m_res = scap_proc_read_from_proc(w->m_handle, e->m_tid, scan->m_procdirname, &e->m_tinfo, error);
+	if(e->m_res != SCAP_SUCCESS)
+	{
+		return;
+	}
+
+	if(e->m_tinfo != NULL && e->m_tinfo->pid == e->m_tinfo->tid)
+	{
+		snprintf(dir_name, sizeof(dir_name), "%s/%u/", scan->m_procdirname, e->m_tid);
+		e->m_net_ns = scap_fd_read_net_ns(dir_name);
+	}
+
+	//
+	// The threads are listed even if the main one is gone, as long as
+	// the process is there
+	//
+	if(w->m_handle->m_mode != SCAP_MODE_NODRIVER)
+	{
+		proc_scan_read_tasks(w, e);
+	}
+}
+
+static void proc_scan_read_sockets(proc_scan_worker* w, uint32_t idx)
+{
+	proc_scan* scan = w->m_scan;
+	char dir_name[SCAP_MAX_PATH_SIZE];
+	char error[SCAP_LASTERR_SIZE];
+
+	//
+	// On failure the table is left empty, and no socket of the namespace
+	// gets its addresses
+	//
+	snprintf(dir_name, sizeof(dir_name), "%s/%u/", scan->m_procdirname, scan->m_entries[scan->m_net_ns_entry[idx]].m_tid);
+	scap_fd_read_sockets(w->m_handle, dir_name, scan->m_net_ns[idx], error);
+}
+
+static void proc_scan_read_fds(proc_scan_worker* w, uint32_t idx)
+{
+	proc_scan* scan = w->m_scan;
+	proc_scan_entry* e = &scan->m_entries[idx];
+	char dir_name[SCAP_MAX_PATH_SIZE];
+	char error[SCAP_LASTERR_SIZE];
+
+	//
+	// Only add fds for processes, not threads
+	//
+	if(e->m_tinfo == NULL || e->m_tinfo->pid != e->m_tinfo->tid)
+	{
+		return;
+	}
+
+	snprintf(dir_name, sizeof(dir_name), "%s/%u/", scan->m_procdirname, e->m_tid);
+	e->m_fd_res = scap_fd_scan_fd_dir(w->m_handle, dir_name, e->m_tinfo, &w->m_sockets_by_ns, error);
+	w->m_nfds += HASH_COUNT(e->m_tinfo->fdlist);
+}
+
+//
+// Gather the network namespaces of the processes, each one with a
+// process to read its sockets from
+//
+static int32_t proc_scan_list_net_ns(proc_scan* scan, char *error)
+{
+	struct scap_ns_socket_list* sockets;
+	int32_t uth_status = SCAP_SUCCESS;
+	uint32_t j;
+
+	scan->m_net_ns = (struct scap_ns_socket_list**)malloc(scan->m_nentries * sizeof(struct scap_ns_socket_list*));
+	scan->m_net_ns_entry = (uint32_t*)malloc(scan->m_nentries * sizeof(uint32_t));
+	if(scan->m_net_ns == NULL || scan->m_net_ns_entry == NULL)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "socket list allocation error");
+		return SCAP_FAILURE;
+	}
+
+	for(j = 0; j < scan->m_nentries; j++)
+	{
+		proc_scan_entry* e = &scan->m_entries[j];
+		if(e->m_tinfo == NULL || e->m_tinfo->pid != e->m_tinfo->tid)
+		{
+			continue;
+		}
+
+		HASH_FIND_INT64(scan->m_sockets_by_ns, &e->m_net_ns, sockets);
+		if(sockets != NULL)
+		{
+			continue;
+		}
+
+		sockets = (struct scap_ns_socket_list*)malloc(sizeof(struct scap_ns_socket_list));
+		if(sockets == NULL)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "socket list allocation error");
+			return SCAP_FAILURE;
+		}
+		sockets->net_ns = e->m_net_ns;
+		sockets->sockets = NULL;
+		HASH_ADD_INT64(scan->m_sockets_by_ns, net_ns, sockets);
+		if(uth_status != SCAP_SUCCESS)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "socket list allocation error");
+			free(sockets);
+			return SCAP_FAILURE;
+		}
+
+		scan->m_net_ns[scan->m_nnet_ns] = sockets;
+		scan->m_net_ns_entry[scan->m_nnet_ns] = j;
+		scan->m_nnet_ns++;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Give each worker its own table of the namespaces, pointing to the
+// shared sockets, so that the ones it finds later are only added there
+//
+static int32_t proc_scan_share_sockets(proc_scan* scan, char *error)
+{
+	struct scap_ns_socket_list* sockets;
+	int32_t uth_status = SCAP_SUCCESS;
+	uint32_t j;
+	uint32_t k;
+
+	for(j = 0; j < scan->m_nworkers; j++)
+	{
+		for(k = 0; k < scan->m_nnet_ns; k++)
+		{
+			sockets = (struct scap_ns_socket_list*)malloc(sizeof(struct scap_ns_socket_list));
+			if(sockets == NULL)
+			{
+				snprintf(error, SCAP_LASTERR_SIZE, "socket list allocation error");
+				return SCAP_FAILURE;
+			}
+			sockets->net_ns = scan->m_net_ns[k]->net_ns;
+			sockets->sockets = scan->m_net_ns[k]->sockets;
+			HASH_ADD_INT64(scan->m_workers[j].m_sockets_by_ns, net_ns, sockets);
+			if(uth_status != SCAP_SUCCESS)
+			{
+				snprintf(error, SCAP_LASTERR_SIZE, "socket list allocation error");
+				free(sockets);
+				return SCAP_FAILURE;
+			}
+		}
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Add a thread read by the workers to the process table, or pass it with
+// its fds to the callback. *added is false if it's suppressed.
+//
+static int32_t proc_scan_add(scap_t* handle, scap_threadinfo* tinfo, bool* added, char *error)
+{
+	scap_fdinfo* fdlist;
+	scap_fdinfo* fdi;
+	scap_fdinfo* tfdi;
+	int32_t uth_status = SCAP_SUCCESS;
+	bool suppressed;
+	int32_t res;
+
+	*added = false;
+
+	if((res = scap_update_suppressed(handle, tinfo->comm, tinfo->tid, 0, &suppressed)) != SCAP_SUCCESS)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't update set of suppressed tids (%s)", handle->m_lasterr);
+		scap_proc_free(handle, tinfo);
+		return res;
+	}
+
+	if(suppressed)
+	{
+		scap_proc_free(handle, tinfo);
+		return SCAP_SUCCESS;
+	}
+
+	*added = true;
+
+	if(handle->m_proc_callback == NULL)
+	{
+		HASH_ADD_INT64(handle->m_proclist, tid, tinfo);
+		if(uth_status != SCAP_SUCCESS)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "process table allocation error (2)");
+			scap_proc_free(handle, tinfo);
+			return SCAP_FAILURE;
+		}
+
+		return SCAP_SUCCESS;
+	}
+
+	//
+	// Like a serial scan, the callback gets the thread before its fds
+	//
+	fdlist = tinfo->fdlist;
+	tinfo->fdlist = NULL;
+	handle->m_proc_callback(handle->m_proc_callback_context, handle, tinfo->tid, tinfo, NULL);
+	HASH_ITER(hh, fdlist, fdi, tfdi)
+	{
+		handle->m_proc_callback(handle->m_proc_callback_context, handle, tinfo->tid, tinfo, fdi);
+	}
+	scap_fd_free_table(handle, &fdlist);
+	free(tinfo);
+
+	return SCAP_SUCCESS;
+}
+
+static int32_t proc_scan_merge(proc_scan* scan, char *error)
+{
+	scap_t* handle = scan->m_handle;
+	scap_threadinfo* tinfo;
+	char add_error[SCAP_LASTERR_SIZE];
+	bool added;
+	uint32_t j;
+	uint32_t k;
+
+	for(j = 0; j < scan->m_nentries; j++)
+	{
+		proc_scan_entry* e = &scan->m_entries[j];
+
+		if(e->m_res != SCAP_SUCCESS)
+		{
+			continue;
+		}
+
+		if(e->m_tinfo != NULL)
+		{
+			HASH_FIND_INT64(handle->m_proclist, &e->m_tinfo->tid, tinfo);
+			if(tinfo != NULL)
+			{
+				ASSERT(false);
+				snprintf(error, SCAP_LASTERR_SIZE, "duplicate process %"PRIu64, e->m_tinfo->tid);
+				return SCAP_FAILURE;
+			}
+
+			handle->m_proc_scan_stats.n_threads++;
+			tinfo = e->m_tinfo;
+			e->m_tinfo = NULL;
+
+			//
+			// As in a serial scan, the threads are dropped with the
+			// process, or if its fds can't be read
+			//
+			if(proc_scan_add(handle, tinfo, &added, add_error) != SCAP_SUCCESS ||
+			   (added && e->m_fd_res != SCAP_SUCCESS))
+			{
+				continue;
+			}
+		}
+
+		for(k = 0; k < e->m_ntasks; k++)
+		{
+			HASH_FIND_INT64(handle->m_proclist, &e->m_tasks[k]->tid, tinfo);
+			if(tinfo != NULL)
+			{
+				ASSERT(false);
+				snprintf(error, SCAP_LASTERR_SIZE, "duplicate process %"PRIu64, e->m_tasks[k]->tid);
+				return SCAP_FAILURE;
+			}
+
+			handle->m_proc_scan_stats.n_threads++;
+			tinfo = e->m_tasks[k];
+			e->m_tasks[k] = NULL;
+			proc_scan_add(handle, tinfo, &added, add_error);
+		}
+	}
+
+	return SCAP_SUCCESS;
+}
+
+static void proc_scan_free(proc_scan* scan)
+{
+	scap_t* handle = scan->m_handle;
+	struct scap_ns_socket_list* sockets;
+	struct scap_ns_socket_list* tsockets;
+	struct scap_ns_socket_list* shared;
+	scap_mountinfo* dev;
+	scap_mountinfo* tdev;
+	scap_mountinfo* hdev;
+	int32_t uth_status = SCAP_SUCCESS;
+	uint32_t j;
+	uint32_t k;
+
+	for(j = 0; j < scan->m_nworkers; j++)
+	{
+		proc_scan_worker* w = &scan->m_workers[j];
+
+		//
+		// Only free the sockets the worker read on its own
+		//
+		HASH_ITER(hh, w->m_sockets_by_ns, sockets, tsockets)
+		{
+			HASH_DEL(w->m_sockets_by_ns, sockets);
+			HASH_FIND_INT64(scan->m_sockets_by_ns, &sockets->net_ns, shared);
+			if(shared == NULL || shared->sockets != sockets->sockets)
+			{
+				scap_fd_free_table(handle, &sockets->sockets);
+			}
+			free(sockets);
+		}
+
+		//
+		// Keep the devices the worker looked up
+		//
+		if(w->m_handle != NULL)
+		{
+			HASH_ITER(hh, w->m_handle->m_dev_list, dev, tdev)
+			{
+				HASH_DEL(w->m_handle->m_dev_list, dev);
+				HASH_FIND_INT64(handle->m_dev_list, &dev->mount_id, hdev);
+				if(hdev != NULL)
+				{
+					free(dev);
+					continue;
+				}
+
+				HASH_ADD_INT64(handle->m_dev_list, mount_id, dev);
+				if(uth_status != SCAP_SUCCESS)
+				{
+					free(dev);
+				}
+			}
+			free(w->m_handle);
+		}
+	}
+	free(scan->m_workers);
+
+	scap_fd_free_ns_sockets_list(handle, &scan->m_sockets_by_ns);
+	free(scan->m_net_ns);
+	free(scan->m_net_ns_entry);
+
+	for(j = 0; j < scan->m_nentries; j++)
+	{
+		proc_scan_entry* e = &scan->m_entries[j];
+
+		if(e->m_tinfo != NULL)
+		{
+			scap_proc_free(handle, e->m_tinfo);
+		}
+
+		for(k = 0; k < e->m_ntasks; k++)
+		{
+			if(e->m_tasks[k] != NULL)
+			{
+				scap_proc_free(handle, e->m_tasks[k]);
+			}
+		}
+		free(e->m_tasks);
+	}
+	free(scan->m_entries);
+}
+
+static int32_t proc_scan_list(proc_scan* scan, char *error)
+{
+	DIR *dir_p;
+	struct dirent *dir_entry_p;
+	uint32_t size = 0;
+
+	dir_p = opendir(scan->m_procdirname);
+	if(dir_p == NULL)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "error opening the %s directory (%s)",
+			 scan->m_procdirname, scap_strerror(scan->m_handle, errno));
+		return SCAP_NOTFOUND;
+	}
+
+	while((dir_entry_p = readdir(dir_p)) != NULL)
+	{
+		if(strspn(dir_entry_p->d_name, "0123456789") != strlen(dir_entry_p->d_name))
+		{
+			continue;
+		}
+
+		if(scan->m_nentries == size)
+		{
+			size = size == 0 ? 1024 : size * 2;
+			proc_scan_entry* entries = (proc_scan_entry*)realloc(scan->m_entries, size * sizeof(proc_scan_entry));
+			if(entries == NULL)
+			{
+				snprintf(error, SCAP_LASTERR_SIZE, "process list allocation error");
+				closedir(dir_p);
+				return SCAP_FAILURE;
+			}
+			scan->m_entries = entries;
+		}
+
+		memset(&scan->m_entries[scan->m_nentries], 0, sizeof(proc_scan_entry));
+		scan->m_entries[scan->m_nentries].m_tid = atoi(dir_entry_p->d_name);
+		scan->m_nentries++;
+	}
+
+	closedir(dir_p);
+	return SCAP_SUCCESS;
+}
+
+static int32_t proc_scan_parallel(scap_t* handle, char* procdirname, uint32_t nworkers, char *error)
+{
+	scap_proc_scan_stats* stats = &handle->m_proc_scan_stats;
+	proc_scan scan;
+	uint64_t start;
+	int32_t res;
+	uint32_t j;
+
+	memset(&scan, 0, sizeof(scan));
+	scan.m_handle = handle;
+	scan.m_procdirname = procdirname;
+
+	start = proc_scan_now_ns();
+	res = proc_scan_list(&scan, error);
+	stats->list_ns = proc_scan_now_ns() - start;
+	if(res != SCAP_SUCCESS)
+	{
+		proc_scan_free(&scan);
+		return res;
+	}
+
+	if((res = scap_proc_read_cgroup_version(handle, procdirname, error)) != SCAP_SUCCESS)
+	{
+		proc_scan_free(&scan);
+		return res;
+	}
+
+	scan.m_workers = (proc_scan_worker*)calloc(nworkers, sizeof(proc_scan_worker));
+	if(scan.m_workers == NULL)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "error allocating the /proc scan workers");
+		proc_scan_free(&scan);
+		return SCAP_FAILURE;
+	}
+	scan.m_nworkers = nworkers;
+
+	for(j = 0; j < nworkers; j++)
+	{
+		scap_t* h = (scap_t*)calloc(1, sizeof(scap_t));
+		if(h == NULL)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "error allocating the /proc scan workers");
+			proc_scan_free(&scan);
+			return SCAP_FAILURE;
+		}
+
+		h->m_mode = handle->m_mode;
+		h->m_devs = handle->m_devs;
+		h->m_ndevs = handle->m_ndevs;
+		h->m_bpf = handle->m_bpf;
+		h->m_udig = handle->m_udig;
+		h->m_fd_lookup_limit = handle->m_fd_lookup_limit;
+		h->m_cgroup_version = handle->m_cgroup_version;
+		scan.m_workers[j].m_scan = &scan;
+		scan.m_workers[j].m_handle = h;
+	}
+	stats->n_workers = nworkers;
+
+	stats->threads_ns = proc_scan_run(&scan, proc_scan_read_threads, scan.m_nentries);
+
+	//
+	// With lazy fd tables, the sockets and the fds are read later by
+	// scap_proc_read_fds()
+	//
+	if(!handle->m_lazy_fd_tables)
+	{
+		start = proc_scan_now_ns();
+		if((res = proc_scan_list_net_ns(&scan, error)) != SCAP_SUCCESS)
+		{
+			proc_scan_free(&scan);
+			return res;
+		}
+		proc_scan_run(&scan, proc_scan_read_sockets, scan.m_nnet_ns);
+		stats->sockets_ns = proc_scan_now_ns() - start;
+		stats->n_net_ns = scan.m_nnet_ns;
+
+		if((res = proc_scan_share_sockets(&scan, error)) != SCAP_SUCCESS)
+		{
+			proc_scan_free(&scan);
+			return res;
+		}
+		stats->fds_ns = proc_scan_run(&scan, proc_scan_read_fds, scan.m_nentries);
+		for(j = 0; j < nworkers; j++)
+		{
+			stats->n_fds += scan.m_workers[j].m_nfds;
+		}
+	}
+
+	start = proc_scan_now_ns();
+	res = proc_scan_merge(&scan, error);
+	stats->merge_ns = proc_scan_now_ns() - start;
+
+	proc_scan_free(&scan);
+	return res;
+}
+
 int32_t scap_proc_scan_proc_dir(scap_t* handle, char* procdirname, char *error)
 {
-	return _scap_proc_scan_proc_dir_impl(handle, procdirname, -1, error);
+	uint32_t nworkers = handle->m_proc_scan_threads;
+	uint64_t start = proc_scan_now_ns();
+	int32_t res;
+
+	if(nworkers == SCAP_PROC_SCAN_AUTO)
+	{
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nworkers = ncpus < 1 ? 1 : (ncpus > PROC_SCAN_MAX_AUTO_THREADS ? PROC_SCAN_MAX_AUTO_THREADS : ncpus);
+	}
+
+	memset(&handle->m_proc_scan_stats, 0, sizeof(handle->m_proc_scan_stats));
+	if(nworkers > 1)
+	{
+		res = proc_scan_parallel(handle, procdirname, nworkers, error);
+	}
+	else
+	{
+		handle->m_proc_scan_stats.n_workers = 1;
+		res = _scap_proc_scan_proc_dir_impl(handle, procdirname, -1, error);
+	}
+	handle->m_proc_scan_stats.total_ns = proc_scan_now_ns() - start;
+
+	return res;
 }
 
 #endif // CYGWING_AGENT
@@ -1369,6 +2103,62 @@ struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_soc
 #endif // HAS_CAPTURE
 }
 
+int32_t scap_proc_read_fds(scap_t* handle, struct scap_threadinfo* tinfo)
+{
+#if !defined(HAS_CAPTURE) || defined(_WIN32)
+	snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "Cannot read the fds (capture not enabled)");
+	return SCAP_NOT_SUPPORTED;
+#else
+	char dir_name[SCAP_MAX_PATH_SIZE];
+	char error[SCAP_LASTERR_SIZE];
+	uint64_t now;
+	int32_t res;
+
+	//
+	// No /proc parsing for offline captures
+	//
+	if(handle->m_mode == SCAP_MODE_CAPTURE)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "Cannot read the fds (not in live mode)");
+		return SCAP_FAILURE;
+	}
+
+	//
+	// The fds go to the thread, not to the callback
+	//
+	proc_entry_callback cb = handle->m_proc_callback;
+	handle->m_proc_callback = NULL;
+
+	//
+	// The sockets of a network namespace are read on its first lookup and
+	// shared by the fd reads that follow, until they get too old to still
+	// describe the namespace
+	//
+	now = proc_scan_now_ns();
+	if(handle->m_lazy_sockets_by_ns != NULL &&
+	   now - handle->m_lazy_sockets_ts > SCAP_LAZY_SOCKETS_MAX_AGE_NS)
+	{
+		scap_proc_free_lazy_sockets(handle);
+	}
+	if(handle->m_lazy_sockets_by_ns == NULL)
+	{
+		handle->m_lazy_sockets_ts = now;
+	}
+
+	snprintf(dir_name, sizeof(dir_name), "%s/proc/%" PRIu64 "/", scap_get_host_root(), tinfo->pid);
+	res = scap_fd_scan_fd_dir(handle, dir_name, tinfo, &handle->m_lazy_sockets_by_ns, error);
+
+	handle->m_proc_callback = cb;
+
+	if(res != SCAP_SUCCESS)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "cannot read the fds of pid %" PRIu64 ": %s", tinfo->pid, error);
+	}
+
+	return res;
+#endif // HAS_CAPTURE
+}
+
 bool scap_is_thread_alive(scap_t* handle, int64_t pid, int64_t tid, const char* comm)
 {
 #if !defined(HAS_CAPTURE)
@@ -1444,6 +2234,7 @@ void scap_refresh_proc_table(scap_t* handle)
 		scap_proc_free_table(handle);
 		handle->m_proclist = NULL;
 	}
+	scap_proc_free_lazy_sockets(handle);
 	scap_proc_scan_proc_table(handle);
 }
 #else
@@ -1452,6 +2243,16 @@ void scap_refresh_proc_table(scap_t* handle)
 }
 #endif // HAS_CAPTURE
 
+void scap_proc_free_lazy_sockets(scap_t* handle)
+{
+	if(handle->m_lazy_sockets_by_ns != NULL)
+	{
+		scap_fd_free_ns_sockets_list(handle, &handle->m_lazy_sockets_by_ns);
+		handle->m_lazy_sockets_by_ns = NULL;
+	}
+	handle->m_lazy_sockets_ts = 0;
+}
+
 struct scap_threadinfo *scap_proc_alloc(scap_t *handle)
 {
 	struct scap_threadinfo *tinfo = (struct scap_threadinfo*) calloc(1, sizeof(scap_threadinfo));
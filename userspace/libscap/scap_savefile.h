@@ -152,6 +152,27 @@ typedef struct _section_header_block
 
 #define EVF_BLOCK_TYPE_V2_LARGE		0x222
 
+///////////////////////////////////////////////////////////////////////////////
+// CHECKPOINT INDEX
+///////////////////////////////////////////////////////////////////////////////
+// The index is kept in a separate file, named after the capture file, so
+// that readers that don't know about it can still read the capture.
+// The header is followed by nentries scap_index_entry. The size of the
+// capture when it was closed ties the index to it: an index that doesn't
+// match the file next to it is rejected.
+#define SCAP_INDEX_SUFFIX		".idx"
+#define SCAP_INDEX_MAGIC		0x58444953	/*SIDX*/
+#define SCAP_INDEX_VERSION		2
+
+typedef struct _scap_index_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t compress;
+	uint32_t nentries;
+	uint64_t capture_size;
+}scap_index_header;
+
 #if defined __sun
 #pragma pack()
 #else
@@ -0,0 +1,723 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef _GNU_SOURCE
+// O_DIRECT
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "settings.h"
+#include "scap.h"
+#include "scap_prefetch.h"
+#include "scap_writer.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+// Upper bound of the automatic number of threads compressing chunks
+#define WRITER_MAX_AUTO_THREADS 4
+// Alignment of the buffers, and of the writes with O_DIRECT
+#define WRITER_ALIGN 4096
+
+#define SLOT_FREE 0
+#define SLOT_QUEUED 1
+#define SLOT_COMPRESSING 2
+#define SLOT_READY 3
+
+typedef struct writer_slot
+{
+	uint8_t* m_data;
+	uint32_t m_len;
+	bool m_flush;
+	int m_state;
+	// SCAP_COMPRESSION_GZIP_CHUNKED: the compressed chunk
+	uint8_t* m_cdata;
+	size_t m_clen;
+	int m_errnum;
+} writer_slot;
+
+struct scap_writer
+{
+	int m_fd;
+	compression_mode m_compress;
+	bool m_direct;
+	// The file supports pwrite()
+	bool m_seekable;
+
+	uint32_t m_nthreads;
+	pthread_t* m_threads;
+	pthread_mutex_t m_mutex;
+	pthread_cond_t m_cond;
+
+	//
+	// Shared with the threads, protected by m_mutex
+	//
+	writer_slot* m_slots;
+	uint32_t m_nslots;
+	// Buffers queued by the dumper, taken for compression, and written,
+	// so far
+	uint64_t m_submitted;
+	uint64_t m_next_compress;
+	uint64_t m_done;
+	// Set while a thread writes m_done, so that the writes stay in order
+	bool m_writing;
+	bool m_stop;
+	int m_errnum;
+	char m_lasterr[SCAP_LASTERR_SIZE];
+	int64_t m_written;
+
+	//
+	// Owned by the thread that is writing
+	//
+#ifdef USE_ZLIB
+	z_stream m_zs;
+	bool m_zs_init;
+#endif
+	uint8_t* m_cbuf;
+	size_t m_cbuf_size;
+	// With O_DIRECT, the data that doesn't fill an aligned block yet. It
+	// goes at m_file_offset, that stays aligned.
+	uint8_t* m_stage;
+	uint32_t m_stagelen;
+	uint64_t m_file_offset;
+};
+
+static void set_error(scap_writer* w, int errnum, const char* msg)
+{
+	if(w->m_errnum == 0)
+	{
+		w->m_errnum = errnum;
+		snprintf(w->m_lasterr, SCAP_LASTERR_SIZE, "%s: %s", msg, strerror(errnum));
+	}
+}
+
+static int write_full(scap_writer* w, const uint8_t* buf, size_t len, uint64_t offset)
+{
+	size_t done = 0;
+
+	while(done < len)
+	{
+		ssize_t res;
+		if(w->m_seekable)
+		{
+			res = pwrite(w->m_fd, buf + done, len - done, offset + done);
+		}
+		else
+		{
+			res = write(w->m_fd, buf + done, len - done);
+		}
+
+		if(res < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(res < 0)
+		{
+			return errno;
+		}
+		if(res == 0)
+		{
+			return EIO;
+		}
+		done += res;
+	}
+
+	return 0;
+}
+
+//
+// Write the padded stage at m_file_offset, without moving it. The block is
+// written again once it's filled.
+//
+static int write_stage(scap_writer* w)
+{
+	uint32_t len = (w->m_stagelen + WRITER_ALIGN - 1) & ~(WRITER_ALIGN - 1);
+
+	if(len == 0)
+	{
+		return 0;
+	}
+
+	memset(w->m_stage + w->m_stagelen, 0, len - w->m_stagelen);
+	return write_full(w, w->m_stage, len, w->m_file_offset);
+}
+
+//
+// Append data to the file
+//
+static int output(scap_writer* w, const uint8_t* data, size_t len)
+{
+	int res;
+
+	if(!w->m_direct)
+	{
+		res = write_full(w, data, len, w->m_file_offset);
+		if(res == 0)
+		{
+			w->m_file_offset += len;
+		}
+		return res;
+	}
+
+	//
+	// Full, aligned buffers go straight to the file, the rest through
+	// the stage
+	//
+	if(w->m_stagelen == 0 && len % WRITER_ALIGN == 0 && ((uintptr_t)data % WRITER_ALIGN) == 0)
+	{
+		res = write_full(w, data, len, w->m_file_offset);
+		if(res == 0)
+		{
+			w->m_file_offset += len;
+		}
+		return res;
+	}
+
+	while(len > 0)
+	{
+		size_t n = SCAP_GZCHUNK_SIZE - w->m_stagelen;
+		if(n > len)
+		{
+			n = len;
+		}
+
+		memcpy(w->m_stage + w->m_stagelen, data, n);
+		w->m_stagelen += n;
+		data += n;
+		len -= n;
+
+		if(w->m_stagelen == SCAP_GZCHUNK_SIZE)
+		{
+			res = write_full(w, w->m_stage, SCAP_GZCHUNK_SIZE, w->m_file_offset);
+			if(res != 0)
+			{
+				return res;
+			}
+			w->m_file_offset += SCAP_GZCHUNK_SIZE;
+			w->m_stagelen = 0;
+		}
+	}
+
+	return 0;
+}
+
+//
+// Compress a chunk. Chunks are independent, so this runs on any thread.
+//
+static void compress_slot(scap_writer* w, writer_slot* slot)
+{
+#ifdef USE_ZLIB
+	slot->m_errnum = 0;
+	slot->m_clen = 0;
+	if(w->m_compress == SCAP_COMPRESSION_GZIP_CHUNKED && slot->m_len != 0)
+	{
+		slot->m_clen = scap_gzchunk_compress(slot->m_cdata, scap_gzchunk_bound(SCAP_GZCHUNK_SIZE),
+						     slot->m_data, slot->m_len, Z_DEFAULT_COMPRESSION);
+		if(slot->m_clen == 0)
+		{
+			slot->m_errnum = EINVAL;
+		}
+	}
+#endif
+}
+
+//
+// Write a buffer, deflating it first with SCAP_COMPRESSION_GZIP. Runs on
+// one thread at a time, in the order of the buffers. Returns 0 or an errno
+// value.
+//
+static int write_slot(scap_writer* w, writer_slot* slot, const char** msg)
+{
+	*msg = "error writing the file";
+
+#ifdef USE_ZLIB
+	if(w->m_compress == SCAP_COMPRESSION_GZIP_CHUNKED)
+	{
+		if(slot->m_errnum != 0)
+		{
+			*msg = "can't compress the chunk";
+			return slot->m_errnum;
+		}
+
+		return output(w, slot->m_cdata, slot->m_clen);
+	}
+	else if(w->m_compress == SCAP_COMPRESSION_GZIP)
+	{
+		int zflush = slot->m_flush ? Z_FULL_FLUSH : Z_NO_FLUSH;
+
+		w->m_zs.next_in = (Bytef*)slot->m_data;
+		w->m_zs.avail_in = slot->m_len;
+		do
+		{
+			int res;
+
+			w->m_zs.next_out = w->m_cbuf;
+			w->m_zs.avail_out = (uInt)w->m_cbuf_size;
+			if(deflate(&w->m_zs, zflush) == Z_STREAM_ERROR)
+			{
+				*msg = "can't compress the data";
+				return EINVAL;
+			}
+
+			res = output(w, w->m_cbuf, w->m_cbuf_size - w->m_zs.avail_out);
+			if(res != 0)
+			{
+				return res;
+			}
+		} while(w->m_zs.avail_out == 0);
+
+		return 0;
+	}
+#endif
+
+	return output(w, slot->m_data, slot->m_len);
+}
+
+static void* writer_thread(void* arg)
+{
+	scap_writer* w = (scap_writer*)arg;
+
+	pthread_mutex_lock(&w->m_mutex);
+	while(true)
+	{
+		writer_slot* next = &w->m_slots[w->m_done % w->m_nslots];
+
+		//
+		// Writing the oldest buffer comes first, it frees a buffer for
+		// the dumper
+		//
+		if(!w->m_writing && w->m_done < w->m_submitted && next->m_state == SLOT_READY)
+		{
+			bool failed = w->m_errnum != 0;
+			const char* msg = NULL;
+			int res = 0;
+
+			w->m_writing = true;
+			pthread_mutex_unlock(&w->m_mutex);
+			if(!failed)
+			{
+				res = write_slot(w, next, &msg);
+			}
+			pthread_mutex_lock(&w->m_mutex);
+
+			if(res != 0)
+			{
+				set_error(w, res, msg);
+			}
+			next->m_state = SLOT_FREE;
+			w->m_written = w->m_file_offset + w->m_stagelen;
+			w->m_done++;
+			w->m_writing = false;
+			pthread_cond_broadcast(&w->m_cond);
+			continue;
+		}
+
+		if(w->m_next_compress < w->m_submitted)
+		{
+			writer_slot* slot = &w->m_slots[w->m_next_compress % w->m_nslots];
+
+			w->m_next_compress++;
+			slot->m_state = SLOT_COMPRESSING;
+			pthread_mutex_unlock(&w->m_mutex);
+			compress_slot(w, slot);
+			pthread_mutex_lock(&w->m_mutex);
+
+			slot->m_state = SLOT_READY;
+			pthread_cond_broadcast(&w->m_cond);
+			continue;
+		}
+
+		if(w->m_stop && w->m_done == w->m_submitted)
+		{
+			break;
+		}
+
+		pthread_cond_wait(&w->m_cond, &w->m_mutex);
+	}
+	pthread_mutex_unlock(&w->m_mutex);
+
+	return NULL;
+}
+
+static void free_writer(scap_writer* w)
+{
+	uint32_t j;
+
+	if(w->m_slots != NULL)
+	{
+		for(j = 0; j < w->m_nslots; j++)
+		{
+			free(w->m_slots[j].m_data);
+			free(w->m_slots[j].m_cdata);
+		}
+	}
+#ifdef USE_ZLIB
+	if(w->m_zs_init)
+	{
+		deflateEnd(&w->m_zs);
+	}
+#endif
+	free(w->m_slots);
+	free(w->m_threads);
+	free(w->m_cbuf);
+	free(w->m_stage);
+	free(w);
+}
+
+static void stop_threads(scap_writer* w, uint32_t nthreads)
+{
+	uint32_t j;
+
+	pthread_mutex_lock(&w->m_mutex);
+	w->m_stop = true;
+	pthread_cond_broadcast(&w->m_cond);
+	pthread_mutex_unlock(&w->m_mutex);
+
+	for(j = 0; j < nthreads; j++)
+	{
+		pthread_join(w->m_threads[j], NULL);
+	}
+
+	pthread_mutex_destroy(&w->m_mutex);
+	pthread_cond_destroy(&w->m_cond);
+}
+
+scap_writer* scap_writer_open(const char* fname, compression_mode compress, bool direct_io, char* error)
+{
+	scap_writer* w;
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+	uint32_t j;
+
+	w = (scap_writer*)calloc(1, sizeof(scap_writer));
+	if(w == NULL)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't allocate the writer");
+		return NULL;
+	}
+
+	w->m_compress = compress;
+	w->m_nthreads = 1;
+#ifdef USE_ZLIB
+	if(compress == SCAP_COMPRESSION_GZIP_CHUNKED)
+	{
+		//
+		// Chunks are compressed in parallel. Leave a CPU to the
+		// thread producing the events.
+		//
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+		w->m_nthreads = ncpus > WRITER_MAX_AUTO_THREADS ? WRITER_MAX_AUTO_THREADS : (ncpus > 1 ? ncpus : 1);
+	}
+#endif
+
+	w->m_nslots = 2 * w->m_nthreads + 2;
+	w->m_slots = (writer_slot*)calloc(w->m_nslots, sizeof(writer_slot));
+	w->m_threads = (pthread_t*)calloc(w->m_nthreads, sizeof(pthread_t));
+	if(w->m_slots == NULL || w->m_threads == NULL)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't allocate the writer");
+		free_writer(w);
+		return NULL;
+	}
+
+	for(j = 0; j < w->m_nslots; j++)
+	{
+		writer_slot* slot = &w->m_slots[j];
+		if(posix_memalign((void**)&slot->m_data, WRITER_ALIGN, SCAP_GZCHUNK_SIZE) != 0)
+		{
+			slot->m_data = NULL;
+			snprintf(error, SCAP_LASTERR_SIZE, "can't allocate the write buffers");
+			free_writer(w);
+			return NULL;
+		}
+
+#ifdef USE_ZLIB
+		if(compress == SCAP_COMPRESSION_GZIP_CHUNKED)
+		{
+			slot->m_cdata = (uint8_t*)malloc(scap_gzchunk_bound(SCAP_GZCHUNK_SIZE));
+			if(slot->m_cdata == NULL)
+			{
+				snprintf(error, SCAP_LASTERR_SIZE, "can't allocate the compression buffers");
+				free_writer(w);
+				return NULL;
+			}
+		}
+#endif
+	}
+
+#ifdef USE_ZLIB
+	if(compress == SCAP_COMPRESSION_GZIP)
+	{
+		w->m_cbuf_size = SCAP_GZCHUNK_SIZE;
+		w->m_cbuf = (uint8_t*)malloc(w->m_cbuf_size);
+		// 16 + 15: gzip wrapper, 32K window, like gzwrite()
+		if(w->m_cbuf == NULL ||
+		   deflateInit2(&w->m_zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't initialize zlib");
+			free_writer(w);
+			return NULL;
+		}
+		w->m_zs_init = true;
+	}
+#endif
+
+	w->m_fd = -1;
+#ifdef O_DIRECT
+	if(direct_io)
+	{
+		//
+		// Not every filesystem supports it (e.g. tmpfs), write through
+		// the page cache there
+		//
+		w->m_fd = open(fname, flags | O_DIRECT, 0666);
+		if(w->m_fd != -1)
+		{
+			w->m_direct = true;
+		}
+	}
+#endif
+	if(w->m_fd == -1)
+	{
+		w->m_fd = open(fname, flags, 0666);
+	}
+	if(w->m_fd == -1)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't open %s: %s", fname, strerror(errno));
+		free_writer(w);
+		return NULL;
+	}
+
+	w->m_seekable = lseek(w->m_fd, 0, SEEK_CUR) != -1;
+	if(w->m_direct)
+	{
+		if(!w->m_seekable || posix_memalign((void**)&w->m_stage, WRITER_ALIGN, SCAP_GZCHUNK_SIZE) != 0)
+		{
+			w->m_stage = NULL;
+			snprintf(error, SCAP_LASTERR_SIZE, "can't set up direct I/O on %s", fname);
+			close(w->m_fd);
+			free_writer(w);
+			return NULL;
+		}
+	}
+
+	pthread_mutex_init(&w->m_mutex, NULL);
+	pthread_cond_init(&w->m_cond, NULL);
+	for(j = 0; j < w->m_nthreads; j++)
+	{
+		if(pthread_create(&w->m_threads[j], NULL, writer_thread, w) != 0)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't start the writer threads");
+			stop_threads(w, j);
+			close(w->m_fd);
+			free_writer(w);
+			return NULL;
+		}
+	}
+
+	return w;
+}
+
+uint8_t* scap_writer_buffer(scap_writer* w)
+{
+	writer_slot* slot;
+	uint8_t* res;
+
+	pthread_mutex_lock(&w->m_mutex);
+	slot = &w->m_slots[w->m_submitted % w->m_nslots];
+	while(slot->m_state != SLOT_FREE && w->m_errnum == 0)
+	{
+		pthread_cond_wait(&w->m_cond, &w->m_mutex);
+	}
+	res = w->m_errnum == 0 ? slot->m_data : NULL;
+	pthread_mutex_unlock(&w->m_mutex);
+
+	return res;
+}
+
+int scap_writer_submit(scap_writer* w, uint32_t len, bool flush)
+{
+	writer_slot* slot;
+	int res;
+
+	pthread_mutex_lock(&w->m_mutex);
+	res = w->m_errnum == 0 ? 0 : -1;
+	if(res == 0)
+	{
+		slot = &w->m_slots[w->m_submitted % w->m_nslots];
+		slot->m_len = len;
+		slot->m_flush = flush;
+		slot->m_state = SLOT_QUEUED;
+		w->m_submitted++;
+		pthread_cond_broadcast(&w->m_cond);
+	}
+	pthread_mutex_unlock(&w->m_mutex);
+
+	return res;
+}
+
+int scap_writer_sync(scap_writer* w)
+{
+	int res;
+
+	pthread_mutex_lock(&w->m_mutex);
+	while(w->m_done != w->m_submitted)
+	{
+		pthread_cond_wait(&w->m_cond, &w->m_mutex);
+	}
+
+	//
+	// The threads are idle until the next buffer is submitted, which only
+	// the caller can do
+	//
+	if(w->m_direct && w->m_errnum == 0)
+	{
+		res = write_stage(w);
+		if(res != 0)
+		{
+			set_error(w, res, "error writing the file");
+		}
+	}
+
+	res = w->m_errnum == 0 ? 0 : -1;
+	pthread_mutex_unlock(&w->m_mutex);
+
+	return res;
+}
+
+int64_t scap_writer_offset(scap_writer* w)
+{
+	int64_t res;
+
+	pthread_mutex_lock(&w->m_mutex);
+	res = w->m_written;
+	pthread_mutex_unlock(&w->m_mutex);
+
+	return res;
+}
+
+const char* scap_writer_error(scap_writer* w)
+{
+	return w->m_lasterr;
+}
+
+int scap_writer_close(scap_writer* w)
+{
+	int res;
+
+	stop_threads(w, w->m_nthreads);
+
+#ifdef USE_ZLIB
+	if(w->m_compress == SCAP_COMPRESSION_GZIP && w->m_errnum == 0)
+	{
+		int zres;
+
+		w->m_zs.next_in = NULL;
+		w->m_zs.avail_in = 0;
+		do
+		{
+			w->m_zs.next_out = w->m_cbuf;
+			w->m_zs.avail_out = (uInt)w->m_cbuf_size;
+			zres = deflate(&w->m_zs, Z_FINISH);
+			res = output(w, w->m_cbuf, w->m_cbuf_size - w->m_zs.avail_out);
+			if(res != 0)
+			{
+				set_error(w, res, "error writing the file");
+				break;
+			}
+		} while(zres == Z_OK);
+	}
+#endif
+
+	//
+	// With O_DIRECT the last block is padded, cut the file at the end of
+	// the data
+	//
+	if(w->m_direct && w->m_errnum == 0)
+	{
+		res = write_stage(w);
+		if(res == 0 && ftruncate(w->m_fd, w->m_file_offset + w->m_stagelen) != 0)
+		{
+			res = errno;
+		}
+		if(res != 0)
+		{
+			set_error(w, res, "error writing the file");
+		}
+	}
+
+	res = w->m_errnum == 0 ? 0 : -1;
+	if(close(w->m_fd) != 0)
+	{
+		res = -1;
+	}
+
+	free_writer(w);
+	return res;
+}
+
+#else // _WIN32
+
+scap_writer* scap_writer_open(const char* fname, compression_mode compress, bool direct_io, char* error)
+{
+	snprintf(error, SCAP_LASTERR_SIZE, "background writing not supported on this platform");
+	return NULL;
+}
+
+uint8_t* scap_writer_buffer(scap_writer* w)
+{
+	return NULL;
+}
+
+int scap_writer_submit(scap_writer* w, uint32_t len, bool flush)
+{
+	return -1;
+}
+
+int scap_writer_sync(scap_writer* w)
+{
+	return -1;
+}
+
+int64_t scap_writer_offset(scap_writer* w)
+{
+	return -1;
+}
+
+const char* scap_writer_error(scap_writer* w)
+{
+	return "background writing not supported on this platform";
+}
+
+int scap_writer_close(scap_writer* w)
+{
+	return -1;
+}
+
+#endif // _WIN32
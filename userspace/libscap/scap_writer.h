@@ -0,0 +1,70 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////
+// Background writing of capture files
+////////////////////////////////////////////////////////////////////////////
+
+//
+// Writing through gzwrite() compresses and issues the writes on the
+// thread that dumps the events. The writer gives the dumper large buffers
+// to copy the events into, and compresses and writes the filled ones on a
+// background thread, with one pwrite() per buffer.
+//
+// The buffers are SCAP_GZCHUNK_SIZE bytes long and page aligned, so the
+// file can be written with O_DIRECT. With SCAP_COMPRESSION_GZIP_CHUNKED,
+// every buffer becomes a chunk, and several chunks are compressed in
+// parallel. With SCAP_COMPRESSION_GZIP, the buffers are deflated into a
+// single gzip stream, by one thread.
+//
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct scap_writer scap_writer;
+
+//
+// Open fname for writing. With direct_io, the file is opened with O_DIRECT
+// when the filesystem supports it. Returns NULL, and fills error, on
+// failure.
+//
+scap_writer* scap_writer_open(const char* fname, compression_mode compress, bool direct_io, char* error);
+// Return the next buffer to fill, of SCAP_GZCHUNK_SIZE bytes, waiting for
+// the background thread to be done with it. Returns NULL after an error.
+uint8_t* scap_writer_buffer(scap_writer* w);
+// Queue the buffer returned by scap_writer_buffer(), with len bytes of
+// data. With flush, the compressed stream is flushed after it.
+int scap_writer_submit(scap_writer* w, uint32_t len, bool flush);
+// Wait for the queued buffers to be written
+int scap_writer_sync(scap_writer* w);
+// Return the size of the data written to the file so far. It includes the
+// queued buffers only after scap_writer_sync().
+int64_t scap_writer_offset(scap_writer* w);
+const char* scap_writer_error(scap_writer* w);
+// Write the queued buffers and close the file
+int scap_writer_close(scap_writer* w);
+
+#ifdef __cplusplus
+}
+#endif
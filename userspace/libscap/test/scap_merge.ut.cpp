@@ -0,0 +1,118 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "scap.h"
+#include "scap_merge.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+typedef std::vector<std::vector<uint64_t>> rings_t;
+
+static std::vector<std::pair<uint64_t, uint32_t>> linear_merge(const rings_t& rings)
+{
+	std::vector<std::pair<uint64_t, uint32_t>> out;
+	std::vector<size_t> pos(rings.size(), 0);
+
+	while(true)
+	{
+		uint64_t min_ts = UINT64_MAX;
+		uint32_t picked = SCAP_MERGE_NO_DEV;
+		for(uint32_t j = 0; j < rings.size(); j++)
+		{
+			if(pos[j] < rings[j].size() && rings[j][pos[j]] < min_ts)
+			{
+				min_ts = rings[j][pos[j]];
+				picked = j;
+			}
+		}
+		if(picked == SCAP_MERGE_NO_DEV)
+		{
+			return out;
+		}
+		out.emplace_back(min_ts, picked);
+		pos[picked]++;
+	}
+}
+
+static std::vector<std::pair<uint64_t, uint32_t>> heap_merge(const rings_t& rings)
+{
+	std::vector<std::pair<uint64_t, uint32_t>> out;
+	std::vector<size_t> pos(rings.size(), 0);
+	scap_merge_heap heap;
+
+	EXPECT_EQ(scap_merge_init(&heap, rings.size()), SCAP_SUCCESS);
+	for(uint32_t j = 0; j < rings.size(); j++)
+	{
+		if(!rings[j].empty())
+		{
+			scap_merge_append(&heap, rings[j][0], j);
+		}
+	}
+	scap_merge_build(&heap);
+
+	while(!scap_merge_empty(&heap))
+	{
+		uint32_t dev = scap_merge_top(&heap)->dev;
+		out.emplace_back(scap_merge_top(&heap)->ts, dev);
+		if(++pos[dev] == rings[dev].size())
+		{
+			scap_merge_pop(&heap);
+		}
+		else
+		{
+			scap_merge_replace_top(&heap, rings[dev][pos[dev]]);
+		}
+	}
+
+	scap_merge_free(&heap);
+	return out;
+}
+
+TEST(scap_merge, empty)
+{
+	scap_merge_heap heap;
+	ASSERT_EQ(scap_merge_init(&heap, 0), SCAP_SUCCESS);
+	scap_merge_build(&heap);
+	EXPECT_TRUE(scap_merge_empty(&heap));
+	scap_merge_pop(&heap);
+	EXPECT_TRUE(scap_merge_empty(&heap));
+	scap_merge_free(&heap);
+}
+
+TEST(scap_merge, same_order_as_linear_scan)
+{
+	std::mt19937_64 rng(42);
+
+	for(uint32_t nrings : {1, 2, 3, 8, 17, 64, 256})
+	{
+		rings_t rings(nrings);
+		for(auto& ring : rings)
+		{
+			uint64_t ts = rng() % 50;
+			size_t nevts = rng() % 40;
+			for(size_t k = 0; k < nevts; k++)
+			{
+				// small increments so that ties across rings are frequent
+				ts += rng() % 3;
+				ring.push_back(ts);
+			}
+		}
+
+		ASSERT_EQ(linear_merge(rings), heap_merge(rings)) << "nrings=" << nrings;
+	}
+}
@@ -0,0 +1,265 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "scap.h"
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <map>
+#include <set>
+#include <string>
+
+typedef std::map<int64_t, std::set<int64_t>> fd_map_t;
+
+static scap_t* open_nodriver(uint32_t proc_scan_threads, proc_entry_callback cb = NULL, void* ctx = NULL, bool lazy_fd_tables = false)
+{
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc;
+	scap_open_args oargs = {};
+
+	oargs.mode = SCAP_MODE_NODRIVER;
+	oargs.proc_scan_threads = proc_scan_threads;
+	oargs.lazy_fd_tables = lazy_fd_tables;
+	oargs.proc_callback = cb;
+	oargs.proc_callback_context = ctx;
+	scap_t* h = scap_open(oargs, error, &rc);
+	EXPECT_NE(h, nullptr) << error;
+	return h;
+}
+
+// The sockets of each process in the table
+static fd_map_t get_fds(scap_t* h)
+{
+	fd_map_t res;
+	scap_threadinfo* tinfo;
+	scap_threadinfo* ttinfo;
+	scap_fdinfo* fdi;
+	scap_fdinfo* tfdi;
+
+	HASH_ITER(hh, scap_get_proc_table(h), tinfo, ttinfo)
+	{
+		std::set<int64_t>& fds = res[tinfo->tid];
+		HASH_ITER(hh, tinfo->fdlist, fdi, tfdi)
+		{
+			fds.insert(fdi->fd);
+		}
+	}
+
+	return res;
+}
+
+static void on_proc_entry(void* context, scap_t* handle, int64_t tid, scap_threadinfo* tinfo, scap_fdinfo* fdinfo)
+{
+	fd_map_t* entries = (fd_map_t*)context;
+
+	ASSERT_EQ(tinfo->tid, (uint64_t)tid);
+	ASSERT_EQ(tinfo->fdlist, nullptr);
+	if(fdinfo == NULL)
+	{
+		ASSERT_EQ(entries->count(tid), 0);
+		(*entries)[tid];
+	}
+	else
+	{
+		ASSERT_EQ(entries->count(tid), 1);
+		(*entries)[tid].insert(fdinfo->fd);
+	}
+}
+
+// A parallel scan finds the same processes and sockets as a serial one
+TEST(scap_proc_scan, parallel)
+{
+	int64_t pid = getpid();
+	int lfd = socket(AF_INET, SOCK_STREAM, 0);
+	int usock[2];
+	struct sockaddr_in addr = {};
+
+	ASSERT_GE(lfd, 0);
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ASSERT_EQ(bind(lfd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+	ASSERT_EQ(listen(lfd, 1), 0);
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, usock), 0);
+
+	scap_t* serial = open_nodriver(SCAP_PROC_SCAN_SERIAL);
+	ASSERT_NE(serial, nullptr);
+	scap_t* parallel = open_nodriver(4);
+	ASSERT_NE(parallel, nullptr);
+
+	fd_map_t serial_fds = get_fds(serial);
+	fd_map_t parallel_fds = get_fds(parallel);
+	ASSERT_EQ(serial_fds.count(pid), 1);
+	ASSERT_EQ(parallel_fds.count(pid), 1);
+	EXPECT_EQ(serial_fds[pid], parallel_fds[pid]);
+	EXPECT_EQ(parallel_fds[pid].count(lfd), 1);
+	EXPECT_EQ(parallel_fds[pid].count(usock[0]), 1);
+
+	// Other processes can come and go between the scans
+	scap_threadinfo* tinfo;
+	scap_threadinfo* ptinfo;
+	scap_threadinfo* ttinfo;
+	uint32_t ncommon = 0;
+	HASH_ITER(hh, scap_get_proc_table(serial), tinfo, ttinfo)
+	{
+		int64_t tid = tinfo->tid;
+		HASH_FIND_INT64(scap_get_proc_table(parallel), &tid, ptinfo);
+		if(ptinfo != NULL)
+		{
+			EXPECT_EQ(tinfo->pid, ptinfo->pid);
+			EXPECT_EQ(tinfo->ptid, ptinfo->ptid);
+			EXPECT_STREQ(tinfo->comm, ptinfo->comm);
+			EXPECT_STREQ(tinfo->exepath, ptinfo->exepath);
+			EXPECT_STREQ(tinfo->cwd, ptinfo->cwd);
+			EXPECT_EQ(tinfo->cgroups_len, ptinfo->cgroups_len);
+			ncommon++;
+		}
+	}
+	EXPECT_GT(ncommon, 0);
+
+	scap_proc_scan_stats stats;
+	ASSERT_EQ(scap_get_proc_scan_stats(serial, &stats), SCAP_SUCCESS);
+	EXPECT_EQ(stats.n_workers, 1);
+	EXPECT_EQ(stats.n_threads, 0);
+	EXPECT_GT(stats.total_ns, 0);
+
+	ASSERT_EQ(scap_get_proc_scan_stats(parallel, &stats), SCAP_SUCCESS);
+	EXPECT_EQ(stats.n_workers, 4);
+	EXPECT_EQ(stats.n_threads, parallel_fds.size());
+	EXPECT_GE(stats.n_fds, 3);
+	EXPECT_GE(stats.n_net_ns, 1);
+	EXPECT_GE(stats.total_ns, stats.list_ns + stats.threads_ns + stats.sockets_ns + stats.fds_ns + stats.merge_ns);
+
+	// The refresh runs the same scan
+	close(usock[1]);
+	scap_refresh_proc_table(parallel);
+	parallel_fds = get_fds(parallel);
+	EXPECT_EQ(parallel_fds[pid].count(lfd), 1);
+	EXPECT_EQ(parallel_fds[pid].count(usock[0]), 1);
+	EXPECT_EQ(parallel_fds[pid].count(usock[1]), 0);
+	ASSERT_EQ(scap_get_proc_scan_stats(parallel, &stats), SCAP_SUCCESS);
+	EXPECT_EQ(stats.n_workers, 4);
+	EXPECT_EQ(stats.n_threads, parallel_fds.size());
+
+	scap_close(serial);
+	scap_close(parallel);
+	close(usock[0]);
+	close(lfd);
+}
+
+// The callback gets each thread, then its fds, on the calling thread
+TEST(scap_proc_scan, callback)
+{
+	int64_t pid = getpid();
+	int usock[2];
+	fd_map_t entries;
+
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, usock), 0);
+
+	scap_t* h = open_nodriver(4, on_proc_entry, &entries);
+	ASSERT_NE(h, nullptr);
+	EXPECT_EQ(scap_get_proc_table(h), nullptr);
+
+	ASSERT_EQ(entries.count(pid), 1);
+	EXPECT_EQ(entries[pid].count(usock[0]), 1);
+	EXPECT_EQ(entries[pid].count(usock[1]), 1);
+
+	scap_proc_scan_stats stats;
+	ASSERT_EQ(scap_get_proc_scan_stats(h, &stats), SCAP_SUCCESS);
+	EXPECT_EQ(stats.n_threads, entries.size());
+
+	scap_close(h);
+	close(usock[0]);
+	close(usock[1]);
+}
+
+// Lazy fd tables are read on demand, with the fds of an eager scan
+TEST(scap_proc_scan, lazy_fd_tables)
+{
+	int64_t pid = getpid();
+	int usock[2];
+
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, usock), 0);
+
+	for(uint32_t nworkers : {1, 4})
+	{
+		scap_t* h = open_nodriver(nworkers, NULL, NULL, true);
+		ASSERT_NE(h, nullptr);
+
+		fd_map_t fds = get_fds(h);
+		ASSERT_EQ(fds.count(pid), 1);
+		for(auto& it : fds)
+		{
+			EXPECT_TRUE(it.second.empty()) << it.first;
+		}
+
+		scap_proc_scan_stats stats;
+		ASSERT_EQ(scap_get_proc_scan_stats(h, &stats), SCAP_SUCCESS);
+		EXPECT_EQ(stats.n_fds, 0);
+
+		scap_threadinfo* tinfo;
+		HASH_FIND_INT64(scap_get_proc_table(h), &pid, tinfo);
+		ASSERT_NE(tinfo, nullptr);
+		ASSERT_EQ(scap_proc_read_fds(h, tinfo), SCAP_SUCCESS) << scap_getlasterr(h);
+
+		scap_threadinfo* eager = scap_proc_get(h, pid, true);
+		ASSERT_NE(eager, nullptr);
+
+		std::set<int64_t> lazy_fds;
+		std::set<int64_t> eager_fds;
+		scap_fdinfo* fdi;
+		scap_fdinfo* tfdi;
+		HASH_ITER(hh, tinfo->fdlist, fdi, tfdi)
+		{
+			lazy_fds.insert(fdi->fd);
+		}
+		HASH_ITER(hh, eager->fdlist, fdi, tfdi)
+		{
+			eager_fds.insert(fdi->fd);
+		}
+		EXPECT_EQ(lazy_fds, eager_fds);
+		EXPECT_EQ(lazy_fds.count(usock[0]), 1);
+		EXPECT_EQ(lazy_fds.count(usock[1]), 1);
+
+		scap_proc_free(h, eager);
+		scap_close(h);
+	}
+
+	close(usock[0]);
+	close(usock[1]);
+}
+
+// Without the scan the table starts empty, until it's refreshed
+TEST(scap_proc_scan, skip_proc_scan)
+{
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc;
+	scap_open_args oargs = {};
+	int64_t pid = getpid();
+
+	oargs.mode = SCAP_MODE_NODRIVER;
+	oargs.skip_proc_scan = true;
+	scap_t* h = scap_open(oargs, error, &rc);
+	ASSERT_NE(h, nullptr) << error;
+	EXPECT_EQ(scap_get_proc_table(h), nullptr);
+
+	scap_refresh_proc_table(h);
+	EXPECT_EQ(get_fds(h).count(pid), 1);
+
+	scap_close(h);
+}
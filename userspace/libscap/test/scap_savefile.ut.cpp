@@ -0,0 +1,395 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "scap.h"
+#include "scap_savefile.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+static const uint32_t NEVTS = 1000;
+
+struct dumped_evt
+{
+	std::vector<uint8_t> m_data;
+	uint16_t m_cpuid;
+};
+
+// write nevts read exit events of growing size to fname, 1us apart
+static std::vector<dumped_evt> write_capture(const std::string& fname, compression_mode compress, uint32_t nevts = NEVTS,
+					     uint64_t checkpoint_interval_ns = 0, uint32_t open_flags = SCAP_DOF_NONE)
+{
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc;
+	scap_open_args oargs = {};
+	std::vector<dumped_evt> evts;
+
+	oargs.mode = SCAP_MODE_NODRIVER;
+	scap_t* h = scap_open(oargs, error, &rc);
+	EXPECT_NE(h, nullptr) << error;
+	if(h == nullptr)
+	{
+		return evts;
+	}
+
+	scap_dumper_t* d = scap_dump_open_ex(h, fname.c_str(), compress, true, open_flags);
+	EXPECT_NE(d, nullptr) << scap_getlasterr(h);
+	if(checkpoint_interval_ns != 0)
+	{
+		EXPECT_EQ(scap_dump_enable_index(h, d, checkpoint_interval_ns), SCAP_SUCCESS);
+	}
+
+	for(uint32_t j = 0; j < nevts; j++)
+	{
+		std::vector<uint8_t> payload(j % 300, (uint8_t)j);
+		std::vector<uint8_t> buf(1024);
+		scap_sized_buffer evt_buf = {buf.data(), buf.size()};
+		size_t evt_size;
+
+		EXPECT_EQ(scap_event_encode_params(evt_buf, &evt_size, error, PPME_SYSCALL_READ_X, 2,
+						   (int64_t)payload.size(), scap_const_sized_buffer{payload.data(), payload.size()}),
+			  SCAP_SUCCESS);
+		scap_evt* evt = (scap_evt*)buf.data();
+		evt->ts = 1000 + j * 1000;
+		evt->tid = 100 + j % 7;
+		buf.resize(evt->len);
+
+		EXPECT_EQ(scap_dump(h, d, evt, j % 4, 0), SCAP_SUCCESS);
+		evts.push_back({buf, (uint16_t)(j % 4)});
+	}
+
+	scap_dump_close(d);
+	scap_close(h);
+	return evts;
+}
+
+// read fname, starting from the checkpoint before start_ts, and compare it
+// with expected starting at event first
+static int32_t read_capture(const std::string& fname, const std::vector<dumped_evt>& expected, uint32_t decompression_threads = SCAP_DECOMPRESSION_INLINE,
+			    uint64_t start_ts = 0, uint32_t first = 0)
+{
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc;
+	uint32_t n = first;
+	scap_open_args oargs = {};
+
+	oargs.mode = SCAP_MODE_CAPTURE;
+	oargs.fname = fname.c_str();
+	oargs.decompression_threads = decompression_threads;
+	oargs.start_ts = start_ts;
+	scap_t* h = scap_open(oargs, error, &rc);
+	EXPECT_NE(h, nullptr) << error;
+	if(h == nullptr)
+	{
+		return rc;
+	}
+
+	while(true)
+	{
+		scap_evt* evt;
+		uint16_t cpuid;
+
+		rc = scap_next(h, &evt, &cpuid);
+		if(rc == SCAP_UNEXPECTED_BLOCK)
+		{
+			// a checkpoint
+			rc = scap_restart_capture(h);
+			if(rc != SCAP_SUCCESS)
+			{
+				break;
+			}
+			continue;
+		}
+		else if(rc != SCAP_SUCCESS)
+		{
+			break;
+		}
+
+		EXPECT_LT(n, expected.size());
+		if(n < expected.size())
+		{
+			EXPECT_EQ(cpuid, expected[n].m_cpuid);
+			EXPECT_EQ(evt->len, expected[n].m_data.size());
+			EXPECT_EQ(memcmp(evt, expected[n].m_data.data(), evt->len), 0);
+		}
+		n++;
+	}
+
+	if(rc == SCAP_EOF)
+	{
+		EXPECT_EQ(n, expected.size());
+	}
+
+	scap_close(h);
+	return rc;
+}
+
+// uncompressed files are memory mapped, compressed ones go through zlib
+// (minimal builds have no zlib, and write both uncompressed): both must
+// return the same events
+TEST(scap_savefile, read_back)
+{
+	std::string plain = testing::TempDir() + "scap_savefile_plain.scap";
+	std::string gz = testing::TempDir() + "scap_savefile_gz.scap";
+
+	auto expected = write_capture(plain, SCAP_COMPRESSION_NONE);
+	EXPECT_EQ(read_capture(plain, expected), SCAP_EOF);
+
+	expected = write_capture(gz, SCAP_COMPRESSION_GZIP);
+	EXPECT_EQ(read_capture(gz, expected), SCAP_EOF);
+	EXPECT_EQ(read_capture(gz, expected, SCAP_DECOMPRESSION_AUTO), SCAP_EOF);
+
+	unlink(plain.c_str());
+	unlink(gz.c_str());
+}
+
+// chunked files span several chunks, that are inflated in parallel, and
+// must read the same with any number of threads
+TEST(scap_savefile, read_back_chunked)
+{
+	std::string fname = testing::TempDir() + "scap_savefile_chunked.scap";
+
+	auto expected = write_capture(fname, SCAP_COMPRESSION_GZIP_CHUNKED, 20000);
+	EXPECT_EQ(read_capture(fname, expected), SCAP_EOF);
+	EXPECT_EQ(read_capture(fname, expected, 1), SCAP_EOF);
+	EXPECT_EQ(read_capture(fname, expected, 4), SCAP_EOF);
+	EXPECT_EQ(read_capture(fname, expected, SCAP_DECOMPRESSION_AUTO), SCAP_EOF);
+
+	unlink(fname.c_str());
+}
+
+// seeking back, past the buffers that were already inflated, restarts the
+// decompression from the start of the file
+TEST(scap_savefile, seek_chunked)
+{
+	std::string fname = testing::TempDir() + "scap_savefile_seek.scap";
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc;
+	uint64_t off = 0;
+	scap_open_args oargs = {};
+	scap_evt* evt;
+	uint16_t cpuid;
+
+	auto expected = write_capture(fname, SCAP_COMPRESSION_GZIP_CHUNKED, 20000);
+	oargs.mode = SCAP_MODE_CAPTURE;
+	oargs.fname = fname.c_str();
+	oargs.decompression_threads = 2;
+	scap_t* h = scap_open(oargs, error, &rc);
+	ASSERT_NE(h, nullptr) << error;
+
+	for(uint32_t j = 0; j < 15000; j++)
+	{
+		if(j == 1000)
+		{
+			off = scap_ftell(h);
+		}
+		ASSERT_EQ(scap_next(h, &evt, &cpuid), SCAP_SUCCESS);
+	}
+
+	scap_fseek(h, off);
+	ASSERT_EQ(scap_next(h, &evt, &cpuid), SCAP_SUCCESS);
+	ASSERT_EQ(evt->len, expected[1000].m_data.size());
+	EXPECT_EQ(memcmp(evt, expected[1000].m_data.data(), evt->len), 0);
+
+	scap_close(h);
+	unlink(fname.c_str());
+}
+
+// the index maps timestamps to checkpoints, and reading can start from any
+// of them in every format
+TEST(scap_savefile, checkpoint_index)
+{
+	const compression_mode modes[] = {SCAP_COMPRESSION_NONE, SCAP_COMPRESSION_GZIP, SCAP_COMPRESSION_GZIP_CHUNKED};
+	std::string fname = testing::TempDir() + "scap_savefile_index.scap";
+	std::string ifname = fname + ".idx";
+	char error[SCAP_LASTERR_SIZE];
+
+	for(auto mode : modes)
+	{
+		// a checkpoint every 1000 events
+		auto expected = write_capture(fname, mode, 20000, 1000000);
+
+		scap_index_entry* entries;
+		uint32_t nentries;
+		compression_mode compress;
+		ASSERT_EQ(scap_read_index(fname.c_str(), &entries, &nentries, &compress, error), SCAP_SUCCESS) << error;
+		EXPECT_EQ(compress, mode);
+		ASSERT_EQ(nentries, 20);
+		EXPECT_EQ(entries[0].ts, 0);
+		EXPECT_EQ(entries[0].offset, 0);
+		for(uint32_t j = 1; j < nentries; j++)
+		{
+			EXPECT_EQ(entries[j].evtnum, j * 1000);
+			EXPECT_EQ(entries[j].ts, 1000 + j * 1000 * 1000);
+			EXPECT_GT(entries[j].offset, entries[j - 1].offset);
+		}
+		EXPECT_EQ(scap_index_find(entries, nentries, 0), 0);
+		EXPECT_EQ(scap_index_find(entries, nentries, entries[5].ts - 1), 4);
+		EXPECT_EQ(scap_index_find(entries, nentries, entries[5].ts), 5);
+		EXPECT_EQ(scap_index_find(entries, nentries, UINT64_MAX), 19);
+		free(entries);
+
+		// the whole file, crossing the checkpoints
+		EXPECT_EQ(read_capture(fname, expected), SCAP_EOF);
+
+		// from the checkpoint before event 12345
+		EXPECT_EQ(read_capture(fname, expected, SCAP_DECOMPRESSION_AUTO, 1000 + 12345 * 1000, 12000), SCAP_EOF);
+		EXPECT_EQ(read_capture(fname, expected, SCAP_DECOMPRESSION_INLINE, 1000 + 12345 * 1000, 12000), SCAP_EOF);
+	}
+
+	unlink(fname.c_str());
+	unlink(ifname.c_str());
+}
+
+// an index is never used with a file it wasn't written for
+TEST(scap_savefile, stale_index)
+{
+	std::string fname = testing::TempDir() + "scap_savefile_stale.scap";
+	std::string ifname = fname + ".idx";
+	char error[SCAP_LASTERR_SIZE];
+	scap_index_entry* entries;
+	uint32_t nentries;
+	compression_mode compress;
+
+	// rewriting the file without an index removes the old one
+	write_capture(fname, SCAP_COMPRESSION_NONE, 2000, 1000000);
+	ASSERT_EQ(scap_read_index(fname.c_str(), &entries, &nentries, &compress, error), SCAP_SUCCESS) << error;
+	free(entries);
+	write_capture(fname, SCAP_COMPRESSION_NONE, 3000);
+	EXPECT_NE(access(ifname.c_str(), F_OK), 0);
+
+	// an index left next to another file is rejected
+	write_capture(fname, SCAP_COMPRESSION_NONE, 2000, 1000000);
+	std::string saved = fname + ".saved";
+	ASSERT_EQ(rename(ifname.c_str(), saved.c_str()), 0);
+	write_capture(fname, SCAP_COMPRESSION_NONE, 3000);
+	ASSERT_EQ(rename(saved.c_str(), ifname.c_str()), 0);
+	EXPECT_EQ(scap_read_index(fname.c_str(), &entries, &nentries, &compress, error), SCAP_FAILURE);
+
+	scap_open_args oargs = {};
+	int32_t rc;
+	oargs.mode = SCAP_MODE_CAPTURE;
+	oargs.fname = fname.c_str();
+	oargs.start_ts = 1000 + 1500 * 1000;
+	EXPECT_EQ(scap_open(oargs, error, &rc), nullptr);
+	EXPECT_NE(std::string(error).find("doesn't match"), std::string::npos) << error;
+
+	unlink(fname.c_str());
+	unlink(ifname.c_str());
+}
+
+// the background writer produces the same files, and indexes, as gzwrite()
+TEST(scap_savefile, background_write)
+{
+	const compression_mode modes[] = {SCAP_COMPRESSION_NONE, SCAP_COMPRESSION_GZIP, SCAP_COMPRESSION_GZIP_CHUNKED};
+	const uint32_t flags[] = {SCAP_DOF_BACKGROUND_WRITE, SCAP_DOF_BACKGROUND_WRITE | SCAP_DOF_DIRECT_IO};
+	std::string fname = testing::TempDir() + "scap_savefile_background.scap";
+
+	for(auto mode : modes)
+	{
+		for(auto f : flags)
+		{
+			auto expected = write_capture(fname, mode, 20000, 1000000, f);
+			EXPECT_EQ(read_capture(fname, expected), SCAP_EOF);
+			EXPECT_EQ(read_capture(fname, expected, SCAP_DECOMPRESSION_AUTO), SCAP_EOF);
+			EXPECT_EQ(read_capture(fname, expected, SCAP_DECOMPRESSION_AUTO, 1000 + 12345 * 1000, 12000), SCAP_EOF);
+		}
+	}
+
+	unlink(fname.c_str());
+	unlink((fname + ".idx").c_str());
+}
+
+// rewrite the event blocks of fname in the format of old captures, whose
+// event headers have no nparams
+static void convert_to_v1(const std::string& fname)
+{
+	FILE* f = fopen(fname.c_str(), "rb");
+	ASSERT_NE(f, nullptr);
+	std::vector<uint8_t> in;
+	uint8_t buf[4096];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+	{
+		in.insert(in.end(), buf, buf + n);
+	}
+	fclose(f);
+
+	std::vector<uint8_t> out;
+	size_t off = 0;
+	while(off + sizeof(block_header) <= in.size())
+	{
+		block_header bh;
+		memcpy(&bh, &in[off], sizeof(bh));
+		ASSERT_LE(off + bh.block_total_length, in.size());
+		if(bh.block_type != EV_BLOCK_TYPE_V2)
+		{
+			out.insert(out.end(), in.begin() + off, in.begin() + off + bh.block_total_length);
+			off += bh.block_total_length;
+			continue;
+		}
+
+		// the v1 header ends right before nparams
+		size_t hdr = off + sizeof(bh) + sizeof(uint16_t);
+		size_t nparams_off = hdr + sizeof(scap_evt) - sizeof(uint32_t);
+		block_header v1 = {EV_BLOCK_TYPE, bh.block_total_length - (uint32_t)sizeof(uint32_t)};
+		uint32_t evt_len;
+		memcpy(&evt_len, &in[hdr + 16], sizeof(evt_len));
+		evt_len -= sizeof(uint32_t);
+
+		size_t start = out.size();
+		out.insert(out.end(), (uint8_t*)&v1, (uint8_t*)&v1 + sizeof(v1));
+		out.insert(out.end(), in.begin() + off + sizeof(bh), in.begin() + nparams_off);
+		out.insert(out.end(), in.begin() + nparams_off + sizeof(uint32_t), in.begin() + off + bh.block_total_length - sizeof(uint32_t));
+		out.insert(out.end(), (uint8_t*)&v1.block_total_length, (uint8_t*)&v1.block_total_length + sizeof(uint32_t));
+		memcpy(&out[start + sizeof(bh) + sizeof(uint16_t) + 16], &evt_len, sizeof(evt_len));
+		off += bh.block_total_length;
+	}
+
+	f = fopen(fname.c_str(), "wb");
+	ASSERT_NE(f, nullptr);
+	ASSERT_EQ(fwrite(out.data(), 1, out.size(), f), out.size());
+	fclose(f);
+}
+
+// events of old captures are converted to the current format when read
+TEST(scap_savefile, read_v1)
+{
+	std::string fname = testing::TempDir() + "scap_savefile_v1.scap";
+
+	auto expected = write_capture(fname, SCAP_COMPRESSION_NONE);
+	convert_to_v1(fname);
+	EXPECT_EQ(read_capture(fname, expected), SCAP_EOF);
+
+	unlink(fname.c_str());
+}
+
+TEST(scap_savefile, truncated)
+{
+	std::string plain = testing::TempDir() + "scap_savefile_truncated.scap";
+
+	auto expected = write_capture(plain, SCAP_COMPRESSION_NONE);
+	FILE* f = fopen(plain.c_str(), "r+");
+	ASSERT_NE(f, nullptr);
+	fseek(f, 0, SEEK_END);
+	ASSERT_EQ(ftruncate(fileno(f), ftell(f) - 10), 0);
+	fclose(f);
+
+	EXPECT_EQ(read_capture(plain, expected), SCAP_FAILURE);
+	unlink(plain.c_str());
+}
@@ -0,0 +1,105 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+//
+// Helpers writing the captures replayed by the benchmarks. The events are
+// built from their parameters, 1us apart, and any error exits.
+//
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <sinsp.h>
+
+inline void open_bench_capture(const std::string& fname, scap_t** h, scap_dumper_t** d)
+{
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc;
+	scap_open_args oargs = {};
+
+	oargs.mode = SCAP_MODE_NODRIVER;
+	*h = scap_open(oargs, error, &rc);
+	if(*h == NULL)
+	{
+		fprintf(stderr, "cannot open scap: %s\n", error);
+		exit(1);
+	}
+
+	*d = scap_dump_open(*h, fname.c_str(), SCAP_COMPRESSION_NONE, true);
+	if(*d == NULL)
+	{
+		fprintf(stderr, "cannot open %s: %s\n", fname.c_str(), scap_getlasterr(*h));
+		exit(1);
+	}
+}
+
+inline void close_bench_capture(scap_t* h, scap_dumper_t* d)
+{
+	scap_dump_close(d);
+	scap_close(h);
+}
+
+//
+// Write an event with the given parameters, see scap_event_encode_params(),
+// advancing *ts
+//
+inline void dump_evt(scap_t* h, scap_dumper_t* d, uint64_t* ts, int64_t tid, ppm_event_type type, uint32_t n, ...)
+{
+	char error[SCAP_LASTERR_SIZE];
+	uint8_t buf[1024];
+	scap_sized_buffer evt_buf = {buf, sizeof(buf)};
+	size_t evt_size;
+	va_list args;
+
+	va_start(args, n);
+	int32_t res = scap_event_encode_params_v(evt_buf, &evt_size, error, type, n, args);
+	va_end(args);
+	if(res != SCAP_SUCCESS)
+	{
+		fprintf(stderr, "cannot encode event: %s\n", error);
+		exit(1);
+	}
+
+	scap_evt* evt = (scap_evt*)buf;
+	*ts += 1000;
+	evt->ts = *ts;
+	evt->tid = tid;
+	if(scap_dump(h, d, evt, 0, 0) != SCAP_SUCCESS)
+	{
+		fprintf(stderr, "cannot write event: %s\n", scap_getlasterr(h));
+		exit(1);
+	}
+}
+
+//
+// Write the clone() exit event of the child of a new process tid, its
+// first event
+//
+inline void dump_clone_evt(scap_t* h, scap_dumper_t* d, uint64_t* ts, int64_t tid, int64_t ptid,
+			   const char* exe, const char* comm,
+			   scap_const_sized_buffer args = scap_const_sized_buffer{"", 0},
+			   scap_const_sized_buffer cgroups = scap_const_sized_buffer{"", 0})
+{
+	dump_evt(h, d, ts, tid, PPME_SYSCALL_CLONE_20_X, 20,
+		 (int64_t)0, exe, args, tid, tid, ptid, "/", (int64_t)1024,
+		 (uint64_t)0, (uint64_t)0, (uint32_t)0, (uint32_t)0, (uint32_t)0,
+		 comm, cgroups, (uint32_t)0, (uint32_t)0, (uint32_t)0, tid, tid);
+}
@@ -0,0 +1,236 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Compares the fd table with an unordered_map of fdinfos, the layout it
+// replaced: memory used per fd, and the time of a lookup in the tables of
+// many processes, that use small fd numbers.
+//
+// usage: sinsp-bench-fdtable [processes=10000] [fds_per_process=32]
+//
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <vector>
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <sinsp.h>
+
+static int64_t g_allocated = 0;
+
+void* operator new(size_t size)
+{
+	void* p = malloc(size);
+	if(p == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	g_allocated += malloc_usable_size(p);
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	if(p != NULL)
+	{
+		g_allocated -= malloc_usable_size(p);
+		free(p);
+	}
+}
+
+void operator delete(void* p, size_t size) noexcept
+{
+	operator delete(p);
+}
+
+static uint64_t g_rand_state = 88172645463325252ULL;
+
+static uint64_t next_rand()
+{
+	g_rand_state ^= g_rand_state << 13;
+	g_rand_state ^= g_rand_state >> 7;
+	g_rand_state ^= g_rand_state << 17;
+	return g_rand_state;
+}
+
+static uint64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The fd table before the small fds were stored in an array
+class unordered_fdtable
+{
+public:
+	unordered_fdtable(sinsp* inspector):
+		m_inspector(inspector),
+		m_last_accessed_fd(-1),
+		m_last_accessed_fdinfo(NULL)
+	{
+	}
+
+	sinsp_fdinfo_t* add(int64_t fd, sinsp_fdinfo_t* fdinfo)
+	{
+		m_last_accessed_fd = -1;
+		return &(m_table.emplace(fd, *fdinfo).first->second);
+	}
+
+	sinsp_fdinfo_t* find(int64_t fd)
+	{
+		if(m_last_accessed_fd != -1 && fd == m_last_accessed_fd)
+		{
+			return m_last_accessed_fdinfo;
+		}
+
+		auto it = m_table.find(fd);
+		if(it == m_table.end())
+		{
+			return NULL;
+		}
+
+		m_last_accessed_fd = fd;
+		m_last_accessed_fdinfo = &(it->second);
+		lookup_device(&(it->second));
+		return &(it->second);
+	}
+
+private:
+	// Same checks as sinsp_fdtable::lookup_device()
+	void lookup_device(sinsp_fdinfo_t* fdi)
+	{
+		if(m_inspector->is_capture())
+		{
+			return;
+		}
+
+		if(fdi->is_file() && fdi->get_device() == UINT32_MAX)
+		{
+			abort();
+		}
+	}
+
+	sinsp* m_inspector;
+	std::unordered_map<int64_t, sinsp_fdinfo_t> m_table;
+	int64_t m_last_accessed_fd;
+	sinsp_fdinfo_t* m_last_accessed_fdinfo;
+};
+
+template<typename table_t>
+static void bench_table(const char* name, sinsp* inspector, uint32_t nprocs, uint32_t nfds)
+{
+	std::vector<std::unique_ptr<table_t>> tables;
+	std::vector<std::pair<uint32_t, int64_t>> lookups;
+	sinsp_fdinfo_t fdinfo;
+	uint64_t sum = 0;
+
+	fdinfo.m_type = SCAP_FD_FILE_V2;
+	fdinfo.m_name = "/var/lib/app/data/file.db";
+
+	int64_t allocated = g_allocated;
+	for(uint32_t j = 0; j < nprocs; j++)
+	{
+		tables.emplace_back(new table_t(inspector));
+		for(uint32_t k = 0; k < nfds; k++)
+		{
+			tables.back()->add(k, &fdinfo);
+		}
+	}
+	allocated = g_allocated - allocated;
+
+	g_rand_state = 88172645463325252ULL;
+	for(uint32_t j = 0; j < 4 * 1024 * 1024; j++)
+	{
+		lookups.emplace_back(next_rand() % nprocs, (int64_t)(next_rand() % nfds));
+	}
+
+	uint64_t start = now_ns();
+	for(auto& l : lookups)
+	{
+		sinsp_fdinfo_t* fdi = tables[l.first]->find(l.second);
+		if(fdi != NULL)
+		{
+			sum += fdi->m_type;
+		}
+	}
+	uint64_t lookup_ns = now_ns() - start;
+
+	printf("%-14s %6.1f bytes/fd, lookup %5.1f ns (%" PRIu64 ")\n",
+	       name,
+	       (double)allocated / ((uint64_t)nprocs * nfds),
+	       (double)lookup_ns / lookups.size(),
+	       sum);
+}
+
+//
+// Every table is measured in its own process, so that it doesn't get the
+// heap left by the previous one
+//
+template<typename fn_t>
+static void run_in_child(fn_t fn)
+{
+	fflush(stdout);
+	pid_t pid = fork();
+	if(pid == 0)
+	{
+		fn();
+		fflush(stdout);
+		_exit(0);
+	}
+	else if(pid > 0)
+	{
+		waitpid(pid, NULL, 0);
+	}
+	else
+	{
+		perror("fork");
+		exit(1);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t nprocs = 10000;
+	uint32_t nfds = 32;
+	sinsp inspector;
+
+	if(argc > 1)
+	{
+		nprocs = atoi(argv[1]);
+	}
+	if(argc > 2)
+	{
+		nfds = atoi(argv[2]);
+	}
+	if(nprocs == 0 || nfds == 0)
+	{
+		fprintf(stderr, "usage: %s [processes] [fds_per_process]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%u processes, %u fds each, sizeof(sinsp_fdinfo_t) %zu\n", nprocs, nfds, sizeof(sinsp_fdinfo_t));
+	run_in_child([&]() { bench_table<unordered_fdtable>("unordered_map", &inspector, nprocs, nfds); });
+	run_in_child([&]() { bench_table<sinsp_fdtable>("sinsp_fdtable", &inspector, nprocs, nfds); });
+	return 0;
+}
@@ -0,0 +1,263 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Compares the filtercheck trees built by sinsp_filter_compiler with the
+// programs built by sinsp_filter_program_compiler, alone and gathered in a
+// sinsp_filter_set, evaluating many rules like the ones of Falco on every
+// event of a capture. The time of reading the capture without filters is
+// subtracted.
+//
+// usage: sinsp-bench-filter [rules=100] [passes=5]
+//
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <sinsp.h>
+#include "bench_capture.h"
+#include <filter_set.h>
+
+#define FIRST_TID 5000000
+#define NPROCS 50
+#define NITERATIONS 5000
+
+static uint64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void write_capture(const std::string& fname)
+{
+	scap_t* h;
+	scap_dumper_t* d;
+	uint64_t ts = 1000000000;
+	uint8_t payload[64] = {};
+	scap_const_sized_buffer data = {payload, sizeof(payload)};
+
+	open_bench_capture(fname, &h, &d);
+
+	for(int64_t tid = FIRST_TID; tid < FIRST_TID + NPROCS; tid++)
+	{
+		std::string comm = "app" + std::to_string(tid % 10);
+		std::string exe = "/usr/bin/" + comm;
+
+		dump_clone_evt(h, d, &ts, tid, 1, exe.c_str(), comm.c_str());
+	}
+
+	for(uint32_t j = 0; j < NITERATIONS; j++)
+	{
+		int64_t tid = FIRST_TID + j % NPROCS;
+		int64_t fd = 3 + (j / NPROCS) % 16;
+		std::string name = (j % 2 ? "/etc/app/conf" : "/var/lib/app/data") + std::to_string(fd);
+
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_OPEN_E, 3, name.c_str(), (uint32_t)0, (uint32_t)0);
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_OPEN_X, 5, fd, name.c_str(), (uint32_t)0, (uint32_t)0, (uint32_t)0);
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_READ_E, 2, fd, (uint32_t)sizeof(payload));
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_READ_X, 2, (int64_t)sizeof(payload), data);
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_CLOSE_E, 1, fd);
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	}
+
+	close_bench_capture(h, d);
+}
+
+// Rules in the shape of the Falco ones, that mostly don't match
+static std::vector<std::string> make_rules(uint32_t nrules)
+{
+	std::vector<std::string> rules;
+
+	for(uint32_t j = 0; j < nrules; j++)
+	{
+		std::string n = std::to_string(j);
+
+		switch(j % 4)
+		{
+		case 0:
+			rules.push_back("evt.type in (open, openat) and evt.dir = < and fd.typechar = f"
+				" and fd.name startswith /etc/rule" + n +
+				" and not proc.name in (app1, app2, sshd, bash)");
+			break;
+		case 1:
+			rules.push_back("evt.type = read and evt.dir = < and evt.rawres >= 64"
+				" and proc.name = app" + n);
+			break;
+		case 2:
+			rules.push_back("(evt.type = close or evt.type = open) and fd.num >= 100"
+				" and fd.name contains rule" + n);
+			break;
+		default:
+			rules.push_back("evt.dir = < and proc.name = app" + n +
+				" and (fd.name endswith .rule" + n + " or fd.name glob /tmp/rule" + n + "*)");
+			break;
+		}
+	}
+	return rules;
+}
+
+// Returns the time per event of reading the capture and running fn on every event
+template<typename fn_t>
+static double read_capture(const std::string& fname, sinsp* inspector, uint64_t* nevts, uint64_t* nmatches, fn_t fn)
+{
+	sinsp_evt* evt;
+
+	inspector->open(fname);
+
+	*nevts = 0;
+	*nmatches = 0;
+	uint64_t start = now_ns();
+	while(true)
+	{
+		int32_t res = inspector->next(&evt);
+		if(res == SCAP_EOF)
+		{
+			break;
+		}
+		else if(res == SCAP_SUCCESS)
+		{
+			(*nevts)++;
+			*nmatches += fn(evt);
+		}
+		else if(res != SCAP_TIMEOUT)
+		{
+			fprintf(stderr, "read failed: %s\n", inspector->getlasterr().c_str());
+			exit(1);
+		}
+	}
+	uint64_t elapsed_ns = now_ns() - start;
+
+	inspector->close();
+	return (double)elapsed_ns / *nevts;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t nrules = 100;
+	uint32_t passes = 5;
+	uint64_t nevts;
+	uint64_t nmatches_tree;
+	uint64_t nmatches_program;
+	uint64_t nmatches_set;
+	double best[4] = {};
+	sinsp inspector;
+	sinsp_filter_cache cache;
+	std::vector<std::unique_ptr<sinsp_filter>> trees;
+	std::vector<std::unique_ptr<sinsp_filter_program>> programs;
+
+	if(argc > 1)
+	{
+		nrules = atoi(argv[1]);
+	}
+	if(argc > 2)
+	{
+		passes = atoi(argv[2]);
+	}
+	if(nrules == 0 || passes == 0)
+	{
+		fprintf(stderr, "usage: %s [rules] [passes]\n", argv[0]);
+		return 1;
+	}
+
+	std::string fname = "/tmp/sinsp-bench-filter.scap";
+	write_capture(fname);
+
+	std::shared_ptr<gen_event_filter_factory> factory(new sinsp_filter_factory(&inspector));
+	sinsp_filter_set set(factory);
+	size_t ninstructions = 0;
+	int32_t rule_id = 0;
+	for(auto& rule : make_rules(nrules))
+	{
+		sinsp_filter_compiler compiler(factory, rule);
+		sinsp_filter_program_compiler program_compiler(factory, rule, &cache);
+		trees.emplace_back(compiler.compile());
+		programs.emplace_back(program_compiler.compile());
+		ninstructions += programs.back()->size();
+		set.add(rule, rule_id++);
+	}
+
+	auto run_trees = [&](sinsp_evt* evt)
+	{
+		uint64_t n = 0;
+		for(auto& t : trees)
+		{
+			n += t->run(evt);
+		}
+		return n;
+	};
+
+	auto run_programs = [&](sinsp_evt* evt)
+	{
+		uint64_t n = 0;
+		for(auto& p : programs)
+		{
+			n += p->run(evt);
+		}
+		return n;
+	};
+
+	std::vector<int32_t> rule_ids;
+	auto run_set = [&](sinsp_evt* evt)
+	{
+		set.run(evt, rule_ids);
+		return rule_ids.size();
+	};
+
+	//
+	// Keep the best of the passes, the others are disturbed by
+	// something else
+	//
+	for(uint32_t j = 0; j < passes; j++)
+	{
+		double ns[4];
+
+		ns[0] = read_capture(fname, &inspector, &nevts, &nmatches_tree, [](sinsp_evt*) { return 0; });
+		ns[1] = read_capture(fname, &inspector, &nevts, &nmatches_tree, run_trees);
+		ns[2] = read_capture(fname, &inspector, &nevts, &nmatches_program, run_programs);
+		ns[3] = read_capture(fname, &inspector, &nevts, &nmatches_set, run_set);
+
+		for(uint32_t k = 0; k < 4; k++)
+		{
+			if(j == 0 || ns[k] < best[k])
+			{
+				best[k] = ns[k];
+			}
+		}
+	}
+
+	if(nmatches_tree != nmatches_program || nmatches_tree != nmatches_set)
+	{
+		fprintf(stderr, "the trees matched %" PRIu64 " times, the programs %" PRIu64 " times, the set %" PRIu64 " times\n",
+			nmatches_tree, nmatches_program, nmatches_set);
+		return 1;
+	}
+
+	printf("%" PRIu64 " events, %u rules, %zu instructions, %zu extracted fields, %" PRIu64 " matches\n",
+	       nevts, nrules, ninstructions, cache.num_fields(), nmatches_tree);
+	printf("tree    %8.1f ns/event\n", best[1] - best[0]);
+	printf("program %8.1f ns/event\n", best[2] - best[0]);
+	printf("set     %8.1f ns/event\n", best[3] - best[0]);
+
+	unlink(fname.c_str());
+	return 0;
+}
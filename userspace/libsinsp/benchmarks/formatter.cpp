@@ -0,0 +1,238 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Compares the JSON rendering of sinsp_evt_formatter, that writes the
+// values straight in the output, with building a Json::Value of the
+// fields and writing it with jsoncpp, as the formatter used to do. The
+// text rendering is measured too. The time of reading the capture is
+// subtracted.
+//
+// usage: sinsp-bench-formatter [passes=5]
+//
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <sinsp.h>
+#include "bench_capture.h"
+#include <filterchecks.h>
+
+#define FIRST_TID 5000000
+#define NPROCS 50
+#define NITERATIONS 5000
+
+#define FORMAT "%evt.num %evt.rawtime %evt.cpu %proc.name %thread.tid %evt.dir %evt.type " \
+	"%fd.num %fd.name %evt.rawres %user.uid %proc.exepath"
+
+static uint64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void write_capture(const std::string& fname)
+{
+	scap_t* h;
+	scap_dumper_t* d;
+	uint64_t ts = 1000000000;
+	uint8_t payload[64] = {};
+	scap_const_sized_buffer data = {payload, sizeof(payload)};
+
+	open_bench_capture(fname, &h, &d);
+
+	for(int64_t tid = FIRST_TID; tid < FIRST_TID + NPROCS; tid++)
+	{
+		std::string comm = "app" + std::to_string(tid % 10);
+		std::string exe = "/usr/bin/" + comm;
+
+		dump_clone_evt(h, d, &ts, tid, 1, exe.c_str(), comm.c_str());
+	}
+
+	for(uint32_t j = 0; j < NITERATIONS; j++)
+	{
+		int64_t tid = FIRST_TID + j % NPROCS;
+		int64_t fd = 3 + (j / NPROCS) % 16;
+		std::string name = (j % 2 ? "/etc/app/conf" : "/var/lib/app/data") + std::to_string(fd);
+
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_OPEN_E, 3, name.c_str(), (uint32_t)0, (uint32_t)0);
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_OPEN_X, 5, fd, name.c_str(), (uint32_t)0, (uint32_t)0, (uint32_t)0);
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_READ_E, 2, fd, (uint32_t)sizeof(payload));
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_READ_X, 2, (int64_t)sizeof(payload), data);
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_CLOSE_E, 1, fd);
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	}
+
+	close_bench_capture(h, d);
+}
+
+// Returns the time per event of reading the capture and running fn on every event, adding up what it returns
+template<typename fn_t>
+static double read_capture(const std::string& fname, sinsp* inspector, uint64_t* nevts, uint64_t* nbytes, fn_t fn)
+{
+	sinsp_evt* evt;
+
+	inspector->open(fname);
+
+	*nevts = 0;
+	*nbytes = 0;
+	uint64_t start = now_ns();
+	while(true)
+	{
+		int32_t res = inspector->next(&evt);
+		if(res == SCAP_EOF)
+		{
+			break;
+		}
+		else if(res == SCAP_SUCCESS)
+		{
+			(*nevts)++;
+			*nbytes += fn(evt);
+		}
+		else if(res != SCAP_TIMEOUT)
+		{
+			fprintf(stderr, "read failed: %s\n", inspector->getlasterr().c_str());
+			exit(1);
+		}
+	}
+	uint64_t elapsed_ns = now_ns() - start;
+
+	inspector->close();
+	return (double)elapsed_ns / *nevts;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t passes = 5;
+	uint64_t nevts;
+	uint64_t nbytes[3];
+	double best[4] = {};
+	sinsp inspector;
+	uint64_t nmismatches = 0;
+
+	if(argc > 1)
+	{
+		passes = atoi(argv[1]);
+	}
+	if(passes == 0)
+	{
+		fprintf(stderr, "usage: %s [passes]\n", argv[0]);
+		return 1;
+	}
+
+	std::string fname = "/tmp/sinsp-bench-formatter.scap";
+	write_capture(fname);
+
+	sinsp_evt_formatter json_formatter(&inspector);
+	json_formatter.set_format(gen_event_formatter::OF_JSON, FORMAT);
+	sinsp_evt_formatter text_formatter(&inspector);
+	text_formatter.set_format(gen_event_formatter::OF_NORMAL, FORMAT);
+
+	// The fields of the format, for the jsoncpp rendering
+	std::vector<std::pair<std::string, std::unique_ptr<sinsp_filter_check>>> fields;
+	std::string fmt = FORMAT;
+	for(size_t pos = fmt.find('%'); pos != std::string::npos; pos = fmt.find('%', pos + 1))
+	{
+		std::string name = fmt.substr(pos + 1, fmt.find(' ', pos) - pos - 1);
+		sinsp_filter_check* chk = g_filterlist.new_filter_check_from_fldname(name, &inspector, false);
+		chk->parse_field_name(name.c_str(), true, false);
+		fields.emplace_back(name, std::unique_ptr<sinsp_filter_check>(chk));
+	}
+
+	Json::Value root;
+	Json::FastWriter writer;
+	std::string jsoncpp_output;
+	auto run_jsoncpp = [&](sinsp_evt* evt)
+	{
+		for(auto& f : fields)
+		{
+			if(f.second->tojson(evt) == Json::nullValue)
+			{
+				return (size_t)0;
+			}
+			root[f.first] = f.second->tojson(evt);
+		}
+		jsoncpp_output = writer.write(root);
+		jsoncpp_output = jsoncpp_output.substr(0, jsoncpp_output.size() - 1);
+		return jsoncpp_output.size();
+	};
+
+	std::string output;
+	auto run_json = [&](sinsp_evt* evt)
+	{
+		return json_formatter.tostring(evt, &output) ? output.size() : 0;
+	};
+
+	auto run_text = [&](sinsp_evt* evt)
+	{
+		return text_formatter.tostring(evt, &output) ? output.size() : 0;
+	};
+
+	auto run_compare = [&](sinsp_evt* evt)
+	{
+		if(run_jsoncpp(evt) != 0 && (run_json(evt) == 0 || output != jsoncpp_output))
+		{
+			nmismatches++;
+		}
+		return 0;
+	};
+
+	//
+	// Keep the best of the passes, the others are disturbed by
+	// something else
+	//
+	for(uint32_t j = 0; j < passes; j++)
+	{
+		double ns[4];
+
+		ns[0] = read_capture(fname, &inspector, &nevts, &nbytes[0], [](sinsp_evt*) { return 0; });
+		ns[1] = read_capture(fname, &inspector, &nevts, &nbytes[0], run_jsoncpp);
+		ns[2] = read_capture(fname, &inspector, &nevts, &nbytes[1], run_json);
+		ns[3] = read_capture(fname, &inspector, &nevts, &nbytes[2], run_text);
+
+		for(uint32_t k = 0; k < 4; k++)
+		{
+			if(j == 0 || ns[k] < best[k])
+			{
+				best[k] = ns[k];
+			}
+		}
+	}
+
+	read_capture(fname, &inspector, &nevts, &nbytes[2], run_compare);
+	if(nbytes[0] != nbytes[1] || nmismatches != 0)
+	{
+		fprintf(stderr, "jsoncpp wrote %" PRIu64 " bytes, the formatter %" PRIu64 " bytes, %" PRIu64 " events differ\n",
+			nbytes[0], nbytes[1], nmismatches);
+		return 1;
+	}
+
+	printf("%" PRIu64 " events, %zu fields, %" PRIu64 " bytes of JSON\n",
+	       nevts, fields.size(), nbytes[0]);
+	printf("jsoncpp   %8.1f ns/event\n", best[1] - best[0]);
+	printf("formatter %8.1f ns/event\n", best[2] - best[0]);
+	printf("text      %8.1f ns/event\n", best[3] - best[0]);
+
+	unlink(fname.c_str());
+	return 0;
+}
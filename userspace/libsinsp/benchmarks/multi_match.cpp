@@ -0,0 +1,299 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Compares testing file paths against the patterns of the sensitive file
+// rules one pattern at a time, as the filtercheck trees do, with testing
+// them against all the patterns at once with a multi_string_matcher. The
+// same is done for glob patterns, with fnmatch() and a glob_matcher.
+//
+// usage: sinsp-bench-multimatch [paths=100000] [passes=5]
+//
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <glob_matcher.h>
+#include <multi_string_matcher.h>
+#include <utils.h>
+
+struct pattern
+{
+	const char* m_str;
+	multi_string_matcher::pattern_type m_type;
+};
+
+static const pattern patterns[] = {
+	{"/etc/shadow", multi_string_matcher::STARTSWITH},
+	{"/etc/sudoers", multi_string_matcher::STARTSWITH},
+	{"/etc/pam.conf", multi_string_matcher::STARTSWITH},
+	{"/etc/pam.d/", multi_string_matcher::STARTSWITH},
+	{"/etc/security/", multi_string_matcher::STARTSWITH},
+	{"/etc/ssh/", multi_string_matcher::STARTSWITH},
+	{"/etc/krb5", multi_string_matcher::STARTSWITH},
+	{"/etc/gshadow", multi_string_matcher::STARTSWITH},
+	{"/etc/ld.so.preload", multi_string_matcher::STARTSWITH},
+	{"/etc/crontab", multi_string_matcher::STARTSWITH},
+	{"/etc/cron.d/", multi_string_matcher::STARTSWITH},
+	{"/var/spool/cron/", multi_string_matcher::STARTSWITH},
+	{"/root/.ssh/", multi_string_matcher::STARTSWITH},
+	{"/root/.bash_history", multi_string_matcher::STARTSWITH},
+	{"/proc/self/environ", multi_string_matcher::STARTSWITH},
+	{"/dev/mem", multi_string_matcher::STARTSWITH},
+	{"/dev/kmem", multi_string_matcher::STARTSWITH},
+	{"/boot/", multi_string_matcher::STARTSWITH},
+	{"/var/run/docker.sock", multi_string_matcher::STARTSWITH},
+	{"/run/containerd/", multi_string_matcher::STARTSWITH},
+	{"/.ssh/", multi_string_matcher::CONTAINS},
+	{"/.aws/", multi_string_matcher::CONTAINS},
+	{"/.kube/", multi_string_matcher::CONTAINS},
+	{"/.docker/config.json", multi_string_matcher::CONTAINS},
+	{"/.gnupg/", multi_string_matcher::CONTAINS},
+	{"/.git-credentials", multi_string_matcher::CONTAINS},
+	{"/.netrc", multi_string_matcher::CONTAINS},
+	{"/.pgpass", multi_string_matcher::CONTAINS},
+	{"/.mysql_history", multi_string_matcher::CONTAINS},
+	{"/secrets/", multi_string_matcher::CONTAINS},
+	{"/serviceaccount/token", multi_string_matcher::CONTAINS},
+	{"/kubelet/pki/", multi_string_matcher::CONTAINS},
+	{"/etcd/", multi_string_matcher::CONTAINS},
+	{".pem", multi_string_matcher::ENDSWITH},
+	{".key", multi_string_matcher::ENDSWITH},
+	{".crt", multi_string_matcher::ENDSWITH},
+	{".p12", multi_string_matcher::ENDSWITH},
+	{".pfx", multi_string_matcher::ENDSWITH},
+	{".jks", multi_string_matcher::ENDSWITH},
+	{".kdbx", multi_string_matcher::ENDSWITH},
+	{".ovpn", multi_string_matcher::ENDSWITH},
+	{"id_rsa", multi_string_matcher::ENDSWITH},
+	{"id_dsa", multi_string_matcher::ENDSWITH},
+	{"id_ecdsa", multi_string_matcher::ENDSWITH},
+	{"id_ed25519", multi_string_matcher::ENDSWITH},
+	{"authorized_keys", multi_string_matcher::ENDSWITH},
+	{"known_hosts", multi_string_matcher::ENDSWITH},
+	{"password", multi_string_matcher::ICONTAINS},
+	{"passwd", multi_string_matcher::ICONTAINS},
+	{"credential", multi_string_matcher::ICONTAINS},
+	{"secret", multi_string_matcher::ICONTAINS},
+	{"private", multi_string_matcher::ICONTAINS},
+};
+
+static const size_t npatterns = sizeof(patterns) / sizeof(patterns[0]);
+
+static const char* globs[] = {
+	"/etc/*.conf",
+	"/etc/ssh/*",
+	"/home/*/.ssh/*",
+	"/root/.*history",
+	"/proc/[0-9]*/environ",
+	"/proc/[0-9]*/mem",
+	"/usr/lib/*/libpam*.so*",
+	"/lib/*/security/pam_*.so",
+	"/var/lib/docker/overlay2/*/diff/etc/shadow",
+	"/var/run/secrets/*/token",
+	"/run/secrets/*",
+	"*/.aws/credentials",
+	"*/.kube/config",
+	"/tmp/.[a-z]*",
+	"/dev/shm/*.so",
+	"/etc/cron.*/*",
+	"/var/spool/cron/crontabs/*",
+	"/etc/systemd/system/*.service",
+	"/etc/init.d/*",
+	"/usr/share/*/id_?sa",
+};
+
+static const size_t nglobs = sizeof(globs) / sizeof(globs[0]);
+
+static uint64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Paths in the shape of the ones opened on a busy host, a few sensitive
+static std::vector<std::string> make_paths(uint32_t npaths)
+{
+	static const char* dirs[] = {"/usr/lib/x86_64-linux-gnu/", "/proc/1234/", "/var/lib/docker/overlay2/3f2a9c/diff/",
+		"/home/user/project/src/", "/tmp/", "/etc/", "/usr/share/locale/en_US/LC_MESSAGES/", "/var/log/",
+		"/sys/fs/cgroup/memory/", "/home/user/.ssh/", "/etc/ssl/certs/", "/run/secrets/"};
+	static const char* names[] = {"libc.so.6", "status", "index.js", "main.cpp", "tmp.XyZ123", "hosts",
+		"messages.mo", "syslog", "memory.usage_in_bytes", "id_rsa", "ca-certificates.crt", "Passwords.txt",
+		"resolv.conf", "libpthread.so.0", "cmdline", "package.json"};
+	std::vector<std::string> paths;
+	uint64_t r = 88172645463325252ULL;
+
+	for(uint32_t j = 0; j < npaths; j++)
+	{
+		r ^= r << 13;
+		r ^= r >> 7;
+		r ^= r << 17;
+		paths.push_back(std::string(dirs[r % (sizeof(dirs) / sizeof(dirs[0]))]) +
+			names[(r >> 16) % (sizeof(names) / sizeof(names[0]))]);
+	}
+	return paths;
+}
+
+static bool match_one_by_one(const char* path)
+{
+	size_t len = strlen(path);
+
+	for(size_t j = 0; j < npatterns; j++)
+	{
+		const pattern& p = patterns[j];
+		bool res;
+
+		switch(p.m_type)
+		{
+		case multi_string_matcher::CONTAINS:
+			res = strstr(path, p.m_str) != NULL;
+			break;
+		case multi_string_matcher::STARTSWITH:
+			res = strncmp(path, p.m_str, strlen(p.m_str)) == 0;
+			break;
+		case multi_string_matcher::ENDSWITH:
+			res = sinsp_utils::endswith(path, p.m_str, len, strlen(p.m_str));
+			break;
+		default:
+			res = strcasestr(path, p.m_str) != NULL;
+			break;
+		}
+
+		if(res)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool glob_one_by_one(const char* path)
+{
+	for(size_t j = 0; j < nglobs; j++)
+	{
+		if(sinsp_utils::glob_match(globs[j], path))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+template<typename fn_t>
+static double run(const std::vector<std::string>& paths, uint64_t* nmatches, fn_t fn)
+{
+	*nmatches = 0;
+	uint64_t start = now_ns();
+	for(auto& p : paths)
+	{
+		*nmatches += fn(p.c_str());
+	}
+	return (double)(now_ns() - start) / paths.size();
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t npaths = 100000;
+	uint32_t passes = 5;
+	uint64_t nmatches_one;
+	uint64_t nmatches_multi;
+	uint64_t nglob_matches_one;
+	uint64_t nglob_matches_multi;
+	double best[4] = {};
+	multi_string_matcher matcher;
+	glob_matcher glob;
+
+	if(argc > 1)
+	{
+		npaths = atoi(argv[1]);
+	}
+	if(argc > 2)
+	{
+		passes = atoi(argv[2]);
+	}
+	if(npaths == 0 || passes == 0)
+	{
+		fprintf(stderr, "usage: %s [paths] [passes]\n", argv[0]);
+		return 1;
+	}
+
+	for(size_t j = 0; j < npatterns; j++)
+	{
+		matcher.add(patterns[j].m_str, patterns[j].m_type);
+	}
+	matcher.compile();
+
+	for(size_t j = 0; j < nglobs; j++)
+	{
+		glob.add(globs[j]);
+	}
+
+	std::vector<std::string> paths = make_paths(npaths);
+	auto match_multi = [&](const char* path)
+	{
+		return matcher.match(path);
+	};
+	auto glob_multi = [&](const char* path)
+	{
+		return glob.match(path);
+	};
+
+	for(uint32_t j = 0; j < passes; j++)
+	{
+		double ns[4];
+
+		ns[0] = run(paths, &nmatches_one, match_one_by_one);
+		ns[1] = run(paths, &nmatches_multi, match_multi);
+		ns[2] = run(paths, &nglob_matches_one, glob_one_by_one);
+		ns[3] = run(paths, &nglob_matches_multi, glob_multi);
+
+		for(uint32_t k = 0; k < 4; k++)
+		{
+			if(j == 0 || ns[k] < best[k])
+			{
+				best[k] = ns[k];
+			}
+		}
+	}
+
+	if(nmatches_one != nmatches_multi)
+	{
+		fprintf(stderr, "the patterns matched %" PRIu64 " times one by one, %" PRIu64 " times together\n",
+			nmatches_one, nmatches_multi);
+		return 1;
+	}
+
+	if(nglob_matches_one != nglob_matches_multi)
+	{
+		fprintf(stderr, "the globs matched %" PRIu64 " times one by one, %" PRIu64 " times together\n",
+			nglob_matches_one, nglob_matches_multi);
+		return 1;
+	}
+
+	printf("%u paths, %zu patterns, %" PRIu64 " matches\n", npaths, npatterns, nmatches_one);
+	printf("one by one %8.1f ns/path\n", best[0]);
+	printf("matcher    %8.1f ns/path\n", best[1]);
+	printf("%zu globs, %" PRIu64 " matches\n", nglobs, nglob_matches_one);
+	printf("fnmatch    %8.1f ns/path\n", best[2]);
+	printf("glob       %8.1f ns/path\n", best[3]);
+	return 0;
+}
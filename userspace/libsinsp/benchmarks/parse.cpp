@@ -0,0 +1,230 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Measures the time sinsp spends parsing the events of a capture. The
+// capture is read once with scap alone and twice with sinsp, the difference
+// is the parsing: once returning all the events, once only the opens and
+// closes (see sinsp::set_events_of_interest()). Without a capture, one is
+// written where a few processes open files, read and write them between
+// futex calls, and close them.
+//
+// usage: sinsp-bench-parse [capture.scap] [passes=5]
+//
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <set>
+#include <string>
+#include <unistd.h>
+
+#include <sinsp.h>
+#include "bench_capture.h"
+
+#define FIRST_TID 5000000
+#define NPROCS 100
+#define NITERATIONS 30000
+#define RW_PER_OPEN 8
+
+static uint64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void write_capture(const std::string& fname)
+{
+	scap_t* h;
+	scap_dumper_t* d;
+	uint64_t ts = 1000000000;
+	uint8_t payload[64] = {};
+	scap_const_sized_buffer data = {payload, sizeof(payload)};
+
+	open_bench_capture(fname, &h, &d);
+
+	for(int64_t tid = FIRST_TID; tid < FIRST_TID + NPROCS; tid++)
+	{
+		dump_clone_evt(h, d, &ts, tid, 1, "/usr/bin/app", "app");
+	}
+
+	for(uint32_t j = 0; j < NITERATIONS; j++)
+	{
+		int64_t tid = FIRST_TID + j % NPROCS;
+		int64_t fd = 3 + (j / NPROCS) % 16;
+		std::string name = "/var/lib/app/data" + std::to_string(fd);
+
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_OPEN_E, 3, name.c_str(), (uint32_t)0, (uint32_t)0);
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_OPEN_X, 5, fd, name.c_str(), (uint32_t)0, (uint32_t)0, (uint32_t)0);
+		for(uint32_t k = 0; k < RW_PER_OPEN; k++)
+		{
+			dump_evt(h, d, &ts, tid, PPME_SYSCALL_READ_E, 2, fd, (uint32_t)sizeof(payload));
+			dump_evt(h, d, &ts, tid, PPME_SYSCALL_READ_X, 2, (int64_t)sizeof(payload), data);
+			dump_evt(h, d, &ts, tid, PPME_SYSCALL_WRITE_E, 2, fd, (uint32_t)sizeof(payload));
+			dump_evt(h, d, &ts, tid, PPME_SYSCALL_WRITE_X, 2, (int64_t)sizeof(payload), data);
+			dump_evt(h, d, &ts, tid, PPME_SYSCALL_FUTEX_E, 3, (uint64_t)0, (uint16_t)0, (uint64_t)0);
+			dump_evt(h, d, &ts, tid, PPME_SYSCALL_FUTEX_X, 1, (int64_t)0);
+		}
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_CLOSE_E, 1, fd);
+		dump_evt(h, d, &ts, tid, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	}
+
+	close_bench_capture(h, d);
+}
+
+// Returns the time per event of reading the capture with scap
+static double read_scap(const std::string& fname, uint64_t* nevts)
+{
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc;
+	scap_open_args oargs = {};
+	scap_evt* evt;
+	uint16_t cpuid;
+
+	oargs.mode = SCAP_MODE_CAPTURE;
+	oargs.fname = fname.c_str();
+	scap_t* h = scap_open(oargs, error, &rc);
+	if(h == NULL)
+	{
+		fprintf(stderr, "cannot open %s: %s\n", fname.c_str(), error);
+		exit(1);
+	}
+
+	*nevts = 0;
+	uint64_t start = now_ns();
+	while(true)
+	{
+		int32_t res = scap_next(h, &evt, &cpuid);
+		if(res == SCAP_EOF)
+		{
+			break;
+		}
+		else if(res == SCAP_SUCCESS)
+		{
+			(*nevts)++;
+		}
+		else if(res != SCAP_TIMEOUT)
+		{
+			fprintf(stderr, "read failed: %s\n", scap_getlasterr(h));
+			exit(1);
+		}
+	}
+	uint64_t elapsed_ns = now_ns() - start;
+
+	scap_close(h);
+	return (double)elapsed_ns / *nevts;
+}
+
+// Returns the time per event of reading and parsing the capture with sinsp,
+// returning the events of the given types, or all of them
+static double read_sinsp(const std::string& fname, const std::set<uint16_t>& evttypes)
+{
+	sinsp inspector;
+	sinsp_evt* evt;
+
+	inspector.set_events_of_interest(evttypes);
+	inspector.open(fname);
+
+	uint64_t start = now_ns();
+	while(true)
+	{
+		int32_t res = inspector.next(&evt);
+		if(res == SCAP_EOF)
+		{
+			break;
+		}
+		else if(res != SCAP_SUCCESS && res != SCAP_TIMEOUT)
+		{
+			fprintf(stderr, "read failed: %s\n", inspector.getlasterr().c_str());
+			exit(1);
+		}
+	}
+	uint64_t elapsed_ns = now_ns() - start;
+	uint64_t nevts = inspector.get_num_events();
+
+	inspector.close();
+	return (double)elapsed_ns / nevts;
+}
+
+int main(int argc, char** argv)
+{
+	std::string fname;
+	uint32_t passes = 5;
+	uint64_t nevts;
+	double best_scap = 0;
+	double best_sinsp = 0;
+	double best_interest = 0;
+	std::set<uint16_t> all;
+	std::set<uint16_t> open_close = {PPME_SYSCALL_OPEN_X, PPME_SYSCALL_CLOSE_X};
+
+	if(argc > 1)
+	{
+		fname = argv[1];
+	}
+	if(argc > 2)
+	{
+		passes = atoi(argv[2]);
+	}
+	if(passes == 0)
+	{
+		fprintf(stderr, "usage: %s [capture.scap] [passes]\n", argv[0]);
+		return 1;
+	}
+
+	bool written = fname.empty();
+	if(written)
+	{
+		fname = "/tmp/sinsp-bench-parse.scap";
+		write_capture(fname);
+	}
+
+	//
+	// Keep the best of the passes, the others are disturbed by
+	// something else
+	//
+	for(uint32_t j = 0; j < passes; j++)
+	{
+		double scap_ns = read_scap(fname, &nevts);
+		double sinsp_ns = read_sinsp(fname, all);
+		double interest_ns = read_sinsp(fname, open_close);
+
+		if(j == 0 || scap_ns < best_scap)
+		{
+			best_scap = scap_ns;
+		}
+		if(j == 0 || sinsp_ns < best_sinsp)
+		{
+			best_sinsp = sinsp_ns;
+		}
+		if(j == 0 || interest_ns < best_interest)
+		{
+			best_interest = interest_ns;
+		}
+	}
+
+	printf("%" PRIu64 " events, scap %.1f ns/event, sinsp %.1f ns/event, parsing %.1f ns/event\n",
+	       nevts, best_scap, best_sinsp, best_sinsp - best_scap);
+	printf("only opens and closes: sinsp %.1f ns/event, parsing %.1f ns/event\n",
+	       best_interest, best_interest - best_scap);
+
+	if(written)
+	{
+		unlink(fname.c_str());
+	}
+	return 0;
+}
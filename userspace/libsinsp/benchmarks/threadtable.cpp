@@ -0,0 +1,275 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Measures the thread table. Compares lookups and churn on the flat table
+// with an unordered_map of shared pointers, the layout it replaced, and
+// replays a capture where short lived processes are continuously cloned
+// and exit next to a large number of long lived ones.
+//
+// usage: sinsp-bench-threadtable [live_threads=20000] [churn_procs=200000]
+//
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <malloc.h>
+#include <unistd.h>
+
+#include <sinsp.h>
+#include "bench_capture.h"
+
+#define FIRST_LIVE_TID 1000
+#define FIRST_CHURN_TID 1000000
+// Events of the live threads between two clones
+#define EVTS_PER_CLONE 8
+
+static uint64_t g_rand_state = 88172645463325252ULL;
+
+static uint64_t next_rand()
+{
+	g_rand_state ^= g_rand_state << 13;
+	g_rand_state ^= g_rand_state >> 7;
+	g_rand_state ^= g_rand_state << 17;
+	return g_rand_state;
+}
+
+static uint64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static sinsp_threadinfo* new_thread(int64_t tid)
+{
+	sinsp_threadinfo* tinfo = new sinsp_threadinfo();
+	tinfo->m_tid = tid;
+	tinfo->m_pid = tid;
+	return tinfo;
+}
+
+// The thread table before it was flattened
+class unordered_threadinfo_map
+{
+public:
+	void put(sinsp_threadinfo* tinfo)
+	{
+		m_threads[tinfo->m_tid] = threadinfo_map_t::ptr_t(tinfo);
+	}
+
+	sinsp_threadinfo* get(int64_t tid)
+	{
+		auto it = m_threads.find(tid);
+		if(it == m_threads.end())
+		{
+			return nullptr;
+		}
+		return it->second.get();
+	}
+
+	void erase(int64_t tid)
+	{
+		m_threads.erase(tid);
+	}
+
+private:
+	std::unordered_map<int64_t, threadinfo_map_t::ptr_t> m_threads;
+};
+
+template<typename map_t>
+static void bench_map(const char* name, uint32_t nlive, uint32_t nchurn)
+{
+	map_t map;
+	std::vector<int64_t> tids;
+	uint64_t sum = 0;
+
+	for(uint32_t j = 0; j < nlive; j++)
+	{
+		map.put(new_thread(FIRST_LIVE_TID + j));
+	}
+
+	//
+	// Look up the live threads in random order, with some misses
+	//
+	g_rand_state = 88172645463325252ULL;
+	for(uint32_t j = 0; j < 4 * 1024 * 1024; j++)
+	{
+		tids.push_back(FIRST_LIVE_TID + (int64_t)(next_rand() % (nlive + nlive / 8)));
+	}
+
+	uint64_t start = now_ns();
+	for(int64_t tid : tids)
+	{
+		sinsp_threadinfo* tinfo = map.get(tid);
+		if(tinfo != nullptr)
+		{
+			sum += tinfo->m_pid;
+		}
+	}
+	uint64_t lookup_ns = now_ns() - start;
+
+	//
+	// Add and remove the short lived threads, a few at a time
+	//
+	start = now_ns();
+	for(uint32_t j = 0; j < nchurn; j++)
+	{
+		map.put(new_thread(FIRST_CHURN_TID + j));
+		if(j >= 4)
+		{
+			map.erase(FIRST_CHURN_TID + j - 4);
+		}
+	}
+	uint64_t churn_ns = now_ns() - start;
+
+	printf("%-14s lookup %6.1f ns, put+erase %7.1f ns (%" PRIu64 ")\n",
+	       name,
+	       (double)lookup_ns / tids.size(),
+	       (double)churn_ns / nchurn,
+	       sum);
+}
+
+// The arguments and cgroups of a worker in a pod, all the same
+static const char CLONE_ARGS[] = "--workers\0" "16\0" "--config\0" "/etc/app/config.yaml\0";
+static const char CLONE_CGROUPS[] =
+	"cpuset=/kubepods/burstable/pod7c6c1c2f-2b5e-4f43-9d9f-5a0f34b8b1c4/0123456789abcdef\0"
+	"cpu=/kubepods/burstable/pod7c6c1c2f-2b5e-4f43-9d9f-5a0f34b8b1c4/0123456789abcdef\0"
+	"memory=/kubepods/burstable/pod7c6c1c2f-2b5e-4f43-9d9f-5a0f34b8b1c4/0123456789abcdef\0"
+	"pids=/kubepods/burstable/pod7c6c1c2f-2b5e-4f43-9d9f-5a0f34b8b1c4/0123456789abcdef\0";
+
+static void dump_clone(scap_t* h, scap_dumper_t* d, uint64_t* ts, int64_t tid, int64_t ptid)
+{
+	scap_const_sized_buffer args = {CLONE_ARGS, sizeof(CLONE_ARGS) - 1};
+	scap_const_sized_buffer cgroups = {CLONE_CGROUPS, sizeof(CLONE_CGROUPS) - 1};
+
+	dump_clone_evt(h, d, ts, tid, ptid, "/usr/bin/app", "app", args, cgroups);
+}
+
+static void dump_read(scap_t* h, scap_dumper_t* d, uint64_t* ts, int64_t tid)
+{
+	uint8_t payload[16] = {};
+
+	dump_evt(h, d, ts, tid, PPME_SYSCALL_READ_X, 2,
+		 (int64_t)sizeof(payload), scap_const_sized_buffer{payload, sizeof(payload)});
+}
+
+static uint64_t write_churn_capture(const std::string& fname, uint32_t nlive, uint32_t nchurn)
+{
+	scap_t* h;
+	scap_dumper_t* d;
+	uint64_t ts = 1000000000;
+	uint64_t nevts = 0;
+
+	open_bench_capture(fname, &h, &d);
+
+	dump_clone(h, d, &ts, 1, 0);
+	nevts++;
+	for(uint32_t j = 0; j < nlive; j++)
+	{
+		dump_clone(h, d, &ts, FIRST_LIVE_TID + j, 1);
+		nevts++;
+	}
+
+	for(uint32_t j = 0; j < nchurn; j++)
+	{
+		int64_t tid = FIRST_CHURN_TID + j;
+
+		dump_clone(h, d, &ts, tid, FIRST_LIVE_TID + (int64_t)(next_rand() % nlive));
+		dump_read(h, d, &ts, tid);
+		for(uint32_t k = 0; k < EVTS_PER_CLONE; k++)
+		{
+			dump_read(h, d, &ts, FIRST_LIVE_TID + (int64_t)(next_rand() % nlive));
+		}
+		dump_evt(h, d, &ts, tid, PPME_PROCEXIT_1_E, 4, (int64_t)0, (int64_t)0, 0, 0);
+		nevts += EVTS_PER_CLONE + 3;
+	}
+
+	close_bench_capture(h, d);
+	return nevts;
+}
+
+static void bench_replay(uint32_t nlive, uint32_t nchurn)
+{
+	std::string fname = "/tmp/sinsp-bench-threadtable.scap";
+	uint64_t nevts = write_churn_capture(fname, nlive, nchurn);
+	sinsp inspector;
+	sinsp_evt* evt;
+	uint64_t nread = 0;
+
+	size_t heap = mallinfo2().uordblks;
+	inspector.open(fname);
+
+	uint64_t start = now_ns();
+	while(true)
+	{
+		int32_t res = inspector.next(&evt);
+		if(res == SCAP_EOF)
+		{
+			break;
+		}
+		else if(res == SCAP_TIMEOUT)
+		{
+			continue;
+		}
+		else if(res != SCAP_SUCCESS)
+		{
+			fprintf(stderr, "replay failed: %s\n", inspector.getlasterr().c_str());
+			exit(1);
+		}
+		nread++;
+	}
+	uint64_t elapsed_ns = now_ns() - start;
+	heap = mallinfo2().uordblks - heap;
+
+	printf("replay         %" PRIu64 "/%" PRIu64 " events, %u threads left, %.1f ns/event, heap %.1f MB\n",
+	       nread, nevts, inspector.m_thread_manager->get_thread_count(),
+	       (double)elapsed_ns / nread, (double)heap / (1024 * 1024));
+
+	inspector.close();
+	unlink(fname.c_str());
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t nlive = 20000;
+	uint32_t nchurn = 200000;
+
+	if(argc > 1)
+	{
+		nlive = atoi(argv[1]);
+	}
+	if(argc > 2)
+	{
+		nchurn = atoi(argv[2]);
+	}
+	if(nlive == 0)
+	{
+		fprintf(stderr, "usage: %s [live_threads] [churn_procs]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%u live threads, %u short lived processes\n", nlive, nchurn);
+	bench_map<unordered_threadinfo_map>("unordered_map", nlive, nchurn);
+	bench_map<threadinfo_map_t>("flat", nlive, nchurn);
+	bench_replay(nlive, nchurn);
+	return 0;
+}
@@ -0,0 +1,776 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <errno.h>
+#include <string.h>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "filterchecks.h"
+#include "column_exporter.h"
+
+// Past this number of strings, the dictionary of a column starts over
+#define MAX_COL_DICTIONARY_SIZE 65536
+
+#define DEFAULT_COL_BATCH_SIZE 4096
+
+template<typename T>
+static inline void put(std::vector<uint8_t>& buf, T val)
+{
+	const uint8_t* p = (const uint8_t*)&val;
+	buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+static inline void put_bytes(std::vector<uint8_t>& buf, const void* data, size_t len)
+{
+	buf.insert(buf.end(), (const uint8_t*)data, (const uint8_t*)data + len);
+}
+
+static inline void pad(std::vector<uint8_t>& buf)
+{
+	buf.resize((buf.size() + 7) & ~(size_t)7, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_column_exporter implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_column_exporter::sinsp_column_exporter(sinsp* inspector,
+					     const std::vector<std::string>& fields,
+					     filter_check_list &available_checks):
+	m_inspector(inspector),
+	m_batch_size(DEFAULT_COL_BATCH_SIZE),
+	m_max_bytes(0),
+	m_max_duration_ns(0),
+	m_file(NULL),
+	m_is_stream(false),
+	m_file_index(0),
+	m_file_start_ts(0),
+	m_nevts(0),
+	m_nbytes(0)
+{
+	if(fields.empty())
+	{
+		throw sinsp_exception("no fields to export");
+	}
+
+	for(auto& field : fields)
+	{
+		sinsp_filter_check* chk = available_checks.new_filter_check_from_fldname(field, m_inspector, false);
+		if(chk == NULL)
+		{
+			throw sinsp_exception("invalid field " + field);
+		}
+		m_checks.push_back(chk);
+
+		if(chk->parse_field_name(field.c_str(), true, false) != (int32_t)field.size())
+		{
+			throw sinsp_exception("invalid field " + field);
+		}
+
+		m_rows.add_column(field, chk->get_field_kind());
+	}
+
+	m_dictionaries.resize(fields.size());
+	m_indexes.resize(fields.size());
+}
+
+sinsp_column_exporter::~sinsp_column_exporter()
+{
+	if(m_file != NULL)
+	{
+		try
+		{
+			close_file();
+		}
+		catch(const sinsp_exception&)
+		{
+		}
+	}
+
+	for(auto chk : m_checks)
+	{
+		delete chk;
+	}
+}
+
+void sinsp_column_exporter::set_batch_size(uint32_t nrows)
+{
+	if(nrows == 0)
+	{
+		throw sinsp_exception("the batches must have at least one row");
+	}
+	m_batch_size = nrows;
+}
+
+void sinsp_column_exporter::set_rollover(uint64_t max_bytes, uint64_t max_duration_ns)
+{
+	m_max_bytes = max_bytes;
+	m_max_duration_ns = max_duration_ns;
+}
+
+void sinsp_column_exporter::open(const std::string& filename)
+{
+	close();
+
+	m_base_file_name = filename;
+	m_file_index = 0;
+	m_is_stream = false;
+	open_next_file();
+}
+
+void sinsp_column_exporter::fdopen(int fd)
+{
+	close();
+
+	FILE* file = ::fdopen(fd, "wb");
+	if(file == NULL)
+	{
+		throw sinsp_exception("can't open file descriptor " + std::to_string(fd) + ": " + strerror(errno));
+	}
+
+	m_is_stream = true;
+	start_file(file, "fd " + std::to_string(fd));
+}
+
+void sinsp_column_exporter::open_next_file()
+{
+	std::string filename = m_base_file_name;
+	if(m_max_bytes != 0 || m_max_duration_ns != 0)
+	{
+		filename += std::to_string(m_file_index);
+	}
+	m_file_index++;
+
+	FILE* file = fopen(filename.c_str(), "wb");
+	if(file == NULL)
+	{
+		throw sinsp_exception("can't open " + filename + ": " + strerror(errno));
+	}
+
+	start_file(file, filename);
+}
+
+void sinsp_column_exporter::start_file(FILE* file, const std::string& filename)
+{
+	m_file = file;
+	m_file_name = filename;
+	m_nevts = 0;
+	m_nbytes = 0;
+	m_batch_offsets.clear();
+	m_rows.clear();
+
+	// each file has its own dictionaries
+	for(auto& dict : m_dictionaries)
+	{
+		dict.m_indexes.clear();
+		dict.m_offsets.assign(1, 0);
+		dict.m_data.clear();
+	}
+
+	write_schema();
+}
+
+void sinsp_column_exporter::close()
+{
+	if(m_file != NULL)
+	{
+		close_file();
+	}
+}
+
+void sinsp_column_exporter::close_file()
+{
+	write_batch();
+
+	m_message.clear();
+	if(!m_is_stream)
+	{
+		put<uint64_t>(m_message, m_batch_offsets.size());
+		for(auto offset : m_batch_offsets)
+		{
+			put<uint64_t>(m_message, offset);
+		}
+	}
+	write_message(SINSP_COL_END);
+
+	if(!m_is_stream)
+	{
+		uint32_t len = m_message.size();
+		write(&len, sizeof(len));
+		write(SINSP_COL_MAGIC, sizeof(SINSP_COL_MAGIC) - 1);
+	}
+
+	int res = fclose(m_file);
+	m_file = NULL;
+	if(res != 0)
+	{
+		throw sinsp_exception("error closing " + m_file_name + ": " + strerror(errno));
+	}
+}
+
+void sinsp_column_exporter::dump(sinsp_evt* evt)
+{
+	sinsp_field_value value;
+
+	if(m_file == NULL)
+	{
+		throw sinsp_exception("exporter not opened yet");
+	}
+
+	uint64_t ts = evt->get_ts();
+	if(!m_is_stream && m_nevts != 0 &&
+	   ((m_max_bytes != 0 && m_nbytes >= m_max_bytes) ||
+	    (m_max_duration_ns != 0 && ts >= m_file_start_ts + m_max_duration_ns)))
+	{
+		close_file();
+		open_next_file();
+	}
+
+	if(m_nevts == 0)
+	{
+		m_file_start_ts = ts;
+	}
+
+	for(uint32_t j = 0; j < m_checks.size(); j++)
+	{
+		sinsp_field_column& column = m_rows.get_column(j);
+		if(m_checks[j]->extract_typed(evt, value))
+		{
+			column.append(value);
+		}
+		else
+		{
+			column.append_null();
+		}
+	}
+	m_nevts++;
+
+	if(m_rows.num_rows() >= m_batch_size)
+	{
+		write_batch();
+	}
+}
+
+void sinsp_column_exporter::flush()
+{
+	if(m_file == NULL)
+	{
+		throw sinsp_exception("exporter not opened yet");
+	}
+
+	write_batch();
+	fflush(m_file);
+}
+
+void sinsp_column_exporter::write_schema()
+{
+	m_message.clear();
+	put_bytes(m_message, SINSP_COL_MAGIC, sizeof(SINSP_COL_MAGIC) - 1);
+	put<uint32_t>(m_message, SINSP_COL_BYTE_ORDER_MAGIC);
+	put<uint32_t>(m_message, SINSP_COL_VERSION);
+	put<uint32_t>(m_message, m_rows.num_columns());
+	for(uint32_t j = 0; j < m_rows.num_columns(); j++)
+	{
+		const sinsp_field_column& column = m_rows.get_column(j);
+		put<uint8_t>(m_message, column.get_kind());
+		put<uint16_t>(m_message, column.get_name().size());
+		put_bytes(m_message, column.get_name().c_str(), column.get_name().size());
+	}
+	pad(m_message);
+	write(m_message.data(), m_message.size());
+}
+
+void sinsp_column_exporter::write_batch()
+{
+	size_t nrows = m_rows.num_rows();
+	if(nrows == 0)
+	{
+		return;
+	}
+
+	//
+	// The strings are replaced by their index first, so that the new ones
+	// are written in the dictionaries before the batch
+	//
+	for(uint32_t j = 0; j < m_rows.num_columns(); j++)
+	{
+		const sinsp_field_column& column = m_rows.get_column(j);
+		if(column.get_kind() != FK_STRING)
+		{
+			continue;
+		}
+
+		dictionary& dict = m_dictionaries[j];
+		bool reset = dict.m_indexes.size() >= MAX_COL_DICTIONARY_SIZE;
+		if(reset)
+		{
+			dict.m_indexes.clear();
+		}
+
+		std::vector<uint32_t>& indexes = m_indexes[j];
+		indexes.clear();
+		for(size_t row = 0; row < nrows; row++)
+		{
+			if(column.is_null(row))
+			{
+				indexes.push_back(0);
+				continue;
+			}
+
+			uint32_t len;
+			const char* data = column.get_data(row, &len);
+			m_key.assign(data, len);
+			auto it = dict.m_indexes.find(m_key);
+			if(it != dict.m_indexes.end())
+			{
+				indexes.push_back(it->second);
+				continue;
+			}
+
+			uint32_t index = dict.m_indexes.size();
+			dict.m_indexes.emplace(m_key, index);
+			dict.m_data.insert(dict.m_data.end(), data, data + len);
+			dict.m_offsets.push_back(dict.m_data.size());
+			indexes.push_back(index);
+		}
+
+		if(reset || dict.m_offsets.size() > 1)
+		{
+			write_dictionary(j, reset);
+		}
+	}
+
+	m_message.clear();
+	put<uint32_t>(m_message, nrows);
+	pad(m_message);
+	for(uint32_t j = 0; j < m_rows.num_columns(); j++)
+	{
+		const sinsp_field_column& column = m_rows.get_column(j);
+		size_t bitmap = m_message.size();
+
+		m_message.resize(bitmap + (nrows + 7) / 8, 0);
+		for(size_t row = 0; row < nrows; row++)
+		{
+			if(!column.is_null(row))
+			{
+				m_message[bitmap + row / 8] |= 1 << (row % 8);
+			}
+		}
+		pad(m_message);
+
+		switch(column.get_kind())
+		{
+		case FK_INT64:
+		case FK_UINT64:
+		case FK_DOUBLE:
+			// the doubles are stored with their bits
+			for(size_t row = 0; row < nrows; row++)
+			{
+				put<uint64_t>(m_message, column.get_uint64(row));
+			}
+			break;
+		case FK_BOOL:
+			bitmap = m_message.size();
+			m_message.resize(bitmap + (nrows + 7) / 8, 0);
+			for(size_t row = 0; row < nrows; row++)
+			{
+				if(column.get_bool(row))
+				{
+					m_message[bitmap + row / 8] |= 1 << (row % 8);
+				}
+			}
+			break;
+		case FK_STRING:
+			for(auto index : m_indexes[j])
+			{
+				put<uint32_t>(m_message, index);
+			}
+			break;
+		default:
+		{
+			uint32_t offset = 0;
+			uint32_t len;
+
+			put<uint32_t>(m_message, 0);
+			for(size_t row = 0; row < nrows; row++)
+			{
+				column.get_data(row, &len);
+				offset += len;
+				put<uint32_t>(m_message, offset);
+			}
+			for(size_t row = 0; row < nrows; row++)
+			{
+				const char* data = column.get_data(row, &len);
+				put_bytes(m_message, data, len);
+			}
+			break;
+		}
+		}
+		pad(m_message);
+	}
+
+	m_batch_offsets.push_back(m_nbytes);
+	write_message(SINSP_COL_RECORD);
+	m_rows.clear();
+}
+
+void sinsp_column_exporter::write_dictionary(uint32_t col, bool reset)
+{
+	dictionary& dict = m_dictionaries[col];
+
+	m_message.clear();
+	put<uint32_t>(m_message, col);
+	put<uint32_t>(m_message, reset);
+	put<uint32_t>(m_message, dict.m_offsets.size() - 1);
+	for(auto offset : dict.m_offsets)
+	{
+		put<uint32_t>(m_message, offset);
+	}
+	put_bytes(m_message, dict.m_data.data(), dict.m_data.size());
+	pad(m_message);
+	write_message(SINSP_COL_DICTIONARY);
+
+	dict.m_offsets.assign(1, 0);
+	dict.m_data.clear();
+}
+
+void sinsp_column_exporter::write_message(sinsp_col_message_type type)
+{
+	uint32_t header[2] = {type, (uint32_t)m_message.size()};
+
+	write(header, sizeof(header));
+	write(m_message.data(), m_message.size());
+}
+
+void sinsp_column_exporter::write(const void* data, size_t len)
+{
+	if(len != 0 && fwrite(data, 1, len, m_file) != len)
+	{
+		throw sinsp_exception("error writing " + m_file_name + ": " + strerror(errno));
+	}
+	m_nbytes += len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_column_reader implementation
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// Reads the values of a message, checking that they're in it
+//
+class col_message_reader
+{
+public:
+	col_message_reader(const std::vector<uint8_t>& message, const std::string& filename):
+		m_message(message),
+		m_filename(filename),
+		m_pos(0)
+	{
+	}
+
+	const uint8_t* get(size_t len)
+	{
+		if(len > m_message.size() - m_pos)
+		{
+			throw sinsp_exception("invalid message in " + m_filename);
+		}
+		const uint8_t* res = m_message.data() + m_pos;
+		m_pos += len;
+		return res;
+	}
+
+	size_t remaining() const
+	{
+		return m_message.size() - m_pos;
+	}
+
+	template<typename T>
+	T get()
+	{
+		T res;
+		memcpy(&res, get(sizeof(T)), sizeof(T));
+		return res;
+	}
+
+	void align()
+	{
+		get(((m_pos + 7) & ~(size_t)7) - m_pos);
+	}
+
+	static bool bit(const uint8_t* bits, size_t j)
+	{
+		return (bits[j / 8] >> (j % 8)) & 1;
+	}
+
+private:
+	const std::vector<uint8_t>& m_message;
+	const std::string& m_filename;
+	size_t m_pos;
+};
+
+sinsp_column_reader::sinsp_column_reader():
+	m_file(NULL)
+{
+}
+
+sinsp_column_reader::~sinsp_column_reader()
+{
+	close();
+}
+
+void sinsp_column_reader::open(const std::string& filename)
+{
+	char magic[sizeof(SINSP_COL_MAGIC) - 1];
+	uint32_t header[3];
+
+	close();
+
+	m_file = fopen(filename.c_str(), "rb");
+	if(m_file == NULL)
+	{
+		throw sinsp_exception("can't open " + filename + ": " + strerror(errno));
+	}
+	m_file_name = filename;
+
+	read(magic, sizeof(magic));
+	read(header, sizeof(header));
+	if(memcmp(magic, SINSP_COL_MAGIC, sizeof(magic)) != 0 ||
+	   header[0] != SINSP_COL_BYTE_ORDER_MAGIC)
+	{
+		throw sinsp_exception(filename + " is not a column file written on this kind of host");
+	}
+	if(header[1] != SINSP_COL_VERSION)
+	{
+		throw sinsp_exception(filename + " has unsupported version " + std::to_string(header[1]));
+	}
+
+	size_t size = sizeof(magic) + sizeof(header);
+	m_columns.clear();
+	for(uint32_t j = 0; j < header[2]; j++)
+	{
+		uint8_t kind;
+		uint16_t len;
+
+		read(&kind, sizeof(kind));
+		read(&len, sizeof(len));
+		if(kind > FK_BYTES)
+		{
+			throw sinsp_exception("invalid column kind in " + filename);
+		}
+
+		std::string name(len, '\0');
+		read(&name[0], len);
+		m_columns.emplace_back(name, (sinsp_field_kind)kind);
+		size += sizeof(kind) + sizeof(len) + len;
+	}
+
+	uint8_t padding[8];
+	read(padding, ((size + 7) & ~(size_t)7) - size);
+
+	m_dictionaries.assign(m_columns.size(), std::vector<std::string>());
+}
+
+void sinsp_column_reader::close()
+{
+	if(m_file != NULL)
+	{
+		fclose(m_file);
+		m_file = NULL;
+	}
+}
+
+bool sinsp_column_reader::next(sinsp_field_buffer& rows)
+{
+	if(m_file == NULL)
+	{
+		throw sinsp_exception("reader not opened yet");
+	}
+
+	if(rows.num_columns() == 0)
+	{
+		for(auto& col : m_columns)
+		{
+			rows.add_column(col.first, col.second);
+		}
+	}
+	else if(rows.num_columns() != m_columns.size())
+	{
+		throw sinsp_exception("the buffer doesn't have the columns of " + m_file_name);
+	}
+	rows.clear();
+
+	while(true)
+	{
+		uint32_t header[2];
+		read(header, sizeof(header));
+		m_message.resize(header[1]);
+		read(m_message.data(), m_message.size());
+
+		col_message_reader msg(m_message, m_file_name);
+		switch(header[0])
+		{
+		case SINSP_COL_END:
+			return false;
+		case SINSP_COL_DICTIONARY:
+		{
+			uint32_t col = msg.get<uint32_t>();
+			uint32_t reset = msg.get<uint32_t>();
+			uint32_t count = msg.get<uint32_t>();
+			if(col >= m_columns.size() || m_columns[col].second != FK_STRING)
+			{
+				throw sinsp_exception("invalid dictionary in " + m_file_name);
+			}
+
+			if(count >= msg.remaining() / sizeof(uint32_t))
+			{
+				throw sinsp_exception("invalid dictionary in " + m_file_name);
+			}
+
+			std::vector<std::string>& dict = m_dictionaries[col];
+			if(reset)
+			{
+				dict.clear();
+			}
+
+			const uint8_t* offsets = msg.get(((size_t)count + 1) * sizeof(uint32_t));
+			uint32_t start;
+			uint32_t end;
+			memcpy(&start, offsets, sizeof(start));
+			for(uint32_t j = 0; j < count; j++)
+			{
+				memcpy(&end, offsets + (j + 1) * sizeof(uint32_t), sizeof(end));
+				if(end < start)
+				{
+					throw sinsp_exception("invalid dictionary in " + m_file_name);
+				}
+				dict.emplace_back((const char*)msg.get(end - start), end - start);
+				start = end;
+			}
+			break;
+		}
+		case SINSP_COL_RECORD:
+		{
+			sinsp_field_value value = {};
+			uint32_t nrows = msg.get<uint32_t>();
+			msg.align();
+
+			for(uint32_t j = 0; j < rows.num_columns(); j++)
+			{
+				sinsp_field_column& column = rows.get_column(j);
+				const uint8_t* validity = msg.get(((size_t)nrows + 7) / 8);
+				msg.align();
+
+				value.m_kind = column.get_kind();
+				switch(value.m_kind)
+				{
+				case FK_INT64:
+				case FK_UINT64:
+				case FK_DOUBLE:
+					for(uint32_t row = 0; row < nrows; row++)
+					{
+						value.m_uint64 = msg.get<uint64_t>();
+						if(col_message_reader::bit(validity, row))
+						{
+							column.append(value);
+						}
+						else
+						{
+							column.append_null();
+						}
+					}
+					break;
+				case FK_BOOL:
+				{
+					const uint8_t* bools = msg.get(((size_t)nrows + 7) / 8);
+					for(uint32_t row = 0; row < nrows; row++)
+					{
+						value.m_uint64 = 0;
+						value.m_bool = col_message_reader::bit(bools, row);
+						if(col_message_reader::bit(validity, row))
+						{
+							column.append(value);
+						}
+						else
+						{
+							column.append_null();
+						}
+					}
+					break;
+				}
+				case FK_STRING:
+					for(uint32_t row = 0; row < nrows; row++)
+					{
+						uint32_t index = msg.get<uint32_t>();
+						if(!col_message_reader::bit(validity, row))
+						{
+							column.append_null();
+							continue;
+						}
+						if(index >= m_dictionaries[j].size())
+						{
+							throw sinsp_exception("invalid string index in " + m_file_name);
+						}
+						value.m_data = m_dictionaries[j][index].c_str();
+						value.m_len = m_dictionaries[j][index].size();
+						column.append(value);
+					}
+					break;
+				default:
+				{
+					const uint8_t* offsets = msg.get(((size_t)nrows + 1) * sizeof(uint32_t));
+					uint32_t start;
+					uint32_t end;
+					memcpy(&start, offsets, sizeof(start));
+					for(uint32_t row = 0; row < nrows; row++)
+					{
+						memcpy(&end, offsets + (row + 1) * sizeof(uint32_t), sizeof(end));
+						if(end < start)
+						{
+							throw sinsp_exception("invalid offsets in " + m_file_name);
+						}
+						value.m_data = (const char*)msg.get(end - start);
+						value.m_len = end - start;
+						start = end;
+						if(col_message_reader::bit(validity, row))
+						{
+							column.append(value);
+						}
+						else
+						{
+							column.append_null();
+						}
+					}
+					break;
+				}
+				}
+				msg.align();
+			}
+			return true;
+		}
+		default:
+			throw sinsp_exception("invalid message type " + std::to_string(header[0]) + " in " + m_file_name);
+		}
+	}
+}
+
+void sinsp_column_reader::read(void* data, size_t len)
+{
+	if(len != 0 && fread(data, 1, len, m_file) != len)
+	{
+		throw sinsp_exception("unexpected end of " + m_file_name);
+	}
+}
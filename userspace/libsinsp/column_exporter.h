@@ -0,0 +1,262 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "filter_check_list.h"
+#include "field_buffer.h"
+
+class sinsp;
+class sinsp_evt;
+class sinsp_filter_check;
+
+/** @defgroup dump Dumping events to disk
+ *  @{
+ */
+
+//
+// The columnar format, in the byte order of the host as the .scap
+// files, the magic telling which one it is. Like the Arrow IPC format,
+// it's a schema followed by messages: record batches, with a validity
+// bitmap and the values of each column, and dictionary batches, with
+// the strings the string columns refer to by index. The dictionaries
+// only grow within a file, each batch of strings is a delta, unless it
+// resets the dictionary first. A file ends with the offsets of its
+// record batches, a stream just stops.
+//
+// schema:     "SINSPCOL" magic:u32 version:u32 ncolumns:u32
+//             (kind:u8 namelen:u16 name)*, padded to 8 bytes
+// message:    type:u32 len:u32 body, its len padded to 8 bytes
+// dictionary: column:u32 reset:u32 count:u32 offsets:u32[count + 1] data
+// record:     nrows:u32, padded to 8 bytes, then each column, padded
+//             to 8 bytes:
+//             validity:bit[nrows], 1 if not null
+//             FK_INT64, FK_UINT64, FK_DOUBLE: value:u64[nrows]
+//             FK_BOOL: value:bit[nrows]
+//             FK_STRING: index:u32[nrows] in the dictionary of the column
+//             FK_IP, FK_BYTES: offsets:u32[nrows + 1] data
+// end:        an empty message for a stream. For a file, its body is
+//             nbatches:u64 offset:u64[nbatches] and it's followed by
+//             the len of that body:u32 and "SINSPCOL"
+//
+// The bits are numbered from the least significant one of each byte.
+//
+#define SINSP_COL_MAGIC "SINSPCOL"
+#define SINSP_COL_BYTE_ORDER_MAGIC 0x1a2b3c4d
+#define SINSP_COL_VERSION 1
+
+enum sinsp_col_message_type
+{
+	SINSP_COL_END = 0,
+	SINSP_COL_DICTIONARY = 1,
+	SINSP_COL_RECORD = 2,
+};
+
+/*!
+  \brief Writes fields of the events in a columnar binary format, so that
+  they can be loaded as typed columns by other tools without parsing
+  strings. The events are gathered in batches of rows, and the strings
+  are replaced by their index in a dictionary, written once per file.
+
+  Like sinsp_dumper, it's given the events to write by the caller. Files
+  can be rolled over by size and by time, as cycle_writer does for the
+  captures.
+*/
+class SINSP_PUBLIC sinsp_column_exporter
+{
+public:
+	/*!
+	  \brief Constructs an exporter writing the given fields, each in a
+	  column named after it.
+
+	  \note Throws a sinsp_exception if a field doesn't exist.
+	*/
+	sinsp_column_exporter(sinsp* inspector,
+		const std::vector<std::string>& fields,
+		filter_check_list &available_checks = g_filterlist);
+
+	~sinsp_column_exporter();
+
+	/*!
+	  \brief Set the number of rows of the record batches, 4096 by
+	  default. It must be called before open().
+	*/
+	void set_batch_size(uint32_t nrows);
+
+	/*!
+	  \brief Start a new file when the current one is larger than
+	  max_bytes, or when its events span more than max_duration_ns
+	  nanoseconds. 0 disables each of them. The files are named after
+	  the name given to open(), followed by a counter, and always end
+	  with a whole batch, so they can be a little bigger or longer.
+	  It must be called before open().
+	*/
+	void set_rollover(uint64_t max_bytes, uint64_t max_duration_ns);
+
+	/*!
+	  \brief Opens a file, that gets the offsets of its batches when
+	  closed.
+	  \note Throws a sinsp_exception if the file can't be opened.
+	*/
+	void open(const std::string& filename);
+
+	/*!
+	  \brief Writes a stream to a file descriptor, such as a pipe or a
+	  socket. There's no rollover.
+	*/
+	void fdopen(int fd);
+
+	/*!
+	  \brief Writes the pending rows and closes the file.
+	*/
+	void close();
+
+	bool is_open() const
+	{
+		return m_file != NULL;
+	}
+
+	/*!
+	  \brief Adds a row with the fields of the event, writing a batch
+	  when it's full.
+	*/
+	void dump(sinsp_evt* evt);
+
+	/*!
+	  \brief Writes the pending rows as a batch, and flushes the file.
+	*/
+	void flush();
+
+	/*!
+	  \brief Return the number of events written to the current file,
+	  including the pending ones.
+	*/
+	uint64_t written_events() const
+	{
+		return m_nevts;
+	}
+
+	/*!
+	  \brief Return the size of the current file.
+	*/
+	uint64_t written_bytes() const
+	{
+		return m_nbytes;
+	}
+
+	const std::string& get_current_file_name() const
+	{
+		return m_file_name;
+	}
+
+private:
+	void open_next_file();
+	void start_file(FILE* file, const std::string& filename);
+	void close_file();
+	void write_schema();
+	void write_batch();
+	void write_dictionary(uint32_t col, bool reset);
+	void write_message(sinsp_col_message_type type);
+	void write(const void* data, size_t len);
+
+	sinsp* m_inspector;
+	std::vector<sinsp_filter_check*> m_checks;
+	sinsp_field_buffer m_rows;
+	uint32_t m_batch_size;
+	uint64_t m_max_bytes;
+	uint64_t m_max_duration_ns;
+
+	FILE* m_file;
+	bool m_is_stream;
+	std::string m_base_file_name;
+	std::string m_file_name;
+	uint32_t m_file_index;
+	uint64_t m_file_start_ts;
+	uint64_t m_nevts;
+	uint64_t m_nbytes;
+	std::vector<uint64_t> m_batch_offsets;
+
+	// The dictionaries of the string columns, with the strings added
+	// since the last dictionary batch
+	struct dictionary
+	{
+		std::unordered_map<std::string, uint32_t> m_indexes;
+		std::vector<uint32_t> m_offsets;
+		std::vector<char> m_data;
+	};
+	std::vector<dictionary> m_dictionaries;
+	std::vector<std::vector<uint32_t>> m_indexes;
+	std::string m_key;
+
+	// The message being built
+	std::vector<uint8_t> m_message;
+};
+
+/*!
+  \brief Reads the files and the streams written by sinsp_column_exporter,
+  one batch of rows at a time.
+*/
+class SINSP_PUBLIC sinsp_column_reader
+{
+public:
+	sinsp_column_reader();
+	~sinsp_column_reader();
+
+	/*!
+	  \brief Opens a file and reads its schema.
+	  \note Throws a sinsp_exception if the file can't be read.
+	*/
+	void open(const std::string& filename);
+
+	void close();
+
+	/*!
+	  \brief Reads the next batch of rows in the buffer, that gets a
+	  column for each one of the file on the first call, with its
+	  strings out of the dictionary.
+
+	  \return false at the end of the file.
+	  \note Throws a sinsp_exception if the file is invalid.
+	*/
+	bool next(sinsp_field_buffer& rows);
+
+	/*!
+	  \brief Return the names and the kinds of the columns.
+	*/
+	const std::vector<std::pair<std::string, sinsp_field_kind>>& get_columns() const
+	{
+		return m_columns;
+	}
+
+private:
+	void read(void* data, size_t len);
+
+	FILE* m_file;
+	std::string m_file_name;
+	std::vector<std::pair<std::string, sinsp_field_kind>> m_columns;
+	std::vector<std::vector<std::string>> m_dictionaries;
+	std::vector<uint8_t> m_message;
+};
+
+/*@}*/
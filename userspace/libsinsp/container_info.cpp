@@ -174,7 +174,7 @@ sinsp_container_info::container_health_probe::probe_type sinsp_container_info::m
 				p.m_health_probe_exe.c_str(), p.m_health_probe_args.size());
 
                 return (p.m_health_probe_exe == tinfo->m_exe &&
-			p.m_health_probe_args == tinfo->m_args);
+			p.m_health_probe_args == tinfo->m_args.get());
         };
 
 	auto match = std::find_if(m_health_probes.begin(),
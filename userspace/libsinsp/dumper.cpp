@@ -27,6 +27,10 @@ sinsp_dumper::sinsp_dumper(sinsp* inspector)
 	m_target_memory_buffer = NULL;
 	m_target_memory_buffer_size = 0;
 	m_nevts = 0;
+	m_threads_from_sinsp = false;
+	m_checkpoint_interval_ns = 0;
+	m_last_checkpoint_ts = 0;
+	m_open_flags = SCAP_DOF_NONE;
 }
 
 sinsp_dumper::sinsp_dumper(sinsp* inspector, uint8_t* target_memory_buffer, uint64_t target_memory_buffer_size)
@@ -35,6 +39,11 @@ sinsp_dumper::sinsp_dumper(sinsp* inspector, uint8_t* target_memory_buffer, uint
 	m_dumper = NULL;
 	m_target_memory_buffer = target_memory_buffer;
 	m_target_memory_buffer_size = target_memory_buffer_size;
+	m_nevts = 0;
+	m_threads_from_sinsp = false;
+	m_checkpoint_interval_ns = 0;
+	m_last_checkpoint_ts = 0;
+	m_open_flags = SCAP_DOF_NONE;
 }
 
 sinsp_dumper::~sinsp_dumper()
@@ -58,13 +67,17 @@ void sinsp_dumper::open(const string& filename, bool compress, bool threads_from
 	}
 	else
 	{
-		if(compress)
+		if(compress && m_checkpoint_interval_ns != 0)
+		{
+			m_dumper = scap_dump_open_ex(m_inspector->m_h, filename.c_str(), SCAP_COMPRESSION_GZIP_CHUNKED, threads_from_sinsp, m_open_flags);
+		}
+		else if(compress)
 		{
-			m_dumper = scap_dump_open(m_inspector->m_h, filename.c_str(), SCAP_COMPRESSION_GZIP, threads_from_sinsp);
+			m_dumper = scap_dump_open_ex(m_inspector->m_h, filename.c_str(), SCAP_COMPRESSION_GZIP, threads_from_sinsp, m_open_flags);
 		}
 		else
 		{
-			m_dumper = scap_dump_open(m_inspector->m_h, filename.c_str(), SCAP_COMPRESSION_NONE, threads_from_sinsp);
+			m_dumper = scap_dump_open_ex(m_inspector->m_h, filename.c_str(), SCAP_COMPRESSION_NONE, threads_from_sinsp, m_open_flags);
 		}
 	}
 
@@ -73,15 +86,16 @@ void sinsp_dumper::open(const string& filename, bool compress, bool threads_from
 		throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
 	}
 
-	if(threads_from_sinsp)
+	m_threads_from_sinsp = threads_from_sinsp;
+	write_state();
+
+	if(m_checkpoint_interval_ns != 0 && !m_target_memory_buffer &&
+	   scap_dump_enable_index(m_inspector->m_h, m_dumper, 0) != SCAP_SUCCESS)
 	{
-		m_inspector->m_thread_manager->dump_threads_to_file(m_dumper);
+		throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
 	}
 
-	m_inspector->m_container_manager.dump_containers(m_dumper);
-
-	m_inspector->m_usergroup_manager.dump_users_groups(m_dumper);
-
+	m_last_checkpoint_ts = 0;
 	m_nevts = 0;
 }
 
@@ -92,7 +106,11 @@ void sinsp_dumper::fdopen(int fd, bool compress, bool threads_from_sinsp)
 		throw sinsp_exception("can't start event dump, inspector not opened yet");
 	}
 
-	if(compress)
+	if(compress && m_checkpoint_interval_ns != 0)
+	{
+		m_dumper = scap_dump_open_fd(m_inspector->m_h, fd, SCAP_COMPRESSION_GZIP_CHUNKED, threads_from_sinsp);
+	}
+	else if(compress)
 	{
 		m_dumper = scap_dump_open_fd(m_inspector->m_h, fd, SCAP_COMPRESSION_GZIP, threads_from_sinsp);
 	}
@@ -106,7 +124,20 @@ void sinsp_dumper::fdopen(int fd, bool compress, bool threads_from_sinsp)
 		throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
 	}
 
-	if(threads_from_sinsp)
+	m_threads_from_sinsp = threads_from_sinsp;
+	write_state();
+
+	m_last_checkpoint_ts = 0;
+	m_nevts = 0;
+}
+
+//
+// Write the state that sinsp keeps on top of the scap tables, after the
+// section written by scap at open or at a checkpoint
+//
+void sinsp_dumper::write_state()
+{
+	if(m_threads_from_sinsp)
 	{
 		m_inspector->m_thread_manager->dump_threads_to_file(m_dumper);
 	}
@@ -114,8 +145,35 @@ void sinsp_dumper::fdopen(int fd, bool compress, bool threads_from_sinsp)
 	m_inspector->m_container_manager.dump_containers(m_dumper);
 
 	m_inspector->m_usergroup_manager.dump_users_groups(m_dumper);
+}
 
-	m_nevts = 0;
+void sinsp_dumper::checkpoint(uint64_t ts)
+{
+	if(scap_dump_checkpoint(m_inspector->m_h, m_dumper, ts) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
+	}
+
+	write_state();
+	m_last_checkpoint_ts = ts;
+}
+
+void sinsp_dumper::set_checkpoint_interval(uint64_t interval_ns)
+{
+	m_checkpoint_interval_ns = interval_ns;
+}
+
+void sinsp_dumper::set_background_write(bool enable, bool direct_io)
+{
+	m_open_flags = SCAP_DOF_NONE;
+	if(enable)
+	{
+		m_open_flags |= SCAP_DOF_BACKGROUND_WRITE;
+		if(direct_io)
+		{
+			m_open_flags |= SCAP_DOF_DIRECT_IO;
+		}
+	}
 }
 
 void sinsp_dumper::close()
@@ -146,6 +204,18 @@ void sinsp_dumper::dump(sinsp_evt* evt)
 
 	scap_evt* pdevt = (evt->m_poriginal_evt)? evt->m_poriginal_evt : evt->m_pevt;
 
+	if(m_checkpoint_interval_ns != 0 && !m_target_memory_buffer)
+	{
+		if(m_last_checkpoint_ts == 0)
+		{
+			m_last_checkpoint_ts = pdevt->ts;
+		}
+		else if(pdevt->ts >= m_last_checkpoint_ts + m_checkpoint_interval_ns)
+		{
+			checkpoint(pdevt->ts);
+		}
+	}
+
 	int32_t res = scap_dump(m_inspector->m_h,
 		m_dumper, pdevt, evt->m_cpuid, 0);
 
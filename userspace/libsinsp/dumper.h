@@ -116,6 +116,28 @@ public:
 	*/
 	void dump(sinsp_evt* evt);
 
+	/*!
+	  \brief Write a state checkpoint every interval_ns nanoseconds of
+	   events, and an index of the checkpoints next to the file, so that
+	   reading can start from any of them (see scap_dump_enable_index()).
+	   Compressed files are written in independent chunks, so that they
+	   can be inflated starting from a checkpoint.
+
+	  \note It must be called before open(). Files opened with fdopen()
+	   get the checkpoints, but no index.
+	*/
+	void set_checkpoint_interval(uint64_t interval_ns);
+
+	/*!
+	  \brief Copy the events into large buffers, that a background thread
+	   compresses and writes, optionally with O_DIRECT (see
+	   scap_dump_open_ex()).
+
+	  \note It must be called before open(). It has no effect on fdopen(),
+	   on memory dumps and when writing to standard output.
+	*/
+	void set_background_write(bool enable, bool direct_io = false);
+
 	inline uint8_t* get_memory_dump_cur_buf()
 	{
 		return scap_get_memorydumper_curpos(m_dumper);
@@ -132,6 +154,13 @@ private:
 	uint8_t* m_target_memory_buffer;
 	uint64_t m_target_memory_buffer_size;
 	uint64_t m_nevts;
+	bool m_threads_from_sinsp;
+	uint64_t m_checkpoint_interval_ns;
+	uint64_t m_last_checkpoint_ts;
+	uint32_t m_open_flags;
+
+	void write_state();
+	void checkpoint(uint64_t ts);
 };
 
 /*@}*/
@@ -15,6 +15,8 @@ limitations under the License.
 
 */
 
+#include <inttypes.h>
+
 #include "sinsp.h"
 #include "sinsp_int.h"
 #include "filter.h"
@@ -95,6 +97,7 @@ void sinsp_evt_formatter::set_format(gen_event_formatter::output_format of, cons
 	const char* cfmt = lfmt.c_str();
 
 	m_tokens.clear();
+	m_chunks.clear();
 	uint32_t lfmtlen = (uint32_t)lfmt.length();
 
 	for(j = 0; j < lfmtlen; j++)
@@ -107,7 +110,7 @@ void sinsp_evt_formatter::set_format(gen_event_formatter::output_format of, cons
 			{
 				rawstring_check* newtkn = new rawstring_check(lfmt.substr(last_nontoken_str_start, j - last_nontoken_str_start));
 				m_tokens.emplace_back(make_pair("", newtkn));
-				m_tokenlens.push_back(0);
+				m_chunks.push_back({newtkn->m_text, NULL, 0});
 				m_chks_to_free.push_back(newtkn);
 			}
 
@@ -165,7 +168,7 @@ void sinsp_evt_formatter::set_format(gen_event_formatter::output_format of, cons
 			ASSERT(j <= lfmt.length());
 
 			m_tokens.emplace_back(make_pair(string(fstart, fsize), chk));
-			m_tokenlens.push_back(toklen);
+			m_chunks.push_back({"", chk, (uint32_t)toklen});
 
 			last_nontoken_str_start = j + 1;
 		}
@@ -173,11 +176,31 @@ void sinsp_evt_formatter::set_format(gen_event_formatter::output_format of, cons
 
 	if(last_nontoken_str_start != j)
 	{
-		sinsp_filter_check * chk = new rawstring_check(lfmt.substr(last_nontoken_str_start, j - last_nontoken_str_start));
+		rawstring_check* chk = new rawstring_check(lfmt.substr(last_nontoken_str_start, j - last_nontoken_str_start));
 		m_tokens.emplace_back(make_pair("", chk));
+		m_chunks.push_back({chk->m_text, NULL, 0});
 		m_chks_to_free.push_back(chk);
-		m_tokenlens.push_back(0);
 	}
+
+	//
+	// jsoncpp writes the keys of an object sorted, and a field given
+	// twice gets the value of its last token
+	//
+	map<string, uint32_t> json_keys;
+	for(j = 0; j < m_tokens.size(); j++)
+	{
+		if(m_tokens[j].second->get_field_info() != NULL)
+		{
+			json_keys[m_tokens[j].first] = j;
+		}
+	}
+
+	m_json_keys.clear();
+	for(auto& key : json_keys)
+	{
+		m_json_keys.emplace_back(Json::valueToQuotedString(key.first.c_str()), key.second);
+	}
+	m_json_values.assign(m_tokens.size(), Json::Value());
 }
 
 bool sinsp_evt_formatter::on_capture_end(OUT string* res)
@@ -192,8 +215,6 @@ bool sinsp_evt_formatter::resolve_tokens(sinsp_evt *evt, map<string,string>& val
 	const filtercheck_field_info* fi;
 	uint32_t j = 0;
 
-	ASSERT(m_tokenlens.size() == m_tokens.size());
-
 	for(j = 0; j < m_tokens.size(); j++)
 	{
 		char* str = m_tokens[j].second->tostring(evt);
@@ -214,7 +235,48 @@ bool sinsp_evt_formatter::resolve_tokens(sinsp_evt *evt, map<string,string>& val
 		fi = m_tokens[j].second->get_field_info();
 		if(fi)
 		{
-			values[m_tokens[j].first] = string(str);
+			// reuses the memory of the strings of a map filled before
+			values[m_tokens[j].first].assign(str);
+		}
+	}
+
+	return retval;
+}
+
+bool sinsp_evt_formatter::resolve_tokens(sinsp_evt *evt, sinsp_field_buffer& values)
+{
+	bool retval = true;
+	sinsp_field_value value;
+	uint32_t col = 0;
+
+	// the tokens without name are the text between the fields
+	if(values.num_columns() == 0)
+	{
+		for(auto& tkn : m_tokens)
+		{
+			if(!tkn.first.empty())
+			{
+				values.add_column(tkn.first, tkn.second->get_field_kind());
+			}
+		}
+	}
+
+	for(auto& tkn : m_tokens)
+	{
+		if(tkn.first.empty())
+		{
+			continue;
+		}
+
+		sinsp_field_column& column = values.get_column(col++);
+		if(tkn.second->extract_typed(evt, value))
+		{
+			column.append(value);
+		}
+		else
+		{
+			column.append_null();
+			retval = retval && !m_require_all_values;
 		}
 	}
 
@@ -233,83 +295,149 @@ gen_event_formatter::output_format sinsp_evt_formatter::get_output_format()
 	return m_output_format;
 }
 
+//
+// Writes the value as FastWriter does. The plain strings and the
+// numbers, that are most of the values, are written here, the others
+// are left to jsoncpp.
+//
+void sinsp_evt_formatter::append_json(const Json::Value& value, std::string& output)
+{
+	char buf[32];
+	const char* begin;
+	const char* end;
+
+	switch(value.type())
+	{
+	case Json::nullValue:
+		output += "null";
+		return;
+	case Json::intValue:
+		snprintf(buf, sizeof(buf), "%" PRId64, (int64_t)value.asLargestInt());
+		output += buf;
+		return;
+	case Json::uintValue:
+		snprintf(buf, sizeof(buf), "%" PRIu64, (uint64_t)value.asLargestUInt());
+		output += buf;
+		return;
+	case Json::booleanValue:
+		output += value.asBool() ? "true" : "false";
+		return;
+	case Json::stringValue:
+		if(value.getString(&begin, &end))
+		{
+			const char* p = begin;
+			while(p < end && *p >= 0x20 && *p < 0x7f && *p != '"' && *p != '\\')
+			{
+				p++;
+			}
+
+			if(p == end)
+			{
+				output += '"';
+				output.append(begin, end - begin);
+				output += '"';
+				return;
+			}
+		}
+		break;
+	default:
+		break;
+	}
+
+	// FastWriter ends the document with a newline
+	const std::string& res = m_writer.write(value);
+	output.append(res, 0, res.size() - 1);
+}
+
 bool sinsp_evt_formatter::tostring_withformat(gen_event* gevt, std::string &output, gen_event_formatter::output_format of)
 {
 	bool retval = true;
-	const filtercheck_field_info* fi;
 
 	sinsp_evt *evt = static_cast<sinsp_evt *>(gevt);
 
 	uint32_t j = 0;
 	output.clear();
 
-	ASSERT(m_tokenlens.size() == m_tokens.size());
+	ASSERT(m_chunks.size() == m_tokens.size());
 
-	for(j = 0; j < m_tokens.size(); j++)
+	if(of == OF_JSON)
 	{
-		if(of == OF_JSON)
+		//
+		// The values are written right away in the output, in the order
+		// of the keys. If one is missing, the ones after it are not
+		// resolved.
+		//
+		uint32_t nresolved = m_tokens.size();
+		for(j = 0; j < m_tokens.size(); j++)
 		{
-			Json::Value json_value = m_tokens[j].second->tojson(evt);
-
-			if(retval == false)
+			if(m_tokens[j].second->get_field_info() == NULL)
 			{
 				continue;
 			}
 
-			if(json_value == Json::nullValue && m_require_all_values)
+			m_json_values[j] = m_tokens[j].second->tojson(evt);
+			if(m_json_values[j].isNull() && m_require_all_values)
 			{
 				retval = false;
-				continue;
-			}
-
-			fi = m_tokens[j].second->get_field_info();
-
-			if(fi)
-			{
-				m_root[m_tokens[j].first] = m_tokens[j].second->tojson(evt);
+				nresolved = j;
+				break;
 			}
 		}
-		else
+
+		// Without fields, the JSON rendering was always a null value
+		if(m_json_keys.empty())
 		{
-			char* str = m_tokens[j].second->tostring(evt);
+			output = "null";
+			return retval;
+		}
 
-			if(retval == false)
+		output += '{';
+		bool first = true;
+		for(auto& key : m_json_keys)
+		{
+			if(key.second >= nresolved)
 			{
 				continue;
 			}
 
-			if(str == NULL)
+			if(!first)
 			{
-				if(m_require_all_values)
-				{
-					retval = false;
-					continue;
-				}
-				else
-				{
-					str = (char*)"<NA>";
-				}
+				output += ',';
 			}
+			first = false;
+			output += key.first;
+			output += ':';
+			append_json(m_json_values[key.second], output);
+		}
+		output += '}';
 
-			uint32_t tks = m_tokenlens[j];
+		return retval;
+	}
 
-			if(tks != 0)
-			{
-				string sstr(str);
-				sstr.resize(tks, ' ');
-				output += sstr;
-			}
-			else
+	for(auto& chunk : m_chunks)
+	{
+		if(chunk.m_check == NULL)
+		{
+			output += chunk.m_text;
+			continue;
+		}
+
+		size_t start = output.size();
+		if(!chunk.m_check->append_string(evt, output))
+		{
+			if(m_require_all_values)
 			{
-				output += str;
+				retval = false;
+				break;
 			}
+			output += "<NA>";
 		}
-	}
 
-	if(of == OF_JSON)
-	{
-		output = m_writer.write(m_root);
-		output = output.substr(0, output.size() - 1);
+		// padded with spaces or truncated to the length of the token
+		if(chunk.m_len != 0)
+		{
+			output.resize(start + chunk.m_len, ' ');
+		}
 	}
 
 	return retval;
@@ -336,13 +464,11 @@ sinsp_evt_formatter_cache::~sinsp_evt_formatter_cache()
 
 std::shared_ptr<sinsp_evt_formatter>& sinsp_evt_formatter_cache::get_cached_formatter(string &format)
 {
-	auto it = m_formatter_cache.lower_bound(format);
+	auto it = m_formatter_cache.find(format);
 
-	if(it == m_formatter_cache.end() ||
-	   it->first != format)
+	if(it == m_formatter_cache.end())
 	{
-		it = m_formatter_cache.emplace_hint(it,
-						    std::make_pair(format, make_shared<sinsp_evt_formatter>(m_inspector, format)));
+		it = m_formatter_cache.emplace(format, make_shared<sinsp_evt_formatter>(m_inspector, format)).first;
 	}
 
 	return it->second;
@@ -17,12 +17,14 @@ limitations under the License.
 
 #pragma once
 #include <map>
+#include <unordered_map>
 #include <utility>
 #include <string>
 #include <json/json.h>
 
 #include "filter_check_list.h"
 #include "gen_filter.h"
+#include "field_buffer.h"
 
 class sinsp_filter_check;
 
@@ -67,6 +69,21 @@ public:
 	*/
 	bool resolve_tokens(sinsp_evt *evt, map<string,string>& values);
 
+	/*!
+	  \brief Resolve all the formatted tokens and append them as a row of
+	  the buffer, with their own types. The first call adds a column per
+	  token, named as the token, so the buffer must be used only with
+	  this formatter. Once the buffer is big enough, this doesn't
+	  allocate memory.
+
+	  \param evt Pointer to the event to be converted into string.
+	  \param values Reference to the buffer that will be filled with the result.
+
+	  \return true if all the tokens can be retrieved successfully, false
+	  otherwise. The tokens that can't be retrieved are null.
+	*/
+	bool resolve_tokens(sinsp_evt *evt, sinsp_field_buffer& values);
+
 	// For compatibility with gen_event_filter_factory
 	// interface. It just calls resolve_tokens().
 	bool get_field_values(gen_event *evt, std::map<std::string, std::string> &fields) override;
@@ -99,18 +116,33 @@ public:
 	bool on_capture_end(OUT string* res);
 
 private:
+	void append_json(const Json::Value& value, std::string& output);
+
 	gen_event_formatter::output_format m_output_format;
 
 	// vector of (full string of the token, filtercheck) pairs
 	// e.g. ("proc.aname[2], ptr to sinsp_filter_check_thread)
 	vector<pair<string, sinsp_filter_check*>> m_tokens;
-	vector<uint32_t> m_tokenlens;
+
+	// The format as a template of text and fields, for the text
+	// rendering. A field is padded to m_len if not 0.
+	struct chunk
+	{
+		string m_text;
+		sinsp_filter_check* m_check;
+		uint32_t m_len;
+	};
+	vector<chunk> m_chunks;
+
 	sinsp* m_inspector;
 	filter_check_list &m_available_checks;
 	bool m_require_all_values;
 	vector<sinsp_filter_check*> m_chks_to_free;
 
-	Json::Value m_root;
+	// The keys of the JSON rendering, quoted and in the order jsoncpp
+	// writes them, each with the index of the token of its value
+	vector<pair<string, uint32_t>> m_json_keys;
+	vector<Json::Value> m_json_values;
 	Json::FastWriter m_writer;
 };
 
@@ -141,7 +173,7 @@ private:
 	// sinsp_evt_formatter object if necessary.
 	std::shared_ptr<sinsp_evt_formatter>& get_cached_formatter(string &format);
 
-	std::map<std::string,std::shared_ptr<sinsp_evt_formatter>> m_formatter_cache;
+	std::unordered_map<std::string,std::shared_ptr<sinsp_evt_formatter>> m_formatter_cache;
 	sinsp *m_inspector;
 };
 /*@}*/
@@ -159,7 +191,7 @@ public:
 protected:
 
 	// Maps from output string to formatter
-	std::map<std::string, std::shared_ptr<gen_event_formatter>> m_formatters;
+	std::unordered_map<std::string, std::shared_ptr<gen_event_formatter>> m_formatters;
 
 	sinsp *m_inspector;
 	filter_check_list &m_available_checks;
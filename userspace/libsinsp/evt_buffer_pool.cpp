@@ -0,0 +1,104 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <cstdlib>
+
+#include "evt_buffer_pool.h"
+#include "settings.h"
+
+sinsp_evt_buffer_pool::sinsp_evt_buffer_pool():
+	m_classes(class_of(SP_EVT_BUF_SIZE) + 1),
+	m_n_free(0),
+	m_n_reused(0),
+	m_n_allocated(0)
+{
+}
+
+sinsp_evt_buffer_pool::~sinsp_evt_buffer_pool()
+{
+	for(auto& c : m_classes)
+	{
+		for(uint8_t* buf : c.m_free)
+		{
+			free(buf);
+		}
+	}
+}
+
+uint8_t* sinsp_evt_buffer_pool::reserve(uint32_t len, uint32_t* size)
+{
+	uint32_t cls = class_of(len);
+	size_class& c = m_classes[cls];
+	uint8_t* buf;
+
+	if(!c.m_free.empty())
+	{
+		buf = c.m_free.back();
+		c.m_free.pop_back();
+		m_n_free--;
+		m_n_reused++;
+	}
+	else
+	{
+		buf = (uint8_t*)malloc(EVT_BUFFER_POOL_MIN_SIZE << cls);
+		if(buf == NULL)
+		{
+			return NULL;
+		}
+		m_n_allocated++;
+	}
+
+	c.m_n_used++;
+	*size = EVT_BUFFER_POOL_MIN_SIZE << cls;
+	return buf;
+}
+
+void sinsp_evt_buffer_pool::release(uint8_t* buf, uint32_t size, size_t max_free)
+{
+	size_class& c = m_classes[class_of(size)];
+
+	c.m_n_used--;
+	if(m_n_free < max_free)
+	{
+		c.m_free.push_back(buf);
+		m_n_free++;
+	}
+	else
+	{
+		free(buf);
+	}
+}
+
+void sinsp_evt_buffer_pool::get_stats(stats* stats) const
+{
+	stats->m_classes.clear();
+	stats->m_used_bytes = 0;
+	stats->m_free_bytes = 0;
+	stats->m_n_reused = m_n_reused;
+	stats->m_n_allocated = m_n_allocated;
+
+	for(uint32_t j = 0; j < m_classes.size(); j++)
+	{
+		class_stats cs;
+		cs.m_size = EVT_BUFFER_POOL_MIN_SIZE << j;
+		cs.m_n_used = m_classes[j].m_n_used;
+		cs.m_n_free = m_classes[j].m_free.size();
+		stats->m_used_bytes += cs.m_n_used * cs.m_size;
+		stats->m_free_bytes += cs.m_n_free * cs.m_size;
+		stats->m_classes.push_back(cs);
+	}
+}
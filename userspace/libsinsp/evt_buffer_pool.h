@@ -0,0 +1,104 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//
+// Buffers for the enter events that the threads keep until their exit
+// event is parsed.
+//
+// The buffers come in power of two size classes, from
+// EVT_BUFFER_POOL_MIN_SIZE to SP_EVT_BUF_SIZE, so an enter event takes
+// roughly its own length. Released buffers are kept on a free list per
+// class and handed out again. The threads holding a buffer share the
+// ownership of the pool, so that they can give it back even after the
+// inspector is gone.
+//
+#define EVT_BUFFER_POOL_MIN_SIZE 64
+
+class sinsp_evt_buffer_pool
+{
+public:
+	//
+	// Occupancy of one size class
+	//
+	struct class_stats
+	{
+		uint32_t m_size;
+		// Buffers handed out and not released yet
+		uint64_t m_n_used;
+		// Buffers on the free list
+		uint64_t m_n_free;
+	};
+
+	struct stats
+	{
+		std::vector<class_stats> m_classes;
+		// Bytes of the used and of the free buffers
+		uint64_t m_used_bytes;
+		uint64_t m_free_bytes;
+		// Number of reserve() calls served from a free list, and
+		// from malloc()
+		uint64_t m_n_reused;
+		uint64_t m_n_allocated;
+	};
+
+	sinsp_evt_buffer_pool();
+	~sinsp_evt_buffer_pool();
+
+	//
+	// Return a buffer of at least len bytes and store its size in
+	// *size. len can't be bigger than SP_EVT_BUF_SIZE. Returns NULL if
+	// the allocation fails.
+	//
+	uint8_t* reserve(uint32_t len, uint32_t* size);
+
+	//
+	// Give back a buffer returned by reserve(). It's freed, instead of
+	// kept for reuse, if there are already max_free buffers on the free
+	// lists.
+	//
+	void release(uint8_t* buf, uint32_t size, size_t max_free);
+
+	void get_stats(stats* stats) const;
+
+private:
+	struct size_class
+	{
+		std::vector<uint8_t*> m_free;
+		uint64_t m_n_used = 0;
+	};
+
+	static inline uint32_t class_of(uint32_t len)
+	{
+		uint32_t cls = 0;
+		for(uint32_t size = EVT_BUFFER_POOL_MIN_SIZE; size < len; size <<= 1)
+		{
+			cls++;
+		}
+		return cls;
+	}
+
+	std::vector<size_class> m_classes;
+	size_t m_n_free;
+	uint64_t m_n_reused;
+	uint64_t m_n_allocated;
+};
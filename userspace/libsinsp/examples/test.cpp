@@ -54,10 +54,33 @@ Options:
   -h, --help                    Print this page
   -f <filter>                   Filter string for events (see https://falco.org/docs/rules/supported-fields/ for supported fields)
   -j, --json                    Use JSON as the output format
+  -w, --wait <policy>           How to wait for events when the driver buffers are empty:
+                                backoff (default), busy, hybrid or poll. Prints the p50/p99
+                                event latency on exit
 )";
     cout << usage << endl;
 }
 
+static bool set_wait_policy(sinsp& inspector, const string& name)
+{
+    static const map<string, scap_wait_policy> policies = {
+            {"backoff", SCAP_WAIT_BACKOFF},
+            {"busy",    SCAP_WAIT_BUSY_POLL},
+            {"hybrid",  SCAP_WAIT_HYBRID},
+            {"poll",    SCAP_WAIT_POLL},
+    };
+
+    auto it = policies.find(name);
+    if(it == policies.end())
+    {
+        return false;
+    }
+
+    inspector.set_wait_policy(it->second);
+    inspector.set_event_latency_tracking(true);
+    return true;
+}
+
 //
 // Sample filters:
 //   "evt.category=process or evt.category=net"
@@ -71,15 +94,17 @@ int main(int argc, char **argv)
     static struct option long_options[] = {
             {"help",      no_argument, 0, 'h'},
             {"json",      no_argument, 0, 'j'},
+            {"wait",      required_argument, 0, 'w'},
             {0,   0,         0,  0}
     };
 
     int op;
     int long_index = 0;
     string filter_string;
+    bool print_latency = false;
     std::function<void (sinsp& inspector)> dump = plaintext_dump;
     while((op = getopt_long(argc, argv,
-                            "hr:s:f:j",
+                            "hr:s:f:jw:",
                             long_options, &long_index)) != -1)
     {
         switch(op)
@@ -98,6 +123,15 @@ int main(int argc, char **argv)
 
                 inspector.set_buffer_format(sinsp_evt::PF_JSON);
                 dump = json_dump;
+                break;
+            case 'w':
+                if(!set_wait_policy(inspector, optarg))
+                {
+                    cerr << "[ERROR] Unknown wait policy: " << optarg << endl;
+                    return EXIT_FAILURE;
+                }
+                print_latency = true;
+                break;
             default:
                 break;
         }
@@ -124,6 +158,14 @@ int main(int argc, char **argv)
         dump(inspector);
     }
 
+    if(print_latency)
+    {
+        const latency_histogram& latency = inspector.get_event_latency();
+        cout << "events: " << latency.count()
+             << " p50: " << latency.percentile(0.5) << "ns"
+             << " p99: " << latency.percentile(0.99) << "ns" << endl;
+    }
+
     // Cleanup JSON formatters
     delete default_formatter;
     delete process_formatter;
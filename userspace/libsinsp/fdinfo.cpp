@@ -31,6 +31,8 @@ template<> sinsp_fdinfo_t::sinsp_fdinfo()
 {
 	m_type = SCAP_FD_UNINITIALIZED;
 	m_flags = FLAGS_NONE;
+	m_dev = 0;
+	m_mount_id = 0;
 	m_callbacks = NULL;
 	m_usrstate = NULL;
 }
@@ -301,24 +303,61 @@ template<> void sinsp_fdinfo_t::unregister_event_callback(sinsp_pd_callback_type
 sinsp_fdtable::sinsp_fdtable(sinsp* inspector)
 {
 	m_inspector = inspector;
+	m_tid = 0;
+	m_nfds = 0;
 	reset_cache();
 }
 
+sinsp_fdtable::sinsp_fdtable(const sinsp_fdtable& other)
+{
+	m_nfds = 0;
+	*this = other;
+}
+
+sinsp_fdtable& sinsp_fdtable::operator=(const sinsp_fdtable& other)
+{
+	if(this == &other)
+	{
+		return *this;
+	}
+
+	m_inspector = other.m_inspector;
+	m_tid = other.m_tid;
+
+	m_fds.clear();
+	m_fds.resize(other.m_fds.size());
+	for(size_t j = 0; j < other.m_fds.size(); j++)
+	{
+		if(other.m_fds[j])
+		{
+			m_fds[j].reset(new sinsp_fdinfo_t(*other.m_fds[j]));
+		}
+	}
+	m_large_fds = other.m_large_fds;
+	m_nfds = other.m_nfds;
+
+	//
+	// The cache of the other table points into it
+	//
+	reset_cache();
+	return *this;
+}
+
 sinsp_fdinfo_t* sinsp_fdtable::add(int64_t fd, sinsp_fdinfo_t* fdinfo)
 {
 	//
 	// Look for the FD in the table
 	//
-	auto it = m_table.find(fd);
+	sinsp_fdinfo_t* existing = lookup(fd);
 
 	// Three possible exits here:
 	// 1. fd is not on the table
 	//   a. the table size is under the limit so create a new entry
 	//   b. table size is over the limit, discard the fd
 	// 2. fd is already in the table, replace it
-	if(it == m_table.end())
+	if(existing == NULL)
 	{
-		if(m_table.size() < m_inspector->m_max_fdtable_size)
+		if(m_nfds < m_inspector->m_max_fdtable_size)
 		{
 			//
 			// No entry in the table, this is the normal case
@@ -327,8 +366,22 @@ sinsp_fdinfo_t* sinsp_fdtable::add(int64_t fd, sinsp_fdinfo_t* fdinfo)
 #ifdef GATHER_INTERNAL_STATS
 			m_inspector->m_stats.m_n_added_fds++;
 #endif
-			pair<unordered_map<int64_t, sinsp_fdinfo_t>::iterator, bool> insert_res = m_table.emplace(fd, *fdinfo);
-			return &(insert_res.first->second);
+			m_nfds++;
+
+			if(fd >= 0 && fd < FDTABLE_MAX_DIRECT_FD)
+			{
+				if((uint64_t)fd >= m_fds.size())
+				{
+					size_t size = std::max<size_t>(8, m_fds.size() * 2);
+					size = std::max<size_t>(size, fd + 1);
+					m_fds.resize(std::min<size_t>(size, FDTABLE_MAX_DIRECT_FD));
+				}
+
+				m_fds[fd].reset(new sinsp_fdinfo_t(*fdinfo));
+				return m_fds[fd].get();
+			}
+
+			return &(m_large_fds.emplace(fd, *fdinfo).first->second);
 		}
 		else
 		{
@@ -340,7 +393,7 @@ sinsp_fdinfo_t* sinsp_fdtable::add(int64_t fd, sinsp_fdinfo_t* fdinfo)
 		//
 		// the fd is already in the table.
 		//
-		if(it->second.m_flags & sinsp_fdinfo_t::FLAGS_CLOSE_IN_PROGRESS)
+		if(existing->m_flags & sinsp_fdinfo_t::FLAGS_CLOSE_IN_PROGRESS)
 		{
 			//
 			// Sometimes an FD-creating syscall can be called on an FD that is being closed (i.e
@@ -351,7 +404,15 @@ sinsp_fdinfo_t* sinsp_fdtable::add(int64_t fd, sinsp_fdinfo_t* fdinfo)
 			fdinfo->m_flags &= ~sinsp_fdinfo_t::FLAGS_CLOSE_IN_PROGRESS;
 			fdinfo->m_flags |= sinsp_fdinfo_t::FLAGS_CLOSE_CANCELED;
 
-			m_table[CANCELED_FD_NUMBER] = it->second;
+			auto res = m_large_fds.emplace(CANCELED_FD_NUMBER, *existing);
+			if(res.second)
+			{
+				m_nfds++;
+			}
+			else
+			{
+				res.first->second = *existing;
+			}
 		}
 		else
 		{
@@ -371,21 +432,34 @@ sinsp_fdinfo_t* sinsp_fdtable::add(int64_t fd, sinsp_fdinfo_t* fdinfo)
 		//
 		// Replace the fd as a struct copy
 		//
-		it->second.copy(*fdinfo, true);
-		return &(it->second);
+		existing->copy(*fdinfo, true);
+		return existing;
 	}
 }
 
 void sinsp_fdtable::erase(int64_t fd)
 {
-	unordered_map<int64_t, sinsp_fdinfo_t>::iterator fdit = m_table.find(fd);
+	bool found = false;
 
 	if(fd == m_last_accessed_fd)
 	{
 		m_last_accessed_fd = -1;
 	}
 
-	if(fdit == m_table.end())
+	if((uint64_t)fd < m_fds.size())
+	{
+		if(m_fds[fd])
+		{
+			m_fds[fd].reset();
+			found = true;
+		}
+	}
+	else if(m_large_fds.erase(fd) != 0)
+	{
+		found = true;
+	}
+
+	if(!found)
 	{
 		//
 		// Looks like there's no fd to remove.
@@ -400,7 +474,7 @@ void sinsp_fdtable::erase(int64_t fd)
 	}
 	else
 	{
-		m_table.erase(fdit);
+		m_nfds--;
 #ifdef GATHER_INTERNAL_STATS
 		m_inspector->m_stats.m_n_noncached_fd_lookups++;
 		m_inspector->m_stats.m_n_removed_fds++;
@@ -410,12 +484,15 @@ void sinsp_fdtable::erase(int64_t fd)
 
 void sinsp_fdtable::clear()
 {
-	m_table.clear();
+	m_fds.clear();
+	m_large_fds.clear();
+	m_nfds = 0;
+	reset_cache();
 }
 
 size_t sinsp_fdtable::size()
 {
-	return m_table.size();
+	return m_nfds;
 }
 
 void sinsp_fdtable::reset_cache()
@@ -423,6 +500,27 @@ void sinsp_fdtable::reset_cache()
 	m_last_accessed_fd = -1;
 }
 
+bool sinsp_fdtable::loop(const fdtable_visitor_t& callback)
+{
+	for(size_t j = 0; j < m_fds.size(); j++)
+	{
+		if(m_fds[j] && !callback((int64_t)j, *m_fds[j]))
+		{
+			return false;
+		}
+	}
+
+	for(auto& it : m_large_fds)
+	{
+		if(!callback(it.first, it.second))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
 void sinsp_fdtable::lookup_device(sinsp_fdinfo_t* fdi, uint64_t fd)
 {
 #ifdef HAS_CAPTURE
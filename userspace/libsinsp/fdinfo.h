@@ -17,6 +17,8 @@ limitations under the License.
 
 #pragma once
 #include "sinsp_pd_callback_type.h"
+#include <functional>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -514,15 +516,24 @@ private:
 ///////////////////////////////////////////////////////////////////////////////
 // fd info table
 ///////////////////////////////////////////////////////////////////////////////
+
+//
+// The fds below this number, that most processes use, are stored in an array
+// indexed by fd. The others are kept in a hash table.
+//
+#define FDTABLE_MAX_DIRECT_FD 1024
+
 class sinsp_fdtable
 {
 public:
+	typedef std::function<bool(int64_t, sinsp_fdinfo_t&)> fdtable_visitor_t;
+
 	sinsp_fdtable(sinsp* inspector);
+	sinsp_fdtable(const sinsp_fdtable& other);
+	sinsp_fdtable& operator=(const sinsp_fdtable& other);
 
 	inline sinsp_fdinfo_t* find(int64_t fd)
 	{
-		std::unordered_map<int64_t, sinsp_fdinfo_t>::iterator fdit;
-
 		//
 		// Try looking up in our simple cache
 		//
@@ -537,9 +548,9 @@ public:
 		//
 		// Caching failed, do a real lookup
 		//
-		fdit = m_table.find(fd);
+		sinsp_fdinfo_t* fdinfo = lookup(fd);
 
-		if(fdit == m_table.end())
+		if(fdinfo == NULL)
 		{
 	#ifdef GATHER_INTERNAL_STATS
 			m_inspector->m_stats.m_n_failed_fd_lookups++;
@@ -552,9 +563,9 @@ public:
 			m_inspector->m_stats.m_n_noncached_fd_lookups++;
 	#endif
 			m_last_accessed_fd = fd;
-			m_last_accessed_fdinfo = &(fdit->second);
-			lookup_device(&(fdit->second), fd);
-			return &(fdit->second);
+			m_last_accessed_fdinfo = fdinfo;
+			lookup_device(fdinfo, fd);
+			return fdinfo;
 		}
 	}
 	
@@ -566,8 +577,14 @@ public:
 	size_t size();
 	void reset_cache();
 
+	//
+	// Call the callback for every fd, in increasing order for the ones
+	// below FDTABLE_MAX_DIRECT_FD. The table must not be modified by the
+	// callback. Returns false if the callback did.
+	//
+	bool loop(const fdtable_visitor_t& callback);
+
 	sinsp* m_inspector;
-	std::unordered_map<int64_t, sinsp_fdinfo_t> m_table;
 
 	//
 	// Simple fd cache
@@ -577,5 +594,34 @@ public:
 	uint64_t m_tid;
 
 private:
+	inline sinsp_fdinfo_t* lookup(int64_t fd)
+	{
+		if((uint64_t)fd < m_fds.size())
+		{
+			return m_fds[fd].get();
+		}
+
+		if(fd >= 0 && fd < FDTABLE_MAX_DIRECT_FD)
+		{
+			return NULL;
+		}
+
+		auto it = m_large_fds.find(fd);
+		if(it == m_large_fds.end())
+		{
+			return NULL;
+		}
+		return &(it->second);
+	}
+
 	void lookup_device(sinsp_fdinfo_t* fdi, uint64_t fd);
+
+	//
+	// The fds below FDTABLE_MAX_DIRECT_FD, indexed by fd. The entries are
+	// allocated one by one, so that pointers to them remain valid when
+	// the array grows.
+	//
+	std::vector<std::unique_ptr<sinsp_fdinfo_t>> m_fds;
+	std::unordered_map<int64_t, sinsp_fdinfo_t> m_large_fds;
+	size_t m_nfds;
 };
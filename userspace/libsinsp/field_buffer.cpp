@@ -0,0 +1,116 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <string.h>
+
+#include "field_buffer.h"
+#include "sinsp_exception.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_field_column implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_field_column::sinsp_field_column(const std::string& name, sinsp_field_kind kind):
+	m_name(name),
+	m_kind(kind),
+	m_offsets(1, 0)
+{
+}
+
+void sinsp_field_column::append(const sinsp_field_value& value)
+{
+	if(value.m_kind != m_kind)
+	{
+		throw sinsp_exception("value of kind " + std::to_string((long long) value.m_kind) +
+			" appended to column " + m_name + " of kind " + std::to_string((long long) m_kind));
+	}
+
+	m_nulls.push_back(0);
+	if(has_data())
+	{
+		m_data.insert(m_data.end(), value.m_data, value.m_data + value.m_len);
+		m_data.push_back('\0');
+		m_offsets.push_back(m_data.size());
+	}
+	else
+	{
+		uint64_t num;
+		switch(m_kind)
+		{
+		case FK_DOUBLE:
+			memcpy(&num, &value.m_double, sizeof(num));
+			break;
+		case FK_BOOL:
+			num = value.m_bool;
+			break;
+		default:
+			num = value.m_uint64;
+			break;
+		}
+		m_nums.push_back(num);
+	}
+}
+
+void sinsp_field_column::append_null()
+{
+	m_nulls.push_back(1);
+	if(has_data())
+	{
+		m_data.push_back('\0');
+		m_offsets.push_back(m_data.size());
+	}
+	else
+	{
+		m_nums.push_back(0);
+	}
+}
+
+void sinsp_field_column::clear()
+{
+	m_nulls.clear();
+	m_nums.clear();
+	m_offsets.resize(1);
+	m_data.clear();
+}
+
+double sinsp_field_column::get_double(size_t row) const
+{
+	double res;
+	memcpy(&res, &m_nums[row], sizeof(res));
+	return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_field_buffer implementation
+///////////////////////////////////////////////////////////////////////////////
+uint32_t sinsp_field_buffer::add_column(const std::string& name, sinsp_field_kind kind)
+{
+	if(num_rows() != 0)
+	{
+		throw sinsp_exception("column " + name + " added to a buffer with rows");
+	}
+
+	m_columns.emplace_back(name, kind);
+	return m_columns.size() - 1;
+}
+
+void sinsp_field_buffer::clear()
+{
+	for(auto& c : m_columns)
+	{
+		c.clear();
+	}
+}
@@ -0,0 +1,201 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "sinsp_public.h"
+
+/** @defgroup event Event manipulation
+ *  @{
+ */
+
+/*!
+  \brief How the value of a field is stored once extracted. The fields
+  of the types that don't have a kind of their own are rendered as
+  strings.
+*/
+enum sinsp_field_kind
+{
+	FK_INT64 = 0,   ///< Signed integers, file descriptors, pids and errors.
+	FK_UINT64 = 1,  ///< Unsigned integers, flags, ports, uids and times.
+	FK_DOUBLE = 2,
+	FK_BOOL = 3,
+	FK_IP = 4,      ///< A 4 or 16 bytes address, in network byte order.
+	FK_STRING = 5,  ///< Null terminated.
+	FK_BYTES = 6,
+};
+
+/*!
+  \brief A typed value of a field, as extracted by
+  sinsp_filter_check::extract_typed(). It points to memory of the
+  filtercheck, valid until its next extraction.
+*/
+struct sinsp_field_value
+{
+	sinsp_field_kind m_kind;
+	union
+	{
+		int64_t m_int64;
+		uint64_t m_uint64;
+		double m_double;
+		bool m_bool;
+	};
+	const char* m_data;     ///< Value of FK_IP, FK_STRING and FK_BYTES.
+	uint32_t m_len;         ///< Length of m_data, without the terminator of the strings.
+	const uint8_t* m_raw;   ///< The value as extracted, before any conversion.
+	uint32_t m_raw_len;
+};
+
+/*!
+  \brief The values of a field for many events, one row per event.
+
+  The numbers are stored in an array, the other values one after the
+  other in a single buffer. Clearing the column keeps its memory, so
+  that once it's big enough for a batch of events filling it again
+  doesn't allocate.
+*/
+class SINSP_PUBLIC sinsp_field_column
+{
+public:
+	sinsp_field_column(const std::string& name, sinsp_field_kind kind);
+
+	const std::string& get_name() const
+	{
+		return m_name;
+	}
+
+	sinsp_field_kind get_kind() const
+	{
+		return m_kind;
+	}
+
+	size_t size() const
+	{
+		return m_nulls.size();
+	}
+
+	/*!
+	  \brief Appends a row with the given value, that must have the kind
+	  of the column.
+	  \note Throws a sinsp_exception if the kind is not the one of the column
+	*/
+	void append(const sinsp_field_value& value);
+
+	/*!
+	  \brief Appends a row without value.
+	*/
+	void append_null();
+
+	/*!
+	  \brief Removes all the rows.
+	*/
+	void clear();
+
+	bool is_null(size_t row) const
+	{
+		return m_nulls[row] != 0;
+	}
+
+	int64_t get_int64(size_t row) const
+	{
+		return (int64_t)m_nums[row];
+	}
+
+	uint64_t get_uint64(size_t row) const
+	{
+		return m_nums[row];
+	}
+
+	double get_double(size_t row) const;
+
+	bool get_bool(size_t row) const
+	{
+		return m_nums[row] != 0;
+	}
+
+	/*!
+	  \brief Returns the value of a row of a FK_IP, FK_STRING or FK_BYTES
+	  column. The strings are null terminated.
+	*/
+	const char* get_data(size_t row, uint32_t* len) const
+	{
+		uint32_t start = m_offsets[row];
+		*len = m_offsets[row + 1] - start - 1;
+		return &m_data[start];
+	}
+
+private:
+	bool has_data() const
+	{
+		return m_kind == FK_IP || m_kind == FK_STRING || m_kind == FK_BYTES;
+	}
+
+	std::string m_name;
+	sinsp_field_kind m_kind;
+	std::vector<uint8_t> m_nulls;
+	std::vector<uint64_t> m_nums;
+	// Where each value starts in m_data, followed by the end of the last one
+	std::vector<uint32_t> m_offsets;
+	std::vector<char> m_data;
+};
+
+/*!
+  \brief A set of columns filled together, a row for each event.
+*/
+class SINSP_PUBLIC sinsp_field_buffer
+{
+public:
+	/*!
+	  \brief Adds a column and returns its index.
+	*/
+	uint32_t add_column(const std::string& name, sinsp_field_kind kind);
+
+	size_t num_columns() const
+	{
+		return m_columns.size();
+	}
+
+	size_t num_rows() const
+	{
+		return m_columns.empty() ? 0 : m_columns[0].size();
+	}
+
+	sinsp_field_column& get_column(uint32_t j)
+	{
+		return m_columns[j];
+	}
+
+	const sinsp_field_column& get_column(uint32_t j) const
+	{
+		return m_columns[j];
+	}
+
+	/*!
+	  \brief Removes all the rows, keeping the columns and their memory.
+	*/
+	void clear();
+
+private:
+	std::vector<sinsp_field_column> m_columns;
+};
+
+/*@}*/
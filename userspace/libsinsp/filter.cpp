@@ -1082,7 +1082,7 @@ char* sinsp_filter_check::rawval_to_string(uint8_t* rawval,
 
 char* sinsp_filter_check::tostring(sinsp_evt* evt)
 {
-	vector<extract_value_t> raw_values;
+	vector<extract_value_t>& raw_values = m_extracted_values;
 	if(!extract_cached(evt, raw_values))
 	{
 		return NULL;
@@ -1133,6 +1133,325 @@ Json::Value sinsp_filter_check::tojson(sinsp_evt* evt)
 	return jsonval;
 }
 
+//
+// The numbers are read with the size of their type, from memory that
+// may be unaligned
+//
+template<typename T>
+static inline T load_typed(const uint8_t* p)
+{
+	T res;
+	memcpy(&res, p, sizeof(res));
+	return res;
+}
+
+static inline uint64_t load_typed_uint(const uint8_t* p, ppm_param_type type)
+{
+	switch(type)
+	{
+	case PT_INT8:
+	case PT_UINT8:
+	case PT_FLAGS8:
+	case PT_ENUMFLAGS8:
+	case PT_SIGTYPE:
+	case PT_L4PROTO:
+	case PT_SOCKFAMILY:
+		return *p;
+	case PT_INT16:
+	case PT_UINT16:
+	case PT_FLAGS16:
+	case PT_ENUMFLAGS16:
+	case PT_PORT:
+	case PT_SYSCALLID:
+		return load_typed<uint16_t>(p);
+	case PT_INT32:
+	case PT_UINT32:
+	case PT_FLAGS32:
+	case PT_ENUMFLAGS32:
+	case PT_UID:
+	case PT_GID:
+	case PT_MODE:
+	case PT_SIGSET:
+	case PT_BOOL:
+		return load_typed<uint32_t>(p);
+	default:
+		return load_typed<uint64_t>(p);
+	}
+}
+
+static inline int64_t load_typed_int(const uint8_t* p, ppm_param_type type)
+{
+	switch(type)
+	{
+	case PT_INT8:
+		return *(const int8_t*)p;
+	case PT_INT16:
+		return load_typed<int16_t>(p);
+	case PT_INT32:
+		return load_typed<int32_t>(p);
+	default:
+		return load_typed<int64_t>(p);
+	}
+}
+
+static inline void append_uint(std::string& out, uint64_t val)
+{
+	char buf[20];
+	char* p = buf + sizeof(buf);
+
+	do
+	{
+		*--p = '0' + val % 10;
+		val /= 10;
+	}
+	while(val != 0);
+	out.append(p, buf + sizeof(buf) - p);
+}
+
+static inline void append_int(std::string& out, int64_t val)
+{
+	if(val < 0)
+	{
+		out += '-';
+		append_uint(out, -(uint64_t)val);
+	}
+	else
+	{
+		append_uint(out, val);
+	}
+}
+
+static inline void append_ipv4(std::string& out, const uint8_t* addr)
+{
+	for(uint32_t j = 0; j < 4; j++)
+	{
+		if(j != 0)
+		{
+			out += '.';
+		}
+		append_uint(out, addr[j]);
+	}
+}
+
+bool sinsp_filter_check::append_string(sinsp_evt* evt, std::string& out)
+{
+	if(m_field->m_flags & EPF_IS_LIST)
+	{
+		char* str = tostring(evt);
+		if(str == NULL)
+		{
+			return false;
+		}
+		out += str;
+		return true;
+	}
+
+	if(!extract_cached(evt, m_extracted_values) || m_extracted_values.empty())
+	{
+		return false;
+	}
+
+	uint8_t* rawval = m_extracted_values[0].ptr;
+	uint32_t len = m_extracted_values[0].len;
+	ppm_param_type type = m_field->m_type;
+	ppm_print_format print_format = m_field->m_print_format;
+	bool dec = print_format == PF_DEC || print_format == PF_ID;
+
+	//
+	// The cases printed in decimal by rawval_to_string(), the others
+	// are left to it
+	//
+	switch(type)
+	{
+	case PT_INT8:
+	case PT_INT16:
+	case PT_INT32:
+		if(dec)
+		{
+			append_int(out, load_typed_int(rawval, type));
+			return true;
+		}
+		break;
+	case PT_INT64:
+	case PT_PID:
+	case PT_ERRNO:
+	case PT_FD:
+		if(print_format != PF_OCT && print_format != PF_10_PADDED_DEC && print_format != PF_HEX)
+		{
+			append_int(out, load_typed<int64_t>(rawval));
+			return true;
+		}
+		break;
+	case PT_L4PROTO:
+	case PT_UINT8:
+	case PT_PORT:
+	case PT_UINT16:
+	case PT_UINT32:
+		if(dec || print_format == PF_HEX)
+		{
+			append_uint(out, load_typed_uint(rawval, type));
+			return true;
+		}
+		break;
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		if(dec)
+		{
+			append_uint(out, load_typed<uint64_t>(rawval));
+			return true;
+		}
+		break;
+	case PT_CHARBUF:
+	case PT_FSPATH:
+	case PT_FSRELPATH:
+		out += (const char*)rawval;
+		return true;
+	case PT_BOOL:
+		out += load_typed<uint32_t>(rawval) != 0 ? "true" : "false";
+		return true;
+	case PT_IPV4ADDR:
+		append_ipv4(out, rawval);
+		return true;
+	case PT_IPADDR:
+		if(len == sizeof(struct in_addr))
+		{
+			append_ipv4(out, rawval);
+			return true;
+		}
+		break;
+	default:
+		break;
+	}
+
+	char* str = rawval_to_string(rawval, type, print_format, len);
+	if(str == NULL)
+	{
+		return false;
+	}
+	out += str;
+	return true;
+}
+
+sinsp_field_kind sinsp_filter_check::get_field_kind()
+{
+	if(m_field->m_flags & EPF_IS_LIST)
+	{
+		return FK_STRING;
+	}
+
+	switch(m_field->m_type)
+	{
+	case PT_INT8:
+	case PT_INT16:
+	case PT_INT32:
+	case PT_INT64:
+	case PT_ERRNO:
+	case PT_FD:
+	case PT_PID:
+		return FK_INT64;
+	case PT_UINT8:
+	case PT_UINT16:
+	case PT_UINT32:
+	case PT_UINT64:
+	case PT_FLAGS8:
+	case PT_FLAGS16:
+	case PT_FLAGS32:
+	case PT_ENUMFLAGS8:
+	case PT_ENUMFLAGS16:
+	case PT_ENUMFLAGS32:
+	case PT_UID:
+	case PT_GID:
+	case PT_MODE:
+	case PT_PORT:
+	case PT_SYSCALLID:
+	case PT_SIGTYPE:
+	case PT_SIGSET:
+	case PT_L4PROTO:
+	case PT_SOCKFAMILY:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		return FK_UINT64;
+	case PT_DOUBLE:
+		return FK_DOUBLE;
+	case PT_BOOL:
+		return FK_BOOL;
+	case PT_IPV4ADDR:
+	case PT_IPV6ADDR:
+	case PT_IPADDR:
+		return FK_IP;
+	case PT_BYTEBUF:
+		return FK_BYTES;
+	default:
+		return FK_STRING;
+	}
+}
+
+bool sinsp_filter_check::extract_typed(sinsp_evt* evt, OUT sinsp_field_value& value, bool sanitize_strings)
+{
+	if(!extract_cached(evt, m_extracted_values, sanitize_strings) || m_extracted_values.empty())
+	{
+		return false;
+	}
+
+	uint8_t* rawval = m_extracted_values[0].ptr;
+	uint32_t len = m_extracted_values[0].len;
+	ppm_param_type type = m_field->m_type;
+
+	value.m_kind = get_field_kind();
+	value.m_uint64 = 0;
+	value.m_data = NULL;
+	value.m_len = 0;
+	value.m_raw = rawval;
+	value.m_raw_len = len;
+
+	switch(value.m_kind)
+	{
+	case FK_INT64:
+		value.m_int64 = load_typed_int(rawval, type);
+		break;
+	case FK_UINT64:
+		value.m_uint64 = load_typed_uint(rawval, type);
+		break;
+	case FK_BOOL:
+		value.m_bool = load_typed_uint(rawval, type) != 0;
+		break;
+	case FK_DOUBLE:
+		value.m_double = load_typed<double>(rawval);
+		break;
+	case FK_IP:
+		value.m_data = (const char*)rawval;
+		value.m_len = type == PT_IPV4ADDR ? 4 : (type == PT_IPV6ADDR ? 16 : len);
+		break;
+	case FK_BYTES:
+		value.m_data = (const char*)rawval;
+		value.m_len = len;
+		break;
+	default:
+		if(m_field->m_flags & EPF_IS_LIST)
+		{
+			value.m_data = tostring(evt);
+		}
+		else if(type == PT_CHARBUF || type == PT_FSPATH || type == PT_FSRELPATH)
+		{
+			value.m_data = (const char*)rawval;
+		}
+		else
+		{
+			value.m_data = rawval_to_string(rawval, type, m_field->m_print_format, len);
+		}
+
+		if(value.m_data == NULL)
+		{
+			return false;
+		}
+		value.m_len = strlen(value.m_data);
+		break;
+	}
+
+	return true;
+}
+
 int32_t sinsp_filter_check::parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering)
 {
 	int32_t j;
@@ -1205,6 +1524,14 @@ void sinsp_filter_check::add_filter_value(const char* str, uint32_t len, uint32_
 	{
 		m_val_storages_paths.add_search_path(item);
 	}
+
+	// If the operator is CO_GLOB, also compile the pattern, it's not
+	// interpreted again at every comparison.
+	if (m_cmpop == CO_GLOB &&
+	    (m_field->m_type == PT_CHARBUF || m_field->m_type == PT_FSPATH || m_field->m_type == PT_FSRELPATH))
+	{
+		m_val_storages_globs.add((const char*)filter_value_p(i));
+	}
 }
 
 size_t sinsp_filter_check::parse_filter_value(const char* str, uint32_t len, uint8_t *storage, uint32_t storage_len)
@@ -1375,6 +1702,11 @@ bool sinsp_filter_check::flt_compare(cmpop op, ppm_param_type type, void* operan
 			break;
 		}
 	}
+	else if (op == CO_GLOB && m_val_storages_globs.size() > 0 &&
+		 (type == PT_CHARBUF || type == PT_FSPATH || type == PT_FSRELPATH))
+	{
+		return m_val_storages_globs.match((const char*)operand1);
+	}
 	else
 	{
 		return (::flt_compare(op,
@@ -1634,11 +1966,8 @@ void sinsp_filter_compiler::visit(libsinsp::filter::ast::unary_check_expr* e)
 	string field = create_filtercheck_name(e->field, e->arg);
 	gen_event_filter_check *check = create_filtercheck(field);
 	m_filter->add_check(check);
-	check_ttable_only(field, check);
-	check->m_cmpop = str_to_cmpop(e->op);
 	check->m_boolop = m_last_boolop;
-	check->parse_field_name(field.c_str(), true, true);
-	check->set_check_id(m_check_id);
+	init_filtercheck(field, e->op, check);
 }
 
 static void add_filtercheck_value(gen_event_filter_check *chk, size_t idx, const std::string& value)
@@ -1665,19 +1994,28 @@ void sinsp_filter_compiler::visit(libsinsp::filter::ast::binary_check_expr* e)
 	string field = create_filtercheck_name(e->field, e->arg);
 	gen_event_filter_check *check = create_filtercheck(field);
 	m_filter->add_check(check);
-	check_ttable_only(field, check);
-	check->m_cmpop = str_to_cmpop(e->op);
 	check->m_boolop = m_last_boolop;
+	init_filtercheck(field, e->op, check);
+	add_filtercheck_values(e->value, check);
+}
+
+void sinsp_filter_compiler::init_filtercheck(string& field, string& op, gen_event_filter_check *check)
+{
+	check_ttable_only(field, check);
+	check->m_cmpop = str_to_cmpop(op);
 	check->parse_field_name(field.c_str(), true, true);
 	check->set_check_id(m_check_id);
+}
 
+void sinsp_filter_compiler::add_filtercheck_values(libsinsp::filter::ast::expr* value, gen_event_filter_check *check)
+{
 	// Read the the the right-hand values of the filtercheck. 
 	// For list-related operators ('in', 'intersects', 'pmatch'), the vector
 	// can be filled with more than 1 value, whereas in all other cases we
 	// expect the vector to only have 1 value. We don't check this here, as
 	// the parser is trusted to apply proper grammar checks on this constraint.
 	m_expect_values = true;
-	e->value->accept(this);
+	value->accept(this);
 	m_expect_values = false;
 	for (size_t i = 0; i < m_field_values.size(); i++)
 	{
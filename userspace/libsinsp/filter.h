@@ -121,6 +121,8 @@ private:
 	cmpop str_to_cmpop(std::string& str);
 	std::string create_filtercheck_name(std::string& name, std::string& arg);
 	gen_event_filter_check* create_filtercheck(std::string& field);
+	void init_filtercheck(std::string& field, std::string& op, gen_event_filter_check *check);
+	void add_filtercheck_values(libsinsp::filter::ast::expr* value, gen_event_filter_check *check);
 
 	int32_t m_check_id;
 	bool m_ttable_only;
@@ -134,6 +136,7 @@ private:
 	std::shared_ptr<gen_event_filter_factory> m_factory;
 
 	friend class sinsp_evt_formatter;
+	friend class sinsp_filter_program_compiler;
 };
 
 /*@}*/
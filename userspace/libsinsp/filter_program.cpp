@@ -0,0 +1,856 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <cstring>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "filter_program.h"
+#include "filter/parser.h"
+
+using namespace libsinsp::filter;
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_cache implementation
+///////////////////////////////////////////////////////////////////////////////
+check_extraction_cache_entry* sinsp_filter_cache::get_extraction_entry(const std::string& field)
+{
+	auto& entry = m_extraction_entries[field];
+	if(entry == nullptr)
+	{
+		entry.reset(new check_extraction_cache_entry());
+	}
+	return entry.get();
+}
+
+check_eval_cache_entry* sinsp_filter_cache::get_eval_entry(const std::string& check)
+{
+	auto& entry = m_eval_entries[check];
+	if(entry == nullptr)
+	{
+		entry.reset(new check_eval_cache_entry());
+	}
+	return entry.get();
+}
+
+void sinsp_filter_cache::invalidate()
+{
+	for(auto& it : m_extraction_entries)
+	{
+		it.second->m_evtnum = UINT64_MAX;
+	}
+	for(auto& it : m_eval_entries)
+	{
+		it.second->m_evtnum = UINT64_MAX;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_program implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_filter_program::sinsp_filter_program():
+	m_check_id(0)
+{
+}
+
+sinsp_filter_program::~sinsp_filter_program()
+{
+	//
+	// The values extracted by our checks can't be used by the other
+	// programs sharing the cache anymore
+	//
+	for(auto entry : m_cache_entries)
+	{
+		entry->m_evtnum = UINT64_MAX;
+	}
+
+	for(auto chk : m_checks)
+	{
+		delete chk;
+	}
+}
+
+static inline uint64_t load_uint(const uint8_t* p, uint8_t size)
+{
+	switch(size)
+	{
+	case 1:
+		return *p;
+	case 2:
+		return *(const uint16_t*)p;
+	case 4:
+		return *(const uint32_t*)p;
+	default:
+		return *(const uint64_t*)p;
+	}
+}
+
+static inline int64_t load_int(const uint8_t* p, uint8_t size)
+{
+	switch(size)
+	{
+	case 1:
+		return *(const int8_t*)p;
+	case 2:
+		return *(const int16_t*)p;
+	case 4:
+		return *(const int32_t*)p;
+	default:
+		return *(const int64_t*)p;
+	}
+}
+
+template<typename T>
+static inline bool compare_num(cmpop op, T v1, T v2)
+{
+	switch(op)
+	{
+	case CO_EQ:
+		return v1 == v2;
+	case CO_NE:
+		return v1 != v2;
+	case CO_LT:
+		return v1 < v2;
+	case CO_LE:
+		return v1 <= v2;
+	case CO_GT:
+		return v1 > v2;
+	default:
+		return v1 >= v2;
+	}
+}
+
+//
+// Same as sinsp_filter_check::extract_cached(), without copying the
+// cached values
+//
+inline std::vector<extract_value_t>* sinsp_filter_program::extract(const instruction& ins, sinsp_evt* evt)
+{
+	check_extraction_cache_entry* entry = ins.m_sinsp_check->m_extraction_cache_entry;
+	if(entry == NULL)
+	{
+		if(!ins.m_sinsp_check->extract(evt, m_values, false))
+		{
+			return NULL;
+		}
+		return &m_values;
+	}
+
+	uint64_t en = evt->get_num();
+	if(en != entry->m_evtnum)
+	{
+		entry->m_evtnum = en;
+		ins.m_sinsp_check->extract(evt, entry->m_res, false);
+	}
+	return entry->m_res.empty() ? NULL : &entry->m_res;
+}
+
+inline bool sinsp_filter_program::exec(const instruction& ins, gen_event* evt)
+{
+	if(ins.m_op == OP_COMPARE)
+	{
+		return ins.m_check->compare(evt);
+	}
+
+	std::vector<extract_value_t>* values = extract(ins, (sinsp_evt*)evt);
+	if(values == NULL)
+	{
+		return false;
+	}
+
+	sinsp_filter_check* chk = ins.m_sinsp_check;
+	if(ins.m_op == OP_EXTRACT_COMPARE || (values->size() != 1 && ins.m_op != OP_STR_MULTI && ins.m_op != OP_GLOB))
+	{
+		// this also reports the errors of the unexpected values
+		return chk->flt_compare(chk->m_cmpop,
+			chk->m_info.m_fields[chk->m_field_id].m_type,
+			*values,
+			chk->m_val_storage_len);
+	}
+
+	// the fields of the merged checks are never lists
+	if(ins.m_op == OP_STR_MULTI)
+	{
+		return ins.m_matcher->match((const char*)(*values)[0].ptr);
+	}
+	if(ins.m_op == OP_GLOB)
+	{
+		return ins.m_glob->match((const char*)(*values)[0].ptr);
+	}
+
+	const uint8_t* val = (*values)[0].ptr;
+	switch(ins.m_op)
+	{
+	case OP_EXISTS:
+		return true;
+	case OP_INT:
+		return compare_num<int64_t>(ins.m_cmpop, load_int(val, ins.m_size), (int64_t)ins.m_val);
+	case OP_UINT:
+		return compare_num<uint64_t>(ins.m_cmpop, load_uint(val, ins.m_size), ins.m_val);
+	case OP_STR_EQ:
+		return strcmp((const char*)val, ins.m_str) == 0;
+	case OP_STR_NE:
+		return strcmp((const char*)val, ins.m_str) != 0;
+	case OP_STR_CONTAINS:
+		return strstr((const char*)val, ins.m_str) != NULL;
+	case OP_STR_STARTSWITH:
+		return strncmp((const char*)val, ins.m_str, ins.m_str_len) == 0;
+	case OP_STR_ENDSWITH:
+		return sinsp_utils::endswith((const char*)val, ins.m_str, strlen((const char*)val), ins.m_str_len);
+	default:
+		ASSERT(false);
+		throw sinsp_exception("invalid filter program instruction " + std::to_string((long long) ins.m_op));
+	}
+}
+
+inline bool sinsp_filter_program::exec_cached(const instruction& ins, gen_event* evt)
+{
+	if(ins.m_eval == NULL)
+	{
+		return exec(ins, evt);
+	}
+
+	uint64_t en = ((sinsp_evt*)evt)->get_num();
+	if(en != ins.m_eval->m_evtnum)
+	{
+		ins.m_eval->m_res = exec(ins, evt);
+		ins.m_eval->m_evtnum = en;
+	}
+	return ins.m_eval->m_res;
+}
+
+bool sinsp_filter_program::run(gen_event *evt)
+{
+	const instruction* code = m_code.data();
+	uint32_t ninstructions = m_code.size();
+	uint32_t pc = 0;
+	bool res = false;
+
+	while(pc < ninstructions)
+	{
+		const instruction& ins = code[pc];
+
+		if(ins.m_op == OP_NOT)
+		{
+			res = !res;
+		}
+		else
+		{
+			res = exec_cached(ins, evt) != ins.m_negate;
+		}
+
+		if((ins.m_jump == JMP_IF_TRUE && res) ||
+		   (ins.m_jump == JMP_IF_FALSE && !res))
+		{
+			pc = ins.m_target;
+		}
+		else
+		{
+			pc++;
+		}
+	}
+
+	if(res)
+	{
+		evt->set_check_id(m_check_id);
+	}
+
+	return res;
+}
+
+std::string sinsp_filter_program::to_string() const
+{
+	static const char* opnames[] = {"compare", "extract_compare", "exists", "int", "uint",
+		"str_eq", "str_ne", "str_contains", "str_startswith", "str_endswith", "not", "str_multi", "glob"};
+	std::string res;
+
+	for(uint32_t j = 0; j < m_code.size(); j++)
+	{
+		const instruction& ins = m_code[j];
+
+		res += std::to_string(j) + ": ";
+		if(ins.m_negate)
+		{
+			res += "!";
+		}
+		res += opnames[ins.m_op];
+		if(ins.m_sinsp_check != NULL)
+		{
+			res += std::string(" ") + ins.m_sinsp_check->get_field_info()->m_name;
+		}
+		if(ins.m_jump != JMP_NONE)
+		{
+			res += (ins.m_jump == JMP_IF_TRUE ? " jt " : " jf ") + std::to_string(ins.m_target);
+		}
+		res += "\n";
+	}
+	return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_program_compiler implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_filter_program_compiler::sinsp_filter_program_compiler(
+		std::shared_ptr<gen_event_filter_factory> factory,
+		const std::string& fltstr,
+		sinsp_filter_cache* cache):
+	m_checks_compiler(factory, (ast::expr*)NULL),
+	m_flt_ast(NULL),
+	m_flt_str(fltstr),
+	m_cache(cache),
+	m_program(NULL)
+{
+}
+
+sinsp_filter_program_compiler::sinsp_filter_program_compiler(
+		std::shared_ptr<gen_event_filter_factory> factory,
+		ast::expr* fltast,
+		sinsp_filter_cache* cache):
+	m_checks_compiler(factory, (ast::expr*)NULL),
+	m_flt_ast(fltast),
+	m_cache(cache),
+	m_program(NULL)
+{
+}
+
+void sinsp_filter_program_compiler::set_check_id(int32_t id)
+{
+	m_checks_compiler.set_check_id(id);
+}
+
+sinsp_filter_program* sinsp_filter_program_compiler::compile()
+{
+	if(m_flt_ast == NULL)
+	{
+		parser parser(m_flt_str);
+		try
+		{
+			m_parsed_ast.reset(parser.parse());
+		}
+		catch (const sinsp_exception& e)
+		{
+			throw sinsp_exception("filter error at "
+				+ parser.get_pos().as_string() + ": " + e.what());
+		}
+		m_flt_ast = m_parsed_ast.get();
+	}
+
+	std::unique_ptr<sinsp_filter_program> program(new sinsp_filter_program());
+	program->m_check_id = m_checks_compiler.m_check_id;
+	m_program = program.get();
+	try
+	{
+		m_flt_ast->accept(this);
+	}
+	catch (const sinsp_exception& e)
+	{
+		m_program = NULL;
+		throw;
+	}
+	thread_jumps();
+	m_program = NULL;
+	return program.release();
+}
+
+void sinsp_filter_program_compiler::visit(ast::and_expr* e)
+{
+	visit_boolop(e->children, true);
+}
+
+void sinsp_filter_program_compiler::visit(ast::or_expr* e)
+{
+	visit_boolop(e->children, false);
+}
+
+//
+// Every child but the last one jumps past the expression as soon as its
+// result decides the one of the expression. The last instruction of an
+// expression never jumps before its parent patches it, so it's always
+// the one to patch.
+//
+void sinsp_filter_program_compiler::visit_boolop(std::vector<ast::expr*>& children, bool is_and)
+{
+	std::vector<uint32_t> patches;
+	auto& code = m_program->m_code;
+
+	//
+	// The pattern checks of the same field are merged in one instruction,
+	// that takes the place of the first of them
+	//
+	std::vector<ast::binary_check_expr*> pattern_checks(children.size(), NULL);
+	std::vector<std::vector<size_t>> groups;
+	std::vector<size_t> group_of(children.size(), SIZE_MAX);
+	std::unordered_map<std::string, size_t> group_by_field;
+	for(size_t j = 0; j < children.size(); j++)
+	{
+		ast::binary_check_expr* c = string_pattern_check(children[j], is_and);
+		if(c != NULL)
+		{
+			// the globs are merged apart from the other patterns
+			std::string field = m_checks_compiler.create_filtercheck_name(c->field, c->arg);
+			if(c->op == "glob")
+			{
+				field += " glob";
+			}
+			auto it = group_by_field.insert({field, groups.size()}).first;
+			if(it->second == groups.size())
+			{
+				groups.emplace_back();
+			}
+			groups[it->second].push_back(j);
+			group_of[j] = it->second;
+			pattern_checks[j] = c;
+		}
+	}
+
+	std::vector<bool> done(children.size(), false);
+	for(size_t j = 0; j < children.size(); j++)
+	{
+		if(done[j])
+		{
+			continue;
+		}
+
+		if(group_of[j] != SIZE_MAX && groups[group_of[j]].size() > 1)
+		{
+			auto& group = groups[group_of[j]];
+			std::vector<ast::binary_check_expr*> checks;
+			for(auto k : group)
+			{
+				checks.push_back(pattern_checks[k]);
+			}
+
+			if(add_multi_check(checks, is_and))
+			{
+				for(auto k : group)
+				{
+					done[k] = true;
+				}
+				patches.push_back(code.size() - 1);
+				continue;
+			}
+
+			// the other checks of the group are compiled one by one too
+			group.clear();
+		}
+
+		children[j]->accept(this);
+		patches.push_back(code.size() - 1);
+	}
+
+	// the last child is patched by the parent
+	if(!patches.empty())
+	{
+		patches.pop_back();
+	}
+
+	for(auto p : patches)
+	{
+		code[p].m_jump = is_and ? sinsp_filter_program::JMP_IF_FALSE : sinsp_filter_program::JMP_IF_TRUE;
+		code[p].m_target = code.size();
+	}
+}
+
+//
+// Returns the check of a child of and/or that can be merged with its
+// siblings: a string pattern check for or, a negated one for and
+//
+ast::binary_check_expr* sinsp_filter_program_compiler::string_pattern_check(ast::expr* e, bool is_and)
+{
+	if(is_and)
+	{
+		auto n = dynamic_cast<ast::not_expr*>(e);
+		if(n == NULL)
+		{
+			return NULL;
+		}
+		e = n->child;
+	}
+
+	auto c = dynamic_cast<ast::binary_check_expr*>(e);
+	if(c == NULL || dynamic_cast<ast::value_expr*>(c->value) == NULL)
+	{
+		return NULL;
+	}
+
+	if(c->op == "contains" || c->op == "icontains" ||
+	   c->op == "startswith" || c->op == "endswith" || c->op == "glob")
+	{
+		return c;
+	}
+	return NULL;
+}
+
+//
+// Adds one instruction for all the given checks of the same field, either
+// all globs or all other patterns, or nothing if the field is not a plain
+// string
+//
+bool sinsp_filter_program_compiler::add_multi_check(std::vector<ast::binary_check_expr*>& checks, bool is_and)
+{
+	std::unique_ptr<multi_string_matcher> matcher(new multi_string_matcher());
+	std::unique_ptr<glob_matcher> glob(new glob_matcher());
+	sinsp_filter_check* first = NULL;
+	std::string field;
+	std::string key = "any(";
+
+	for(auto c : checks)
+	{
+		field = m_checks_compiler.create_filtercheck_name(c->field, c->arg);
+		gen_event_filter_check* check = m_checks_compiler.create_filtercheck(field);
+		m_program->m_checks.push_back(check);
+		m_checks_compiler.init_filtercheck(field, c->op, check);
+		m_checks_compiler.add_filtercheck_values(c->value, check);
+
+		sinsp_filter_check* chk = dynamic_cast<sinsp_filter_check*>(check);
+		if(chk == NULL || !chk->compares_extracted_value() || chk->m_val_storages.empty())
+		{
+			return false;
+		}
+
+		const filtercheck_field_info* finfo = &chk->m_info.m_fields[chk->m_field_id];
+		if((finfo->m_flags & EPF_IS_LIST) ||
+		   (finfo->m_type != PT_CHARBUF && finfo->m_type != PT_FSPATH && finfo->m_type != PT_FSRELPATH))
+		{
+			return false;
+		}
+
+		const char* pattern = (const char*)chk->filter_value_p();
+		switch(chk->m_cmpop)
+		{
+		case CO_GLOB:
+			glob->add(pattern);
+			break;
+		case CO_CONTAINS:
+			matcher->add(pattern, multi_string_matcher::CONTAINS);
+			break;
+		case CO_ICONTAINS:
+			matcher->add(pattern, multi_string_matcher::ICONTAINS);
+			break;
+		case CO_STARTSWITH:
+			matcher->add(pattern, multi_string_matcher::STARTSWITH);
+			break;
+		case CO_ENDSWITH:
+			matcher->add(pattern, multi_string_matcher::ENDSWITH);
+			break;
+		default:
+			return false;
+		}
+
+		key += check_key(field, c->op, c->value) + ",";
+		if(first == NULL)
+		{
+			first = chk;
+		}
+	}
+	matcher->compile();
+
+	sinsp_filter_cache* cache = m_cache != NULL ? m_cache : &m_program->m_local_cache;
+	first->m_extraction_cache_entry = cache->get_extraction_entry(field);
+	m_program->m_cache_entries.push_back(first->m_extraction_cache_entry);
+
+	sinsp_filter_program::instruction ins = {};
+	ins.m_cmpop = first->m_cmpop;
+	ins.m_negate = is_and;
+	ins.m_check = first;
+	ins.m_sinsp_check = first;
+	if(m_cache != NULL)
+	{
+		ins.m_eval = m_cache->get_eval_entry(key + ")");
+	}
+
+	if(glob->size() > 0)
+	{
+		ins.m_op = sinsp_filter_program::OP_GLOB;
+		ins.m_glob = glob.get();
+		m_program->m_globs.push_back(std::move(glob));
+	}
+	else
+	{
+		ins.m_op = sinsp_filter_program::OP_STR_MULTI;
+		ins.m_matcher = matcher.get();
+		m_program->m_matchers.push_back(std::move(matcher));
+	}
+	m_program->m_code.push_back(ins);
+	return true;
+}
+
+void sinsp_filter_program_compiler::visit(ast::not_expr* e)
+{
+	auto& code = m_program->m_code;
+	size_t start = code.size();
+
+	e->child->accept(this);
+
+	// a single check is negated in place
+	if(code.size() == start + 1 && code.back().m_op != sinsp_filter_program::OP_NOT)
+	{
+		code.back().m_negate = !code.back().m_negate;
+		return;
+	}
+
+	sinsp_filter_program::instruction ins = {};
+	ins.m_op = sinsp_filter_program::OP_NOT;
+	code.push_back(ins);
+}
+
+void sinsp_filter_program_compiler::visit(ast::value_expr* e)
+{
+	// values are read by m_checks_compiler, this happens only for
+	// identifiers used as checks, such as unresolved macros
+	throw sinsp_exception("filter error: unexpected identifier '" + e->value + "'");
+}
+
+void sinsp_filter_program_compiler::visit(ast::list_expr* e)
+{
+	ASSERT(false);
+	throw sinsp_exception("filter error: unexpected value list");
+}
+
+void sinsp_filter_program_compiler::visit(ast::unary_check_expr* e)
+{
+	add_check(e->field, e->arg, e->op, NULL);
+}
+
+void sinsp_filter_program_compiler::visit(ast::binary_check_expr* e)
+{
+	add_check(e->field, e->arg, e->op, e->value);
+}
+
+void sinsp_filter_program_compiler::add_check(std::string& name, std::string& arg, std::string& op, ast::expr* value)
+{
+	std::string field = m_checks_compiler.create_filtercheck_name(name, arg);
+	gen_event_filter_check* check = m_checks_compiler.create_filtercheck(field);
+	m_program->m_checks.push_back(check);
+	m_checks_compiler.init_filtercheck(field, op, check);
+	if(value != NULL)
+	{
+		m_checks_compiler.add_filtercheck_values(value, check);
+	}
+
+	sinsp_filter_program::instruction ins = {};
+	ins.m_op = sinsp_filter_program::OP_COMPARE;
+	ins.m_cmpop = check->m_cmpop;
+	ins.m_check = check;
+
+	//
+	// The checks extracting their values the usual way share them with the
+	// other checks of the same field
+	//
+	sinsp_filter_check* sinsp_check = dynamic_cast<sinsp_filter_check*>(check);
+	if(sinsp_check != NULL && sinsp_check->compares_extracted_value())
+	{
+		sinsp_filter_cache* cache = m_cache != NULL ? m_cache : &m_program->m_local_cache;
+
+		sinsp_check->m_extraction_cache_entry = cache->get_extraction_entry(field);
+		m_program->m_cache_entries.push_back(sinsp_check->m_extraction_cache_entry);
+		ins.m_op = sinsp_filter_program::OP_EXTRACT_COMPARE;
+		ins.m_sinsp_check = sinsp_check;
+		specialize(ins);
+	}
+
+	//
+	// The same check in other programs is evaluated once per event
+	//
+	if(sinsp_check != NULL && m_cache != NULL)
+	{
+		ins.m_eval = m_cache->get_eval_entry(check_key(field, op, value));
+	}
+
+	m_program->m_code.push_back(ins);
+}
+
+std::string sinsp_filter_program_compiler::check_key(const std::string& field, const std::string& op, ast::expr* value)
+{
+	std::string key = field + " " + op;
+	std::vector<std::string> values;
+
+	auto v = dynamic_cast<ast::value_expr*>(value);
+	auto l = dynamic_cast<ast::list_expr*>(value);
+	if(v != NULL)
+	{
+		values.push_back(v->value);
+	}
+	else if(l != NULL)
+	{
+		values = l->values;
+	}
+
+	// the lengths keep apart values containing the separators
+	for(auto& val : values)
+	{
+		key += " " + std::to_string(val.size()) + ":" + val;
+	}
+	return key;
+}
+
+//
+// Picks the instruction doing the comparison of ::flt_compare() for the
+// type of the field and the operator, if there's one
+//
+void sinsp_filter_program_compiler::specialize(sinsp_filter_program::instruction& ins)
+{
+	sinsp_filter_check* chk = ins.m_sinsp_check;
+	const filtercheck_field_info* finfo = &chk->m_info.m_fields[chk->m_field_id];
+
+	if(finfo->m_flags & EPF_IS_LIST)
+	{
+		return;
+	}
+
+	if(ins.m_cmpop == CO_EXISTS)
+	{
+		ins.m_op = sinsp_filter_program::OP_EXISTS;
+		return;
+	}
+
+	if(chk->m_val_storages.empty())
+	{
+		return;
+	}
+
+	const uint8_t* val = chk->filter_value_p();
+	bool is_num = ins.m_cmpop == CO_EQ || ins.m_cmpop == CO_NE ||
+		ins.m_cmpop == CO_LT || ins.m_cmpop == CO_LE ||
+		ins.m_cmpop == CO_GT || ins.m_cmpop == CO_GE;
+
+	switch(finfo->m_type)
+	{
+	case PT_INT8:
+		ins.m_size = 1;
+		break;
+	case PT_INT16:
+		ins.m_size = 2;
+		break;
+	case PT_INT32:
+		ins.m_size = 4;
+		break;
+	case PT_INT64:
+	case PT_FD:
+	case PT_PID:
+	case PT_ERRNO:
+		ins.m_size = 8;
+		break;
+	case PT_FLAGS8:
+	case PT_ENUMFLAGS8:
+	case PT_UINT8:
+	case PT_SIGTYPE:
+		ins.m_size = 1;
+		break;
+	case PT_FLAGS16:
+	case PT_UINT16:
+	case PT_ENUMFLAGS16:
+	case PT_PORT:
+	case PT_SYSCALLID:
+		ins.m_size = 2;
+		break;
+	case PT_UINT32:
+	case PT_FLAGS32:
+	case PT_ENUMFLAGS32:
+	case PT_MODE:
+	case PT_BOOL:
+	case PT_IPV4ADDR:
+		ins.m_size = 4;
+		break;
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		ins.m_size = 8;
+		break;
+	case PT_CHARBUF:
+	case PT_FSPATH:
+	case PT_FSRELPATH:
+		ins.m_str = (const char*)val;
+		ins.m_str_len = strlen(ins.m_str);
+		switch(ins.m_cmpop)
+		{
+		case CO_EQ:
+			ins.m_op = sinsp_filter_program::OP_STR_EQ;
+			break;
+		case CO_NE:
+			ins.m_op = sinsp_filter_program::OP_STR_NE;
+			break;
+		case CO_CONTAINS:
+			ins.m_op = sinsp_filter_program::OP_STR_CONTAINS;
+			break;
+		case CO_STARTSWITH:
+			ins.m_op = sinsp_filter_program::OP_STR_STARTSWITH;
+			break;
+		case CO_ENDSWITH:
+			ins.m_op = sinsp_filter_program::OP_STR_ENDSWITH;
+			break;
+		case CO_GLOB:
+			ins.m_op = sinsp_filter_program::OP_GLOB;
+			ins.m_glob = &chk->m_val_storages_globs;
+			break;
+		default:
+			break;
+		}
+		return;
+	default:
+		return;
+	}
+
+	if(!is_num)
+	{
+		return;
+	}
+
+	bool is_signed = finfo->m_type == PT_INT8 || finfo->m_type == PT_INT16 ||
+		finfo->m_type == PT_INT32 || finfo->m_type == PT_INT64 ||
+		finfo->m_type == PT_FD || finfo->m_type == PT_PID ||
+		finfo->m_type == PT_ERRNO;
+	if(is_signed)
+	{
+		ins.m_op = sinsp_filter_program::OP_INT;
+		ins.m_val = (uint64_t)load_int(val, ins.m_size);
+	}
+	else
+	{
+		ins.m_op = sinsp_filter_program::OP_UINT;
+		ins.m_val = load_uint(val, ins.m_size);
+	}
+}
+
+//
+// A jump lands right after the last instruction of the expression it
+// skips, with the result of that expression. If that instruction jumps
+// with this result too, go straight to its target.
+//
+void sinsp_filter_program_compiler::thread_jumps()
+{
+	auto& code = m_program->m_code;
+
+	for(size_t j = code.size(); j-- > 0;)
+	{
+		sinsp_filter_program::instruction& ins = code[j];
+		if(ins.m_jump == sinsp_filter_program::JMP_NONE)
+		{
+			continue;
+		}
+
+		while(ins.m_target < code.size())
+		{
+			const sinsp_filter_program::instruction& last = code[ins.m_target - 1];
+			if(last.m_jump != ins.m_jump || &last == &ins)
+			{
+				break;
+			}
+			ins.m_target = last.m_target;
+		}
+	}
+}
@@ -0,0 +1,243 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "filter.h"
+#include "filterchecks.h"
+#include "multi_string_matcher.h"
+
+/** @defgroup filter Filtering events
+ *  @{
+ */
+
+/*!
+  \brief What the filter programs sharing this cache know about the current
+  event: the values of the fields, by field name, and the results of the
+  checks, by check. A field or a check used by many programs is extracted
+  or evaluated only once per event. The programs sharing a cache must be
+  compiled with the same factory.
+*/
+class SINSP_PUBLIC sinsp_filter_cache
+{
+public:
+	/*!
+	  \brief Returns the entry of the given field, creating it if needed.
+	*/
+	check_extraction_cache_entry* get_extraction_entry(const std::string& field);
+
+	/*!
+	  \brief Returns the entry of the given check, creating it if needed.
+	*/
+	check_eval_cache_entry* get_eval_entry(const std::string& check);
+
+	/*!
+	  \brief Forgets what is known about the current event.
+	*/
+	void invalidate();
+
+	size_t num_fields() const
+	{
+		return m_extraction_entries.size();
+	}
+
+	size_t num_checks() const
+	{
+		return m_eval_entries.size();
+	}
+
+private:
+	std::unordered_map<std::string, std::unique_ptr<check_extraction_cache_entry>> m_extraction_entries;
+	std::unordered_map<std::string, std::unique_ptr<check_eval_cache_entry>> m_eval_entries;
+};
+
+/*!
+  \brief A filter compiled to a flat list of instructions, that is
+  evaluated without walking the filtercheck tree.
+
+  Every check is an instruction comparing the extracted value with the
+  constant according to the type of the field, and and/or are jumps past
+  the rest of the expression once its result is known. The contains,
+  icontains, startswith and endswith checks of the same string field
+  joined by or, or negated and joined by and, are a single instruction
+  that scans the value once for all their patterns. The glob checks of
+  the same field are merged the same way.
+*/
+class SINSP_PUBLIC sinsp_filter_program
+{
+public:
+	~sinsp_filter_program();
+
+	/*!
+	  \brief Applies the filter to the given event.
+
+	  \param evt Pointer that needs to be filtered.
+	  \return true if the event is accepted by the filter, false if it's rejected.
+	*/
+	bool run(gen_event *evt);
+
+	/*!
+	  \brief Returns a human readable listing of the instructions, for
+	  debugging.
+	*/
+	std::string to_string() const;
+
+	size_t size() const
+	{
+		return m_code.size();
+	}
+
+private:
+	enum opcode
+	{
+		OP_COMPARE = 0,         ///< Calls compare() of the check.
+		OP_EXTRACT_COMPARE = 1, ///< Extracts the field and calls flt_compare() of the check.
+		OP_EXISTS = 2,          ///< True if the field can be extracted.
+		OP_INT = 3,             ///< Signed numeric comparison.
+		OP_UINT = 4,            ///< Unsigned numeric comparison.
+		OP_STR_EQ = 5,
+		OP_STR_NE = 6,
+		OP_STR_CONTAINS = 7,
+		OP_STR_STARTSWITH = 8,
+		OP_STR_ENDSWITH = 9,
+		OP_NOT = 10,            ///< Negates the result of the previous instruction.
+		OP_STR_MULTI = 11,      ///< True if any pattern of m_matcher matches.
+		OP_GLOB = 12,           ///< True if any pattern of m_glob matches.
+	};
+
+	enum jump_type
+	{
+		JMP_NONE = 0,
+		JMP_IF_TRUE = 1,
+		JMP_IF_FALSE = 2,
+	};
+
+	struct instruction
+	{
+		opcode m_op;
+		cmpop m_cmpop;
+		jump_type m_jump;
+		bool m_negate;
+		uint8_t m_size;     ///< Size of the operands of OP_INT and OP_UINT.
+		uint32_t m_target;  ///< Where m_jump goes.
+		gen_event_filter_check* m_check;
+		sinsp_filter_check* m_sinsp_check;  ///< m_check, for the extracting instructions.
+		check_eval_cache_entry* m_eval;     ///< Result of the check shared with other programs.
+		uint64_t m_val;     ///< Constant of OP_INT and OP_UINT.
+		const char* m_str;  ///< Constant of the string instructions.
+		uint32_t m_str_len;
+		const multi_string_matcher* m_matcher;  ///< Patterns of OP_STR_MULTI.
+		glob_matcher* m_glob;   ///< Patterns of OP_GLOB.
+	};
+
+	sinsp_filter_program();
+
+	std::vector<extract_value_t>* extract(const instruction& ins, sinsp_evt* evt);
+	bool exec(const instruction& ins, gen_event* evt);
+	bool exec_cached(const instruction& ins, gen_event* evt);
+
+	std::vector<instruction> m_code;
+	std::vector<gen_event_filter_check*> m_checks;
+	std::vector<std::unique_ptr<multi_string_matcher>> m_matchers;
+	std::vector<std::unique_ptr<glob_matcher>> m_globs;
+	std::vector<extract_value_t> m_values;
+	std::vector<check_extraction_cache_entry*> m_cache_entries;
+	sinsp_filter_cache m_local_cache;
+	int32_t m_check_id;
+
+	friend class sinsp_filter_program_compiler;
+};
+
+/*!
+  \brief Compiles the AST of a filter to a sinsp_filter_program.
+*/
+class SINSP_PUBLIC sinsp_filter_program_compiler:
+	private libsinsp::filter::ast::expr_visitor
+{
+public:
+	/*!
+		\brief Constructs the compiler
+
+		\param factory Pointer to a filter factory to be used to build
+		the filterchecks
+		\param fltstr The filter string to compile
+		\param cache Where the extracted values and the results of the
+		checks are shared with the other programs compiled with the same
+		cache. If NULL, only the checks of this program share the extracted
+		values. The cache must outlive the program.
+	*/
+	sinsp_filter_program_compiler(
+		std::shared_ptr<gen_event_filter_factory> factory,
+		const std::string& fltstr,
+		sinsp_filter_cache* cache = NULL);
+
+	/*!
+		\brief Constructs the compiler
+
+		\param factory Pointer to a filter factory to be used to build
+		the filterchecks
+		\param fltast AST of a parsed filter
+		\param cache Where the extracted values and the results of the
+		checks are shared with the other programs compiled with the same
+		cache. If NULL, only the checks of this program share the extracted
+		values. The cache must outlive the program.
+	*/
+	sinsp_filter_program_compiler(
+		std::shared_ptr<gen_event_filter_factory> factory,
+		libsinsp::filter::ast::expr* fltast,
+		sinsp_filter_cache* cache = NULL);
+
+	/*!
+		\brief Builds the program
+		\return The resulting pointer is owned by the caller and must be deleted
+		by it. The pointer is automatically deleted in case of exception.
+		\note Throws a sinsp_exception if the filter syntax is not valid
+	*/
+	sinsp_filter_program* compile();
+
+	void set_check_id(int32_t id);
+
+private:
+	void visit(libsinsp::filter::ast::and_expr*) override;
+	void visit(libsinsp::filter::ast::or_expr*) override;
+	void visit(libsinsp::filter::ast::not_expr*) override;
+	void visit(libsinsp::filter::ast::value_expr*) override;
+	void visit(libsinsp::filter::ast::list_expr*) override;
+	void visit(libsinsp::filter::ast::unary_check_expr*) override;
+	void visit(libsinsp::filter::ast::binary_check_expr*) override;
+	void visit_boolop(std::vector<libsinsp::filter::ast::expr*>& children, bool is_and);
+	libsinsp::filter::ast::binary_check_expr* string_pattern_check(libsinsp::filter::ast::expr* e, bool is_and);
+	bool add_multi_check(std::vector<libsinsp::filter::ast::binary_check_expr*>& checks, bool is_and);
+	void add_check(std::string& name, std::string& arg, std::string& op, libsinsp::filter::ast::expr* value);
+	static std::string check_key(const std::string& field, const std::string& op, libsinsp::filter::ast::expr* value);
+	void specialize(sinsp_filter_program::instruction& ins);
+	void thread_jumps();
+
+	sinsp_filter_compiler m_checks_compiler;
+	std::unique_ptr<libsinsp::filter::ast::expr> m_parsed_ast;
+	libsinsp::filter::ast::expr* m_flt_ast;
+	std::string m_flt_str;
+	sinsp_filter_cache* m_cache;
+	sinsp_filter_program* m_program;
+};
+
+/*@}*/
@@ -0,0 +1,255 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <cstring>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "filter_set.h"
+#include "filter/parser.h"
+
+using namespace libsinsp::filter;
+
+//
+// For every node of the AST, finds the event types for which it can be
+// true and the ones for which it can be false. Keeping both makes "not"
+// exact: "not (evt.type = open and proc.name = cat)" can be true for open.
+//
+class evttype_resolver: public ast::expr_visitor
+{
+public:
+	typedef std::vector<bool> evtset;
+
+	evtset m_true;
+	evtset m_false;
+
+	void visit(ast::and_expr* e) override
+	{
+		evtset t(PPM_EVENT_MAX, true);
+		evtset f(PPM_EVENT_MAX, false);
+
+		for(auto c : e->children)
+		{
+			c->accept(this);
+			for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+			{
+				t[j] = t[j] && m_true[j];
+				f[j] = f[j] || m_false[j];
+			}
+		}
+		m_true.swap(t);
+		m_false.swap(f);
+	}
+
+	void visit(ast::or_expr* e) override
+	{
+		evtset t(PPM_EVENT_MAX, false);
+		evtset f(PPM_EVENT_MAX, true);
+
+		for(auto c : e->children)
+		{
+			c->accept(this);
+			for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+			{
+				t[j] = t[j] || m_true[j];
+				f[j] = f[j] && m_false[j];
+			}
+		}
+		m_true.swap(t);
+		m_false.swap(f);
+	}
+
+	void visit(ast::not_expr* e) override
+	{
+		e->child->accept(this);
+		m_true.swap(m_false);
+	}
+
+	void visit(ast::value_expr* e) override
+	{
+		any();
+	}
+
+	void visit(ast::list_expr* e) override
+	{
+		any();
+	}
+
+	void visit(ast::unary_check_expr* e) override
+	{
+		any();
+	}
+
+	void visit(ast::binary_check_expr* e) override
+	{
+		std::vector<std::string> names;
+
+		auto v = dynamic_cast<ast::value_expr*>(e->value);
+		auto l = dynamic_cast<ast::list_expr*>(e->value);
+		if(e->field != "evt.type" || !e->arg.empty())
+		{
+			any();
+			return;
+		}
+		else if(v != NULL && (e->op == "=" || e->op == "==" || e->op == "!="))
+		{
+			names.push_back(v->value);
+		}
+		else if(l != NULL && e->op == "in")
+		{
+			names = l->values;
+		}
+		else
+		{
+			any();
+			return;
+		}
+
+		//
+		// The generic events carry the name of their system call, they
+		// can have any name
+		//
+		m_true.assign(PPM_EVENT_MAX, false);
+		m_false.assign(PPM_EVENT_MAX, true);
+		for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+		{
+			if(j == PPME_GENERIC_E || j == PPME_GENERIC_X)
+			{
+				m_true[j] = true;
+				continue;
+			}
+
+			for(auto& name : names)
+			{
+				if(name == g_infotables.m_event_info[j].name)
+				{
+					m_true[j] = true;
+					m_false[j] = false;
+					break;
+				}
+			}
+		}
+
+		if(e->op == "!=")
+		{
+			m_true.swap(m_false);
+		}
+	}
+
+private:
+	void any()
+	{
+		m_true.assign(PPM_EVENT_MAX, true);
+		m_false.assign(PPM_EVENT_MAX, true);
+	}
+};
+
+sinsp_filter_set::sinsp_filter_set(std::shared_ptr<gen_event_filter_factory> factory):
+	m_factory(factory),
+	m_filters_by_type(PPM_EVENT_MAX)
+{
+}
+
+sinsp_filter_set::~sinsp_filter_set()
+{
+}
+
+void sinsp_filter_set::add(const std::string& fltstr, int32_t rule_id)
+{
+	std::unique_ptr<ast::expr> fltast;
+
+	parser parser(fltstr);
+	try
+	{
+		fltast.reset(parser.parse());
+	}
+	catch (const sinsp_exception& e)
+	{
+		throw sinsp_exception("filter error at "
+			+ parser.get_pos().as_string() + ": " + e.what());
+	}
+
+	add(fltast.get(), rule_id);
+}
+
+void sinsp_filter_set::add(ast::expr* fltast, int32_t rule_id)
+{
+	sinsp_filter_program_compiler compiler(m_factory, fltast, &m_cache);
+	std::set<uint16_t> types;
+	filter flt;
+
+	compiler.set_check_id(rule_id);
+	flt.m_program.reset(compiler.compile());
+	flt.m_rule_id = rule_id;
+
+	get_event_types(fltast, types);
+	for(auto type : types)
+	{
+		m_filters_by_type[type].push_back(m_filters.size());
+	}
+	m_filters.push_back(std::move(flt));
+}
+
+bool sinsp_filter_set::run(gen_event *evt, std::vector<int32_t>& rule_ids)
+{
+	uint16_t type = evt->get_type();
+
+	rule_ids.clear();
+	if(type < PPM_EVENT_MAX)
+	{
+		for(auto j : m_filters_by_type[type])
+		{
+			if(m_filters[j].m_program->run(evt))
+			{
+				rule_ids.push_back(m_filters[j].m_rule_id);
+			}
+		}
+	}
+	else
+	{
+		for(auto& flt : m_filters)
+		{
+			if(flt.m_program->run(evt))
+			{
+				rule_ids.push_back(flt.m_rule_id);
+			}
+		}
+	}
+
+	return !rule_ids.empty();
+}
+
+void sinsp_filter_set::get_shared_counts(size_t* nfields, size_t* nchecks) const
+{
+	*nfields = m_cache.num_fields();
+	*nchecks = m_cache.num_checks();
+}
+
+void sinsp_filter_set::get_event_types(ast::expr* fltast, std::set<uint16_t>& types)
+{
+	evttype_resolver resolver;
+
+	fltast->accept(&resolver);
+	types.clear();
+	for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
+	{
+		if(resolver.m_true[j])
+		{
+			types.insert(j);
+		}
+	}
+}
@@ -0,0 +1,110 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "filter_program.h"
+
+/** @defgroup filter Filtering events
+ *  @{
+ */
+
+/*!
+  \brief A set of filters, each one identified by a rule id, that are
+  applied together to the events.
+
+  An event is given only to the filters that can match its type, as told
+  by the evt.type checks of the filters. The filters share the values of
+  the fields they extract and the results of the checks they have in
+  common, so these are extracted and evaluated once per event.
+*/
+class SINSP_PUBLIC sinsp_filter_set
+{
+public:
+	/*!
+		\brief Constructs the set
+
+		\param factory Pointer to a filter factory to be used to build
+		the filterchecks of all the filters
+	*/
+	sinsp_filter_set(std::shared_ptr<gen_event_filter_factory> factory);
+
+	~sinsp_filter_set();
+
+	/*!
+		\brief Compiles a filter and adds it to the set.
+		\note Throws a sinsp_exception if the filter syntax is not valid
+	*/
+	void add(const std::string& fltstr, int32_t rule_id);
+
+	/*!
+		\brief Compiles the AST of a filter and adds it to the set. The AST
+		is still owned by the caller.
+		\note Throws a sinsp_exception if the filter is not valid
+	*/
+	void add(libsinsp::filter::ast::expr* fltast, int32_t rule_id);
+
+	/*!
+	  \brief Applies the filters to the given event.
+
+	  \param evt Pointer that needs to be filtered.
+	  \param rule_ids Filled with the rule ids of the filters accepting
+	  the event, in the order they were added.
+	  \return true if the event is accepted by any filter.
+	*/
+	bool run(gen_event *evt, std::vector<int32_t>& rule_ids);
+
+	size_t size() const
+	{
+		return m_filters.size();
+	}
+
+	/*!
+	  \brief Returns the number of distinct fields and checks the filters
+	  use, that are extracted and evaluated at most once per event.
+	*/
+	void get_shared_counts(size_t* nfields, size_t* nchecks) const;
+
+	/*!
+	  \brief Finds the types of the events a filter can accept, that are
+	  all the types unless its evt.type checks restrict them.
+	*/
+	static void get_event_types(libsinsp::filter::ast::expr* fltast, std::set<uint16_t>& types);
+
+private:
+	struct filter
+	{
+		int32_t m_rule_id;
+		std::unique_ptr<sinsp_filter_program> m_program;
+	};
+
+	std::shared_ptr<gen_event_filter_factory> m_factory;
+
+	// Declared before the filters, that use it until they're destroyed
+	sinsp_filter_cache m_cache;
+	std::vector<filter> m_filters;
+
+	// Indexes in m_filters of the filters that can accept each event type
+	std::vector<std::vector<uint32_t>> m_filters_by_type;
+};
+
+/*@}*/
@@ -1791,6 +1791,18 @@ bool sinsp_filter_check_fd::compare(sinsp_evt *evt)
 			   len);
 }
 
+bool sinsp_filter_check_fd::compares_extracted_value()
+{
+	return m_field_id != TYPE_IP &&
+		m_field_id != TYPE_PORT &&
+		m_field_id != TYPE_PROTO &&
+		m_field_id != TYPE_NET &&
+		m_field_id != TYPE_CLIENTIP_NAME &&
+		m_field_id != TYPE_SERVERIP_NAME &&
+		m_field_id != TYPE_LIP_NAME &&
+		m_field_id != TYPE_RIP_NAME;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_check_thread implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -2791,6 +2803,11 @@ bool sinsp_filter_check_thread::compare(sinsp_evt *evt)
 	return sinsp_filter_check::compare(evt);
 }
 
+bool sinsp_filter_check_thread::compares_extracted_value()
+{
+	return !((m_field_id == TYPE_APID || m_field_id == TYPE_ANAME) && m_argid == -1);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_check_event implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -4697,6 +4714,14 @@ bool sinsp_filter_check_event::compare(sinsp_evt *evt)
 	return res;
 }
 
+bool sinsp_filter_check_event::compares_extracted_value()
+{
+	// the buffer is extracted differently when compared
+	return m_field_id != TYPE_ARGRAW &&
+		m_field_id != TYPE_AROUND &&
+		m_field_id != TYPE_BUFFER;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_check_user implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -5953,6 +5978,11 @@ fcec_end:
 	return res;
 }
 
+bool sinsp_filter_check_evtin::compares_extracted_value()
+{
+	return false;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // rawstring_check implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -20,6 +20,8 @@ limitations under the License.
 #include <json/json.h>
 #include "filter_value.h"
 #include "prefix_search.h"
+#include "glob_matcher.h"
+#include "field_buffer.h"
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
 #include "k8s.h"
 #include "mesos.h"
@@ -147,17 +149,49 @@ public:
 	bool compare(gen_event *evt);
 	virtual bool compare(sinsp_evt *evt);
 
+	//
+	// Returns false if compare() does more than comparing the extracted
+	// value with the constant, in which case compiled filter programs
+	// must call it instead of extracting the field themselves
+	//
+	virtual bool compares_extracted_value()
+	{
+		return true;
+	}
+
 	//
 	// Extract the value from the event and convert it into a string
 	//
 	virtual char* tostring(sinsp_evt* evt);
 
+	//
+	// Extract the value from the event and append its string rendering,
+	// the one of tostring(), to out. The numbers, the IPv4 addresses and
+	// the strings are appended directly instead of being printed in a
+	// buffer first. Returns false if the value can't be extracted.
+	// Subclasses that override tostring() must override this too.
+	//
+	virtual bool append_string(sinsp_evt* evt, std::string& out);
+
 	//
 	// Extract the value from the event and convert it into a Json value
 	// or object
 	//
 	virtual Json::Value tojson(sinsp_evt* evt);
 
+	//
+	// Extract the value from the event as a number, an address or a view
+	// of a string, according to the kind of the field. This doesn't
+	// allocate memory once the check has seen a few events, the value
+	// points to memory of the check.
+	//
+	bool extract_typed(sinsp_evt* evt, OUT sinsp_field_value& value, bool sanitize_strings = true);
+
+	//
+	// Return the kind of the values returned by extract_typed()
+	//
+	sinsp_field_kind get_field_kind();
+
 	sinsp* m_inspector;
 	bool m_needs_state_tracking = false;
 	sinsp_field_aggregation m_aggregation;
@@ -192,6 +226,11 @@ protected:
 
 	path_prefix_search m_val_storages_paths;
 
+	glob_matcher m_val_storages_globs;
+
+	// Reused by the extractions that don't return the values to the caller
+	vector<extract_value_t> m_extracted_values;
+
 	uint32_t m_val_storages_min_size;
 	uint32_t m_val_storages_max_size;
 
@@ -207,6 +246,8 @@ private:
 friend class filter_check_list;
 friend class sinsp_filter_optimizer;
 friend class chk_compare_helper;
+friend class sinsp_filter_program;
+friend class sinsp_filter_program_compiler;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -288,6 +329,7 @@ public:
 	bool compare_port(sinsp_evt *evt);
 	bool compare_domain(sinsp_evt *evt);
 	bool compare(sinsp_evt *evt);
+	bool compares_extracted_value();
 
 	sinsp_threadinfo* m_tinfo;
 	sinsp_fdinfo_t* m_fdinfo;
@@ -370,6 +412,7 @@ public:
 	int32_t parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering);
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings = true);
 	bool compare(sinsp_evt *evt);
+	bool compares_extracted_value();
 
 private:
 	uint64_t extract_exectime(sinsp_evt *evt);
@@ -503,6 +546,7 @@ public:
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings = true);
 	Json::Value extract_as_js(sinsp_evt *evt, OUT uint32_t* len);
 	bool compare(sinsp_evt *evt);
+	bool compares_extracted_value();
 
 	uint64_t m_u64val;
 	uint64_t m_tsdelta;
@@ -677,6 +721,7 @@ public:
 	sinsp_filter_check* allocate_new();
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings = true);
 	bool compare(sinsp_evt *evt);
+	bool compares_extracted_value();
 
 	uint64_t m_u64val;
 	uint64_t m_tsdelta;
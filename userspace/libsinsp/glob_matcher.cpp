@@ -0,0 +1,349 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "glob_matcher.h"
+#include "utils.h"
+
+// Past this number of states, they're dropped and built again
+#define MAX_GLOB_STATES 1024
+
+glob_matcher::glob_matcher():
+	m_npatterns(0)
+{
+}
+
+void glob_matcher::add(const std::string& pattern)
+{
+	std::vector<position> positions;
+
+	m_npatterns++;
+	if(!parse(pattern, positions))
+	{
+		m_simple_patterns.push_back({pattern, FNMATCH});
+		return;
+	}
+
+	//
+	// A literal string, with or without a star at either end, doesn't
+	// need the automaton
+	//
+	size_t first = 0;
+	size_t last = positions.size();
+	bool leading_star = last > 0 && positions[0].m_star;
+	if(leading_star)
+	{
+		first++;
+	}
+	bool trailing_star = last > first && positions[last - 1].m_star;
+	if(trailing_star)
+	{
+		last--;
+	}
+
+	std::string str;
+	size_t j = first;
+	while(j < last && is_literal(positions[j], str))
+	{
+		j++;
+	}
+
+	if(j == last)
+	{
+		pattern_type type = leading_star ?
+			(trailing_star ? CONTAINS : SUFFIX) :
+			(trailing_star ? PREFIX : LITERAL);
+		m_simple_patterns.push_back({str, type});
+		return;
+	}
+
+	uint32_t start = m_positions.size();
+	m_positions.insert(m_positions.end(), positions.begin(), positions.end());
+	position final_pos = {};
+	final_pos.m_final = true;
+	m_positions.push_back(final_pos);
+
+	add_closure(start, m_start_positions);
+	std::sort(m_start_positions.begin(), m_start_positions.end());
+	reset_states();
+}
+
+bool glob_matcher::match(const char* str)
+{
+	for(auto& p : m_simple_patterns)
+	{
+		bool res;
+		switch(p.m_type)
+		{
+		case LITERAL:
+			res = strcmp(str, p.m_str.c_str()) == 0;
+			break;
+		case PREFIX:
+			res = strncmp(str, p.m_str.c_str(), p.m_str.size()) == 0;
+			break;
+		case SUFFIX:
+			res = sinsp_utils::endswith(str, p.m_str.c_str(), strlen(str), p.m_str.size());
+			break;
+		case CONTAINS:
+			res = strstr(str, p.m_str.c_str()) != NULL;
+			break;
+		default:
+			res = sinsp_utils::glob_match(p.m_str.c_str(), str);
+			break;
+		}
+
+		if(res)
+		{
+			return true;
+		}
+	}
+
+	if(m_start_positions.empty())
+	{
+		return false;
+	}
+
+	uint32_t s = 0;
+	for(const uint8_t* p = (const uint8_t*)str; *p != '\0'; p++)
+	{
+		const state& st = m_states[s];
+		if(st.m_always)
+		{
+			return true;
+		}
+		if(st.m_positions.empty())
+		{
+			return false;
+		}
+
+		uint32_t next = m_transitions[s * 256 + *p];
+		s = next != UINT32_MAX ? next : next_state(s, *p);
+	}
+	return m_states[s].m_accept;
+}
+
+//
+// Reads the pattern as fnmatch() does without flags: '*' and '?' match
+// '/' and leading dots too, and '\' quotes the next character. Returns
+// false if the pattern is left to fnmatch().
+//
+bool glob_matcher::parse(const std::string& pattern, std::vector<position>& positions)
+{
+	size_t n = pattern.size();
+
+	for(size_t i = 0; i < n; i++)
+	{
+		position pos = {};
+		uint8_t c = pattern[i];
+
+		if(c == '*')
+		{
+			if(!positions.empty() && positions.back().m_star)
+			{
+				continue;
+			}
+			pos.m_star = true;
+			pos.m_chars.set();
+		}
+		else if(c == '?')
+		{
+			pos.m_chars.set();
+		}
+		else if(c == '\\')
+		{
+			if(++i == n)
+			{
+				return false;
+			}
+			pos.m_chars.set((uint8_t)pattern[i]);
+		}
+		else if(c == '[')
+		{
+			size_t j = i + 1;
+			bool negate = false;
+			bool first = true;
+
+			if(j < n && (pattern[j] == '!' || pattern[j] == '^'))
+			{
+				negate = true;
+				j++;
+			}
+
+			while(true)
+			{
+				// a '[' that isn't closed is a literal, not worth handling
+				if(j >= n)
+				{
+					return false;
+				}
+
+				uint8_t lo = pattern[j];
+				if(lo == ']' && !first)
+				{
+					break;
+				}
+				first = false;
+
+				if(lo == '[' && j + 1 < n &&
+				   (pattern[j + 1] == ':' || pattern[j + 1] == '=' || pattern[j + 1] == '.'))
+				{
+					return false;
+				}
+
+				if(lo == '\\')
+				{
+					if(++j == n)
+					{
+						return false;
+					}
+					lo = pattern[j];
+				}
+				j++;
+
+				uint8_t hi = lo;
+				if(j + 1 < n && pattern[j] == '-' && pattern[j + 1] != ']')
+				{
+					hi = pattern[++j];
+					if(hi == '[' || hi == '\\' || hi < lo)
+					{
+						return false;
+					}
+					j++;
+				}
+
+				for(uint32_t k = lo; k <= hi; k++)
+				{
+					pos.m_chars.set(k);
+				}
+			}
+
+			if(negate)
+			{
+				pos.m_chars.flip();
+				pos.m_chars.reset(0);
+			}
+			i = j;
+		}
+		else
+		{
+			pos.m_chars.set(c);
+		}
+
+		positions.push_back(pos);
+	}
+
+	return true;
+}
+
+bool glob_matcher::is_literal(const position& pos, std::string& str)
+{
+	if(pos.m_star || pos.m_chars.count() != 1)
+	{
+		return false;
+	}
+
+	for(uint32_t c = 0; c < 256; c++)
+	{
+		if(pos.m_chars[c])
+		{
+			str += (char)c;
+			break;
+		}
+	}
+	return true;
+}
+
+// A star can match nothing, so the positions after it are reached too
+void glob_matcher::add_closure(uint32_t pos, std::vector<uint32_t>& positions) const
+{
+	while(true)
+	{
+		positions.push_back(pos);
+		if(!m_positions[pos].m_star)
+		{
+			break;
+		}
+		pos++;
+	}
+}
+
+uint32_t glob_matcher::add_state(std::vector<uint32_t>& positions)
+{
+	auto it = m_state_ids.find(positions);
+	if(it != m_state_ids.end())
+	{
+		return it->second;
+	}
+
+	state st;
+	st.m_accept = false;
+	st.m_always = false;
+	for(auto p : positions)
+	{
+		st.m_accept = st.m_accept || m_positions[p].m_final;
+		st.m_always = st.m_always || (m_positions[p].m_star && m_positions[p + 1].m_final);
+	}
+	st.m_positions = positions;
+
+	uint32_t id = m_states.size();
+	m_states.push_back(std::move(st));
+	m_transitions.resize(m_states.size() * 256, UINT32_MAX);
+	m_state_ids[positions] = id;
+	return id;
+}
+
+uint32_t glob_matcher::next_state(uint32_t s, uint8_t c)
+{
+	std::vector<uint32_t> positions;
+
+	for(auto p : m_states[s].m_positions)
+	{
+		const position& pos = m_positions[p];
+		if(pos.m_star)
+		{
+			add_closure(p, positions);
+		}
+		else if(!pos.m_final && pos.m_chars[c])
+		{
+			add_closure(p + 1, positions);
+		}
+	}
+	std::sort(positions.begin(), positions.end());
+	positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+
+	if(m_states.size() >= MAX_GLOB_STATES)
+	{
+		reset_states();
+		return add_state(positions);
+	}
+
+	uint32_t id = add_state(positions);
+	m_transitions[s * 256 + c] = id;
+	return id;
+}
+
+// The start state is always the first one
+void glob_matcher::reset_states()
+{
+	m_states.clear();
+	m_transitions.clear();
+	m_state_ids.clear();
+	add_state(m_start_positions);
+}
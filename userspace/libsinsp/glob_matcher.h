@@ -0,0 +1,109 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <bitset>
+#include <map>
+#include <string>
+#include <vector>
+
+//
+// Tests a string against a set of glob patterns, with the same results
+// as fnmatch() without flags. The search succeeds if any pattern matches.
+//
+// The patterns that are just a literal string, a prefix (abc*), a suffix
+// (*abc) or a substring (*abc*) are tested as such. All the others are
+// merged in a single automaton, whose deterministic states are built
+// while matching, the first time each is reached, so that the string is
+// scanned once for all of them. The patterns with bracket expressions
+// this class doesn't know ([:alpha:], [=a=], [.a.]) are left to fnmatch().
+//
+// Here are some examples:
+// - match(/etc/ssh/sshd_config, [/etc/ssh/*, /usr/*/lib?])
+//         succeeds because /etc/ssh/ is a prefix of the path.
+// - match(/usr/local/lib6, [/etc/ssh/*, /usr/*/lib?])
+//         succeeds because of the second pattern.
+// - match(/usr/lib, [/etc/ssh/*, /usr/*/lib?])
+//         does not succeed.
+//
+class glob_matcher
+{
+public:
+	glob_matcher();
+
+	void add(const std::string& pattern);
+
+	// Not const, this builds the states of the automaton it goes through
+	bool match(const char* str);
+
+	size_t size() const
+	{
+		return m_npatterns;
+	}
+
+private:
+	enum pattern_type
+	{
+		LITERAL = 0,
+		PREFIX = 1,
+		SUFFIX = 2,
+		CONTAINS = 3,
+		FNMATCH = 4,
+	};
+
+	struct simple_pattern
+	{
+		std::string m_str;
+		pattern_type m_type;
+	};
+
+	// A position in a pattern: it reads a character of m_chars and moves
+	// to the next one, or any number of them if m_star
+	struct position
+	{
+		bool m_star;
+		bool m_final;
+		std::bitset<256> m_chars;
+	};
+
+	struct state
+	{
+		std::vector<uint32_t> m_positions;
+		bool m_accept;
+		bool m_always; ///< Accepts whatever follows.
+	};
+
+	static bool parse(const std::string& pattern, std::vector<position>& positions);
+	static bool is_literal(const position& pos, std::string& str);
+	void add_closure(uint32_t pos, std::vector<uint32_t>& positions) const;
+	uint32_t add_state(std::vector<uint32_t>& positions);
+	uint32_t next_state(uint32_t s, uint8_t c);
+	void reset_states();
+
+	std::vector<simple_pattern> m_simple_patterns;
+	std::vector<position> m_positions;
+	std::vector<uint32_t> m_start_positions;
+	size_t m_npatterns;
+
+	// The states built so far and their transitions, UINT32_MAX if unknown
+	std::vector<state> m_states;
+	std::vector<uint32_t> m_transitions;
+	std::map<std::vector<uint32_t>, uint32_t> m_state_ids;
+};
@@ -0,0 +1,117 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "latency_histogram.h"
+
+// Every power of two is split in 1 << SUB_BUCKET_BITS sub-buckets
+#define SUB_BUCKET_BITS 3
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+// Values below this are counted exactly, one bucket per value
+#define LINEAR_LIMIT (2 * SUB_BUCKETS)
+#define NUM_BUCKETS (LINEAR_LIMIT + (64 - SUB_BUCKET_BITS - 1) * SUB_BUCKETS)
+
+latency_histogram::latency_histogram():
+	m_buckets(NUM_BUCKETS, 0),
+	m_count(0)
+{
+}
+
+uint32_t latency_histogram::bucket_of(uint64_t ns)
+{
+	uint32_t msb = 0;
+
+	if(ns < LINEAR_LIMIT)
+	{
+		return (uint32_t)ns;
+	}
+
+	for(uint64_t v = ns >> 1; v != 0; v >>= 1)
+	{
+		msb++;
+	}
+
+	uint32_t shift = msb - SUB_BUCKET_BITS;
+	uint32_t sub = (uint32_t)(ns >> shift) & (SUB_BUCKETS - 1);
+	return LINEAR_LIMIT + (msb - SUB_BUCKET_BITS - 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t latency_histogram::bucket_upper_bound(uint32_t bucket)
+{
+	if(bucket < LINEAR_LIMIT)
+	{
+		return bucket;
+	}
+
+	uint32_t shift = (bucket - LINEAR_LIMIT) / SUB_BUCKETS + 1;
+	uint64_t sub = (bucket - LINEAR_LIMIT) % SUB_BUCKETS;
+	uint64_t lower = (SUB_BUCKETS + sub) << shift;
+	return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void latency_histogram::add(uint64_t ns)
+{
+	m_buckets[bucket_of(ns)]++;
+	m_count++;
+}
+
+uint64_t latency_histogram::percentile(double p) const
+{
+	if(m_count == 0)
+	{
+		return 0;
+	}
+
+	if(p < 0)
+	{
+		p = 0;
+	}
+	else if(p > 1)
+	{
+		p = 1;
+	}
+
+	uint64_t rank = (uint64_t)(p * m_count);
+	if(rank == 0)
+	{
+		rank = 1;
+	}
+
+	uint64_t seen = 0;
+	for(uint32_t j = 0; j < m_buckets.size(); j++)
+	{
+		seen += m_buckets[j];
+		if(seen >= rank)
+		{
+			return bucket_upper_bound(j);
+		}
+	}
+
+	return bucket_upper_bound(m_buckets.size() - 1);
+}
+
+uint64_t latency_histogram::count() const
+{
+	return m_count;
+}
+
+void latency_histogram::clear()
+{
+	for(auto& b : m_buckets)
+	{
+		b = 0;
+	}
+	m_count = 0;
+}
@@ -0,0 +1,56 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// A fixed size histogram of latencies, in nanoseconds. Buckets are
+// log-linear: every power of two is split in 8 equal sub-buckets, so the
+// relative error of the reported percentiles is at most 12.5%, and adding
+// a sample never allocates.
+class latency_histogram
+{
+public:
+	latency_histogram();
+
+	//
+	// Add a sample
+	//
+	void add(uint64_t ns);
+
+	//
+	// Return the value below which a fraction p (0 to 1) of the samples
+	// fall, rounded up to the end of its bucket. Returns 0 if there are
+	// no samples.
+	//
+	uint64_t percentile(double p) const;
+
+	// Return the number of samples
+	uint64_t count() const;
+
+	// Remove all the samples
+	void clear();
+
+private:
+	static uint32_t bucket_of(uint64_t ns);
+	static uint64_t bucket_upper_bound(uint32_t bucket);
+
+	std::vector<uint64_t> m_buckets;
+	uint64_t m_count;
+};
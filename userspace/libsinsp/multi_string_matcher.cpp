@@ -0,0 +1,239 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <string.h>
+
+#include <queue>
+
+#include "multi_string_matcher.h"
+
+static inline uint8_t to_lower(uint8_t c)
+{
+	return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+multi_string_matcher::multi_string_matcher():
+	m_npatterns(0),
+	m_match_all(false)
+{
+}
+
+void multi_string_matcher::add(const std::string& pattern, pattern_type type)
+{
+	m_npatterns++;
+
+	// every string contains, starts and ends with the empty string
+	if(pattern.empty())
+	{
+		m_match_all = true;
+	}
+	else if(type == ICONTAINS)
+	{
+		m_insensitive.add(pattern, type);
+	}
+	else
+	{
+		m_sensitive.add(pattern, type);
+	}
+}
+
+void multi_string_matcher::compile()
+{
+	m_sensitive.compile(false);
+	m_insensitive.compile(true);
+}
+
+bool multi_string_matcher::match(const char* str) const
+{
+	return m_match_all ||
+		(!m_sensitive.empty() && m_sensitive.match(str)) ||
+		(!m_insensitive.empty() && m_insensitive.match(str));
+}
+
+void multi_string_matcher::automaton::add(const std::string& pattern, pattern_type type)
+{
+	m_patterns.push_back({pattern, type});
+}
+
+void multi_string_matcher::automaton::compile(bool ignore_case)
+{
+	const uint32_t missing = UINT32_MAX;
+
+	//
+	// The characters of the patterns get a class each, all the others
+	// share class 0
+	//
+	memset(m_class, 0, sizeof(m_class));
+	m_nclasses = 1;
+	for(auto& p : m_patterns)
+	{
+		if(ignore_case)
+		{
+			for(auto& c : p.m_str)
+			{
+				c = to_lower(c);
+			}
+		}
+
+		for(uint8_t c : p.m_str)
+		{
+			if(m_class[c] == 0)
+			{
+				m_class[c] = m_nclasses++;
+				if(ignore_case && c >= 'a' && c <= 'z')
+				{
+					m_class[c - ('a' - 'A')] = m_class[c];
+				}
+			}
+		}
+	}
+
+	// The trie of the patterns
+	std::vector<std::vector<uint32_t>> ends(1);
+	m_transitions.assign(m_nclasses, missing);
+	for(uint32_t j = 0; j < m_patterns.size(); j++)
+	{
+		uint32_t state = 0;
+		for(uint8_t c : m_patterns[j].m_str)
+		{
+			uint32_t* next = &m_transitions[state * m_nclasses + m_class[c]];
+			if(*next == missing)
+			{
+				*next = ends.size();
+				ends.emplace_back();
+				m_transitions.resize(ends.size() * m_nclasses, missing);
+				next = &m_transitions[state * m_nclasses + m_class[c]];
+			}
+			state = *next;
+		}
+		ends[state].push_back(j);
+	}
+
+	//
+	// Visit the trie breadth first, so that the failure state of every
+	// state is complete when we get to it. The missing transitions become
+	// the ones of the failure state.
+	//
+	uint32_t nstates = ends.size();
+	std::vector<uint32_t> fail(nstates, 0);
+	std::vector<uint32_t> dict(nstates, 0);
+	std::queue<uint32_t> queue;
+
+	for(uint32_t c = 0; c < m_nclasses; c++)
+	{
+		uint32_t& next = m_transitions[c];
+		if(next == missing)
+		{
+			next = 0;
+		}
+		else
+		{
+			queue.push(next);
+		}
+	}
+
+	while(!queue.empty())
+	{
+		uint32_t state = queue.front();
+		queue.pop();
+
+		// the closest state along the failure links where a pattern ends
+		uint32_t f = fail[state];
+		dict[state] = ends[f].empty() ? dict[f] : f;
+
+		for(uint32_t c = 0; c < m_nclasses; c++)
+		{
+			uint32_t& next = m_transitions[state * m_nclasses + c];
+			uint32_t fail_next = m_transitions[f * m_nclasses + c];
+			if(next == missing)
+			{
+				next = fail_next;
+			}
+			else
+			{
+				fail[next] = fail_next;
+				queue.push(next);
+			}
+		}
+	}
+
+	m_state_output.assign(nstates, 0);
+	m_outputs.clear();
+	for(uint32_t state = 0; state < nstates; state++)
+	{
+		if(!ends[state].empty() || dict[state] != 0)
+		{
+			output out;
+			out.m_patterns = std::move(ends[state]);
+			out.m_next = dict[state];
+			m_outputs.push_back(std::move(out));
+			m_state_output[state] = m_outputs.size();
+		}
+	}
+}
+
+// pos is the number of characters read, next the following one
+inline bool multi_string_matcher::automaton::accept(uint32_t state, size_t pos, const char* next) const
+{
+	uint32_t o = m_state_output[state];
+
+	while(o != 0)
+	{
+		const output& out = m_outputs[o - 1];
+		for(auto j : out.m_patterns)
+		{
+			const pattern& p = m_patterns[j];
+			switch(p.m_type)
+			{
+			case STARTSWITH:
+				if(pos == p.m_str.size())
+				{
+					return true;
+				}
+				break;
+			case ENDSWITH:
+				if(*next == '\0')
+				{
+					return true;
+				}
+				break;
+			default:
+				return true;
+			}
+		}
+		o = out.m_next == 0 ? 0 : m_state_output[out.m_next];
+	}
+	return false;
+}
+
+bool multi_string_matcher::automaton::match(const char* str) const
+{
+	const uint32_t* transitions = m_transitions.data();
+	uint32_t nclasses = m_nclasses;
+	uint32_t state = 0;
+
+	for(const char* p = str; *p != '\0';)
+	{
+		state = transitions[state * nclasses + m_class[(uint8_t)*p]];
+		p++;
+		if(m_state_output[state] != 0 && accept(state, p - str, p))
+		{
+			return true;
+		}
+	}
+	return false;
+}
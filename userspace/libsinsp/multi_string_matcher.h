@@ -0,0 +1,112 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+//
+// Tests a string against many patterns at once, each of which must be
+// contained in the string, start it, end it, or be contained in it
+// ignoring the case. The search succeeds if any pattern matches.
+//
+// The patterns are compiled to Aho-Corasick automatons, one for the case
+// sensitive patterns and one for the others, so that the string is
+// scanned once by each, whatever the number of patterns. The transitions
+// are a table indexed by the state and the class of the next character,
+// where all the characters that don't appear in the patterns share the
+// same class.
+//
+// Here are some examples:
+// - match(/home/user/.ssh/id_rsa, [contains .ssh/, endswith .pem])
+//         succeeds because .ssh/ is contained in the path.
+// - match(/etc/ssl/cert.pem, [contains .ssh/, endswith .pem])
+//         succeeds because the path ends with .pem.
+// - match(/var/log/ssh.log, [contains .ssh/, startswith /etc])
+//         does not succeed.
+//
+class multi_string_matcher
+{
+public:
+	enum pattern_type
+	{
+		CONTAINS = 0,
+		STARTSWITH = 1,
+		ENDSWITH = 2,
+		ICONTAINS = 3,
+	};
+
+	multi_string_matcher();
+
+	void add(const std::string& pattern, pattern_type type);
+
+	// Builds the automatons, must be called after the last add()
+	void compile();
+
+	bool match(const char* str) const;
+
+	size_t size() const
+	{
+		return m_npatterns;
+	}
+
+private:
+	class automaton
+	{
+	public:
+		void add(const std::string& pattern, pattern_type type);
+		void compile(bool ignore_case);
+		bool match(const char* str) const;
+
+		bool empty() const
+		{
+			return m_patterns.empty();
+		}
+
+	private:
+		struct pattern
+		{
+			std::string m_str;
+			pattern_type m_type;
+		};
+
+		// Matches of a state: the patterns ending there, and the next
+		// state along the failure links with some matches
+		struct output
+		{
+			std::vector<uint32_t> m_patterns;
+			uint32_t m_next = 0;
+		};
+
+		bool accept(uint32_t state, size_t pos, const char* next) const;
+
+		std::vector<pattern> m_patterns;
+		uint8_t m_class[256];
+		uint32_t m_nclasses;
+		std::vector<uint32_t> m_transitions;
+		std::vector<uint32_t> m_state_output; // index in m_outputs + 1, 0 if none
+		std::vector<output> m_outputs;
+	};
+
+	automaton m_sensitive;
+	automaton m_insensitive;
+	size_t m_npatterns;
+	bool m_match_all;
+};
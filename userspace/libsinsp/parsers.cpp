@@ -53,7 +53,8 @@ extern sinsp_evttables g_infotables;
 sinsp_parser::sinsp_parser(sinsp *inspector) :
 	m_inspector(inspector),
 	m_tmp_evt(m_inspector),
-	m_fd_listener(NULL)
+	m_fd_listener(NULL),
+	m_evt_buffer_pool(std::make_shared<sinsp_evt_buffer_pool>())
 {
 	m_fake_userevt = (scap_evt*)m_fake_userevt_storage;
 
@@ -66,6 +67,7 @@ sinsp_parser::sinsp_parser(sinsp *inspector) :
 	init_metaevt(m_k8s_metaevents_state, PPME_K8S_E, SP_EVT_BUF_SIZE);
 	init_metaevt(m_mesos_metaevents_state, PPME_MESOS_E, SP_EVT_BUF_SIZE);
 	m_drop_event_flags = EF_NONE;
+	init_event_handlers();
 }
 
 sinsp_parser::~sinsp_parser()
@@ -75,12 +77,6 @@ sinsp_parser::~sinsp_parser()
 		delete m_protodecoders[j];
 	}
 
-	while(!m_tmp_events_buffer.empty())
-	{
-		auto ptr = m_tmp_events_buffer.top();
-		free(ptr);
-		m_tmp_events_buffer.pop();
-	}
 	m_protodecoders.clear();
 
 	free(m_k8s_metaevents_state.m_piscapevt);
@@ -116,6 +112,230 @@ void sinsp_parser::set_track_connection_status(bool enabled)
 	m_track_connection_status = enabled;
 }
 
+void sinsp_parser::set_event_handler(std::initializer_list<uint16_t> etypes, event_handler_t parse, uint32_t flags)
+{
+	for(uint16_t etype : etypes)
+	{
+		m_event_handlers[etype].m_parse = parse;
+		m_event_handlers[etype].m_flags |= flags;
+	}
+}
+
+//
+// Precompute, for every event type, the function that parses it and the
+// state that reset() needs to look up, so that process_event() doesn't
+// need to compare the type against long lists for every event. The
+// inspector calls it again when it starts, once the events of interest are
+// known.
+//
+void sinsp_parser::init_event_handlers()
+{
+	const struct ppm_event_info* info = scap_get_event_info_table();
+	const std::set<uint16_t>& interest = m_inspector->m_events_of_interest;
+
+	for(uint32_t etype = 0; etype < PPM_EVENT_MAX; etype++)
+	{
+		m_event_handlers[etype].m_parse = NULL;
+		m_event_handlers[etype].m_flags = EPF_NONE;
+
+		//
+		// The return value is the first parameter, called "res" or "fd"
+		//
+		if(info[etype].nparams != 0 &&
+		   (strcmp(info[etype].params[0].name, "res") == 0 ||
+		    strcmp(info[etype].params[0].name, "fd") == 0))
+		{
+			m_event_handlers[etype].m_flags |= EPF_HAS_RESULT;
+		}
+	}
+
+	//
+	// If we're exiting a clone or if we have a scheduler event
+	// (many kernel thread), we don't look for /proc
+	//
+	set_event_handler({PPME_SYSCALL_CLONE_11_X,
+			   PPME_SYSCALL_CLONE_16_X,
+			   PPME_SYSCALL_CLONE_17_X,
+			   PPME_SYSCALL_CLONE_20_X,
+			   PPME_SYSCALL_FORK_X,
+			   PPME_SYSCALL_FORK_17_X,
+			   PPME_SYSCALL_FORK_20_X,
+			   PPME_SYSCALL_VFORK_X,
+			   PPME_SYSCALL_VFORK_17_X,
+			   PPME_SYSCALL_VFORK_20_X,
+			   PPME_SYSCALL_CLONE3_X},
+			  &sinsp_parser::parse_clone_exit, EPF_CLONE_EXIT | EPF_NO_PROC_LOOKUP);
+
+	set_event_handler({PPME_SOCKET_SENDTO_E, PPME_SOCKET_SENDMSG_E}, &sinsp_parser::parse_send_enter);
+	set_event_handler({PPME_SYSCALL_OPEN_E,
+			   PPME_SYSCALL_CREAT_E,
+			   PPME_SYSCALL_OPENAT_E,
+			   PPME_SYSCALL_OPENAT_2_E,
+			   PPME_SYSCALL_OPENAT2_E,
+			   PPME_SOCKET_SOCKET_E,
+			   PPME_SYSCALL_EVENTFD_E,
+			   PPME_SYSCALL_CHDIR_E,
+			   PPME_SYSCALL_FCHDIR_E,
+			   PPME_SOCKET_SHUTDOWN_E,
+			   PPME_SYSCALL_GETRLIMIT_E,
+			   PPME_SYSCALL_SETRLIMIT_E,
+			   PPME_SYSCALL_PRLIMIT_E,
+			   PPME_SYSCALL_SENDFILE_E,
+			   PPME_SYSCALL_SETRESUID_E,
+			   PPME_SYSCALL_SETRESGID_E,
+			   PPME_SYSCALL_SETUID_E,
+			   PPME_SYSCALL_SETGID_E,
+			   PPME_SYSCALL_EXECVE_18_E,
+			   PPME_SYSCALL_EXECVE_19_E,
+			   PPME_SYSCALL_EXECVEAT_E,
+			   PPME_SYSCALL_SETPGID_E,
+			   PPME_SYSCALL_UNSHARE_E,
+			   PPME_SYSCALL_SETNS_E},
+			  &sinsp_parser::store_event);
+	set_event_handler({PPME_SYSCALL_WRITE_E}, &sinsp_parser::parse_write_enter, EPF_MAY_FILTER_OUT);
+	set_event_handler({PPME_SYSCALL_READ_X,
+			   PPME_SYSCALL_WRITE_X,
+			   PPME_SOCKET_RECV_X,
+			   PPME_SOCKET_SEND_X,
+			   PPME_SOCKET_RECVFROM_X,
+			   PPME_SOCKET_RECVMSG_X,
+			   PPME_SOCKET_SENDTO_X,
+			   PPME_SOCKET_SENDMSG_X,
+			   PPME_SYSCALL_READV_X,
+			   PPME_SYSCALL_WRITEV_X,
+			   PPME_SYSCALL_PREAD_X,
+			   PPME_SYSCALL_PWRITE_X,
+			   PPME_SYSCALL_PREADV_X,
+			   PPME_SYSCALL_PWRITEV_X},
+			  &sinsp_parser::parse_rw_exit);
+	set_event_handler({PPME_SYSCALL_SENDFILE_X}, &sinsp_parser::parse_sendfile_exit);
+	set_event_handler({PPME_SYSCALL_OPEN_X,
+			   PPME_SYSCALL_CREAT_X,
+			   PPME_SYSCALL_OPENAT_X,
+			   PPME_SYSCALL_OPENAT_2_X,
+			   PPME_SYSCALL_OPENAT2_X,
+			   PPME_SYSCALL_OPEN_BY_HANDLE_AT_X},
+			  &sinsp_parser::parse_open_openat_creat_exit);
+	set_event_handler({PPME_SYSCALL_SELECT_E,
+			   PPME_SYSCALL_POLL_E,
+			   PPME_SYSCALL_PPOLL_E,
+			   PPME_SYSCALL_EPOLLWAIT_E},
+			  &sinsp_parser::parse_select_poll_epollwait_enter);
+	set_event_handler({PPME_SYSCALL_UNSHARE_X, PPME_SYSCALL_SETNS_X}, &sinsp_parser::parse_unshare_setns_exit);
+	set_event_handler({PPME_SYSCALL_EXECVE_8_X,
+			   PPME_SYSCALL_EXECVE_13_X,
+			   PPME_SYSCALL_EXECVE_14_X,
+			   PPME_SYSCALL_EXECVE_15_X,
+			   PPME_SYSCALL_EXECVE_16_X,
+			   PPME_SYSCALL_EXECVE_17_X,
+			   PPME_SYSCALL_EXECVE_18_X,
+			   PPME_SYSCALL_EXECVE_19_X,
+			   PPME_SYSCALL_EXECVEAT_X},
+			  &sinsp_parser::parse_execve_exit);
+	set_event_handler({PPME_PROCEXIT_E, PPME_PROCEXIT_1_E}, &sinsp_parser::parse_thread_exit);
+	set_event_handler({PPME_SYSCALL_PIPE_X}, &sinsp_parser::parse_pipe_exit);
+	set_event_handler({PPME_SOCKET_SOCKET_X}, &sinsp_parser::parse_socket_exit);
+	set_event_handler({PPME_SOCKET_BIND_X}, &sinsp_parser::parse_bind_exit);
+	set_event_handler({PPME_SOCKET_CONNECT_E}, &sinsp_parser::parse_connect_enter);
+	set_event_handler({PPME_SOCKET_CONNECT_X}, &sinsp_parser::parse_connect_exit);
+	set_event_handler({PPME_SOCKET_ACCEPT_X,
+			   PPME_SOCKET_ACCEPT_5_X,
+			   PPME_SOCKET_ACCEPT4_X,
+			   PPME_SOCKET_ACCEPT4_5_X},
+			  &sinsp_parser::parse_accept_exit);
+	set_event_handler({PPME_SYSCALL_CLOSE_E}, &sinsp_parser::parse_close_enter);
+	set_event_handler({PPME_SYSCALL_CLOSE_X}, &sinsp_parser::parse_close_exit);
+	set_event_handler({PPME_SYSCALL_FCNTL_E}, &sinsp_parser::parse_fcntl_enter);
+	set_event_handler({PPME_SYSCALL_FCNTL_X}, &sinsp_parser::parse_fcntl_exit);
+	set_event_handler({PPME_SYSCALL_EVENTFD_X}, &sinsp_parser::parse_eventfd_exit);
+	set_event_handler({PPME_SYSCALL_CHDIR_X}, &sinsp_parser::parse_chdir_exit);
+	set_event_handler({PPME_SYSCALL_FCHDIR_X}, &sinsp_parser::parse_fchdir_exit);
+	set_event_handler({PPME_SYSCALL_GETCWD_X}, &sinsp_parser::parse_getcwd_exit);
+	set_event_handler({PPME_SOCKET_SHUTDOWN_X}, &sinsp_parser::parse_shutdown_exit);
+	set_event_handler({PPME_SYSCALL_DUP_X}, &sinsp_parser::parse_dup_exit);
+	set_event_handler({PPME_SYSCALL_SIGNALFD_X}, &sinsp_parser::parse_signalfd_exit);
+	set_event_handler({PPME_SYSCALL_TIMERFD_CREATE_X}, &sinsp_parser::parse_timerfd_create_exit);
+	set_event_handler({PPME_SYSCALL_INOTIFY_INIT_X}, &sinsp_parser::parse_inotify_init_exit);
+	set_event_handler({PPME_SYSCALL_GETRLIMIT_X, PPME_SYSCALL_SETRLIMIT_X}, &sinsp_parser::parse_getrlimit_setrlimit_exit);
+	set_event_handler({PPME_SYSCALL_PRLIMIT_X}, &sinsp_parser::parse_prlimit_exit);
+	set_event_handler({PPME_SOCKET_SOCKETPAIR_X}, &sinsp_parser::parse_socketpair_exit);
+	set_event_handler({PPME_SCHEDSWITCH_1_E}, &sinsp_parser::parse_context_switch);
+	set_event_handler({PPME_SCHEDSWITCH_6_E}, &sinsp_parser::parse_context_switch, EPF_NO_PROC_LOOKUP);
+	set_event_handler({PPME_SYSCALL_BRK_4_X,
+			   PPME_SYSCALL_MMAP_X,
+			   PPME_SYSCALL_MMAP2_X,
+			   PPME_SYSCALL_MUNMAP_X},
+			  &sinsp_parser::parse_brk_munmap_mmap_exit);
+	set_event_handler({PPME_SYSCALL_SETRESUID_X}, &sinsp_parser::parse_setresuid_exit);
+	set_event_handler({PPME_SYSCALL_SETRESGID_X}, &sinsp_parser::parse_setresgid_exit);
+	set_event_handler({PPME_SYSCALL_SETUID_X}, &sinsp_parser::parse_setuid_exit);
+	set_event_handler({PPME_SYSCALL_SETGID_X}, &sinsp_parser::parse_setgid_exit);
+	set_event_handler({PPME_CONTAINER_E}, &sinsp_parser::parse_container_evt); // deprecated, only here for backwards compatibility
+	set_event_handler({PPME_CONTAINER_JSON_E, PPME_CONTAINER_JSON_2_E}, &sinsp_parser::parse_container_json_evt);
+	set_event_handler({PPME_CPU_HOTPLUG_E}, &sinsp_parser::parse_cpu_hotplug_enter);
+#if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
+	set_event_handler({PPME_K8S_E}, &sinsp_parser::parse_k8s_evt);
+	set_event_handler({PPME_MESOS_E}, &sinsp_parser::parse_mesos_evt);
+#endif // #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
+	set_event_handler({PPME_SYSCALL_CHROOT_X}, &sinsp_parser::parse_chroot_exit);
+	set_event_handler({PPME_SYSCALL_SETSID_X}, &sinsp_parser::parse_setsid_exit);
+	set_event_handler({PPME_SOCKET_GETSOCKOPT_X}, &sinsp_parser::parse_getsockopt_exit);
+	set_event_handler({PPME_SYSCALL_CAPSET_X}, &sinsp_parser::parse_capset_exit);
+	set_event_handler({PPME_USER_ADDED_E, PPME_USER_DELETED_E}, &sinsp_parser::parse_user_evt);
+	set_event_handler({PPME_GROUP_ADDED_E, PPME_GROUP_DELETED_E}, &sinsp_parser::parse_group_evt);
+
+	//
+	// The events that are not of interest are still parsed if they
+	// change the state, and then filtered out. The others don't need any
+	// lookup, unless the other event of their syscall is of interest,
+	// since the enter event tells the fd to the exit event, or an fd
+	// listener wants to see them.
+	//
+	std::vector<bool> of_interest(PPM_EVENT_MAX, true);
+	for(uint32_t etype = 0; etype < PPM_EVENT_MAX; etype++)
+	{
+		if(!interest.empty() && interest.count(etype) == 0)
+		{
+			of_interest[etype] = false;
+		}
+
+		if(m_inspector->m_simpleconsumer && !sinsp::simple_consumer_consider_evtnum(etype))
+		{
+			of_interest[etype] = false;
+		}
+	}
+
+	for(uint32_t etype = 0; etype < PPM_EVENT_MAX; etype++)
+	{
+		uint32_t other = etype ^ PPME_DIRECTION_FLAG;
+
+		if(of_interest[etype])
+		{
+			continue;
+		}
+
+		m_event_handlers[etype].m_flags |= EPF_NOT_OF_INTEREST;
+
+		bool stateless = m_fd_listener == NULL &&
+			(other >= PPM_EVENT_MAX || !of_interest[other]);
+		for(uint32_t t : {etype, other})
+		{
+			if(t < PPM_EVENT_MAX &&
+			   (m_event_handlers[t].m_parse != NULL ||
+			    (info[t].flags & (EF_MODIFIES_STATE | EF_SKIPPARSERESET)) ||
+			    (info[t].category & (EC_INTERNAL | EC_SCHEDULER))))
+			{
+				stateless = false;
+			}
+		}
+
+		if(stateless)
+		{
+			m_event_handlers[etype].m_flags |= EPF_SKIP;
+		}
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // PROCESSING ENTRY POINT
 ///////////////////////////////////////////////////////////////////////////////
@@ -123,6 +343,19 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 {
 	uint16_t etype = evt->m_pevt->type;
 	bool is_live = m_inspector->is_live();
+	const event_handler& handler = m_event_handlers[etype];
+
+	//
+	// The events that the consumer doesn't want, and that don't change
+	// the state, skip all the lookups
+	//
+	if(handler.m_flags & EPF_SKIP)
+	{
+		evt->init();
+		evt->m_fdinfo = NULL;
+		evt->m_filtered_out = true;
+		return;
+	}
 
 	//
 	// Cleanup the event-related state
@@ -178,7 +411,7 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	//
 	bool do_filter_later = false;
 
-	if(m_inspector->m_filter)
+	if(m_inspector->m_filter && !(handler.m_flags & EPF_NOT_OF_INTEREST))
 	{
 		ppm_event_flags eflags = evt->get_info_flags();
 
@@ -239,265 +472,14 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	//
 	// Route the event to the proper function
 	//
-	switch(etype)
+	if(handler.m_parse != NULL)
 	{
-	case PPME_SOCKET_SENDTO_E:
-		if((evt->m_fdinfo == nullptr) && (evt->m_tinfo != nullptr))
-		{
-			infer_sendto_fdinfo(evt);
-		}
-
-		// FALLTHRU
-	case PPME_SYSCALL_OPEN_E:
-	case PPME_SYSCALL_CREAT_E:
-	case PPME_SYSCALL_OPENAT_E:
-	case PPME_SYSCALL_OPENAT_2_E:
-	case PPME_SYSCALL_OPENAT2_E:
-	case PPME_SOCKET_SOCKET_E:
-	case PPME_SYSCALL_EVENTFD_E:
-	case PPME_SYSCALL_CHDIR_E:
-	case PPME_SYSCALL_FCHDIR_E:
-	case PPME_SOCKET_SHUTDOWN_E:
-	case PPME_SYSCALL_GETRLIMIT_E:
-	case PPME_SYSCALL_SETRLIMIT_E:
-	case PPME_SYSCALL_PRLIMIT_E:
-	case PPME_SOCKET_SENDMSG_E:
-	case PPME_SYSCALL_SENDFILE_E:
-	case PPME_SYSCALL_SETRESUID_E:
-	case PPME_SYSCALL_SETRESGID_E:
-	case PPME_SYSCALL_SETUID_E:
-	case PPME_SYSCALL_SETGID_E:
-	case PPME_SYSCALL_EXECVE_18_E:
-	case PPME_SYSCALL_EXECVE_19_E:
-	case PPME_SYSCALL_EXECVEAT_E:
-	case PPME_SYSCALL_SETPGID_E:
-		store_event(evt);
-		break;
-	case PPME_SYSCALL_WRITE_E:
-		if(!m_inspector->m_is_dumping && evt->m_tinfo != nullptr)
-		{
-			evt->m_fdinfo = evt->m_tinfo->get_fd(evt->m_tinfo->m_lastevent_fd);
-			if(evt->m_fdinfo)
-			{
-				if(evt->m_fdinfo->m_flags & sinsp_fdinfo_t::FLAGS_IS_TRACER_FD)
-				{
-					evt->m_filtered_out = true;
-					return;
-				}
-			}
-		}
-		break;
-	case PPME_SYSCALL_READ_X:
-	case PPME_SYSCALL_WRITE_X:
-	case PPME_SOCKET_RECV_X:
-	case PPME_SOCKET_SEND_X:
-	case PPME_SOCKET_RECVFROM_X:
-	case PPME_SOCKET_RECVMSG_X:
-	case PPME_SOCKET_SENDTO_X:
-	case PPME_SOCKET_SENDMSG_X:
-	case PPME_SYSCALL_READV_X:
-	case PPME_SYSCALL_WRITEV_X:
-	case PPME_SYSCALL_PREAD_X:
-	case PPME_SYSCALL_PWRITE_X:
-	case PPME_SYSCALL_PREADV_X:
-	case PPME_SYSCALL_PWRITEV_X:
-		parse_rw_exit(evt);
-		break;
-	case PPME_SYSCALL_SENDFILE_X:
-		parse_sendfile_exit(evt);
-		break;
-	case PPME_SYSCALL_OPEN_X:
-	case PPME_SYSCALL_CREAT_X:
-	case PPME_SYSCALL_OPENAT_X:
-	case PPME_SYSCALL_OPENAT_2_X:
-	case PPME_SYSCALL_OPENAT2_X:
-	case PPME_SYSCALL_OPEN_BY_HANDLE_AT_X:
-		parse_open_openat_creat_exit(evt);
-		break;
-	case PPME_SYSCALL_SELECT_E:
-	case PPME_SYSCALL_POLL_E:
-	case PPME_SYSCALL_PPOLL_E:
-	case PPME_SYSCALL_EPOLLWAIT_E:
-		parse_select_poll_epollwait_enter(evt);
-		break;
-	case PPME_SYSCALL_UNSHARE_E:
-	case PPME_SYSCALL_SETNS_E:
-		store_event(evt);
-		break;
-	case PPME_SYSCALL_UNSHARE_X:
-	case PPME_SYSCALL_SETNS_X:
-		parse_unshare_setns_exit(evt);
-		break;
-	case PPME_SYSCALL_CLONE_11_X:
-	case PPME_SYSCALL_CLONE_16_X:
-	case PPME_SYSCALL_CLONE_17_X:
-	case PPME_SYSCALL_CLONE_20_X:
-	case PPME_SYSCALL_FORK_X:
-	case PPME_SYSCALL_FORK_17_X:
-	case PPME_SYSCALL_FORK_20_X:
-	case PPME_SYSCALL_VFORK_X:
-	case PPME_SYSCALL_VFORK_17_X:
-	case PPME_SYSCALL_VFORK_20_X:
-	case PPME_SYSCALL_CLONE3_X:
-		parse_clone_exit(evt);
-		break;
-	case PPME_SYSCALL_EXECVE_8_X:
-	case PPME_SYSCALL_EXECVE_13_X:
-	case PPME_SYSCALL_EXECVE_14_X:
-	case PPME_SYSCALL_EXECVE_15_X:
-	case PPME_SYSCALL_EXECVE_16_X:
-	case PPME_SYSCALL_EXECVE_17_X:
-	case PPME_SYSCALL_EXECVE_18_X:
-	case PPME_SYSCALL_EXECVE_19_X:
-    case PPME_SYSCALL_EXECVEAT_X:
-		parse_execve_exit(evt);
-		break;
-	case PPME_PROCEXIT_E:
-	case PPME_PROCEXIT_1_E:
-		parse_thread_exit(evt);
-		break;
-	case PPME_SYSCALL_PIPE_X:
-		parse_pipe_exit(evt);
-		break;
+		(this->*handler.m_parse)(evt);
 
-	case PPME_SOCKET_SOCKET_X:
-		parse_socket_exit(evt);
-		break;
-	case PPME_SOCKET_BIND_X:
-		parse_bind_exit(evt);
-		break;
-	case PPME_SOCKET_CONNECT_E:
-		parse_connect_enter(evt);
-		break;
-	case PPME_SOCKET_CONNECT_X:
-		parse_connect_exit(evt);
-		break;
-	case PPME_SOCKET_ACCEPT_X:
-	case PPME_SOCKET_ACCEPT_5_X:
-	case PPME_SOCKET_ACCEPT4_X:
-	case PPME_SOCKET_ACCEPT4_5_X:
-		parse_accept_exit(evt);
-		break;
-	case PPME_SYSCALL_CLOSE_E:
-		parse_close_enter(evt);
-		break;
-	case PPME_SYSCALL_CLOSE_X:
-		parse_close_exit(evt);
-		break;
-	case PPME_SYSCALL_FCNTL_E:
-		parse_fcntl_enter(evt);
-		break;
-	case PPME_SYSCALL_FCNTL_X:
-		parse_fcntl_exit(evt);
-		break;
-	case PPME_SYSCALL_EVENTFD_X :
-		parse_eventfd_exit(evt);
-		break;
-	case PPME_SYSCALL_CHDIR_X:
-		parse_chdir_exit(evt);
-		break;
-	case PPME_SYSCALL_FCHDIR_X:
-		parse_fchdir_exit(evt);
-		break;
-	case PPME_SYSCALL_GETCWD_X:
-		parse_getcwd_exit(evt);
-		break;
-	case PPME_SOCKET_SHUTDOWN_X:
-		parse_shutdown_exit(evt);
-		break;
-	case PPME_SYSCALL_DUP_X:
-		parse_dup_exit(evt);
-		break;
-	case PPME_SYSCALL_SIGNALFD_X:
-		parse_signalfd_exit(evt);
-		break;
-	case PPME_SYSCALL_TIMERFD_CREATE_X:
-		parse_timerfd_create_exit(evt);
-		break;
-	case PPME_SYSCALL_INOTIFY_INIT_X:
-		parse_inotify_init_exit(evt);
-		break;
-	case PPME_SYSCALL_GETRLIMIT_X:
-	case PPME_SYSCALL_SETRLIMIT_X:
-		parse_getrlimit_setrlimit_exit(evt);
-		break;
-	case PPME_SYSCALL_PRLIMIT_X:
-		parse_prlimit_exit(evt);
-		break;
-	case PPME_SOCKET_SOCKETPAIR_X:
-		parse_socketpair_exit(evt);
-		break;
-	case PPME_SCHEDSWITCH_1_E:
-	case PPME_SCHEDSWITCH_6_E:
-		parse_context_switch(evt);
-		break;
-	case PPME_SYSCALL_BRK_4_X:
-	case PPME_SYSCALL_MMAP_X:
-	case PPME_SYSCALL_MMAP2_X:
-	case PPME_SYSCALL_MUNMAP_X:
-		parse_brk_munmap_mmap_exit(evt);
-		break;
-	case PPME_SYSCALL_SETRESUID_X:
-		parse_setresuid_exit(evt);
-		break;
-	case PPME_SYSCALL_SETRESGID_X:
-		parse_setresgid_exit(evt);
-		break;
-	case PPME_SYSCALL_SETUID_X:
-		parse_setuid_exit(evt);
-		break;
-	case PPME_SYSCALL_SETGID_X:
-		parse_setgid_exit(evt);
-		break;
-	case PPME_CONTAINER_E:
-		parse_container_evt(evt); // deprecated, only here for backwards compatibility
-		break;
-	case PPME_CONTAINER_JSON_E:
-	case PPME_CONTAINER_JSON_2_E:
-		parse_container_json_evt(evt);
-		break;
-	case PPME_CPU_HOTPLUG_E:
-		parse_cpu_hotplug_enter(evt);
-		break;
-#if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
-	case PPME_K8S_E:
-		if(!m_inspector->is_live())
-		{
-			parse_k8s_evt(evt);
-		}
-		break;
-	case PPME_MESOS_E:
-		if(!m_inspector->is_live())
-		{
-			parse_mesos_evt(evt);
-		}
-		break;
-#endif // #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
-	case PPME_SYSCALL_CHROOT_X:
-		parse_chroot_exit(evt);
-		break;
-	case PPME_SYSCALL_SETSID_X:
-		parse_setsid_exit(evt);
-		break;
-	case PPME_SOCKET_GETSOCKOPT_X:
-		if(evt->get_num_params() > 0)
+		if((handler.m_flags & EPF_MAY_FILTER_OUT) && evt->m_filtered_out)
 		{
-			parse_getsockopt_exit(evt);
+			return;
 		}
-		break;
-	case PPME_SYSCALL_CAPSET_X:
-		parse_capset_exit(evt);
-		break;
-	case PPME_USER_ADDED_E:
-	case PPME_USER_DELETED_E:
-		parse_user_evt(evt);
-		break;
-	case PPME_GROUP_ADDED_E:
-	case PPME_GROUP_DELETED_E:
-		parse_group_evt(evt);
-		break;
-	default:
-		break;
 	}
 
 	//
@@ -513,6 +495,12 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 		}
 		evt->m_filtered_out = false;
 	}
+
+	if(handler.m_flags & EPF_NOT_OF_INTEREST)
+	{
+		evt->m_filtered_out = true;
+	}
+
 	//
 	// Offline captures can produce events with the SCAP_DF_STATE_ONLY. They are
 	// supposed to go through the engine, but they must be filtered out before
@@ -535,13 +523,52 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	}
 }
 
+//
+// The exits of sendto and sendmsg only read their enter event to set the
+// tuple of an fd that has none, or that is not a TCP socket (see
+// parse_rw_exit()). Don't copy it otherwise.
+//
+void sinsp_parser::parse_send_enter(sinsp_evt *evt)
+{
+	if(evt->get_type() == PPME_SOCKET_SENDTO_E &&
+	   (evt->m_fdinfo == nullptr) && (evt->m_tinfo != nullptr))
+	{
+		infer_sendto_fdinfo(evt);
+	}
+
+	if(evt->m_fdinfo != nullptr &&
+	   evt->m_fdinfo->m_name.length() != 0 && evt->m_fdinfo->is_tcp_socket())
+	{
+		return;
+	}
+
+	store_event(evt);
+}
+
+//
+// Writes on the tracer fds are filtered out, unless we are dumping
+//
+void sinsp_parser::parse_write_enter(sinsp_evt *evt)
+{
+	if(!m_inspector->m_is_dumping && evt->m_tinfo != nullptr)
+	{
+		evt->m_fdinfo = evt->m_tinfo->get_fd(evt->m_tinfo->m_lastevent_fd);
+		if(evt->m_fdinfo)
+		{
+			if(evt->m_fdinfo->m_flags & sinsp_fdinfo_t::FLAGS_IS_TRACER_FD)
+			{
+				evt->m_filtered_out = true;
+			}
+		}
+	}
+}
+
 void sinsp_parser::event_cleanup(sinsp_evt *evt)
 {
 	if(evt->get_direction() == SCAP_ED_OUT &&
 	   evt->m_tinfo && evt->m_tinfo->m_lastevent_data)
 	{
-		free_event_buffer(evt->m_tinfo->m_lastevent_data);
-		evt->m_tinfo->m_lastevent_data = NULL;
+		free_event_buffer(evt->m_tinfo);
 		evt->m_tinfo->set_lastevent_data_validity(false);
 	}
 }
@@ -614,26 +641,8 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 	// If we're exiting a clone or if we have a scheduler event
 	// (many kernel thread), we don't look for /proc
 	//
-	bool query_os;
-	if(etype == PPME_SYSCALL_CLONE_11_X ||
-		etype == PPME_SYSCALL_CLONE_16_X ||
-		etype == PPME_SYSCALL_CLONE_17_X ||
-		etype == PPME_SYSCALL_CLONE_20_X ||
-		etype == PPME_SYSCALL_FORK_X ||
-		etype == PPME_SYSCALL_FORK_17_X ||
-		etype == PPME_SYSCALL_FORK_20_X ||
-		etype == PPME_SYSCALL_VFORK_X ||
-		etype == PPME_SYSCALL_VFORK_17_X ||
-		etype == PPME_SYSCALL_VFORK_20_X ||
-		etype == PPME_SYSCALL_CLONE3_X ||
-		etype == PPME_SCHEDSWITCH_6_E)
-	{
-		query_os = false;
-	}
-	else
-	{
-		query_os = true;
-	}
+	uint32_t parse_flags = m_event_handlers[etype].m_flags;
+	bool query_os = !(parse_flags & EPF_NO_PROC_LOOKUP);
 
 	if(etype == PPME_CONTAINER_JSON_E || etype == PPME_CONTAINER_JSON_2_E)
 	{
@@ -652,17 +661,7 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 
 	if(!evt->m_tinfo)
 	{
-		if(etype == PPME_SYSCALL_CLONE_11_X ||
-			etype == PPME_SYSCALL_CLONE_16_X ||
-			etype == PPME_SYSCALL_CLONE_17_X ||
-			etype == PPME_SYSCALL_CLONE_20_X ||
-			etype == PPME_SYSCALL_FORK_X ||
-			etype == PPME_SYSCALL_FORK_17_X ||
-			etype == PPME_SYSCALL_FORK_20_X ||
-			etype == PPME_SYSCALL_VFORK_X ||
-			etype == PPME_SYSCALL_VFORK_17_X ||
-			etype == PPME_SYSCALL_VFORK_20_X ||
-			etype == PPME_SYSCALL_CLONE3_X)
+		if(parse_flags & EPF_CLONE_EXIT)
 		{
 #ifdef GATHER_INTERNAL_STATS
 			m_inspector->m_thread_manager->m_failed_lookups->decrement();
@@ -735,14 +734,7 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 		//
 		// Error detection logic
 		//
-		if(evt->get_num_params() != 0 &&
-			((evt->m_info->params[0].name[0] == 'r' &&
-			  evt->m_info->params[0].name[1] == 'e' &&
-			  evt->m_info->params[0].name[2] == 's' &&
-			  evt->m_info->params[0].name[3] == '\0') ||
-			 (evt->m_info->params[0].name[0] == 'f' &&
-			  evt->m_info->params[0].name[1] == 'd' &&
-			  evt->m_info->params[0].name[2] == '\0')))
+		if((parse_flags & EPF_HAS_RESULT) && evt->get_num_params() != 0)
 		{
 			sinsp_evt_param *parinfo;
 
@@ -846,9 +838,9 @@ void sinsp_parser::store_event(sinsp_evt *evt)
 	// Copy the data
 	//
 	auto tinfo = evt->m_tinfo;
-	if(tinfo->m_lastevent_data == NULL)
+	if(reserve_event_buffer(tinfo, elen) == NULL)
 	{
-		tinfo->m_lastevent_data = reserve_event_buffer();
+		return;
 	}
 	memcpy(tinfo->m_lastevent_data, evt->m_pevt, elen);
 	tinfo->m_lastevent_cpuid = evt->get_cpuid();
@@ -1360,10 +1352,11 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 		//
 		// Track down that those are cloned fds
 		//
-		for(auto fdit = tinfo->m_fdtable.m_table.begin(); fdit != tinfo->m_fdtable.m_table.end(); ++fdit)
+		tinfo->m_fdtable.loop([](int64_t fd, sinsp_fdinfo_t& fdi)
 		{
-			fdit->second.set_is_cloned();
-		}
+			fdi.set_is_cloned();
+			return true;
+		});
 
 		//
 		// It's important to reset the cache of the child thread, to prevent it from
@@ -4666,9 +4659,9 @@ void sinsp_parser::parse_select_poll_epollwait_enter(sinsp_evt *evt)
 		return;
 	}
 
-	if(evt->m_tinfo->m_lastevent_data == NULL)
+	if(reserve_event_buffer(evt->m_tinfo, sizeof(uint64_t)) == NULL)
 	{
-		evt->m_tinfo->m_lastevent_data = reserve_event_buffer();
+		return;
 	}
 	*(uint64_t*)evt->m_tinfo->m_lastevent_data = evt->get_ts();
 }
@@ -5273,18 +5266,27 @@ void sinsp_parser::parse_cpu_hotplug_enter(sinsp_evt *evt)
 	}
 }
 
-uint8_t* sinsp_parser::reserve_event_buffer()
+//
+// Make sure the buffer of the last enter event of the thread can hold len
+// bytes
+//
+uint8_t* sinsp_parser::reserve_event_buffer(sinsp_threadinfo* tinfo, uint32_t len)
 {
-	if(m_tmp_events_buffer.empty())
+	if(tinfo->m_lastevent_data != NULL)
 	{
-		return (uint8_t*)malloc(sizeof(uint8_t)*SP_EVT_BUF_SIZE);
+		if(tinfo->m_lastevent_data_size >= len)
+		{
+			return tinfo->m_lastevent_data;
+		}
+		free_event_buffer(tinfo);
 	}
-	else
+
+	tinfo->m_lastevent_data = m_evt_buffer_pool->reserve(len, &tinfo->m_lastevent_data_size);
+	if(tinfo->m_lastevent_data != NULL)
 	{
-		auto ptr = m_tmp_events_buffer.top();
-		m_tmp_events_buffer.pop();
-		return ptr;
+		tinfo->m_lastevent_pool = m_evt_buffer_pool;
 	}
+	return tinfo->m_lastevent_data;
 }
 
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
@@ -5330,6 +5332,12 @@ int sinsp_parser::get_k8s_version(const std::string& json)
 
 void sinsp_parser::parse_k8s_evt(sinsp_evt *evt)
 {
+	// Live, the client gets the events by itself
+	if(m_inspector->is_live())
+	{
+		return;
+	}
+
 	sinsp_evt_param *parinfo = evt->get_param(0);
 	ASSERT(parinfo);
 	ASSERT(parinfo->m_len > 0);
@@ -5356,6 +5364,12 @@ void sinsp_parser::parse_k8s_evt(sinsp_evt *evt)
 
 void sinsp_parser::parse_mesos_evt(sinsp_evt *evt)
 {
+	// Live, the client gets the events by itself
+	if(m_inspector->is_live())
+	{
+		return;
+	}
+
 	sinsp_evt_param *parinfo = evt->get_param(0);
 	ASSERT(parinfo);
 	ASSERT(parinfo->m_len > 0);
@@ -5417,7 +5431,7 @@ void sinsp_parser::parse_getsockopt_exit(sinsp_evt *evt)
 	int64_t fd;
 	int8_t level, optname;
 
-	if(!evt->m_tinfo)
+	if(!evt->m_tinfo || evt->get_num_params() == 0)
 	{
 		return;
 	}
@@ -5573,14 +5587,25 @@ void sinsp_parser::parse_unshare_setns_exit(sinsp_evt *evt)
 	}
 }
 
-void sinsp_parser::free_event_buffer(uint8_t *ptr)
+void sinsp_parser::free_event_buffer(sinsp_threadinfo* tinfo)
 {
-	if(m_tmp_events_buffer.size() < m_inspector->m_thread_manager->m_threadtable.size())
-	{
-		m_tmp_events_buffer.push(ptr);
-	}
-	else
+	if(tinfo->m_lastevent_data == NULL)
 	{
-		free(ptr);
+		return;
 	}
+
+	//
+	// Keep at most one free buffer per thread
+	//
+	m_evt_buffer_pool->release(tinfo->m_lastevent_data,
+				   tinfo->m_lastevent_data_size,
+				   m_inspector->m_thread_manager->m_threadtable.size());
+	tinfo->m_lastevent_data = NULL;
+	tinfo->m_lastevent_data_size = 0;
+	tinfo->m_lastevent_pool.reset();
+}
+
+void sinsp_parser::get_evt_buffer_pool_stats(sinsp_evt_buffer_pool::stats* stats) const
+{
+	m_evt_buffer_pool->get_stats(stats);
 }
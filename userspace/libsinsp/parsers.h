@@ -19,7 +19,9 @@ limitations under the License.
 // Public definitions for the scap library
 ////////////////////////////////////////////////////////////////////////////
 #pragma once
+#include <initializer_list>
 #include "sinsp.h"
+#include "evt_buffer_pool.h"
 
 class sinsp_fd_listener;
 
@@ -47,6 +49,18 @@ public:
 
 	void erase_fd(erase_fd_params* params);
 
+	//
+	// Build the table of what process_event() does for every event
+	// type, from the events of interest of the inspector
+	//
+	void init_event_handlers();
+
+	//
+	// Give back the buffer of the last enter event of a thread
+	//
+	void free_event_buffer(sinsp_threadinfo* tinfo);
+	void get_evt_buffer_pool_stats(sinsp_evt_buffer_pool::stats* stats) const;
+
 	//
 	// Get the enter event matching the last received event
 	//
@@ -81,10 +95,33 @@ public:
 
 	void set_track_connection_status(bool enabled);
 private:
+	typedef void (sinsp_parser::*event_handler_t)(sinsp_evt* evt);
+
+	//
+	// What process_event() and reset() do for an event type
+	//
+	enum event_parse_flags
+	{
+		EPF_NONE = 0,
+		EPF_CLONE_EXIT = 1 << 0, // clone, fork or vfork exit
+		EPF_NO_PROC_LOOKUP = 1 << 1, // don't look for the thread in /proc
+		EPF_HAS_RESULT = 1 << 2, // the first parameter is the return value
+		EPF_MAY_FILTER_OUT = 1 << 3, // the parser can filter out the event
+		EPF_NOT_OF_INTEREST = 1 << 4, // filtered out once the state is updated
+		EPF_SKIP = 1 << 5, // not of interest and no state to update, dropped before reset()
+	};
+
+	struct event_handler
+	{
+		event_handler_t m_parse;
+		uint32_t m_flags;
+	};
+
 	//
 	// Initializers
 	//
 	inline void init_metaevt(metaevents_state& evt_state, uint16_t evt_type, uint16_t buf_size);
+	void set_event_handler(std::initializer_list<uint16_t> etypes, event_handler_t parse, uint32_t flags = EPF_NONE);
 
 	//
 	// Helpers
@@ -95,6 +132,8 @@ private:
 	//
 	// Parsers
 	//
+	void parse_send_enter(sinsp_evt* evt);
+	void parse_write_enter(sinsp_evt* evt);
 	void parse_clone_exit(sinsp_evt* evt);
 	void parse_execve_exit(sinsp_evt* evt);
 	void proc_schedule_removal(sinsp_evt* evt);
@@ -165,8 +204,7 @@ private:
 	bool set_unix_info(sinsp_fdinfo_t* fdinfo, uint8_t* packed_data);
 
 	void swap_addresses(sinsp_fdinfo_t* fdinfo);
-	uint8_t* reserve_event_buffer();
-	void free_event_buffer(uint8_t*);
+	uint8_t* reserve_event_buffer(sinsp_threadinfo* tinfo, uint32_t len);
 
 	//
 	// Pointers to inspector context
@@ -195,7 +233,11 @@ private:
 	int              m_k8s_capture_version = -1;
 	metaevents_state m_mesos_metaevents_state;
 
-	stack<uint8_t*> m_tmp_events_buffer;
+	// Shared with the threads holding one of its buffers
+	std::shared_ptr<sinsp_evt_buffer_pool> m_evt_buffer_pool;
+
+	event_handler m_event_handlers[PPM_EVENT_MAX];
+
 	friend class sinsp_analyzer;
 	friend class sinsp_analyzer_fd_listener;
 	friend class sinsp_protodecoder;
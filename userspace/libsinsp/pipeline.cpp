@@ -0,0 +1,860 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cstring>
+
+#include "pipeline.h"
+#include "scap_open_exception.h"
+
+// Number of events after which the batch of a shard is sent to its worker
+#define PIPELINE_BATCH_EVENTS 256
+// Number of events after which all the batches are sent, to bound the
+// delay of the ordered output
+#define PIPELINE_FLUSH_EVENTS 4096
+// Number of batches that can be queued to a worker before the capture
+// thread blocks
+#define PIPELINE_QUEUE_BATCHES 64
+// Number of outputs a worker can queue before it blocks, while next()
+// doesn't return them
+#define PIPELINE_QUEUE_OUTPUTS 4096
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_shard_router implementation
+///////////////////////////////////////////////////////////////////////////////
+
+const uint32_t sinsp_shard_router::NO_SHARD;
+
+sinsp_shard_router::sinsp_shard_router(uint32_t nshards, tgid_lookup_t lookup):
+	m_nshards(nshards),
+	m_lookup(lookup)
+{
+}
+
+void sinsp_shard_router::add_thread(int64_t tid, int64_t tgid)
+{
+	m_tgids[tid] = tgid;
+}
+
+uint32_t sinsp_shard_router::shard_of_tgid(int64_t tgid) const
+{
+	//
+	// pids are allocated sequentially, mix them so that the processes
+	// created in a burst don't end up in neighbouring shards
+	//
+	uint64_t h = (uint64_t)tgid * 0x9E3779B97F4A7C15ULL;
+	return (uint32_t)((h >> 32) % m_nshards);
+}
+
+int64_t sinsp_shard_router::get_tgid(int64_t tid)
+{
+	auto it = m_tgids.find(tid);
+	if(it != m_tgids.end())
+	{
+		return it->second;
+	}
+
+	int64_t tgid = -1;
+	if(m_lookup)
+	{
+		tgid = m_lookup(tid);
+	}
+
+	if(tgid == -1)
+	{
+		tgid = tid;
+	}
+
+	m_tgids[tid] = tgid;
+	return tgid;
+}
+
+uint32_t sinsp_shard_router::route_clone_exit(const scap_evt* pevt, uint32_t* handoff)
+{
+	struct scap_sized_buffer params[PPM_MAX_EVENT_PARAMS];
+	uint32_t nparams = scap_event_decode_params(pevt, params);
+	uint32_t flags_idx;
+
+	switch(pevt->type)
+	{
+	case PPME_SYSCALL_CLONE_11_X:
+		flags_idx = 8;
+		break;
+	case PPME_SYSCALL_CLONE_16_X:
+	case PPME_SYSCALL_FORK_X:
+	case PPME_SYSCALL_VFORK_X:
+		flags_idx = 13;
+		break;
+	case PPME_SYSCALL_CLONE_17_X:
+	case PPME_SYSCALL_FORK_17_X:
+	case PPME_SYSCALL_VFORK_17_X:
+		flags_idx = 14;
+		break;
+	default:
+		flags_idx = 15;
+		break;
+	}
+
+	if(nparams <= flags_idx)
+	{
+		return shard_of_tgid(get_tgid(pevt->tid));
+	}
+
+	int64_t res;
+	int64_t pid;
+	uint32_t flags;
+	memcpy(&res, params[0].buf, sizeof(res));
+	memcpy(&pid, params[4].buf, sizeof(pid));
+	memcpy(&flags, params[flags_idx].buf, sizeof(flags));
+
+	if(res == 0)
+	{
+		//
+		// In the child the event carries the global tid and pid, which
+		// is all we need, and it's always the first event of the new
+		// thread
+		//
+		add_thread(pevt->tid, pid);
+		return shard_of_tgid(pid);
+	}
+
+	uint32_t shard = shard_of_tgid(get_tgid(pevt->tid));
+
+	//
+	// In the parent, the return value is the child tid as seen from the
+	// parent's pid namespace. We can only use it when that is the
+	// global one.
+	//
+	bool in_pidns = (flags & PPM_CL_CHILD_IN_PIDNS) != 0;
+	if(nparams > 18)
+	{
+		int64_t vtid;
+		memcpy(&vtid, params[18].buf, sizeof(vtid));
+		in_pidns = in_pidns || vtid != (int64_t)pevt->tid;
+	}
+
+	if(res > 0 && !(flags & PPM_CL_CLONE_THREAD) && !in_pidns)
+	{
+		uint32_t child_shard = shard_of_tgid(res);
+		if(child_shard != shard)
+		{
+			*handoff = child_shard;
+		}
+	}
+
+	return shard;
+}
+
+uint32_t sinsp_shard_router::route(const scap_evt* pevt, uint32_t* handoff)
+{
+	uint32_t shard;
+
+	*handoff = NO_SHARD;
+
+	switch(pevt->type)
+	{
+	case PPME_SYSCALL_CLONE_11_X:
+	case PPME_SYSCALL_CLONE_16_X:
+	case PPME_SYSCALL_CLONE_17_X:
+	case PPME_SYSCALL_CLONE_20_X:
+	case PPME_SYSCALL_FORK_X:
+	case PPME_SYSCALL_FORK_17_X:
+	case PPME_SYSCALL_FORK_20_X:
+	case PPME_SYSCALL_VFORK_X:
+	case PPME_SYSCALL_VFORK_17_X:
+	case PPME_SYSCALL_VFORK_20_X:
+	case PPME_SYSCALL_CLONE3_X:
+		return route_clone_exit(pevt, handoff);
+	case PPME_PROCEXIT_E:
+	case PPME_PROCEXIT_1_E:
+		shard = shard_of_tgid(get_tgid(pevt->tid));
+		m_tgids.erase(pevt->tid);
+		return shard;
+	default:
+		return shard_of_tgid(get_tgid(pevt->tid));
+	}
+}
+
+size_t sinsp_shard_router::size() const
+{
+	return m_tgids.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_pipeline implementation
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// A group of events sent from the capture thread to a worker. The events
+// are copied back to back in m_data, each aligned to 8 bytes.
+//
+struct sinsp_pipeline::batch
+{
+	struct evt_ref
+	{
+		uint64_t m_seq;
+		uint32_t m_offset;
+		uint16_t m_cpuid;
+		// The event is a fork whose child is handed off to the
+		// given shard, or NO_SHARD
+		uint32_t m_handoff;
+		// The event is only delivered to build the state of a
+		// process handed off to this shard, it must not be output
+		bool m_state_only;
+	};
+
+	std::vector<uint8_t> m_data;
+	std::vector<evt_ref> m_evts;
+	// All the events routed to this shard with a lower or equal sequence
+	// number are in this batch or in the previous ones
+	uint64_t m_watermark = 0;
+	bool m_eof = false;
+
+	void add(const scap_evt* pevt, uint64_t seq, uint16_t cpuid, uint32_t handoff, bool state_only)
+	{
+		uint32_t offset = (uint32_t)m_data.size();
+		uint32_t len = (pevt->len + 7) & ~7u;
+
+		m_data.resize(offset + len);
+		memcpy(&m_data[offset], pevt, pevt->len);
+		m_evts.push_back({seq, offset, cpuid, handoff, state_only});
+	}
+};
+
+struct sinsp_pipeline::worker
+{
+	struct output
+	{
+		uint64_t m_seq;
+		std::string m_data;
+	};
+
+	uint32_t m_shard;
+	std::unique_ptr<sinsp> m_inspector;
+	std::thread m_thread;
+
+	//
+	// Input queue, filled by the capture thread
+	//
+	std::mutex m_in_mutex;
+	std::condition_variable m_in_cv;
+	std::deque<std::unique_ptr<batch>> m_in;
+
+	// Batch being filled by the capture thread
+	std::unique_ptr<batch> m_pending;
+	uint64_t m_sent_watermark = 0;
+
+	//
+	// Outputs, protected by sinsp_pipeline::m_out_mutex
+	//
+	std::deque<output> m_out;
+	uint64_t m_watermark = 0;
+	bool m_done = false;
+};
+
+sinsp_pipeline::sinsp_pipeline(sinsp* source, uint32_t nworkers, bool ordered):
+	m_source(source),
+	m_ordered(ordered),
+	m_stopping(false),
+	m_nevts(0),
+	m_next_worker(0),
+	m_out_stalled(false)
+{
+	if(nworkers == 0)
+	{
+		nworkers = 1;
+	}
+
+	for(uint32_t j = 0; j < nworkers; j++)
+	{
+		m_workers.emplace_back(new worker());
+		m_workers[j]->m_shard = j;
+	}
+}
+
+sinsp_pipeline::~sinsp_pipeline()
+{
+	stop();
+
+	if(m_capture_thread.joinable())
+	{
+		m_capture_thread.join();
+	}
+
+	for(auto& w : m_workers)
+	{
+		if(w->m_thread.joinable())
+		{
+			w->m_thread.join();
+		}
+	}
+}
+
+void sinsp_pipeline::start(output_fn_t output_fn, init_fn_t init_fn)
+{
+	uint32_t nworkers = (uint32_t)m_workers.size();
+
+	m_output_fn = output_fn;
+
+	//
+	// The router starts from the processes known by the source
+	// inspector, and looks up the threads it doesn't know in /proc.
+	// They're not added to the thread table of the source, whose state
+	// engine doesn't run and would never remove them.
+	//
+	scap_t* h = m_source->m_h;
+	m_router.reset(new sinsp_shard_router(nworkers, [h](int64_t tid) -> int64_t
+	{
+		scap_threadinfo* tinfo = scap_proc_get(h, tid, false);
+		if(tinfo == NULL)
+		{
+			return -1;
+		}
+
+		int64_t tgid = tinfo->pid;
+		scap_proc_free(h, tinfo);
+		return tgid;
+	}));
+
+	m_source->m_thread_manager->get_threads()->loop([this](sinsp_threadinfo& tinfo)
+	{
+		m_router->add_thread(tinfo.m_tid, tinfo.m_pid);
+		return true;
+	});
+
+	//
+	// The workers are opened without scanning /proc. It's scanned once
+	// here, and every process goes to the worker of its shard (see
+	// on_proc_entry()).
+	//
+	for(auto& w : m_workers)
+	{
+		w->m_inspector.reset(new sinsp());
+		if(init_fn)
+		{
+			init_fn(w->m_inspector.get(), w->m_shard);
+		}
+		w->m_inspector->m_skip_proc_scan = true;
+		w->m_inspector->open_nodriver();
+		w->m_pending.reset(new batch());
+	}
+
+	scan_proc();
+
+	for(auto& w : m_workers)
+	{
+		w->m_inspector->m_thread_manager->create_child_dependencies();
+		w->m_inspector->m_thread_manager->fix_sockets_coming_from_proc();
+	}
+
+	for(auto& w : m_workers)
+	{
+		worker* pw = w.get();
+		w->m_thread = std::thread([this, pw]() { run_worker(pw); });
+	}
+
+	m_capture_thread = std::thread([this]() { run_capture(); });
+}
+
+//
+// Scan /proc with the settings of the first worker, that init_fn configures
+// like the others
+//
+void sinsp_pipeline::scan_proc()
+{
+	sinsp* first = m_workers[0]->m_inspector.get();
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc;
+	scap_open_args oargs = {};
+
+	oargs.mode = SCAP_MODE_NODRIVER;
+	oargs.proc_callback = on_proc_entry;
+	oargs.proc_callback_context = this;
+	oargs.proc_scan_threads = first->m_proc_scan_threads;
+	oargs.lazy_fd_tables = first->m_lazy_fd_tables;
+
+	scap_t* h = scap_open(oargs, error, &rc);
+	if(h == NULL)
+	{
+		throw scap_open_exception(error, rc);
+	}
+	scap_close(h);
+}
+
+void sinsp_pipeline::on_proc_entry(void* context, scap_t* handle, int64_t tid, scap_threadinfo* tinfo, scap_fdinfo* fdinfo)
+{
+	sinsp_pipeline* pipeline = (sinsp_pipeline*)context;
+	uint32_t shard = pipeline->m_router->shard_of_tgid(tinfo->pid);
+	sinsp* inspector = pipeline->m_workers[shard]->m_inspector.get();
+
+	if(fdinfo == NULL)
+	{
+		pipeline->m_router->add_thread(tid, tinfo->pid);
+	}
+
+	inspector->on_new_entry_from_proc(inspector, inspector->m_h, tid, tinfo, fdinfo);
+
+	//
+	// The server ports are shared, as when every worker scanned all of
+	// /proc, so that the sockets connecting processes of different
+	// shards get the same direction
+	//
+	if(fdinfo != NULL &&
+	   (fdinfo->type == SCAP_FD_IPV4_SERVSOCK || fdinfo->type == SCAP_FD_IPV6_SERVSOCK))
+	{
+		uint16_t port = fdinfo->type == SCAP_FD_IPV4_SERVSOCK ?
+			fdinfo->info.ipv4serverinfo.port : fdinfo->info.ipv6serverinfo.port;
+
+		for(auto& w : pipeline->m_workers)
+		{
+			w->m_inspector->m_thread_manager->m_server_ports.insert(port);
+		}
+	}
+}
+
+void sinsp_pipeline::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_out_mutex);
+		m_stopping = true;
+	}
+	m_out_cv.notify_all();
+}
+
+void sinsp_pipeline::flush(uint32_t shard, bool eof)
+{
+	worker* w = m_workers[shard].get();
+	uint64_t watermark = m_nevts;
+
+	if(w->m_pending->m_evts.empty() && w->m_sent_watermark == watermark && !eof)
+	{
+		return;
+	}
+
+	std::unique_ptr<batch> b = std::move(w->m_pending);
+	b->m_watermark = watermark;
+	b->m_eof = eof;
+	w->m_sent_watermark = watermark;
+	w->m_pending.reset(new batch());
+
+	std::unique_lock<std::mutex> lock(w->m_in_mutex);
+	w->m_in_cv.wait(lock, [w]() { return w->m_in.size() < PIPELINE_QUEUE_BATCHES; });
+	w->m_in.push_back(std::move(b));
+	w->m_in_cv.notify_all();
+}
+
+void sinsp_pipeline::run_capture()
+{
+	uint32_t nworkers = (uint32_t)m_workers.size();
+	scap_t* h = m_source->m_h;
+	uint64_t nevts = 0;
+
+	while(!m_stopping)
+	{
+		scap_evt* pevt;
+		uint16_t cpuid;
+		int32_t res;
+
+		//
+		// The first event may have been read by the source inspector
+		// when it consumed the initial state events at open
+		//
+		if(m_source->m_replay_scap_evt != NULL)
+		{
+			pevt = m_source->m_replay_scap_evt;
+			cpuid = m_source->m_replay_scap_cpuid;
+			m_source->m_replay_scap_evt = NULL;
+			res = SCAP_SUCCESS;
+		}
+		else
+		{
+			res = scap_next(h, &pevt, &cpuid);
+		}
+
+		if(res == SCAP_TIMEOUT)
+		{
+			for(uint32_t j = 0; j < nworkers; j++)
+			{
+				flush(j, false);
+			}
+			continue;
+		}
+		else if(res != SCAP_SUCCESS)
+		{
+			if(res != SCAP_EOF)
+			{
+				std::lock_guard<std::mutex> lock(m_out_mutex);
+				m_lasterr = scap_getlasterr(h);
+			}
+			break;
+		}
+
+		uint32_t handoff;
+		uint32_t shard = m_router->route(pevt, &handoff);
+
+		nevts++;
+		m_workers[shard]->m_pending->add(pevt, nevts, cpuid, handoff, false);
+		if(handoff != sinsp_shard_router::NO_SHARD)
+		{
+			m_workers[handoff]->m_pending->add(pevt, nevts, cpuid, sinsp_shard_router::NO_SHARD, true);
+		}
+		m_nevts = nevts;
+
+		//
+		// The worker of the child waits for the parent from the
+		// worker of the parent, which must get the fork before it
+		//
+		if(handoff != sinsp_shard_router::NO_SHARD)
+		{
+			flush(shard, false);
+		}
+
+		if(nevts % PIPELINE_FLUSH_EVENTS == 0)
+		{
+			for(uint32_t j = 0; j < nworkers; j++)
+			{
+				flush(j, false);
+			}
+		}
+		else
+		{
+			if(m_workers[shard]->m_pending->m_evts.size() >= PIPELINE_BATCH_EVENTS)
+			{
+				flush(shard, false);
+			}
+			if(handoff != sinsp_shard_router::NO_SHARD &&
+			   m_workers[handoff]->m_pending->m_evts.size() >= PIPELINE_BATCH_EVENTS)
+			{
+				flush(handoff, false);
+			}
+		}
+	}
+
+	for(uint32_t j = 0; j < nworkers; j++)
+	{
+		flush(j, true);
+	}
+}
+
+void sinsp_pipeline::run_worker(worker* w)
+{
+	sinsp* inspector = w->m_inspector.get();
+	std::vector<worker::output> outputs;
+	std::string data;
+	bool eof = false;
+	bool failed = false;
+
+	while(!eof)
+	{
+		std::unique_ptr<batch> b;
+
+		{
+			std::unique_lock<std::mutex> lock(w->m_in_mutex);
+			w->m_in_cv.wait(lock, [w]() { return !w->m_in.empty(); });
+			b = std::move(w->m_in.front());
+			w->m_in.pop_front();
+			w->m_in_cv.notify_all();
+		}
+
+		//
+		// After a failure keep draining the queue, so that the capture
+		// thread doesn't block, until it sees the stop request
+		//
+		size_t next_unsent = 0;
+		try
+		{
+			for(size_t j = 0; j < b->m_evts.size() && !failed; j++)
+			{
+				const batch::evt_ref& ref = b->m_evts[j];
+				scap_evt* pevt = (scap_evt*)&b->m_data[ref.m_offset];
+				int64_t fork_parent = -1;
+				sinsp_evt* evt;
+				int32_t res;
+
+				//
+				// On a fork handed off to another shard, the child
+				// inherits the state of a parent that only this
+				// shard knows. The parent is passed to the worker
+				// of the child, which keeps it for the time of
+				// the fork.
+				//
+				if(ref.m_handoff != sinsp_shard_router::NO_SHARD)
+				{
+					send_fork_parent(inspector->find_thread(pevt->tid, true).get(), ref.m_seq, ref.m_handoff);
+				}
+				else if(ref.m_state_only)
+				{
+					std::unique_ptr<sinsp_threadinfo> parent = receive_fork_parent(ref.m_seq);
+					if(parent && inspector->find_thread(parent->m_tid, true) == nullptr &&
+					   inspector->m_thread_manager->add_thread(parent.get(), true))
+					{
+						fork_parent = parent.release()->m_tid;
+					}
+				}
+				next_unsent = j + 1;
+
+				inspector->m_replay_scap_evt = pevt;
+				inspector->m_replay_scap_cpuid = ref.m_cpuid;
+
+				//
+				// next() returns any pending meta event before the
+				// injected one
+				//
+				do
+				{
+					res = inspector->next(&evt);
+					if(res != SCAP_SUCCESS || ref.m_state_only)
+					{
+						continue;
+					}
+
+					data.clear();
+					if(m_output_fn(evt, data))
+					{
+						outputs.push_back({ref.m_seq, std::move(data)});
+					}
+				}
+				while(inspector->m_replay_scap_evt != NULL);
+
+				if(ref.m_handoff != sinsp_shard_router::NO_SHARD)
+				{
+					struct scap_sized_buffer params[PPM_MAX_EVENT_PARAMS];
+					int64_t childtid;
+
+					scap_event_decode_params(pevt, params);
+					memcpy(&childtid, params[0].buf, sizeof(childtid));
+					inspector->remove_thread(childtid, true);
+				}
+				else if(fork_parent != -1)
+				{
+					inspector->remove_thread(fork_parent, true);
+				}
+			}
+		}
+		catch(const std::exception& e)
+		{
+			//
+			// Errors of the output function end up here too, they
+			// must not escape the thread
+			//
+			std::lock_guard<std::mutex> lock(m_out_mutex);
+			m_lasterr = e.what();
+			m_stopping = true;
+			failed = true;
+		}
+		catch(...)
+		{
+			std::lock_guard<std::mutex> lock(m_out_mutex);
+			m_lasterr = "unknown error in the worker of shard " + std::to_string(w->m_shard);
+			m_stopping = true;
+			failed = true;
+		}
+
+		//
+		// The workers of the children of the forks that weren't run
+		// must not wait for their parents
+		//
+		for(size_t j = next_unsent; j < b->m_evts.size(); j++)
+		{
+			if(b->m_evts[j].m_handoff != sinsp_shard_router::NO_SHARD)
+			{
+				send_fork_parent(NULL, b->m_evts[j].m_seq, b->m_evts[j].m_handoff);
+			}
+		}
+
+		eof = b->m_eof;
+
+		{
+			//
+			// In ordered mode next() may be waiting for a worker that
+			// can't progress until this one takes its next batch, it
+			// lets the full queues grow in that case
+			//
+			std::unique_lock<std::mutex> lock(m_out_mutex);
+			m_out_cv.wait(lock, [this, w, &outputs]()
+			{
+				return outputs.empty() || m_stopping || m_out_stalled ||
+				       w->m_out.size() < PIPELINE_QUEUE_OUTPUTS;
+			});
+			for(auto& o : outputs)
+			{
+				w->m_out.push_back(std::move(o));
+			}
+			w->m_watermark = b->m_watermark;
+			w->m_done = eof;
+		}
+		outputs.clear();
+		m_out_cv.notify_all();
+	}
+
+	inspector->close();
+}
+
+//
+// Pass a copy of the parent of a fork to the worker of the child, or NULL
+// if it's unknown. Only what the child inherits is copied.
+//
+void sinsp_pipeline::send_fork_parent(sinsp_threadinfo* ptinfo, uint64_t seq, uint32_t handoff)
+{
+	std::unique_ptr<sinsp_threadinfo> parent;
+
+	if(ptinfo != NULL)
+	{
+		sinsp* inspector = m_workers[handoff]->m_inspector.get();
+		sinsp_fdtable* fdtable = ptinfo->get_fd_table();
+
+		//
+		// The copy has no main thread to look up in the other shard,
+		// it's a process of its own with the fds and cwd of the
+		// parent's process
+		//
+		parent.reset(new sinsp_threadinfo(inspector));
+		parent->m_tid = ptinfo->m_tid;
+		parent->m_pid = ptinfo->m_tid;
+		parent->m_ptid = ptinfo->m_ptid;
+		parent->m_sid = ptinfo->m_sid;
+		parent->m_vpgid = ptinfo->m_vpgid;
+		parent->m_vtid = ptinfo->m_vtid;
+		parent->m_vpid = ptinfo->m_vpid;
+		parent->m_comm = ptinfo->m_comm;
+		parent->m_exe = ptinfo->m_exe;
+		parent->m_exepath = ptinfo->m_exepath;
+		parent->m_exe_writable = ptinfo->m_exe_writable;
+		parent->m_args = ptinfo->m_args;
+		parent->m_env = ptinfo->m_env;
+		parent->m_cgroups = ptinfo->m_cgroups;
+		parent->m_container_id = ptinfo->m_container_id;
+		parent->m_root = ptinfo->m_root;
+		parent->m_tty = ptinfo->m_tty;
+		parent->m_user = ptinfo->m_user;
+		parent->m_group = ptinfo->m_group;
+		parent->m_loginuser = ptinfo->m_loginuser;
+		parent->m_cap_permitted = ptinfo->m_cap_permitted;
+		parent->m_cap_effective = ptinfo->m_cap_effective;
+		parent->m_cap_inheritable = ptinfo->m_cap_inheritable;
+		parent->m_cwd = ptinfo->get_cwd();
+		if(fdtable != NULL)
+		{
+			parent->m_fdtable = *fdtable;
+			parent->m_fdtable.m_inspector = inspector;
+			parent->m_fdtable.m_tid = parent->m_tid;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_fork_mutex);
+		m_fork_parents[seq] = std::move(parent);
+	}
+	m_fork_cv.notify_all();
+}
+
+std::unique_ptr<sinsp_threadinfo> sinsp_pipeline::receive_fork_parent(uint64_t seq)
+{
+	std::unique_lock<std::mutex> lock(m_fork_mutex);
+	m_fork_cv.wait(lock, [this, seq]() { return m_fork_parents.find(seq) != m_fork_parents.end(); });
+
+	auto it = m_fork_parents.find(seq);
+	std::unique_ptr<sinsp_threadinfo> parent = std::move(it->second);
+	m_fork_parents.erase(it);
+	return parent;
+}
+
+bool sinsp_pipeline::next(std::string& output)
+{
+	uint32_t nworkers = (uint32_t)m_workers.size();
+	std::unique_lock<std::mutex> lock(m_out_mutex);
+
+	while(true)
+	{
+		bool all_done = true;
+
+		if(m_ordered)
+		{
+			//
+			// Return the output with the lowest sequence number, once
+			// all the other workers are past it
+			//
+			worker* best = NULL;
+			for(auto& w : m_workers)
+			{
+				if(!w->m_out.empty() && (best == NULL || w->m_out.front().m_seq < best->m_out.front().m_seq))
+				{
+					best = w.get();
+				}
+				all_done = all_done && w->m_done;
+			}
+
+			if(best != NULL)
+			{
+				uint64_t seq = best->m_out.front().m_seq;
+				bool ready = true;
+				for(auto& w : m_workers)
+				{
+					if(w->m_out.empty() && !w->m_done && w->m_watermark < seq)
+					{
+						ready = false;
+						break;
+					}
+				}
+
+				if(ready)
+				{
+					output = std::move(best->m_out.front().m_data);
+					best->m_out.pop_front();
+					m_out_stalled = false;
+					m_out_cv.notify_all();
+					return true;
+				}
+
+				m_out_stalled = true;
+				m_out_cv.notify_all();
+			}
+		}
+		else
+		{
+			for(uint32_t j = 0; j < nworkers; j++)
+			{
+				worker* w = m_workers[(m_next_worker + j) % nworkers].get();
+				if(!w->m_out.empty())
+				{
+					output = std::move(w->m_out.front().m_data);
+					w->m_out.pop_front();
+					m_out_cv.notify_all();
+					m_next_worker = (m_next_worker + j + 1) % nworkers;
+					return true;
+				}
+				all_done = all_done && w->m_done;
+			}
+		}
+
+		if(all_done)
+		{
+			return false;
+		}
+
+		m_out_cv.wait(lock);
+	}
+}
+
+std::string sinsp_pipeline::getlasterr()
+{
+	std::lock_guard<std::mutex> lock(m_out_mutex);
+	return m_lasterr;
+}
+
+uint64_t sinsp_pipeline::get_num_events() const
+{
+	return m_nevts;
+}
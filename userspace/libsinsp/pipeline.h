@@ -0,0 +1,177 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "sinsp.h"
+
+//
+// Assigns the events to the shards of a sinsp_pipeline. All the threads of a
+// process (same tgid) go to the same shard, so that each shard sees the
+// complete history of the processes it owns.
+//
+class SINSP_PUBLIC sinsp_shard_router
+{
+public:
+	static const uint32_t NO_SHARD = 0xffffffff;
+
+	//
+	// Called to find the tgid of threads that were never seen before.
+	// Returns -1 if it's unknown.
+	//
+	typedef std::function<int64_t(int64_t tid)> tgid_lookup_t;
+
+	sinsp_shard_router(uint32_t nshards, tgid_lookup_t lookup = nullptr);
+
+	//
+	// Record that tid belongs to the process tgid
+	//
+	void add_thread(int64_t tid, int64_t tgid);
+
+	uint32_t shard_of_tgid(int64_t tgid) const;
+
+	//
+	// Return the shard owning the thread that generated the event.
+	// When the event is a fork that creates a process owned by a
+	// different shard, handoff is set to that shard, otherwise to
+	// NO_SHARD: the event must be delivered to both, so that the new
+	// shard can build the child's state.
+	//
+	uint32_t route(const scap_evt* pevt, uint32_t* handoff);
+
+	// Return the number of threads the router knows about
+	size_t size() const;
+
+private:
+	int64_t get_tgid(int64_t tid);
+	uint32_t route_clone_exit(const scap_evt* pevt, uint32_t* handoff);
+
+	uint32_t m_nshards;
+	tgid_lookup_t m_lookup;
+	std::unordered_map<int64_t, int64_t> m_tgids;
+};
+
+//
+// Runs the state engine of a live capture on multiple threads.
+//
+// A capture thread reads the events from the source inspector and shards
+// them by tgid (see sinsp_shard_router) to nworkers worker threads. Every
+// worker runs its own inspector, which only keeps the state of the
+// processes of its shard, and calls the output function on each event
+// that passes its filter. /proc is scanned once, and each worker only gets
+// the processes of its shard. When a process forks a child owned by
+// another shard, the worker of the parent passes the state the child
+// inherits (fds, cwd, environment...) to the worker of the child. The
+// outputs of all the workers are returned by next(), either in capture
+// order or as soon as they are available.
+//
+// The source inspector must be opened, and is only used to read the
+// events: its state engine, filter and dumper are not run.
+//
+class SINSP_PUBLIC sinsp_pipeline
+{
+public:
+	//
+	// Called by start() before opening each worker's inspector, to
+	// configure it, e.g. to set its filter.
+	//
+	typedef std::function<void(sinsp* inspector, uint32_t shard)> init_fn_t;
+
+	//
+	// Called on the worker threads for every event returned by the
+	// worker's inspector. Returns true if output must be emitted.
+	//
+	typedef std::function<bool(sinsp_evt* evt, std::string& output)> output_fn_t;
+
+	sinsp_pipeline(sinsp* source, uint32_t nworkers, bool ordered = false);
+	~sinsp_pipeline();
+
+	//
+	// Create the workers and start the capture.
+	//
+	// @throws a sinsp_exception if a worker inspector can't be opened or
+	// /proc can't be scanned.
+	//
+	void start(output_fn_t output_fn, init_fn_t init_fn = nullptr);
+
+	//
+	// Stop the capture. The outputs of the events that were already read
+	// are still returned by next(). Can be called from any thread.
+	//
+	void stop();
+
+	//
+	// Wait for the next output. Returns false once the capture has
+	// stopped and all the outputs have been returned.
+	//
+	bool next(std::string& output);
+
+	// Return the error that stopped the capture, if any
+	std::string getlasterr();
+
+	// Return the number of events read from the source
+	uint64_t get_num_events() const;
+
+private:
+	struct batch;
+	struct worker;
+
+	void run_capture();
+	void run_worker(worker* w);
+	void flush(uint32_t shard, bool eof);
+	void scan_proc();
+	static void on_proc_entry(void* context, scap_t* handle, int64_t tid, scap_threadinfo* tinfo, scap_fdinfo* fdinfo);
+	void send_fork_parent(sinsp_threadinfo* ptinfo, uint64_t seq, uint32_t handoff);
+	std::unique_ptr<sinsp_threadinfo> receive_fork_parent(uint64_t seq);
+
+	sinsp* m_source;
+	bool m_ordered;
+	output_fn_t m_output_fn;
+	std::vector<std::unique_ptr<worker>> m_workers;
+	std::unique_ptr<sinsp_shard_router> m_router;
+	std::thread m_capture_thread;
+	std::atomic<bool> m_stopping;
+	std::atomic<uint64_t> m_nevts;
+	std::string m_lasterr;
+
+	// Protects the outputs and the watermarks of all the workers
+	std::mutex m_out_mutex;
+	std::condition_variable m_out_cv;
+	uint32_t m_next_worker;
+	// next() waits for the watermark of a worker in ordered mode
+	bool m_out_stalled;
+
+	//
+	// Copies of the parents of the forks handed off to another shard, by
+	// sequence number of the fork event
+	//
+	std::mutex m_fork_mutex;
+	std::condition_variable m_fork_cv;
+	std::unordered_map<uint64_t, std::unique_ptr<sinsp_threadinfo>> m_fork_parents;
+};
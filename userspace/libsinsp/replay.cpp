@@ -0,0 +1,259 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cstdlib>
+
+#include "replay.h"
+
+// Number of outputs a shard can queue, before its worker blocks, while
+// next() is still returning the outputs of the previous shards
+#define REPLAY_QUEUE_OUTPUTS 4096
+// Number of outputs a worker collects before queueing them
+#define REPLAY_BATCH_OUTPUTS 256
+
+sinsp_replay::sinsp_replay(const std::string& filename, uint32_t nworkers):
+	m_filename(filename),
+	m_nworkers(nworkers == 0 ? 1 : nworkers),
+	m_next_shard(0),
+	m_stopping(false),
+	m_nevts(0),
+	m_cur_shard(0)
+{
+}
+
+sinsp_replay::~sinsp_replay()
+{
+	stop();
+
+	for(auto& t : m_threads)
+	{
+		if(t.joinable())
+		{
+			t.join();
+		}
+	}
+}
+
+void sinsp_replay::start(output_fn_t output_fn, init_fn_t init_fn)
+{
+	char error[SCAP_LASTERR_SIZE];
+	scap_index_entry* entries;
+	uint32_t nentries;
+	compression_mode compress;
+
+	m_output_fn = output_fn;
+	m_init_fn = init_fn;
+
+	//
+	// Every checkpoint starts a shard, that ends where the next one
+	// starts. The shards are opened at their checkpoint by position, not
+	// by timestamp, since checkpoints can share a timestamp.
+	//
+	m_shards.emplace_back(new shard());
+	m_shards[0]->m_checkpoint = 0;
+	if(scap_read_index(m_filename.c_str(), &entries, &nentries, &compress, error) == SCAP_SUCCESS)
+	{
+		for(uint32_t j = 1; j < nentries; j++)
+		{
+			m_shards.emplace_back(new shard());
+			m_shards.back()->m_checkpoint = j;
+		}
+		free(entries);
+	}
+
+	uint32_t nthreads = std::min(m_nworkers, (uint32_t)m_shards.size());
+	for(uint32_t j = 0; j < nthreads; j++)
+	{
+		m_threads.emplace_back([this]() { run_worker(); });
+	}
+}
+
+void sinsp_replay::stop()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stopping = true;
+	m_cv.notify_all();
+}
+
+void sinsp_replay::run_worker()
+{
+	while(true)
+	{
+		uint32_t id = m_next_shard++;
+		if(id >= m_shards.size())
+		{
+			break;
+		}
+
+		if(!m_stopping)
+		{
+			try
+			{
+				replay_shard(id);
+			}
+			catch(const std::exception& e)
+			{
+				//
+				// Errors of the output and init functions end up
+				// here too, they must not escape the thread
+				//
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_lasterr = e.what();
+				m_stopping = true;
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_lasterr = "unknown error replaying shard " + std::to_string(id);
+				m_stopping = true;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shards[id]->m_done = true;
+		m_cv.notify_all();
+	}
+}
+
+void sinsp_replay::replay_shard(uint32_t id)
+{
+	shard* s = m_shards[id].get();
+	std::unique_ptr<sinsp> inspector;
+	std::vector<std::string> outputs;
+	std::string data;
+
+	//
+	// Creating and opening an inspector touches process wide tables, do
+	// it on one thread at a time
+	//
+	{
+		std::lock_guard<std::mutex> lock(m_open_mutex);
+		inspector.reset(new sinsp());
+		if(m_init_fn)
+		{
+			m_init_fn(inspector.get(), id);
+		}
+
+		inspector->set_start_checkpoint(s->m_checkpoint);
+		inspector->set_stop_at_checkpoint(m_shards.size() > 1);
+		inspector->open(m_filename);
+	}
+
+	while(!m_stopping)
+	{
+		sinsp_evt* evt;
+		int32_t res = inspector->next(&evt);
+
+		if(res == SCAP_TIMEOUT)
+		{
+			continue;
+		}
+		else if(res == SCAP_EOF)
+		{
+			break;
+		}
+		else if(res != SCAP_SUCCESS)
+		{
+			throw sinsp_exception(inspector->getlasterr());
+		}
+
+		m_nevts++;
+
+		data.clear();
+		if(m_output_fn(evt, data))
+		{
+			outputs.push_back(std::move(data));
+			if(outputs.size() == REPLAY_BATCH_OUTPUTS)
+			{
+				queue_outputs(id, outputs);
+			}
+		}
+	}
+
+	queue_outputs(id, outputs);
+	inspector->close();
+}
+
+void sinsp_replay::queue_outputs(uint32_t id, std::vector<std::string>& outputs)
+{
+	shard* s = m_shards[id].get();
+
+	if(outputs.empty())
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cv.wait(lock, [this, s, id]()
+	{
+		return m_stopping || m_cur_shard == id || s->m_out.size() < REPLAY_QUEUE_OUTPUTS;
+	});
+
+	for(auto& o : outputs)
+	{
+		s->m_out.push_back(std::move(o));
+	}
+	outputs.clear();
+	m_cv.notify_all();
+}
+
+bool sinsp_replay::next(std::string& output)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while(m_cur_shard < m_shards.size())
+	{
+		shard* s = m_shards[m_cur_shard].get();
+
+		if(!s->m_out.empty())
+		{
+			output = std::move(s->m_out.front());
+			s->m_out.pop_front();
+			return true;
+		}
+
+		if(s->m_done)
+		{
+			//
+			// The worker of the next shard may be waiting for
+			// next() to get to it
+			//
+			m_cur_shard++;
+			m_cv.notify_all();
+			continue;
+		}
+
+		m_cv.wait(lock);
+	}
+
+	return false;
+}
+
+std::string sinsp_replay::getlasterr()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_lasterr;
+}
+
+uint64_t sinsp_replay::get_num_events() const
+{
+	return m_nevts;
+}
+
+uint32_t sinsp_replay::get_num_shards() const
+{
+	return (uint32_t)m_shards.size();
+}
@@ -0,0 +1,119 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sinsp.h"
+
+//
+// Replays a capture file on multiple threads.
+//
+// The file is split in time shards at its state checkpoints (see
+// sinsp_dumper::set_checkpoint_interval()). Every shard is replayed by its
+// own inspector, that loads the state from the checkpoint the shard starts
+// at and stops at the next one. The outputs of the shards are returned by
+// next() in file order.
+//
+// Files without an index are replayed as a single shard. Uncompressed and
+// chunked gzip files are read from each checkpoint directly, other gzip
+// files are inflated from their beginning by every shard.
+//
+class SINSP_PUBLIC sinsp_replay
+{
+public:
+	//
+	// Called before opening the inspector of each shard, to configure
+	// it, e.g. to set its filter.
+	//
+	typedef std::function<void(sinsp* inspector, uint32_t shard)> init_fn_t;
+
+	//
+	// Called on the worker threads for every event returned by the
+	// inspector of a shard. Returns true if output must be emitted.
+	//
+	typedef std::function<bool(sinsp_evt* evt, std::string& output)> output_fn_t;
+
+	sinsp_replay(const std::string& filename, uint32_t nworkers);
+	~sinsp_replay();
+
+	//
+	// Load the index of the file and start the workers.
+	//
+	void start(output_fn_t output_fn, init_fn_t init_fn = nullptr);
+
+	//
+	// Stop the replay. The shards that didn't start are skipped. Can be
+	// called from any thread.
+	//
+	void stop();
+
+	//
+	// Wait for the next output. Returns false once all the shards are
+	// done and their outputs have been returned.
+	//
+	bool next(std::string& output);
+
+	// Return the error that stopped the replay, if any
+	std::string getlasterr();
+
+	// Return the number of events replayed by all the shards
+	uint64_t get_num_events() const;
+
+	uint32_t get_num_shards() const;
+
+private:
+	struct shard
+	{
+		// Position in the index of the checkpoint the shard starts at
+		uint32_t m_checkpoint;
+		std::deque<std::string> m_out;
+		bool m_done = false;
+	};
+
+	void run_worker();
+	void replay_shard(uint32_t id);
+	void queue_outputs(uint32_t id, std::vector<std::string>& outputs);
+
+	std::string m_filename;
+	uint32_t m_nworkers;
+	output_fn_t m_output_fn;
+	init_fn_t m_init_fn;
+	std::vector<std::unique_ptr<shard>> m_shards;
+	std::vector<std::thread> m_threads;
+	std::atomic<uint32_t> m_next_shard;
+	std::atomic<bool> m_stopping;
+	std::atomic<uint64_t> m_nevts;
+	std::mutex m_open_mutex;
+
+	// Protects the outputs of the shards, m_cur_shard and m_lasterr
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	// Shard whose outputs are being returned by next()
+	uint32_t m_cur_shard;
+	std::string m_lasterr;
+};
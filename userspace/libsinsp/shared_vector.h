@@ -0,0 +1,226 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//
+// A read only vector whose copies share the same storage. It's never
+// modified in place: a writer builds a new vector and assigns it, so the
+// other copies keep the old content.
+//
+template<typename T>
+class sinsp_shared_vector
+{
+public:
+	typedef std::vector<T> vector_t;
+	typedef typename vector_t::const_iterator const_iterator;
+
+	sinsp_shared_vector()
+	{
+	}
+
+	sinsp_shared_vector(vector_t&& v)
+	{
+		*this = std::move(v);
+	}
+
+	sinsp_shared_vector(std::shared_ptr<const vector_t> v):
+		m_vec(std::move(v))
+	{
+	}
+
+	sinsp_shared_vector& operator=(vector_t&& v)
+	{
+		if(v.empty())
+		{
+			m_vec.reset();
+		}
+		else
+		{
+			m_vec = std::make_shared<const vector_t>(std::move(v));
+		}
+		return *this;
+	}
+
+	const vector_t& get() const
+	{
+		if(m_vec == nullptr)
+		{
+			static const vector_t empty;
+			return empty;
+		}
+		return *m_vec;
+	}
+
+	operator const vector_t&() const
+	{
+		return get();
+	}
+
+	size_t size() const
+	{
+		return m_vec == nullptr ? 0 : m_vec->size();
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	const T& operator[](size_t j) const
+	{
+		return (*m_vec)[j];
+	}
+
+	const_iterator begin() const
+	{
+		return get().begin();
+	}
+
+	const_iterator end() const
+	{
+		return get().end();
+	}
+
+	void clear()
+	{
+		m_vec.reset();
+	}
+
+	// True if this and other use the same storage
+	bool shares(const sinsp_shared_vector& other) const
+	{
+		return m_vec == other.m_vec;
+	}
+
+private:
+	std::shared_ptr<const vector_t> m_vec;
+};
+
+//
+// Hands out a single shared copy of every distinct vector it's given, for
+// as long as somebody uses it. Only weak references are kept, the ones no
+// longer in use are dropped when they are found during a lookup and when
+// the pool doubles its size.
+//
+template<typename T>
+class sinsp_intern_pool
+{
+public:
+	typedef std::vector<T> vector_t;
+
+	sinsp_shared_vector<T> intern(vector_t&& v)
+	{
+		if(v.empty())
+		{
+			return sinsp_shared_vector<T>();
+		}
+
+		size_t h = hash(v);
+		auto range = m_entries.equal_range(h);
+		for(auto it = range.first; it != range.second;)
+		{
+			std::shared_ptr<const vector_t> cur = it->second.lock();
+			if(cur == nullptr)
+			{
+				it = m_entries.erase(it);
+			}
+			else if(*cur == v)
+			{
+				return sinsp_shared_vector<T>(std::move(cur));
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		std::shared_ptr<const vector_t> res = std::make_shared<const vector_t>(std::move(v));
+		m_entries.emplace(h, res);
+		if(m_entries.size() >= m_purge_size)
+		{
+			purge();
+		}
+		return sinsp_shared_vector<T>(std::move(res));
+	}
+
+	size_t size() const
+	{
+		return m_entries.size();
+	}
+
+	void clear()
+	{
+		m_entries.clear();
+		m_purge_size = MIN_PURGE_SIZE;
+	}
+
+private:
+	static const size_t MIN_PURGE_SIZE = 64;
+
+	static void combine(size_t& seed, const std::string& s)
+	{
+		seed ^= std::hash<std::string>()(s) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	}
+
+	static void combine(size_t& seed, const std::pair<std::string, std::string>& p)
+	{
+		combine(seed, p.first);
+		combine(seed, p.second);
+	}
+
+	static size_t hash(const vector_t& v)
+	{
+		size_t seed = v.size();
+		for(const auto& e : v)
+		{
+			combine(seed, e);
+		}
+		return seed;
+	}
+
+	void purge()
+	{
+		for(auto it = m_entries.begin(); it != m_entries.end();)
+		{
+			if(it->second.expired())
+			{
+				it = m_entries.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		m_purge_size = 2 * m_entries.size();
+		if(m_purge_size < MIN_PURGE_SIZE)
+		{
+			m_purge_size = MIN_PURGE_SIZE;
+		}
+	}
+
+	std::unordered_multimap<size_t, std::weak_ptr<const vector_t>> m_entries;
+	size_t m_purge_size = MIN_PURGE_SIZE;
+};
@@ -108,6 +108,17 @@ sinsp::sinsp(bool static_container, const std::string &static_id, const std::str
 	m_input_fd = 0;
 	m_bpf = false;
 	m_udig = false;
+	m_relaxed_ordering = false;
+	m_wait_policy = SCAP_WAIT_BACKOFF;
+	m_decompression_threads = 0;
+	m_proc_scan_threads = 1;
+	m_lazy_fd_tables = false;
+	m_lazy_fd_tables_prefill = 0;
+	m_skip_proc_scan = false;
+	m_start_ts = 0;
+	m_start_checkpoint = 0;
+	m_stop_at_checkpoint = false;
+	m_track_event_latency = false;
 	m_isdebug_enabled = false;
 	m_isfatfile_enabled = false;
 	m_isinternal_events_enabled = false;
@@ -168,6 +179,9 @@ sinsp::sinsp(bool static_container, const std::string &static_id, const std::str
 	m_filter_proc_table_when_saving = false;
 
 	m_replay_scap_evt = NULL;
+	m_scap_batch.nevts = 0;
+	m_scap_batch.evts = NULL;
+	m_scap_batch_pos = 0;
 
 	m_plugin_manager = new sinsp_plugin_manager();
 }
@@ -329,6 +343,11 @@ void sinsp::consume_initialstate_events()
 
 void sinsp::init()
 {
+	//
+	// Build the parser table for the events the consumer wants
+	//
+	m_parser->init_event_handlers();
+
 	//
 	// Retrieve machine information
 	//
@@ -470,6 +489,57 @@ void sinsp::set_import_users(bool import_users)
 	m_usergroup_manager.m_import_users = import_users;
 }
 
+void sinsp::set_relaxed_ordering(bool enable)
+{
+	m_relaxed_ordering = enable;
+}
+
+void sinsp::set_wait_policy(scap_wait_policy policy)
+{
+	m_wait_policy = policy;
+}
+
+void sinsp::set_decompression_threads(uint32_t nthreads)
+{
+	m_decompression_threads = nthreads;
+}
+
+void sinsp::set_proc_scan_threads(uint32_t nthreads)
+{
+	m_proc_scan_threads = nthreads;
+}
+
+void sinsp::set_lazy_fd_tables(bool enable, uint32_t prefill_batch)
+{
+	m_lazy_fd_tables = enable;
+	m_lazy_fd_tables_prefill = prefill_batch;
+}
+
+void sinsp::set_start_ts(uint64_t ts)
+{
+	m_start_ts = ts;
+}
+
+void sinsp::set_start_checkpoint(uint32_t checkpoint)
+{
+	m_start_checkpoint = checkpoint;
+}
+
+void sinsp::set_stop_at_checkpoint(bool enable)
+{
+	m_stop_at_checkpoint = enable;
+}
+
+void sinsp::set_events_of_interest(const std::set<uint16_t>& evttypes)
+{
+	m_events_of_interest = evttypes;
+}
+
+void sinsp::set_event_latency_tracking(bool enable)
+{
+	m_track_event_latency = enable;
+}
+
 void sinsp::fill_syscalls_of_interest(scap_open_args *oargs)
 {
 	// Fallback to set all events as interesting
@@ -513,6 +583,7 @@ void sinsp::open_live_common(uint32_t timeout_ms, scap_mode_t mode)
 	// Reset the thread manager
 	//
 	m_thread_manager->clear();
+	m_lazy_fd_table_tids = std::queue<int64_t>();
 
 	//
 	// Start the capture
@@ -525,6 +596,10 @@ void sinsp::open_live_common(uint32_t timeout_ms, scap_mode_t mode)
 	oargs.proc_callback = NULL;
 	oargs.proc_callback_context = NULL;
 	oargs.udig = m_udig;
+	oargs.relaxed_ordering = m_relaxed_ordering;
+	oargs.wait_policy = m_wait_policy;
+	oargs.proc_scan_threads = m_proc_scan_threads;
+	oargs.lazy_fd_tables = m_lazy_fd_tables && !m_filter_proc_table_when_saving;
 
 	fill_syscalls_of_interest(&oargs);
 
@@ -594,6 +669,7 @@ void sinsp::open_nodriver()
 	// Reset the thread manager
 	//
 	m_thread_manager->clear();
+	m_lazy_fd_table_tids = std::queue<int64_t>();
 
 	//
 	// Start the capture
@@ -610,6 +686,9 @@ void sinsp::open_nodriver()
 		oargs.proc_callback_context = this;
 	}
 	oargs.import_users = m_usergroup_manager.m_import_users;
+	oargs.proc_scan_threads = m_proc_scan_threads;
+	oargs.lazy_fd_tables = m_lazy_fd_tables && !m_filter_proc_table_when_saving;
+	oargs.skip_proc_scan = m_skip_proc_scan;
 	fill_syscalls_of_interest(&oargs);
 
 	int32_t scap_rc;
@@ -748,6 +827,9 @@ void sinsp::open_int()
 	oargs.proc_callback_context = NULL;
 	oargs.import_users = m_usergroup_manager.m_import_users;
 	oargs.start_offset = 0;
+	oargs.decompression_threads = m_decompression_threads;
+	oargs.start_ts = m_start_ts;
+	oargs.start_checkpoint = m_start_checkpoint;
 	fill_syscalls_of_interest(&oargs);
 
 	add_suppressed_comms(oargs);
@@ -811,6 +893,9 @@ void sinsp::close()
 		m_h = NULL;
 	}
 
+	m_scap_batch.nevts = 0;
+	m_scap_batch_pos = 0;
+
 	if(NULL != m_dumper)
 	{
 		scap_dump_close(m_dumper);
@@ -843,6 +928,7 @@ void sinsp::deinit_state()
 	}
 
 	m_thread_manager->clear();
+	m_lazy_fd_table_tids = std::queue<int64_t>();
 }
 
 void sinsp::autodump_start(const string& dump_filename, bool compress)
@@ -929,6 +1015,12 @@ void sinsp::on_new_entry_from_proc(void* context,
 		bool thread_added = false;
 		sinsp_threadinfo* newti = build_threadinfo();
 		newti->init(tinfo);
+
+		//
+		// The fds of the process weren't read, see set_lazy_fd_tables()
+		//
+		bool lazy_fdtable = m_lazy_fd_tables && newti->is_main_thread();
+		newti->m_lazy_fdtable = lazy_fdtable;
 		if(is_nodriver())
 		{
 			auto sinsp_tinfo = find_thread(tid, true);
@@ -944,6 +1036,10 @@ void sinsp::on_new_entry_from_proc(void* context,
 		if (!thread_added) {
 			delete newti;
 		}
+		else if(lazy_fdtable)
+		{
+			m_lazy_fd_table_tids.push(tid);
+		}
 	}
 	else
 	{
@@ -1000,6 +1096,27 @@ void sinsp::import_thread_table()
 	}
 }
 
+//
+// Read some of the fd tables left to read, the ones already read on use
+// don't count
+//
+void sinsp::prefill_fd_tables()
+{
+	uint32_t nloaded = 0;
+
+	while(nloaded < m_lazy_fd_tables_prefill && !m_lazy_fd_table_tids.empty())
+	{
+		auto tinfo = find_thread(m_lazy_fd_table_tids.front(), true);
+		m_lazy_fd_table_tids.pop();
+
+		if(tinfo && tinfo->m_lazy_fdtable)
+		{
+			tinfo->load_fdtable();
+			nloaded++;
+		}
+	}
+}
+
 void sinsp::import_ifaddr_list()
 {
 	m_network_interfaces = new sinsp_network_interfaces(this);
@@ -1239,17 +1356,49 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 			evt->m_cpuid = m_replay_scap_cpuid;
 			m_replay_scap_evt = NULL;
 		}
-		else 
+		else if(m_scap_batch_pos < m_scap_batch.nevts)
+		{
+			// Keep going through the current batch
+			res = SCAP_SUCCESS;
+			evt->m_pevt = m_scap_batch.evts[m_scap_batch_pos++];
+			evt->m_cpuid = m_scap_batch.cpuid;
+		}
+		else if(m_relaxed_ordering)
+		{
+			// Fetch a new batch and return its first event
+			m_scap_batch_pos = 0;
+			res = scap_next_batch(m_h, &m_scap_batch);
+			if(res == SCAP_SUCCESS)
+			{
+				evt->m_pevt = m_scap_batch.evts[m_scap_batch_pos++];
+				evt->m_cpuid = m_scap_batch.cpuid;
+			}
+			else
+			{
+				m_scap_batch.nevts = 0;
+			}
+		}
+		else
 		{
 			// If no last event was saved, invoke
 			// the actual scap_next
 			res = scap_next(m_h, &(evt->m_pevt), &(evt->m_cpuid));
 		}
 
+		if(res == SCAP_UNEXPECTED_BLOCK && m_stop_at_checkpoint)
+		{
+			res = SCAP_EOF;
+		}
+
 		if(res != SCAP_SUCCESS)
 		{
 			if(res == SCAP_TIMEOUT)
 			{
+				if(!m_lazy_fd_table_tids.empty())
+				{
+					prefill_fd_tables();
+				}
+
 				if (m_external_event_processor)
 				{
 					m_external_event_processor->process_event(NULL, libsinsp::EVENT_RETURN_TIMEOUT);
@@ -1507,6 +1656,12 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		evt->m_tinfo->m_lastevent_ts = m_lastevent_ts;
 	}
 
+	if(m_track_event_latency && is_live())
+	{
+		uint64_t now = sinsp_utils::get_current_time_ns();
+		m_event_latency.add(now > ts ? now - ts : 0);
+	}
+
 	//
 	// Done
 	//
@@ -1514,6 +1669,34 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 	return res;
 }
 
+int32_t sinsp::next_batch(const std::function<void(sinsp_evt*)>& on_evt)
+{
+	sinsp_evt* evt;
+	int32_t res;
+	bool processed = false;
+
+	//
+	// The first call to next() fetches a new batch if needed, the following
+	// ones go through it until it's exhausted
+	//
+	do
+	{
+		res = next(&evt);
+		if(res == SCAP_SUCCESS)
+		{
+			on_evt(evt);
+			processed = true;
+		}
+		else if(res != SCAP_TIMEOUT)
+		{
+			return res;
+		}
+	}
+	while(m_scap_batch_pos < m_scap_batch.nevts);
+
+	return processed ? SCAP_SUCCESS : SCAP_TIMEOUT;
+}
+
 uint64_t sinsp::get_num_events()
 {
 	if(m_h)
@@ -1860,6 +2043,11 @@ void sinsp::get_capture_stats(scap_stats* stats) const
 	}
 }
 
+void sinsp::get_evt_buffer_pool_stats(sinsp_evt_buffer_pool::stats* stats) const
+{
+	m_parser->get_evt_buffer_pool_stats(stats);
+}
+
 #ifdef GATHER_INTERNAL_STATS
 sinsp_stats sinsp::get_stats()
 {
@@ -58,11 +58,13 @@ limitations under the License.
 
 #include <string>
 #include <map>
+#include <set>
 #include <queue>
 #include <vector>
 #include <unordered_set>
 #include <list>
 #include <memory>
+#include <functional>
 
 using namespace std;
 
@@ -73,6 +75,8 @@ using namespace std;
 #include "filter.h"
 #include "dumper.h"
 #include "stats.h"
+#include "latency_histogram.h"
+#include "evt_buffer_pool.h"
 #include "ifinfo.h"
 #include "container.h"
 #include "user.h"
@@ -275,6 +279,26 @@ public:
 	*/
 	virtual int32_t next(OUT sinsp_evt **evt);
 
+	/*!
+	  \brief Get the next batch of events from the open capture source and
+	  run them through the state engine, one after the other.
+
+	  \param on_evt callback invoked on every event that \ref next() would
+	  return, in the order they are parsed.
+
+	  \return SCAP_SUCCESS if at least one event has been processed.
+	   SCAP_TIMEOUT if no event was available. SCAP_EOF when the end of an
+	   offline capture is reached. On Failure, SCAP_FAILURE is returned and
+	   getlasterr() can be used to obtain the cause of the error.
+
+	  \note Batches contain more than one event only for live captures with
+	   relaxed ordering enabled (see \ref set_relaxed_ordering()). In that
+	   case, all the events of a batch come from the same CPU.
+	  \note The event passed to the callback is valid only for the duration of
+	   the callback.
+	*/
+	int32_t next_batch(const std::function<void(sinsp_evt*)>& on_evt);
+
 	/*!
 	  \brief Get the maximum number of bytes currently in use by any CPU buffer
      */
@@ -325,6 +349,113 @@ public:
 	*/
 	void set_import_users(bool import_users);
 
+	/*!
+	  \brief If enabled, live events are returned in timestamp order only
+	  within each CPU, and the per-CPU buffers are drained in batches
+	  instead of being merged event by event.
+
+	  \note Useful for consumers that don't depend on the global ordering
+	   of the events, e.g. per-process counters. It must be called before
+	   opening the capture.
+	*/
+	void set_relaxed_ordering(bool enable);
+
+	/*!
+	  \brief Select how live captures wait for new events when the
+	  driver buffers are empty. See \ref scap_wait_policy.
+
+	  \note It must be called before opening the capture.
+	*/
+	void set_wait_policy(scap_wait_policy policy);
+
+	/*!
+	  \brief Set the number of threads that inflate gzip capture files
+	  ahead of the parser. 0 (SCAP_DECOMPRESSION_INLINE, the default)
+	  inflates on the thread calling next(), SCAP_DECOMPRESSION_AUTO
+	  picks it based on the number of CPUs.
+
+	  \note Only files written with SCAP_COMPRESSION_GZIP_CHUNKED are
+	   inflated by more than one thread. It must be called before
+	   opening the capture.
+	*/
+	void set_decompression_threads(uint32_t nthreads);
+
+	/*!
+	  \brief Set the number of threads that scan /proc when a live
+	  capture is opened and when its thread table is refreshed. 1 (the
+	  default) scans on the calling thread, SCAP_PROC_SCAN_AUTO picks it
+	  based on the number of CPUs.
+
+	  \note It must be called before opening the capture.
+	*/
+	void set_proc_scan_threads(uint32_t nthreads);
+
+	/*!
+	  \brief Don't read the fds of the processes found in /proc when a
+	  live capture is opened, only their threads. The fd table of a
+	  process is read from /proc the first time it's used, or ahead of
+	  that when next() times out, at most prefill_batch tables each time,
+	  in the order of the scan. A prefill_batch of 0 only reads them on
+	  use.
+
+	  \note It must be called before opening the capture. It has no
+	  effect if the thread table is filtered when saving.
+	*/
+	void set_lazy_fd_tables(bool enable, uint32_t prefill_batch = 16);
+
+	/*!
+	  \brief Start reading a capture file from the last state checkpoint
+	  before ts, instead of its beginning. The file must have an index,
+	  see sinsp_dumper::set_checkpoint_interval().
+
+	  \note It must be called before opening the capture.
+	*/
+	void set_start_ts(uint64_t ts);
+
+	/*!
+	  \brief Start reading a capture file from a state checkpoint, by its
+	  position in the index of the file (see scap_read_index()). Unlike
+	  set_start_ts(), it tells apart checkpoints with the same timestamp.
+	  0, the default, starts from the beginning or from set_start_ts().
+
+	  \note It must be called before opening the capture.
+	*/
+	void set_start_checkpoint(uint32_t checkpoint);
+
+	/*!
+	  \brief If enabled, reading a capture file ends, as if the file
+	  ended, at the next state checkpoint or merged file section, instead
+	  of reloading the state from it and going on.
+	*/
+	void set_stop_at_checkpoint(bool enable);
+
+	/*!
+	  \brief Set the types of the events that next() returns, e.g. the
+	  ones found by sinsp_filter_set::get_event_types(). The events of
+	  the other types still update the state, but are filtered out. The
+	  ones that don't change the state are dropped before the parser looks
+	  up their thread. An empty set, the default, returns all the events.
+
+	  \note It must be called before opening the capture.
+	*/
+	void set_events_of_interest(const std::set<uint16_t>& evttypes);
+
+	/*!
+	  \brief If enabled, next() records the time between the kernel
+	  timestamp of every live event it returns and the moment it returns
+	  it. Use \ref get_event_latency() to read the distribution.
+	*/
+	void set_event_latency_tracking(bool enable);
+
+	/*!
+	  \brief Return the event latencies recorded so far, see
+	  \ref set_event_latency_tracking().
+	*/
+	inline const latency_histogram& get_event_latency() const
+	{
+		return m_event_latency;
+	}
+
 	/*!
 	  \brief temporarily pauses event capture.
 
@@ -500,6 +631,12 @@ public:
 	*/
 	void get_capture_stats(scap_stats* stats) const override;
 
+	/*!
+	  \brief Fill the given structure with the occupancy of the buffers
+	   that keep the enter events of the threads until their exit event.
+	*/
+	void get_evt_buffer_pool_stats(sinsp_evt_buffer_pool::stats* stats) const;
+
 #ifdef GATHER_INTERNAL_STATS
 	sinsp_stats get_stats();
 #endif
@@ -991,6 +1128,7 @@ private:
 	void consume_initialstate_events();
 	bool is_initialstate_event(scap_evt* pevent);
 	void import_thread_table();
+	void prefill_fd_tables();
 	void import_ifaddr_list();
 	void import_user_list();
 	void add_protodecoders();
@@ -1057,6 +1195,23 @@ private:
 	std::string m_input_filename;
 	bool m_bpf;
 	bool m_udig;
+	bool m_relaxed_ordering;
+	scap_wait_policy m_wait_policy;
+	uint32_t m_decompression_threads;
+	uint32_t m_proc_scan_threads;
+	bool m_lazy_fd_tables;
+	uint32_t m_lazy_fd_tables_prefill;
+	// The processes whose fd table is still to be read
+	std::queue<int64_t> m_lazy_fd_table_tids;
+	// If true, open_nodriver() doesn't scan /proc. Set by sinsp_pipeline,
+	// that scans it once for all its workers.
+	bool m_skip_proc_scan;
+	uint64_t m_start_ts;
+	uint32_t m_start_checkpoint;
+	bool m_stop_at_checkpoint;
+	std::set<uint16_t> m_events_of_interest;
+	bool m_track_event_latency;
+	latency_histogram m_event_latency;
 	bool m_is_windows;
 	std::string m_bpf_probe;
 	bool m_isdebug_enabled;
@@ -1278,6 +1433,11 @@ public:
 	// This is related to m_replay_scap_evt, and is used to store the additional cpuid
 	// information of the replayed scap event.
 	uint16_t m_replay_scap_cpuid;
+	//
+	// The events returned by the last call to scap_next_batch(), and how
+	// many of them have been consumed by sinsp::next().
+	scap_evt_batch m_scap_batch;
+	uint32_t m_scap_batch_pos;
 
 	bool m_inited;
 	static std::atomic<int> instance_count;
@@ -1309,6 +1469,7 @@ public:
 	friend class sinsp_memory_dumper;
 	friend class sinsp_network_interfaces;
 	friend class test_helper;
+	friend class sinsp_pipeline;
 	friend class sinsp_usergroup_manager;
 
 	template<class TKey,class THash,class TCompare> friend class sinsp_connection_manager;
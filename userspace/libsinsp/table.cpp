@@ -445,9 +445,10 @@ void sinsp_table::process_event(sinsp_evt* evt)
 	}
 
 	//
-	// Extract the values and create the row to add
+	// Extract the values and create the row to add. The vector of the
+	// values is reused across the events, not to allocate it every time.
 	//
-	vector<extract_value_t> extracted_values;
+	vector<extract_value_t>& extracted_values = m_extracted_values;
 	for(j = 0; j < m_n_premerge_fields; j++)
 	{
 		sinsp_table_field* pfld = &(m_premerge_fld_pointers[j]);
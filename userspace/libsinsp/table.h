@@ -321,6 +321,7 @@ private:
 	vector<sinsp_filter_check*> m_postmerge_extractors;
 	vector<sinsp_filter_check*>* m_extractors;
 	vector<sinsp_filter_check*> m_chks_to_free;
+	vector<extract_value_t> m_extracted_values;
 	vector<ppm_param_type> m_premerge_types;
 	vector<ppm_param_type> m_postmerge_types;
 	bool m_is_key_present;
@@ -0,0 +1,261 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sinsp.h>
+#include <column_exporter.h>
+#include <gtest/gtest.h>
+#include "test_capture.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const int64_t FIRST_TID = 5000000;
+static const vector<string> FIELDS = {"evt.num", "proc.name", "fd.num", "fd.name", "evt.rawres",
+				      "evt.type", "evt.is_open_read", "fd.sip", "evt.rawtime"};
+
+// Processes opening and closing files
+static void write_capture(const std::string& fname)
+{
+	files_capture c;
+
+	c.first_tid = FIRST_TID;
+	for(int64_t tid = FIRST_TID; tid < FIRST_TID + 3; tid++)
+	{
+		c.comms.push_back("app" + to_string(tid % 3));
+	}
+	for(int64_t j = 0; j < 25; j++)
+	{
+		c.names.push_back("/etc/" + to_string(j % 7));
+	}
+	c.fail_every = 5;
+	write_files_capture(fname, c);
+}
+
+// The fields of every event, as resolved by the formatter
+static void read_expected(const std::string& capture, sinsp_field_buffer& expected)
+{
+	sinsp inspector;
+	sinsp_evt* evt;
+	string fmt = "*";
+
+	for(auto& field : FIELDS)
+	{
+		fmt += "%" + field + " ";
+	}
+	sinsp_evt_formatter formatter(&inspector, fmt);
+
+	inspector.open(capture);
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+		formatter.resolve_tokens(evt, expected);
+	}
+	inspector.close();
+}
+
+static void export_capture(const std::string& capture, sinsp_column_exporter& exporter, sinsp* inspector)
+{
+	sinsp_evt* evt;
+
+	inspector->open(capture);
+	while(inspector->next(&evt) != SCAP_EOF)
+	{
+		exporter.dump(evt);
+	}
+	exporter.close();
+	inspector->close();
+}
+
+// Compares the rows of the file with the ones of expected starting at *row
+static void check_file(const std::string& fname, const sinsp_field_buffer& expected, size_t* row, uint32_t* nbatches)
+{
+	sinsp_column_reader reader;
+	sinsp_field_buffer rows;
+
+	*nbatches = 0;
+
+	reader.open(fname);
+	EXPECT_EQ(reader.get_columns().size(), FIELDS.size());
+	while(reader.next(rows))
+	{
+		for(size_t r = 0; r < rows.num_rows(); r++, (*row)++)
+		{
+			for(uint32_t j = 0; j < rows.num_columns(); j++)
+			{
+				const sinsp_field_column& col = rows.get_column(j);
+				const sinsp_field_column& exp = expected.get_column(j);
+				uint32_t len;
+				uint32_t exp_len;
+
+				ASSERT_EQ(col.get_name(), exp.get_name());
+				ASSERT_EQ(col.get_kind(), exp.get_kind());
+				ASSERT_EQ(col.is_null(r), exp.is_null(*row)) << col.get_name() << " " << *row;
+				if(col.get_kind() == FK_STRING || col.get_kind() == FK_IP || col.get_kind() == FK_BYTES)
+				{
+					const char* data = col.get_data(r, &len);
+					const char* exp_data = exp.get_data(*row, &exp_len);
+					EXPECT_EQ(string(data, len), string(exp_data, exp_len)) << col.get_name();
+				}
+				else
+				{
+					EXPECT_EQ(col.get_uint64(r), exp.get_uint64(*row)) << col.get_name();
+				}
+			}
+		}
+		(*nbatches)++;
+	}
+}
+
+TEST(sinsp_column_exporter, file)
+{
+	std::string capture = testing::TempDir() + "sinsp_column_exporter.scap";
+	std::string fname = testing::TempDir() + "sinsp_column_exporter.col";
+	sinsp inspector;
+	sinsp_field_buffer expected;
+	size_t row = 0;
+
+	write_capture(capture);
+	read_expected(capture, expected);
+	ASSERT_EQ(expected.num_rows(), 103);
+
+	sinsp_column_exporter exporter(&inspector, FIELDS);
+	exporter.set_batch_size(10);
+	exporter.open(fname);
+	export_capture(capture, exporter, &inspector);
+
+	uint32_t nbatches;
+	check_file(fname, expected, &row, &nbatches);
+	EXPECT_EQ(nbatches, 11);
+	EXPECT_EQ(row, expected.num_rows());
+
+	// the file ends with the offsets of the batches
+	char trailer[13] = {};
+	FILE* f = fopen(fname.c_str(), "rb");
+	ASSERT_NE(f, nullptr);
+	ASSERT_EQ(fseek(f, -12, SEEK_END), 0);
+	ASSERT_EQ(fread(trailer, 1, 12, f), 12);
+	fclose(f);
+	EXPECT_EQ(*(uint32_t*)trailer, 8 * (nbatches + 1));
+	EXPECT_STREQ(trailer + 4, SINSP_COL_MAGIC);
+
+	EXPECT_THROW(sinsp_column_exporter(&inspector, {"proc.nam"}), sinsp_exception);
+	EXPECT_THROW(exporter.dump(NULL), sinsp_exception);
+
+	unlink(fname.c_str());
+	unlink(capture.c_str());
+}
+
+TEST(sinsp_column_exporter, stream)
+{
+	std::string capture = testing::TempDir() + "sinsp_column_exporter_stream.scap";
+	std::string fname = testing::TempDir() + "sinsp_column_exporter_stream.col";
+	sinsp inspector;
+	sinsp_field_buffer expected;
+	size_t row = 0;
+
+	write_capture(capture);
+	read_expected(capture, expected);
+
+	int fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	ASSERT_GE(fd, 0);
+	sinsp_column_exporter exporter(&inspector, FIELDS);
+	exporter.fdopen(fd);
+	export_capture(capture, exporter, &inspector);
+
+	uint32_t nbatches;
+	check_file(fname, expected, &row, &nbatches);
+	EXPECT_EQ(nbatches, 1);
+	EXPECT_EQ(row, expected.num_rows());
+
+	unlink(fname.c_str());
+	unlink(capture.c_str());
+}
+
+// The events are 1ns apart, every file gets 20 of them
+TEST(sinsp_column_exporter, rollover)
+{
+	std::string capture = testing::TempDir() + "sinsp_column_exporter_rollover.scap";
+	std::string fname = testing::TempDir() + "sinsp_column_exporter_rollover.col";
+	sinsp inspector;
+	sinsp_field_buffer expected;
+	size_t row = 0;
+
+	write_capture(capture);
+	read_expected(capture, expected);
+
+	sinsp_column_exporter exporter(&inspector, FIELDS);
+	exporter.set_batch_size(8);
+	exporter.set_rollover(0, 20);
+	exporter.open(fname);
+	export_capture(capture, exporter, &inspector);
+
+	uint32_t nfiles = 0;
+	for(; row < expected.num_rows(); nfiles++)
+	{
+		size_t start = row;
+		uint32_t nbatches;
+		check_file(fname + to_string(nfiles), expected, &row, &nbatches);
+		ASSERT_EQ(nbatches, nfiles < 5 ? 3 : 1);
+		EXPECT_EQ(row - start, nfiles < 5 ? 20 : 3);
+		unlink((fname + to_string(nfiles)).c_str());
+	}
+	EXPECT_EQ(nfiles, 6);
+
+	unlink(capture.c_str());
+}
+
+// Writes a file with a string column and a message of the given type
+static void write_message(const std::string& fname, uint32_t type, const vector<uint32_t>& body)
+{
+	uint32_t header[3] = {SINSP_COL_BYTE_ORDER_MAGIC, SINSP_COL_VERSION, 1};
+	uint8_t kind = FK_STRING;
+	uint16_t len = 7;
+	uint8_t padding[2] = {};
+	uint32_t msg_header[2] = {type, (uint32_t)(body.size() * sizeof(uint32_t))};
+
+	FILE* f = fopen(fname.c_str(), "wb");
+	ASSERT_NE(f, nullptr);
+	fwrite(SINSP_COL_MAGIC, 1, sizeof(SINSP_COL_MAGIC) - 1, f);
+	fwrite(header, sizeof(header), 1, f);
+	fwrite(&kind, sizeof(kind), 1, f);
+	fwrite(&len, sizeof(len), 1, f);
+	fwrite("fd.name", 1, len, f);
+	fwrite(padding, sizeof(padding), 1, f);
+	fwrite(msg_header, sizeof(msg_header), 1, f);
+	fwrite(body.data(), sizeof(uint32_t), body.size(), f);
+	fclose(f);
+}
+
+// Counts that don't fit in their message are rejected
+TEST(sinsp_column_exporter, malformed)
+{
+	std::string fname = testing::TempDir() + "sinsp_column_exporter_malformed.col";
+	sinsp_column_reader reader;
+	sinsp_field_buffer rows;
+
+	// column 0, no reset, UINT32_MAX strings, a single offset
+	ASSERT_NO_FATAL_FAILURE(write_message(fname, SINSP_COL_DICTIONARY, {0, 0, UINT32_MAX, 0}));
+	reader.open(fname);
+	EXPECT_THROW(reader.next(rows), sinsp_exception);
+
+	// UINT32_MAX rows, padding, one byte of validity
+	ASSERT_NO_FATAL_FAILURE(write_message(fname, SINSP_COL_RECORD, {UINT32_MAX, 0, 0xff, 0}));
+	reader.open(fname);
+	EXPECT_THROW(reader.next(rows), sinsp_exception);
+
+	unlink(fname.c_str());
+}
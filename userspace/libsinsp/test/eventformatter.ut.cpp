@@ -0,0 +1,164 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sinsp.h>
+#include <eventformatter.h>
+#include <filterchecks.h>
+#include <gtest/gtest.h>
+#include "test_capture.h"
+#include <unistd.h>
+
+using namespace std;
+
+static const int64_t FIRST_TID = 5000000;
+
+// A process opening files whose names must be escaped in JSON
+static void write_capture(const std::string& fname, const vector<string>& names)
+{
+	files_capture c;
+
+	c.first_tid = FIRST_TID;
+	c.comms = {"cat"};
+	c.names = names;
+	write_files_capture(fname, c);
+}
+
+// The JSON rendering is the one jsoncpp writes for an object of the fields
+TEST(sinsp_evt_formatter, json)
+{
+	std::string fname = testing::TempDir() + "sinsp_evt_formatter_json.scap";
+	vector<string> names = {"/etc/passwd", "/tmp/a\"b", "/tmp/back\\slash", "/tmp/tab\tname",
+				"/tmp/\xc3\xa9t\xc3\xa9", "/tmp/ctrl\x01", "", "/tmp/last"};
+	vector<string> fields = {"proc.name", "fd.num", "fd.name", "evt.rawres", "evt.type", "evt.dir",
+				 "evt.args", "evt.num", "evt.cpu", "evt.is_open_read", "evt.latency.s", "fd.name"};
+	sinsp inspector;
+	sinsp_evt* evt;
+	string output;
+	uint32_t nevts = 0;
+
+	string fmt = "*";
+	vector<unique_ptr<sinsp_filter_check>> chks;
+	for(auto& field : fields)
+	{
+		fmt += "text %" + field + " ";
+		chks.emplace_back(g_filterlist.new_filter_check_from_fldname(field, &inspector, false));
+		chks.back()->parse_field_name(field.c_str(), true, false);
+	}
+
+	sinsp_evt_formatter formatter(&inspector);
+	formatter.set_format(gen_event_formatter::OF_JSON, fmt);
+
+	write_capture(fname, names);
+	inspector.open(fname);
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+		Json::Value root;
+		Json::FastWriter writer;
+
+		for(size_t j = 0; j < fields.size(); j++)
+		{
+			root[fields[j]] = chks[j]->tojson(evt);
+		}
+		string expected = writer.write(root);
+		expected.pop_back();
+
+		EXPECT_TRUE(formatter.tostring(evt, &output));
+		EXPECT_EQ(output, expected);
+		nevts++;
+	}
+	EXPECT_EQ(nevts, 1 + 4 * names.size());
+
+	inspector.close();
+	unlink(fname.c_str());
+}
+
+// The text rendering is the one of tostring() of the fields
+TEST(sinsp_evt_formatter, text)
+{
+	std::string fname = testing::TempDir() + "sinsp_evt_formatter_text.scap";
+	vector<string> fields = {"evt.num", "evt.rawtime", "evt.cpu", "evt.dir", "evt.type", "proc.name",
+				 "proc.pid", "thread.tid", "user.uid", "fd.num", "fd.name", "fd.typechar",
+				 "fd.sip", "evt.rawres", "evt.is_open_read", "evt.rawarg.fd", "evt.rawarg.name",
+				 "evt.arg.flags", "evt.latency", "evt.rawarg.res"};
+	sinsp inspector;
+	sinsp_evt* evt;
+	string output;
+	uint32_t nevts = 0;
+
+	string fmt = "*";
+	vector<unique_ptr<sinsp_filter_check>> chks;
+	for(auto& field : fields)
+	{
+		fmt += "%" + field + "|";
+		chks.emplace_back(g_filterlist.new_filter_check_from_fldname(field, &inspector, false));
+		chks.back()->parse_field_name(field.c_str(), true, false);
+	}
+
+	sinsp_evt_formatter formatter(&inspector);
+	formatter.set_format(gen_event_formatter::OF_NORMAL, fmt);
+
+	write_capture(fname, {"/etc/passwd", "/tmp/a", "/tmp/b", "/tmp/c"});
+	inspector.open(fname);
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+		string expected;
+		for(auto& chk : chks)
+		{
+			char* str = chk->tostring(evt);
+			expected += str != NULL ? str : "<NA>";
+			expected += "|";
+		}
+
+		EXPECT_TRUE(formatter.tostring(evt, &output));
+		EXPECT_EQ(output, expected);
+		nevts++;
+	}
+	EXPECT_EQ(nevts, 17);
+
+	inspector.close();
+	unlink(fname.c_str());
+}
+
+TEST(sinsp_evt_formatter, padding)
+{
+	std::string fname = testing::TempDir() + "sinsp_evt_formatter_padding.scap";
+	sinsp inspector;
+	sinsp_evt* evt;
+	string output;
+
+	sinsp_evt_formatter formatter(&inspector);
+	formatter.set_format(gen_event_formatter::OF_NORMAL, "*[%6proc.name][%8fd.name][%2evt.type]%fd.num");
+	sinsp_evt_formatter strict_formatter(&inspector);
+	strict_formatter.set_format(gen_event_formatter::OF_NORMAL, "[%6proc.name][%fd.num]");
+
+	write_capture(fname, {"/etc/passwd"});
+	inspector.open(fname);
+	ASSERT_EQ(inspector.next(&evt), SCAP_SUCCESS);
+	EXPECT_TRUE(formatter.tostring(evt, &output));
+	EXPECT_EQ(output, "[cat   ][<NA>    ][cl]<NA>");
+	EXPECT_FALSE(strict_formatter.tostring(evt, &output));
+
+	ASSERT_EQ(inspector.next(&evt), SCAP_SUCCESS);
+	ASSERT_EQ(inspector.next(&evt), SCAP_SUCCESS);
+	EXPECT_TRUE(formatter.tostring(evt, &output));
+	EXPECT_EQ(output, "[cat   ][/etc/pas][op]-1");
+	EXPECT_TRUE(strict_formatter.tostring(evt, &output));
+	EXPECT_EQ(output, "[cat   ][-1]");
+
+	inspector.close();
+	unlink(fname.c_str());
+}
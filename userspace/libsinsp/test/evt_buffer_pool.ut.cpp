@@ -0,0 +1,172 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include <gtest/gtest.h>
+#include "test_capture.h"
+#include <unistd.h>
+
+TEST(sinsp_evt_buffer_pool, size_classes)
+{
+	sinsp_evt_buffer_pool pool;
+	sinsp_evt_buffer_pool::stats stats;
+	uint32_t size;
+
+	uint8_t* small = pool.reserve(1, &size);
+	EXPECT_EQ(size, EVT_BUFFER_POOL_MIN_SIZE);
+	uint8_t* exact = pool.reserve(128, &size);
+	EXPECT_EQ(size, 128);
+	uint8_t* large = pool.reserve(SP_EVT_BUF_SIZE, &size);
+	EXPECT_EQ(size, SP_EVT_BUF_SIZE);
+
+	pool.get_stats(&stats);
+	EXPECT_EQ(stats.m_classes.front().m_size, EVT_BUFFER_POOL_MIN_SIZE);
+	EXPECT_EQ(stats.m_classes.back().m_size, SP_EVT_BUF_SIZE);
+	EXPECT_EQ(stats.m_used_bytes, EVT_BUFFER_POOL_MIN_SIZE + 128 + SP_EVT_BUF_SIZE);
+	EXPECT_EQ(stats.m_free_bytes, 0);
+	EXPECT_EQ(stats.m_n_allocated, 3);
+
+	// a released buffer is handed out again for the same class
+	pool.release(small, EVT_BUFFER_POOL_MIN_SIZE, 10);
+	EXPECT_EQ(pool.reserve(EVT_BUFFER_POOL_MIN_SIZE, &size), small);
+
+	// up to max_free buffers are kept
+	pool.release(small, EVT_BUFFER_POOL_MIN_SIZE, 1);
+	pool.release(exact, 128, 1);
+	pool.release(large, SP_EVT_BUF_SIZE, 1);
+
+	pool.get_stats(&stats);
+	EXPECT_EQ(stats.m_used_bytes, 0);
+	EXPECT_EQ(stats.m_free_bytes, EVT_BUFFER_POOL_MIN_SIZE);
+	EXPECT_EQ(stats.m_n_reused, 1);
+	EXPECT_EQ(stats.m_classes[0].m_n_free, 1);
+}
+
+static const uint32_t NTHREADS = 100;
+static const int64_t FIRST_TID = 5000000;
+
+// chdir() enter events for NTHREADS threads, half of which exit
+static void write_capture(const std::string& fname)
+{
+	scap_t* h;
+	scap_dumper_t* d;
+	uint64_t ts = 1000000;
+
+	ASSERT_NO_FATAL_FAILURE(open_test_capture(fname, &h, &d));
+
+	for(uint32_t j = 0; j < NTHREADS; j++)
+	{
+		dump_evt(h, d, ts++, FIRST_TID + j, PPME_SYSCALL_CHDIR_E, 0);
+	}
+
+	for(uint32_t j = 0; j < NTHREADS / 2; j++)
+	{
+		dump_evt(h, d, ts++, FIRST_TID + j, PPME_SYSCALL_CHDIR_X, 2, (int64_t)0, "/tmp");
+	}
+
+	close_test_capture(h, d);
+}
+
+// the threads waiting for their exit event hold a buffer of the smallest
+// class, the others gave theirs back
+TEST(sinsp_evt_buffer_pool, pending_enter_events)
+{
+	std::string fname = testing::TempDir() + "sinsp_evt_buffer_pool.scap";
+	sinsp_evt_buffer_pool::stats stats;
+	sinsp inspector;
+	sinsp_evt* evt;
+
+	write_capture(fname);
+	inspector.open(fname);
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+	}
+
+	inspector.get_evt_buffer_pool_stats(&stats);
+	EXPECT_EQ(stats.m_classes[0].m_n_used, NTHREADS / 2);
+	EXPECT_EQ(stats.m_classes[0].m_n_free, NTHREADS / 2);
+	EXPECT_EQ(stats.m_used_bytes, (NTHREADS / 2) * EVT_BUFFER_POOL_MIN_SIZE);
+	EXPECT_EQ(stats.m_n_allocated, NTHREADS);
+
+	inspector.close();
+	inspector.get_evt_buffer_pool_stats(&stats);
+	EXPECT_EQ(stats.m_used_bytes, 0);
+
+	unlink(fname.c_str());
+}
+
+// the buffers of the threads go back to the pool when the threads exit
+TEST(sinsp_evt_buffer_pool, thread_exit)
+{
+	std::string fname = testing::TempDir() + "sinsp_evt_buffer_pool_exit.scap";
+	sinsp_evt_buffer_pool::stats stats;
+	sinsp inspector;
+	sinsp_evt* evt;
+	scap_t* h;
+	scap_dumper_t* d;
+	uint64_t ts = 1000000;
+
+	ASSERT_NO_FATAL_FAILURE(open_test_capture(fname, &h, &d));
+	for(uint32_t j = 0; j < NTHREADS; j++)
+	{
+		dump_evt(h, d, ts++, FIRST_TID + j, PPME_SYSCALL_CHDIR_E, 0);
+	}
+	for(uint32_t j = 0; j < NTHREADS; j++)
+	{
+		dump_evt(h, d, ts++, FIRST_TID + j, PPME_PROCEXIT_1_E, 4, (int64_t)0, (int64_t)0, (uint8_t)0, (uint8_t)0);
+	}
+	// the last exited thread is removed on the next event
+	dump_evt(h, d, ts++, FIRST_TID + NTHREADS, PPME_SYSCALL_CHDIR_X, 2, (int64_t)0, "/tmp");
+	close_test_capture(h, d);
+
+	inspector.open(fname);
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+	}
+
+	inspector.get_evt_buffer_pool_stats(&stats);
+	EXPECT_EQ(stats.m_classes[0].m_n_used, 0);
+	EXPECT_EQ(stats.m_used_bytes, 0);
+
+	inspector.close();
+	unlink(fname.c_str());
+}
+
+// a thread still waiting for its exit event can outlive the inspector, and
+// give its buffer back after it's gone
+TEST(sinsp_evt_buffer_pool, thread_outlives_inspector)
+{
+	std::string fname = testing::TempDir() + "sinsp_evt_buffer_pool_outlive.scap";
+	threadinfo_map_t::ptr_t tinfo;
+	sinsp_evt* evt;
+
+	write_capture(fname);
+
+	{
+		sinsp inspector;
+		inspector.open(fname);
+		while(inspector.next(&evt) != SCAP_EOF)
+		{
+		}
+		tinfo = inspector.get_thread_ref(FIRST_TID + NTHREADS - 1);
+		ASSERT_NE(tinfo, nullptr);
+		inspector.close();
+	}
+
+	tinfo.reset();
+	unlink(fname.c_str());
+}
@@ -0,0 +1,129 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include <gtest/gtest.h>
+#include <map>
+
+static sinsp_fdinfo_t* add_fd(sinsp_fdtable& table, int64_t fd)
+{
+	sinsp_fdinfo_t fdinfo;
+	fdinfo.m_type = SCAP_FD_FILE_V2;
+	fdinfo.m_name = "/tmp/file" + std::to_string(fd);
+	return table.add(fd, &fdinfo);
+}
+
+static std::map<int64_t, std::string> dump(sinsp_fdtable& table)
+{
+	std::map<int64_t, std::string> fds;
+
+	table.loop([&](int64_t fd, sinsp_fdinfo_t& fdinfo)
+	{
+		fds[fd] = fdinfo.m_name;
+		return true;
+	});
+	return fds;
+}
+
+TEST(sinsp_fdtable, small_and_large_fds)
+{
+	sinsp inspector;
+	sinsp_fdtable table(&inspector);
+	std::vector<int64_t> fds = {0, 1, 2, 100, FDTABLE_MAX_DIRECT_FD - 1, FDTABLE_MAX_DIRECT_FD, 1000000};
+
+	EXPECT_EQ(table.find(0), nullptr);
+	EXPECT_EQ(table.find(-1), nullptr);
+	EXPECT_EQ(table.find(1000000), nullptr);
+
+	// entries keep their address while the array grows
+	std::vector<sinsp_fdinfo_t*> ptrs;
+	for(int64_t fd : fds)
+	{
+		ptrs.push_back(add_fd(table, fd));
+		ASSERT_NE(ptrs.back(), nullptr);
+	}
+	EXPECT_EQ(table.size(), fds.size());
+
+	for(size_t j = 0; j < fds.size(); j++)
+	{
+		EXPECT_EQ(table.find(fds[j]), ptrs[j]);
+		EXPECT_EQ(table.find(fds[j])->m_name, "/tmp/file" + std::to_string(fds[j]));
+	}
+	EXPECT_EQ(table.find(3), nullptr);
+	EXPECT_EQ(table.find(FDTABLE_MAX_DIRECT_FD + 1), nullptr);
+
+	// adding an fd again replaces it in place
+	sinsp_fdinfo_t fdinfo;
+	fdinfo.m_name = "replaced";
+	EXPECT_EQ(table.add(100, &fdinfo), ptrs[3]);
+	EXPECT_EQ(table.find(100)->m_name, "replaced");
+	EXPECT_EQ(table.size(), fds.size());
+
+	table.erase(100);
+	table.erase(1000000);
+	EXPECT_EQ(table.find(100), nullptr);
+	EXPECT_EQ(table.find(1000000), nullptr);
+	EXPECT_EQ(table.size(), fds.size() - 2);
+
+	std::map<int64_t, std::string> expected = {
+		{0, "/tmp/file0"},
+		{1, "/tmp/file1"},
+		{2, "/tmp/file2"},
+		{FDTABLE_MAX_DIRECT_FD - 1, "/tmp/file" + std::to_string(FDTABLE_MAX_DIRECT_FD - 1)},
+		{FDTABLE_MAX_DIRECT_FD, "/tmp/file" + std::to_string(FDTABLE_MAX_DIRECT_FD)},
+	};
+	EXPECT_EQ(dump(table), expected);
+
+	table.clear();
+	EXPECT_EQ(table.size(), 0);
+	EXPECT_EQ(table.find(0), nullptr);
+}
+
+TEST(sinsp_fdtable, copy)
+{
+	sinsp inspector;
+	sinsp_fdtable table(&inspector);
+
+	add_fd(table, 3);
+	add_fd(table, 5000);
+	EXPECT_NE(table.find(3), nullptr);
+
+	sinsp_fdtable copy(table);
+	EXPECT_EQ(dump(copy), dump(table));
+	EXPECT_EQ(copy.size(), 2);
+	EXPECT_NE(copy.find(3), table.find(3));
+
+	copy.find(3)->m_name = "changed";
+	EXPECT_EQ(table.find(3)->m_name, "/tmp/file3");
+
+	copy = sinsp_fdtable(&inspector);
+	EXPECT_EQ(copy.size(), 0);
+	EXPECT_EQ(copy.find(3), nullptr);
+}
+
+TEST(sinsp_fdtable, size_limit)
+{
+	sinsp inspector;
+	sinsp_fdtable table(&inspector);
+
+	for(uint32_t j = 0; j < inspector.m_max_fdtable_size; j++)
+	{
+		ASSERT_NE(add_fd(table, j), nullptr);
+	}
+	EXPECT_EQ(add_fd(table, inspector.m_max_fdtable_size), nullptr);
+	EXPECT_NE(add_fd(table, 0), nullptr);
+}
@@ -0,0 +1,146 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sinsp.h>
+#include <eventformatter.h>
+#include <field_buffer.h>
+#include <gtest/gtest.h>
+#include "test_capture.h"
+#include <unistd.h>
+
+using namespace std;
+
+TEST(sinsp_field_buffer, columns)
+{
+	sinsp_field_buffer buf;
+	sinsp_field_value value = {};
+
+	EXPECT_EQ(buf.add_column("num", FK_INT64), 0);
+	EXPECT_EQ(buf.add_column("str", FK_STRING), 1);
+
+	for(uint32_t pass = 0; pass < 2; pass++)
+	{
+		buf.clear();
+		EXPECT_EQ(buf.num_rows(), 0);
+
+		value.m_kind = FK_INT64;
+		value.m_int64 = -5;
+		buf.get_column(0).append(value);
+		buf.get_column(0).append_null();
+
+		value.m_kind = FK_STRING;
+		value.m_data = "/etc/passwd";
+		value.m_len = strlen(value.m_data);
+		buf.get_column(1).append(value);
+		value.m_data = "";
+		value.m_len = 0;
+		buf.get_column(1).append(value);
+
+		uint32_t len;
+		EXPECT_EQ(buf.num_rows(), 2);
+		EXPECT_FALSE(buf.get_column(0).is_null(0));
+		EXPECT_EQ(buf.get_column(0).get_int64(0), -5);
+		EXPECT_TRUE(buf.get_column(0).is_null(1));
+		EXPECT_STREQ(buf.get_column(1).get_data(0, &len), "/etc/passwd");
+		EXPECT_EQ(len, 11);
+		EXPECT_STREQ(buf.get_column(1).get_data(1, &len), "");
+		EXPECT_EQ(len, 0);
+	}
+
+	value.m_kind = FK_DOUBLE;
+	EXPECT_THROW(buf.get_column(1).append(value), sinsp_exception);
+	EXPECT_THROW(buf.add_column("late", FK_BOOL), sinsp_exception);
+}
+
+static const int64_t FIRST_TID = 5000000;
+
+// A process opening and closing files
+static files_capture test_files()
+{
+	files_capture c;
+
+	c.first_tid = FIRST_TID;
+	c.comms = {"cat"};
+	for(int64_t j = 0; j < 10; j++)
+	{
+		c.names.push_back("/etc/" + to_string(j));
+	}
+	return c;
+}
+
+// the typed values are the ones of the strings of the other resolve_tokens()
+TEST(sinsp_field_buffer, formatter)
+{
+	std::string fname = testing::TempDir() + "sinsp_field_buffer.scap";
+	sinsp inspector;
+	sinsp_evt* evt;
+	sinsp_field_buffer buf;
+	map<string, string> strings;
+	uint32_t nevts = 0;
+	uint32_t nnulls = 0;
+
+	sinsp_evt_formatter formatter(&inspector, "*%proc.name %fd.num %fd.name %evt.rawres %evt.rawtime %evt.type");
+
+	ASSERT_NO_FATAL_FAILURE(write_files_capture(fname, test_files()));
+	inspector.open(fname);
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+		buf.clear();
+		strings.clear();
+		EXPECT_TRUE(formatter.resolve_tokens(evt, buf));
+		EXPECT_TRUE(formatter.resolve_tokens(evt, strings));
+		ASSERT_EQ(buf.num_columns(), 6);
+		ASSERT_EQ(buf.num_rows(), 1);
+
+		for(uint32_t j = 0; j < buf.num_columns(); j++)
+		{
+			const sinsp_field_column& column = buf.get_column(j);
+			const string& expected = strings[column.get_name()];
+			uint32_t len;
+
+			if(column.is_null(0))
+			{
+				EXPECT_EQ(expected, "<NA>") << column.get_name();
+				nnulls++;
+				continue;
+			}
+
+			switch(column.get_kind())
+			{
+			case FK_INT64:
+				EXPECT_EQ(to_string(column.get_int64(0)), expected) << column.get_name();
+				break;
+			case FK_UINT64:
+				EXPECT_EQ(to_string(column.get_uint64(0)), expected) << column.get_name();
+				break;
+			default:
+				EXPECT_EQ(column.get_data(0, &len), expected) << column.get_name();
+				break;
+			}
+		}
+		nevts++;
+	}
+
+	EXPECT_EQ(buf.get_column(0).get_kind(), FK_STRING);
+	EXPECT_EQ(buf.get_column(1).get_kind(), FK_INT64);
+	EXPECT_EQ(buf.get_column(4).get_kind(), FK_UINT64);
+	EXPECT_EQ(nevts, 41);
+	EXPECT_GT(nnulls, 0);
+
+	inspector.close();
+	unlink(fname.c_str());
+}
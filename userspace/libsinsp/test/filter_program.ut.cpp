@@ -0,0 +1,230 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sinsp.h>
+#include <filter.h>
+#include <filter_program.h>
+#include <gtest/gtest.h>
+#include "test_capture.h"
+#include <unistd.h>
+
+using namespace std;
+
+// A mock filtercheck that returns true or false depending on the
+// passed-in field name
+class mock_program_filter_check: public gen_event_filter_check
+{
+public:
+	inline int32_t parse_field_name(const char* str, bool a, bool n) override
+	{
+		m_name = string(str);
+		return 0;
+	}
+
+	inline bool compare(gen_event *evt) override
+	{
+		return m_name == "c.true";
+	}
+
+	inline void add_filter_value(const char* str, uint32_t l, uint32_t i) override
+	{
+	}
+
+	inline bool extract(gen_event *e, OUT vector<extract_value_t>& v, bool) override
+	{
+		return false;
+	}
+
+	string m_name;
+};
+
+class mock_program_filter_factory: public gen_event_filter_factory
+{
+public:
+	inline gen_event_filter *new_filter() override
+	{
+		return new sinsp_filter(NULL);
+	}
+
+	inline gen_event_filter_check *new_filtercheck(const char *fldname) override
+	{
+		return new mock_program_filter_check();
+	}
+
+	inline list<gen_event_filter_factory::filter_fieldclass_info> get_fields() override
+	{
+		return list<gen_event_filter_factory::filter_fieldclass_info>();
+	}
+};
+
+static bool run_tree(std::shared_ptr<gen_event_filter_factory> factory, const string& filter_str, gen_event* evt)
+{
+	sinsp_filter_compiler compiler(factory, filter_str);
+	unique_ptr<sinsp_filter> filter(compiler.compile());
+	return filter->run(evt);
+}
+
+static bool run_program(std::shared_ptr<gen_event_filter_factory> factory, const string& filter_str, gen_event* evt)
+{
+	sinsp_filter_program_compiler compiler(factory, filter_str);
+	unique_ptr<sinsp_filter_program> program(compiler.compile());
+	return program->run(evt);
+}
+
+static uint64_t g_rand_state = 88172645463325252ULL;
+
+static uint64_t next_rand()
+{
+	g_rand_state ^= g_rand_state << 13;
+	g_rand_state ^= g_rand_state >> 7;
+	g_rand_state ^= g_rand_state << 17;
+	return g_rand_state;
+}
+
+static string random_expr(uint32_t depth)
+{
+	uint64_t r = next_rand() % 8;
+	if(depth == 0 || r < 3)
+	{
+		return next_rand() % 2 ? "c.true=1" : "c.false=1";
+	}
+	if(r == 3)
+	{
+		return "not " + random_expr(depth - 1);
+	}
+
+	string op = r < 6 ? " and " : " or ";
+	string res = "(" + random_expr(depth - 1);
+	uint32_t n = 1 + next_rand() % 3;
+	for(uint32_t j = 0; j < n; j++)
+	{
+		res += op + random_expr(depth - 1);
+	}
+	return res + ")";
+}
+
+// the jumps of the programs give the same results as the filtercheck trees
+TEST(sinsp_filter_program, boolean_evaluation)
+{
+	std::shared_ptr<gen_event_filter_factory> factory(new mock_program_filter_factory());
+	vector<string> filters = {
+		"c.true=1",
+		"not not c.true=1",
+		"not (c.false=1 or not c.false=1 and c.true=1)",
+		"not ((c.false=1 or not (c.false=1 and not c.true=1)) and c.true=1)",
+		"((c.true=1 and c.false=1) and c.true=1) or c.false=1",
+		"((c.false=1 or c.true=1) or c.false=1) and c.true=1",
+	};
+
+	for(uint32_t j = 0; j < 500; j++)
+	{
+		filters.push_back(random_expr(5));
+	}
+
+	for(auto& f : filters)
+	{
+		EXPECT_EQ(run_program(factory, f, NULL), run_tree(factory, f, NULL)) << f;
+	}
+}
+
+TEST(sinsp_filter_program, errors)
+{
+	sinsp inspector;
+	std::shared_ptr<gen_event_filter_factory> factory(new sinsp_filter_factory(&inspector));
+
+	EXPECT_THROW(sinsp_filter_program_compiler(factory, "proc.name =").compile(), sinsp_exception);
+	EXPECT_THROW(sinsp_filter_program_compiler(factory, "proc.nonexistent = a").compile(), sinsp_exception);
+	EXPECT_THROW(sinsp_filter_program_compiler(factory, "proc.name = a and some_macro").compile(), sinsp_exception);
+}
+
+static const int64_t FIRST_TID = 5000000;
+
+// the type specialized comparisons give the same results as flt_compare()
+TEST(sinsp_filter_program, fields)
+{
+	std::string fname = testing::TempDir() + "sinsp_filter_program.scap";
+	sinsp inspector;
+	sinsp_evt* evt;
+	sinsp_filter_cache cache;
+	vector<string> filters = {
+		"evt.type = open",
+		"evt.type in (open, close) and evt.dir = <",
+		"fd.num >= 5",
+		"fd.num < 4 or fd.num = 6",
+		"evt.res != 0",
+		"evt.rawres < 0",
+		"evt.rawres > 10",
+		"fd.name startswith /etc",
+		"fd.name endswith 1",
+		"fd.name contains tmp",
+		"fd.name glob /etc/*1",
+		"not fd.name exists",
+		"proc.name = bash and not fd.name startswith /tmp",
+		"proc.name != nginx or evt.type = read",
+		"proc.name in (bash, sh) and fd.typechar = f",
+		"fd.name pmatch (/tmp)",
+		"evt.buffer contains abc",
+		"evt.arg.fd = 4",
+		"thread.tid = 5000001",
+		"fd.name contains tmp or fd.name endswith 1 or proc.name = bash or fd.name startswith /etc/1",
+		"not fd.name startswith /tmp and not fd.name icontains ETC/1 and evt.type = open",
+		"proc.name startswith ng or proc.name endswith sh",
+		"fd.name glob '/tmp/[0-9]' or fd.name contains 5 or fd.name glob /etc/*1?",
+	};
+	vector<unique_ptr<sinsp_filter>> trees;
+	vector<unique_ptr<sinsp_filter_program>> programs;
+	vector<uint32_t> nmatches(filters.size());
+
+	std::shared_ptr<gen_event_filter_factory> factory(new sinsp_filter_factory(&inspector));
+	for(auto& f : filters)
+	{
+		sinsp_filter_compiler compiler(factory, f);
+		sinsp_filter_program_compiler program_compiler(factory, f, &cache);
+		trees.emplace_back(compiler.compile());
+		programs.emplace_back(program_compiler.compile());
+	}
+
+	// the fields used by many filters are extracted once
+	EXPECT_EQ(cache.num_fields(), 10);
+	EXPECT_EQ(programs[2]->to_string(), "0: int fd.num\n");
+	EXPECT_EQ(programs[12]->to_string(), "0: str_eq proc.name jf 2\n1: !str_startswith fd.name\n");
+	EXPECT_EQ(programs[16]->to_string(), "0: compare\n");
+
+	// the pattern checks of the same field are a single instruction
+	EXPECT_EQ(programs[19]->to_string(), "0: str_multi fd.name jt 2\n1: str_eq proc.name\n");
+	EXPECT_EQ(programs[20]->to_string(), "0: !str_multi fd.name jf 2\n1: str_eq evt.type\n");
+	EXPECT_EQ(programs[10]->to_string(), "0: glob fd.name\n");
+	EXPECT_EQ(programs[22]->to_string(), "0: glob fd.name jt 2\n1: str_contains fd.name\n");
+
+	ASSERT_NO_FATAL_FAILURE(write_files_capture(fname, filter_test_files(FIRST_TID)));
+	inspector.open(fname);
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+		for(size_t j = 0; j < filters.size(); j++)
+		{
+			bool expected = trees[j]->run(evt);
+			EXPECT_EQ(programs[j]->run(evt), expected) << filters[j] << " on event " << evt->get_num();
+			nmatches[j] += expected;
+		}
+	}
+
+	EXPECT_EQ(nmatches[0], 40);
+	EXPECT_GT(nmatches[7], 0);
+
+	inspector.close();
+	unlink(fname.c_str());
+}
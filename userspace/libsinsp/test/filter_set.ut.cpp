@@ -0,0 +1,131 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sinsp.h>
+#include <filter.h>
+#include <filter_set.h>
+#include <filter/parser.h>
+#include <gtest/gtest.h>
+#include "test_capture.h"
+#include <unistd.h>
+
+using namespace std;
+
+static set<uint16_t> event_types(const string& filter_str)
+{
+	libsinsp::filter::parser parser(filter_str);
+	unique_ptr<libsinsp::filter::ast::expr> e(parser.parse());
+	set<uint16_t> types;
+
+	sinsp_filter_set::get_event_types(e.get(), types);
+	return types;
+}
+
+TEST(sinsp_filter_set, event_types)
+{
+	set<uint16_t> types = event_types("evt.type = open");
+	EXPECT_EQ(types.count(PPME_SYSCALL_OPEN_E), 1);
+	EXPECT_EQ(types.count(PPME_SYSCALL_OPEN_X), 1);
+	EXPECT_EQ(types.count(PPME_SYSCALL_CLOSE_E), 0);
+
+	// the generic events can be any system call
+	EXPECT_EQ(types.count(PPME_GENERIC_E), 1);
+	EXPECT_EQ(types.count(PPME_GENERIC_X), 1);
+
+	types = event_types("evt.type in (open, close) and proc.name = cat");
+	EXPECT_EQ(types.count(PPME_SYSCALL_OPEN_X), 1);
+	EXPECT_EQ(types.count(PPME_SYSCALL_CLOSE_X), 1);
+	EXPECT_EQ(types.count(PPME_SYSCALL_READ_X), 0);
+
+	types = event_types("not evt.type = open");
+	EXPECT_EQ(types.count(PPME_SYSCALL_OPEN_X), 0);
+	EXPECT_EQ(types.count(PPME_SYSCALL_READ_X), 1);
+	EXPECT_EQ(types.count(PPME_GENERIC_X), 1);
+
+	types = event_types("evt.type != open and evt.type != close");
+	EXPECT_EQ(types.count(PPME_SYSCALL_OPEN_X), 0);
+	EXPECT_EQ(types.count(PPME_SYSCALL_CLOSE_X), 0);
+	EXPECT_EQ(types.count(PPME_SYSCALL_READ_X), 1);
+
+	types = event_types("evt.type = open and evt.type = close");
+	EXPECT_EQ(types, set<uint16_t>({PPME_GENERIC_E, PPME_GENERIC_X}));
+
+	// these can be true for any event
+	EXPECT_EQ(event_types("not (evt.type = open and proc.name = cat)").size(), PPM_EVENT_MAX);
+	EXPECT_EQ(event_types("evt.type = open or proc.name = cat").size(), PPM_EVENT_MAX);
+	EXPECT_EQ(event_types("evt.type startswith open").size(), PPM_EVENT_MAX);
+	EXPECT_EQ(event_types("proc.name exists").size(), PPM_EVENT_MAX);
+}
+
+static const int64_t FIRST_TID = 5000000;
+
+// the set gives the same results as every filter on its own
+TEST(sinsp_filter_set, run)
+{
+	std::string fname = testing::TempDir() + "sinsp_filter_set.scap";
+	sinsp inspector;
+	sinsp_evt* evt;
+	vector<string> filters = {
+		"evt.type = open and fd.name startswith /etc",
+		"evt.type in (read, close) and proc.name = bash",
+		"proc.name = bash",
+		"not evt.type = open and proc.name in (bash, sh)",
+		"evt.type = open and proc.name = bash",
+	};
+	vector<unique_ptr<sinsp_filter>> trees;
+	vector<int32_t> rule_ids;
+	size_t nfields;
+	size_t nchecks;
+	uint32_t nmatches = 0;
+
+	std::shared_ptr<gen_event_filter_factory> factory(new sinsp_filter_factory(&inspector));
+	sinsp_filter_set set(factory);
+	for(size_t j = 0; j < filters.size(); j++)
+	{
+		sinsp_filter_compiler compiler(factory, filters[j]);
+		trees.emplace_back(compiler.compile());
+		set.add(filters[j], 100 + j);
+	}
+	EXPECT_EQ(set.size(), filters.size());
+
+	// proc.name = bash and evt.type = open are evaluated once
+	set.get_shared_counts(&nfields, &nchecks);
+	EXPECT_EQ(nfields, 3);
+	EXPECT_EQ(nchecks, 5);
+
+	ASSERT_NO_FATAL_FAILURE(write_files_capture(fname, filter_test_files(FIRST_TID)));
+	inspector.open(fname);
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+		vector<int32_t> expected;
+		for(size_t j = 0; j < filters.size(); j++)
+		{
+			if(trees[j]->run(evt))
+			{
+				expected.push_back(100 + j);
+			}
+		}
+
+		EXPECT_EQ(set.run(evt, rule_ids), !expected.empty());
+		EXPECT_EQ(rule_ids, expected) << "event " << evt->get_num();
+		nmatches += rule_ids.size();
+	}
+	EXPECT_GT(nmatches, 0);
+
+	inspector.close();
+	unlink(fname.c_str());
+}
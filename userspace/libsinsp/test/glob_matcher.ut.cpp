@@ -0,0 +1,131 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <glob_matcher.h>
+#include <gtest/gtest.h>
+#include <fnmatch.h>
+
+using namespace std;
+
+TEST(glob_matcher, patterns)
+{
+	glob_matcher m;
+
+	m.add("/etc/ssh/*");
+	m.add("/usr/*/lib?");
+	m.add("*.[ch]");
+	m.add("/bin/[!a-m]*sh");
+	m.add("/tmp/\\*");
+
+	EXPECT_EQ(m.size(), 5);
+	EXPECT_TRUE(m.match("/etc/ssh/sshd_config"));
+	EXPECT_TRUE(m.match("/usr/local/lib6"));
+	EXPECT_TRUE(m.match("/usr/a/b/lib6"));
+	EXPECT_TRUE(m.match("/src/main.c"));
+	EXPECT_TRUE(m.match("/bin/zsh"));
+	EXPECT_TRUE(m.match("/tmp/*"));
+	EXPECT_FALSE(m.match("/usr/lib"));
+	EXPECT_FALSE(m.match("/src/main.cpp"));
+	EXPECT_FALSE(m.match("/bin/bash"));
+	EXPECT_FALSE(m.match("/tmp/a"));
+	EXPECT_FALSE(m.match(""));
+}
+
+TEST(glob_matcher, fnmatch_fallback)
+{
+	glob_matcher m;
+
+	m.add("/dev/tty[[:digit:]]");
+	m.add("/tmp/[abc");
+
+	EXPECT_TRUE(m.match("/dev/tty1"));
+	EXPECT_TRUE(m.match("/tmp/[abc"));
+	EXPECT_FALSE(m.match("/dev/ttyS"));
+}
+
+static uint64_t g_rand_state = 88172645463325252ULL;
+
+static uint64_t next_rand()
+{
+	g_rand_state ^= g_rand_state << 13;
+	g_rand_state ^= g_rand_state >> 7;
+	g_rand_state ^= g_rand_state << 17;
+	return g_rand_state;
+}
+
+static string random_string(const char* alphabet, uint32_t maxlen)
+{
+	string res;
+	uint32_t len = next_rand() % (maxlen + 1);
+	for(uint32_t j = 0; j < len; j++)
+	{
+		res += alphabet[next_rand() % strlen(alphabet)];
+	}
+	return res;
+}
+
+// the automaton gives the same results as fnmatch() with each pattern
+TEST(glob_matcher, random)
+{
+	static const char* brackets[] = {"[ab]", "[!a]", "[^/]", "[a-c]", "[]a]", "[a-]", "[\\]]"};
+
+	for(uint32_t j = 0; j < 500; j++)
+	{
+		glob_matcher m;
+		vector<string> patterns;
+		uint32_t npatterns = 1 + next_rand() % 4;
+
+		for(uint32_t k = 0; k < npatterns; k++)
+		{
+			string pattern;
+			uint32_t len = next_rand() % 7;
+			for(uint32_t l = 0; l < len; l++)
+			{
+				uint64_t r = next_rand() % 10;
+				if(r < 2)
+				{
+					pattern += "*";
+				}
+				else if(r < 3)
+				{
+					pattern += "?";
+				}
+				else if(r < 4)
+				{
+					pattern += brackets[next_rand() % (sizeof(brackets) / sizeof(brackets[0]))];
+				}
+				else
+				{
+					pattern += random_string("ab/.", 1);
+				}
+			}
+			patterns.push_back(pattern);
+			m.add(pattern);
+		}
+
+		for(uint32_t k = 0; k < 50; k++)
+		{
+			string str = random_string("abc/.]-", 10);
+			bool expected = false;
+			for(auto& p : patterns)
+			{
+				expected = expected || fnmatch(p.c_str(), str.c_str(), 0) == 0;
+			}
+			EXPECT_EQ(m.match(str.c_str()), expected) << "string " << str << " first pattern " << patterns[0];
+		}
+	}
+}
@@ -0,0 +1,69 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "latency_histogram.h"
+#include <gtest/gtest.h>
+
+TEST(latency_histogram, empty)
+{
+	latency_histogram h;
+
+	EXPECT_EQ(h.count(), 0);
+	EXPECT_EQ(h.percentile(0.5), 0);
+}
+
+// small values are counted exactly
+TEST(latency_histogram, exact_small_values)
+{
+	latency_histogram h;
+
+	for(uint64_t j = 1; j <= 10; j++)
+	{
+		h.add(j);
+	}
+
+	EXPECT_EQ(h.count(), 10);
+	EXPECT_EQ(h.percentile(0.5), 5);
+	EXPECT_EQ(h.percentile(0.9), 9);
+	EXPECT_EQ(h.percentile(1), 10);
+}
+
+// large values are within one bucket, i.e. 12.5%, of the real percentile
+TEST(latency_histogram, relative_error)
+{
+	latency_histogram h;
+
+	for(uint64_t j = 1; j <= 100000; j++)
+	{
+		h.add(j * 1000);
+	}
+
+	uint64_t p50 = h.percentile(0.5);
+	uint64_t p99 = h.percentile(0.99);
+
+	EXPECT_GE(p50, 50000000);
+	EXPECT_LE(p50, 50000000 * 1.125);
+	EXPECT_GE(p99, 99000000);
+	EXPECT_LE(p99, 99000000 * 1.125);
+
+	h.add(UINT64_MAX);
+	EXPECT_EQ(h.percentile(1), UINT64_MAX);
+
+	h.clear();
+	EXPECT_EQ(h.count(), 0);
+	EXPECT_EQ(h.percentile(0.99), 0);
+}
@@ -0,0 +1,130 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <multi_string_matcher.h>
+#include <utils.h>
+#include <gtest/gtest.h>
+#include <string.h>
+
+using namespace std;
+
+TEST(multi_string_matcher, patterns)
+{
+	multi_string_matcher m;
+
+	m.add(".ssh/", multi_string_matcher::CONTAINS);
+	m.add(".pem", multi_string_matcher::ENDSWITH);
+	m.add("/etc/shadow", multi_string_matcher::STARTSWITH);
+	m.add("PASSWD", multi_string_matcher::ICONTAINS);
+	m.compile();
+
+	EXPECT_EQ(m.size(), 4);
+	EXPECT_TRUE(m.match("/home/user/.ssh/id_rsa"));
+	EXPECT_TRUE(m.match("/etc/ssl/cert.pem"));
+	EXPECT_TRUE(m.match("/etc/shadow-"));
+	EXPECT_TRUE(m.match("/etc/passwd"));
+	EXPECT_TRUE(m.match("/etc/PassWd.bak"));
+	EXPECT_FALSE(m.match("/var/log/ssh.log"));
+	EXPECT_FALSE(m.match("/etc/cert.pem.old"));
+	EXPECT_FALSE(m.match("/tmp/etc/shadow"));
+	EXPECT_FALSE(m.match(""));
+}
+
+TEST(multi_string_matcher, empty_pattern)
+{
+	multi_string_matcher m;
+
+	m.add("abc", multi_string_matcher::CONTAINS);
+	m.add("", multi_string_matcher::ENDSWITH);
+	m.compile();
+
+	EXPECT_TRUE(m.match(""));
+	EXPECT_TRUE(m.match("xyz"));
+}
+
+static uint64_t g_rand_state = 88172645463325252ULL;
+
+static uint64_t next_rand()
+{
+	g_rand_state ^= g_rand_state << 13;
+	g_rand_state ^= g_rand_state >> 7;
+	g_rand_state ^= g_rand_state << 17;
+	return g_rand_state;
+}
+
+// a small alphabet makes the patterns overlap often
+static string random_string(uint32_t maxlen)
+{
+	static const char alphabet[] = "abAB/.";
+	string res;
+	uint32_t len = next_rand() % (maxlen + 1);
+	for(uint32_t j = 0; j < len; j++)
+	{
+		res += alphabet[next_rand() % (sizeof(alphabet) - 1)];
+	}
+	return res;
+}
+
+static bool match_one(const string& str, const string& pattern, multi_string_matcher::pattern_type type)
+{
+	switch(type)
+	{
+	case multi_string_matcher::CONTAINS:
+		return strstr(str.c_str(), pattern.c_str()) != NULL;
+	case multi_string_matcher::STARTSWITH:
+		return strncmp(str.c_str(), pattern.c_str(), pattern.size()) == 0;
+	case multi_string_matcher::ENDSWITH:
+		return sinsp_utils::endswith(str, pattern);
+	default:
+		return strcasestr(str.c_str(), pattern.c_str()) != NULL;
+	}
+}
+
+// the automatons give the same results as testing the patterns one by one
+TEST(multi_string_matcher, random)
+{
+	for(uint32_t j = 0; j < 200; j++)
+	{
+		multi_string_matcher m;
+		vector<pair<string, multi_string_matcher::pattern_type>> patterns;
+		uint32_t npatterns = 1 + next_rand() % 8;
+
+		for(uint32_t k = 0; k < npatterns; k++)
+		{
+			string pattern = random_string(4);
+			auto type = (multi_string_matcher::pattern_type)(next_rand() % 4);
+			if(pattern.empty())
+			{
+				pattern = "a";
+			}
+			patterns.push_back({pattern, type});
+			m.add(pattern, type);
+		}
+		m.compile();
+
+		for(uint32_t k = 0; k < 50; k++)
+		{
+			string str = random_string(12);
+			bool expected = false;
+			for(auto& p : patterns)
+			{
+				expected = expected || match_one(str, p.first, p.second);
+			}
+			EXPECT_EQ(m.match(str.c_str()), expected) << "string " << str << " pattern " << patterns[0].first;
+		}
+	}
+}
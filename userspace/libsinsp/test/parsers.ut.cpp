@@ -0,0 +1,342 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// the error code of the events is private
+#define VISIBILITY_PRIVATE
+
+#include "sinsp.h"
+#include <gtest/gtest.h>
+#include "test_capture.h"
+#include <unistd.h>
+
+static const int64_t FIRST_TID = 5000000;
+static const int64_t PARENT = FIRST_TID;
+static const int64_t CHILD = FIRST_TID + 1;
+static const int64_t THREAD = FIRST_TID + 2;
+
+static void dump_read(scap_t* h, scap_dumper_t* d, uint64_t* ts, int64_t tid, int64_t fd)
+{
+	uint8_t payload[16] = {};
+
+	dump_evt(h, d, (*ts)++, tid, PPME_SYSCALL_READ_E, 2, fd, (uint32_t)sizeof(payload));
+	dump_evt(h, d, (*ts)++, tid, PPME_SYSCALL_READ_X, 2, (int64_t)sizeof(payload),
+		 scap_const_sized_buffer{payload, sizeof(payload)});
+}
+
+static void dump_clone_exit(scap_t* h, scap_dumper_t* d, uint64_t* ts, int64_t tid, int64_t res,
+			    int64_t pid, int64_t ptid, uint32_t flags)
+{
+	dump_evt(h, d, (*ts)++, tid, PPME_SYSCALL_CLONE_20_X, 20,
+		 res, "/usr/bin/app", scap_const_sized_buffer{"", 0}, tid, pid, ptid, "/", (int64_t)1024,
+		 (uint64_t)0, (uint64_t)0, (uint32_t)0, (uint32_t)0, (uint32_t)0,
+		 "app", scap_const_sized_buffer{"", 0}, flags, (uint32_t)0, (uint32_t)0, tid, pid);
+}
+
+//
+// A process opens a file, fails to open another and to create a socket,
+// changes directory, then forks a child and creates a thread, which both
+// read the file. The parent closes it and the child exits.
+//
+static void write_capture(const std::string& fname)
+{
+	scap_t* h;
+	scap_dumper_t* d;
+	uint64_t ts = 1000000;
+
+	ASSERT_NO_FATAL_FAILURE(open_test_capture(fname, &h, &d));
+
+	dump_clone_evt(h, d, ts++, PARENT, 1, "/usr/bin/app", "app");
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_OPEN_E, 3, "/etc/passwd", (uint32_t)0, (uint32_t)0);
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_OPEN_X, 5, (int64_t)3, "/etc/passwd", (uint32_t)0, (uint32_t)0, (uint32_t)0);
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_OPEN_E, 3, "/nonexistent", (uint32_t)0, (uint32_t)0);
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_OPEN_X, 5, (int64_t)-2, "/nonexistent", (uint32_t)0, (uint32_t)0, (uint32_t)0);
+	dump_evt(h, d, ts++, PARENT, PPME_SOCKET_SOCKET_E, 3, (uint32_t)2, (uint32_t)1, (uint32_t)0);
+	dump_evt(h, d, ts++, PARENT, PPME_SOCKET_SOCKET_X, 1, (int64_t)-24);
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_CHDIR_E, 0);
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_CHDIR_X, 2, (int64_t)0, "/tmp");
+	dump_read(h, d, &ts, PARENT, 3);
+
+	dump_clone_exit(h, d, &ts, PARENT, CHILD, PARENT, 1, 0);
+	dump_clone_exit(h, d, &ts, CHILD, 0, CHILD, PARENT, 0);
+	dump_clone_exit(h, d, &ts, THREAD, 0, PARENT, 1, PPM_CL_CLONE_THREAD | PPM_CL_CLONE_FILES);
+	dump_read(h, d, &ts, THREAD, 3);
+
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_CLOSE_E, 1, (int64_t)3);
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	dump_read(h, d, &ts, PARENT, 3);
+	dump_read(h, d, &ts, CHILD, 3);
+
+	dump_evt(h, d, ts++, CHILD, PPME_PROCEXIT_1_E, 4, (int64_t)0, (int64_t)0, (uint8_t)0, (uint8_t)0);
+	dump_read(h, d, &ts, PARENT, 3);
+
+	close_test_capture(h, d);
+}
+
+// the next event of the test processes, that the inspector didn't filter out
+static void next_evt(sinsp& inspector, sinsp_evt** evt)
+{
+	int32_t res;
+
+	do
+	{
+		res = inspector.next(evt);
+		ASSERT_NE(res, SCAP_EOF);
+	}
+	while(res != SCAP_SUCCESS || (*evt)->get_tid() < FIRST_TID);
+}
+
+// the parsers keep the thread and fd tables in sync with the events
+TEST(sinsp_parser, state)
+{
+	std::string fname = testing::TempDir() + "sinsp_parser_state.scap";
+	sinsp inspector;
+	sinsp_evt* evt;
+
+	ASSERT_NO_FATAL_FAILURE(write_capture(fname));
+	inspector.open(fname);
+
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	sinsp_threadinfo* parent = inspector.get_thread_ref(PARENT, false, true).get();
+	ASSERT_NE(parent, nullptr);
+	EXPECT_EQ(parent->m_comm, "app");
+
+	// open
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	EXPECT_EQ(evt->m_errorcode, 0);
+	ASSERT_NE(evt->get_fd_info(), nullptr);
+	EXPECT_EQ(evt->get_fd_info()->m_name, "/etc/passwd");
+	ASSERT_NE(parent->get_fd(3), nullptr);
+	EXPECT_EQ(parent->get_fd(3)->m_name, "/etc/passwd");
+
+	// the error is the return value, called "res" or "fd"
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	EXPECT_EQ(evt->get_type(), PPME_SYSCALL_OPEN_X);
+	EXPECT_EQ(evt->m_errorcode, 2);
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	EXPECT_EQ(evt->get_type(), PPME_SOCKET_SOCKET_X);
+	EXPECT_EQ(evt->m_errorcode, 24);
+	EXPECT_EQ(parent->get_fd(-24), nullptr);
+
+	// chdir
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	EXPECT_EQ(parent->get_cwd(), "/tmp/");
+
+	// the exit of read finds the fd of its enter event
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	EXPECT_EQ(evt->get_type(), PPME_SYSCALL_READ_X);
+	ASSERT_NE(evt->get_fd_info(), nullptr);
+	EXPECT_EQ(evt->get_fd_info()->m_name, "/etc/passwd");
+
+	// a child process gets copies of the fds and the cwd
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	sinsp_threadinfo* child = inspector.get_thread_ref(CHILD, false, true).get();
+	ASSERT_NE(child, nullptr);
+	EXPECT_EQ(child->m_pid, CHILD);
+	EXPECT_EQ(child->m_ptid, PARENT);
+	EXPECT_EQ(child->m_comm, "app");
+	EXPECT_EQ(child->get_cwd(), "/tmp/");
+	ASSERT_NE(child->get_fd(3), nullptr);
+	EXPECT_EQ(child->get_fd(3)->m_name, "/etc/passwd");
+	EXPECT_NE(child->get_fd(3), parent->get_fd(3));
+
+	// a thread shares them
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	sinsp_threadinfo* thread = inspector.get_thread_ref(THREAD, false, true).get();
+	ASSERT_NE(thread, nullptr);
+	EXPECT_EQ(thread->m_pid, PARENT);
+	EXPECT_EQ(thread->get_fd(3), parent->get_fd(3));
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	ASSERT_NE(evt->get_fd_info(), nullptr);
+	EXPECT_EQ(evt->get_fd_info()->m_name, "/etc/passwd");
+
+	// close removes the fd of the parent only, on the next event
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	EXPECT_EQ(evt->get_type(), PPME_SYSCALL_CLOSE_X);
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	EXPECT_EQ(parent->get_fd(3), nullptr);
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	EXPECT_EQ(evt->get_fd_info(), nullptr);
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	ASSERT_NE(evt->get_fd_info(), nullptr);
+	EXPECT_EQ(evt->get_fd_info()->m_name, "/etc/passwd");
+
+	// the exited process is removed on the next event
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	EXPECT_EQ(evt->get_type(), PPME_PROCEXIT_1_E);
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	EXPECT_EQ(inspector.get_thread_ref(CHILD, false, true), nullptr);
+
+	inspector.close();
+	unlink(fname.c_str());
+}
+
+// the drop flags apply from the next event when they change during the
+// capture
+TEST(sinsp_parser, drop_event_flags)
+{
+	std::string fname = testing::TempDir() + "sinsp_parser_drop.scap";
+	sinsp inspector;
+	sinsp_evt* evt;
+	std::vector<uint16_t> types;
+
+	ASSERT_NO_FATAL_FAILURE(write_capture(fname));
+	inspector.open(fname);
+
+	// the clone, the opens and the first read
+	while(types.size() < 11)
+	{
+		ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+		types.push_back(evt->get_type());
+	}
+	EXPECT_EQ(types.back(), PPME_SYSCALL_READ_X);
+
+	// the reads and close are skipped, the clones still build the state
+	inspector.set_drop_event_flags(EF_DROP_SIMPLE_CONS);
+	types.clear();
+	while(types.size() < 3)
+	{
+		ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+		types.push_back(evt->get_type());
+	}
+	EXPECT_EQ(types, std::vector<uint16_t>({PPME_SYSCALL_CLONE_20_X, PPME_SYSCALL_CLONE_20_X, PPME_SYSCALL_CLONE_20_X}));
+	ASSERT_NE(inspector.get_thread_ref(CHILD, false, true), nullptr);
+	ASSERT_NE(inspector.get_thread_ref(THREAD, false, true), nullptr);
+
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	EXPECT_EQ(evt->get_type(), PPME_PROCEXIT_1_E);
+	ASSERT_NE(inspector.get_thread_ref(PARENT, false, true)->get_fd(3), nullptr);
+
+	// and are back once the flags are cleared
+	inspector.set_drop_event_flags((ppm_event_flags)0);
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	EXPECT_EQ(evt->get_type(), PPME_SYSCALL_READ_E);
+	ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	EXPECT_EQ(evt->get_type(), PPME_SYSCALL_READ_X);
+	ASSERT_NE(evt->get_fd_info(), nullptr);
+	EXPECT_EQ(evt->get_fd_info()->m_name, "/etc/passwd");
+
+	inspector.close();
+	unlink(fname.c_str());
+}
+
+// the types of the events of the test processes returned until the end
+static std::vector<uint16_t> read_types(sinsp& inspector)
+{
+	std::vector<uint16_t> types;
+	sinsp_evt* evt;
+	int32_t res;
+
+	while((res = inspector.next(&evt)) != SCAP_EOF)
+	{
+		if(res == SCAP_SUCCESS && evt->get_tid() >= FIRST_TID)
+		{
+			types.push_back(evt->get_type());
+		}
+	}
+	return types;
+}
+
+// the events of other types are filtered out, after updating the state if
+// they change it, and the threads that only make syscalls of no interest
+// are never looked up
+TEST(sinsp_parser, events_of_interest)
+{
+	std::string fname = testing::TempDir() + "sinsp_parser_interest.scap";
+	const int64_t OTHER = FIRST_TID + 3;
+	sinsp inspector;
+	scap_t* h;
+	scap_dumper_t* d;
+	uint64_t ts = 1000000;
+
+	ASSERT_NO_FATAL_FAILURE(open_test_capture(fname, &h, &d));
+	dump_clone_evt(h, d, ts++, PARENT, 1, "/usr/bin/app", "app");
+	dump_evt(h, d, ts++, OTHER, PPME_SYSCALL_FUTEX_E, 3, (uint64_t)0, (uint16_t)0, (uint64_t)0);
+	dump_evt(h, d, ts++, OTHER, PPME_SYSCALL_FUTEX_X, 1, (int64_t)0);
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_OPEN_E, 3, "/etc/passwd", (uint32_t)0, (uint32_t)0);
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_OPEN_X, 5, (int64_t)3, "/etc/passwd", (uint32_t)0, (uint32_t)0, (uint32_t)0);
+	dump_read(h, d, &ts, PARENT, 3);
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_CLOSE_E, 1, (int64_t)3);
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_OPEN_E, 3, "/etc/group", (uint32_t)0, (uint32_t)0);
+	dump_evt(h, d, ts++, PARENT, PPME_SYSCALL_OPEN_X, 5, (int64_t)4, "/etc/group", (uint32_t)0, (uint32_t)0, (uint32_t)0);
+	close_test_capture(h, d);
+
+	inspector.set_events_of_interest({PPME_SYSCALL_OPEN_X});
+	inspector.open(fname);
+	EXPECT_EQ(read_types(inspector), std::vector<uint16_t>({PPME_SYSCALL_OPEN_X, PPME_SYSCALL_OPEN_X}));
+	sinsp_threadinfo* parent = inspector.get_thread_ref(PARENT, false, true).get();
+	ASSERT_NE(parent, nullptr);
+	EXPECT_EQ(parent->get_fd(3), nullptr);
+	ASSERT_NE(parent->get_fd(4), nullptr);
+	EXPECT_EQ(parent->get_fd(4)->m_name, "/etc/group");
+	EXPECT_EQ(inspector.get_thread_ref(OTHER, false, true), nullptr);
+	inspector.close();
+
+	// by default, all the events are returned and their threads found
+	sinsp all;
+	all.open(fname);
+	EXPECT_EQ(read_types(all).size(), 11);
+	EXPECT_NE(all.get_thread_ref(OTHER, false, true), nullptr);
+
+	all.close();
+	unlink(fname.c_str());
+}
+
+// sendto keeps its enter event for the exit to name the fd from the tuple
+TEST(sinsp_parser, sendto_tuple)
+{
+	std::string fname = testing::TempDir() + "sinsp_parser_sendto.scap";
+	uint8_t payload[16] = {};
+	uint8_t tuple[13] = {PPM_AF_INET, 10, 0, 0, 1, 0x30, 0x39, 10, 0, 0, 2, 0, 53};
+	sinsp inspector;
+	sinsp_evt* evt;
+	scap_t* h;
+	scap_dumper_t* d;
+	uint64_t ts = 1000000;
+
+	ASSERT_NO_FATAL_FAILURE(open_test_capture(fname, &h, &d));
+	dump_clone_evt(h, d, ts++, PARENT, 1, "/usr/bin/app", "app");
+	dump_evt(h, d, ts++, PARENT, PPME_SOCKET_SOCKET_E, 3, (uint32_t)PPM_AF_INET, (uint32_t)2, (uint32_t)0);
+	dump_evt(h, d, ts++, PARENT, PPME_SOCKET_SOCKET_X, 1, (int64_t)3);
+	dump_evt(h, d, ts++, PARENT, PPME_SOCKET_SENDTO_E, 3, (int64_t)3, (uint32_t)sizeof(payload),
+		 scap_const_sized_buffer{tuple, sizeof(tuple)});
+	dump_evt(h, d, ts++, PARENT, PPME_SOCKET_SENDTO_X, 2, (int64_t)sizeof(payload),
+		 scap_const_sized_buffer{payload, sizeof(payload)});
+	close_test_capture(h, d);
+
+	inspector.open(fname);
+	do
+	{
+		ASSERT_NO_FATAL_FAILURE(next_evt(inspector, &evt));
+	}
+	while(evt->get_type() != PPME_SOCKET_SENDTO_X);
+
+	ASSERT_NE(evt->get_fd_info(), nullptr);
+	EXPECT_NE(evt->get_fd_info()->m_name, "");
+
+	inspector.close();
+	unlink(fname.c_str());
+}
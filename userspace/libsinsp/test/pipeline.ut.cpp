@@ -0,0 +1,309 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "pipeline.h"
+#include <gtest/gtest.h>
+#include "test_capture.h"
+#include <algorithm>
+#include <unistd.h>
+
+static const uint32_t NSHARDS = 8;
+
+// craft a clone exit event, as seen by the thread tid
+static scap_evt* make_clone_exit(uint8_t* buf, size_t size, int64_t tid, int64_t res, int64_t pid, int64_t ptid, uint32_t flags, int64_t vtid)
+{
+	char err[SCAP_LASTERR_SIZE];
+	size_t evt_size;
+	scap_sized_buffer evt_buf = {buf, size};
+
+	int32_t rc = scap_event_encode_params(evt_buf, &evt_size, err, PPME_SYSCALL_CLONE_20_X, 20,
+		res, "bash", scap_const_sized_buffer{"", 0}, tid, pid, ptid, "", 1024, 0, 0, 0, 0, 0,
+		"bash", scap_const_sized_buffer{"", 0}, flags, 0, 0, vtid, pid);
+	EXPECT_EQ(rc, SCAP_SUCCESS);
+
+	scap_evt* evt = (scap_evt*)buf;
+	evt->tid = tid;
+	return evt;
+}
+
+// find two processes owned by different shards
+static void find_different_shards(sinsp_shard_router& router, int64_t* a, int64_t* b)
+{
+	*a = 100;
+	*b = 101;
+	while(router.shard_of_tgid(*a) == router.shard_of_tgid(*b))
+	{
+		(*b)++;
+	}
+}
+
+TEST(sinsp_shard_router, threads_follow_process)
+{
+	sinsp_shard_router router(NSHARDS);
+	uint32_t handoff;
+
+	router.add_thread(100, 100);
+	router.add_thread(101, 100);
+	router.add_thread(102, 100);
+
+	uint8_t buf[1024];
+	scap_evt* evt = make_clone_exit(buf, sizeof(buf), 101, 0, 100, 100, 0, 101);
+	evt->type = PPME_SYSCALL_READ_X;
+	EXPECT_EQ(router.route(evt, &handoff), router.shard_of_tgid(100));
+	EXPECT_EQ(handoff, sinsp_shard_router::NO_SHARD);
+
+	// a new thread is owned by the shard of its process
+	evt = make_clone_exit(buf, sizeof(buf), 103, 0, 100, 100, PPM_CL_CLONE_THREAD, 103);
+	EXPECT_EQ(router.route(evt, &handoff), router.shard_of_tgid(100));
+	EXPECT_EQ(handoff, sinsp_shard_router::NO_SHARD);
+	EXPECT_EQ(router.size(), 4);
+}
+
+TEST(sinsp_shard_router, fork_handoff)
+{
+	sinsp_shard_router router(NSHARDS);
+	uint32_t handoff;
+	int64_t parent, child;
+	uint8_t buf[1024];
+
+	find_different_shards(router, &parent, &child);
+	router.add_thread(parent, parent);
+
+	// the parent side is handed off to the child's shard
+	scap_evt* evt = make_clone_exit(buf, sizeof(buf), parent, child, parent, 1, 0, parent);
+	EXPECT_EQ(router.route(evt, &handoff), router.shard_of_tgid(parent));
+	EXPECT_EQ(handoff, router.shard_of_tgid(child));
+
+	// the child side goes to the child's shard only
+	evt = make_clone_exit(buf, sizeof(buf), child, 0, child, parent, 0, child);
+	EXPECT_EQ(router.route(evt, &handoff), router.shard_of_tgid(child));
+	EXPECT_EQ(handoff, sinsp_shard_router::NO_SHARD);
+
+	// in a pid namespace the return value can't be trusted
+	evt = make_clone_exit(buf, sizeof(buf), parent, child, parent, 1, PPM_CL_CHILD_IN_PIDNS, parent);
+	router.route(evt, &handoff);
+	EXPECT_EQ(handoff, sinsp_shard_router::NO_SHARD);
+	evt = make_clone_exit(buf, sizeof(buf), parent, child, parent, 1, 0, 7);
+	router.route(evt, &handoff);
+	EXPECT_EQ(handoff, sinsp_shard_router::NO_SHARD);
+}
+
+TEST(sinsp_shard_router, lookup_and_exit)
+{
+	uint32_t nlookups = 0;
+	sinsp_shard_router router(NSHARDS, [&nlookups](int64_t tid) -> int64_t
+	{
+		nlookups++;
+		return tid == 201 ? 200 : -1;
+	});
+	uint32_t handoff;
+	uint8_t buf[1024];
+
+	scap_evt* evt = make_clone_exit(buf, sizeof(buf), 201, 0, 200, 200, 0, 201);
+	evt->type = PPME_SYSCALL_READ_X;
+	EXPECT_EQ(router.route(evt, &handoff), router.shard_of_tgid(200));
+	EXPECT_EQ(router.route(evt, &handoff), router.shard_of_tgid(200));
+	EXPECT_EQ(nlookups, 1);
+
+	// unknown threads are their own process
+	evt->tid = 300;
+	EXPECT_EQ(router.route(evt, &handoff), router.shard_of_tgid(300));
+
+	// the exiting thread is forgotten after its last event
+	evt->tid = 201;
+	evt->type = PPME_PROCEXIT_1_E;
+	EXPECT_EQ(router.route(evt, &handoff), router.shard_of_tgid(200));
+	EXPECT_EQ(router.size(), 1);
+}
+
+static const int64_t FIRST_TID = 5000000;
+static const uint32_t NPROCS = 6;
+
+// a child of parent owned by another shard, with both 3 and 4 shards
+static int64_t find_handed_off_child(int64_t parent)
+{
+	sinsp_shard_router router3(3);
+	sinsp_shard_router router4(4);
+	int64_t child = FIRST_TID + NPROCS;
+
+	while(router3.shard_of_tgid(child) == router3.shard_of_tgid(parent) ||
+	      router4.shard_of_tgid(child) == router4.shard_of_tgid(parent))
+	{
+		child++;
+	}
+	return child;
+}
+
+//
+// Processes opening, reading and closing files. The first one keeps a file
+// open and forks a child, owned by another shard, that reads it.
+//
+static void write_capture(const std::string& fname)
+{
+	scap_t* h;
+	scap_dumper_t* d;
+	uint64_t ts = 1000000;
+	uint8_t payload[16] = {};
+	scap_const_sized_buffer data = {payload, sizeof(payload)};
+	int64_t parent = FIRST_TID;
+	int64_t child = find_handed_off_child(parent);
+
+	ASSERT_NO_FATAL_FAILURE(open_test_capture(fname, &h, &d));
+
+	for(uint32_t j = 0; j < NPROCS; j++)
+	{
+		std::string comm = "proc" + std::to_string(j);
+		std::string exe = "/usr/bin/" + comm;
+
+		dump_clone_evt(h, d, ts++, FIRST_TID + j, 1, exe.c_str(), comm.c_str());
+	}
+
+	dump_evt(h, d, ts++, parent, PPME_SYSCALL_OPEN_E, 3, "/etc/passwd", (uint32_t)0, (uint32_t)0);
+	dump_evt(h, d, ts++, parent, PPME_SYSCALL_OPEN_X, 5, (int64_t)9, "/etc/passwd", (uint32_t)0, (uint32_t)0, (uint32_t)0);
+
+	for(int64_t j = 0; j < 60; j++)
+	{
+		int64_t tid = FIRST_TID + j % NPROCS;
+		int64_t fd = 3 + j % 5;
+		std::string name = (j % 3 ? "/etc/" : "/tmp/") + std::to_string(j);
+
+		dump_evt(h, d, ts++, tid, PPME_SYSCALL_OPEN_E, 3, name.c_str(), (uint32_t)0, (uint32_t)0);
+		dump_evt(h, d, ts++, tid, PPME_SYSCALL_OPEN_X, 5, fd, name.c_str(), (uint32_t)0, (uint32_t)0, (uint32_t)0);
+		dump_evt(h, d, ts++, tid, PPME_SYSCALL_READ_E, 2, fd, (uint32_t)sizeof(payload));
+		dump_evt(h, d, ts++, tid, PPME_SYSCALL_READ_X, 2, (int64_t)sizeof(payload), data);
+		dump_evt(h, d, ts++, tid, PPME_SYSCALL_CLOSE_E, 1, fd);
+		dump_evt(h, d, ts++, tid, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	}
+
+	// the parent side of the fork comes first
+	dump_evt(h, d, ts++, parent, PPME_SYSCALL_CLONE_20_X, 20,
+		 child, "/usr/bin/proc0", scap_const_sized_buffer{"", 0}, parent, parent, (int64_t)1, "/", (int64_t)1024,
+		 (uint64_t)0, (uint64_t)0, (uint32_t)0, (uint32_t)0, (uint32_t)0,
+		 "proc0", scap_const_sized_buffer{"", 0}, (uint32_t)0, (uint32_t)0, (uint32_t)0, parent, parent);
+	dump_clone_evt(h, d, ts++, child, parent, "/usr/bin/proc0", "proc0");
+
+	for(int64_t j = 0; j < 4; j++)
+	{
+		dump_evt(h, d, ts++, child, PPME_SYSCALL_READ_E, 2, (int64_t)9, (uint32_t)sizeof(payload));
+		dump_evt(h, d, ts++, child, PPME_SYSCALL_READ_X, 2, (int64_t)sizeof(payload), data);
+		dump_evt(h, d, ts++, parent, PPME_SYSCALL_READ_E, 2, (int64_t)9, (uint32_t)sizeof(payload));
+		dump_evt(h, d, ts++, parent, PPME_SYSCALL_READ_X, 2, (int64_t)sizeof(payload), data);
+	}
+
+	dump_evt(h, d, ts++, child, PPME_PROCEXIT_1_E, 4, (int64_t)0, (int64_t)0, (uint8_t)0, (uint8_t)0);
+
+	close_test_capture(h, d);
+}
+
+// describe the events of the test processes with their state
+static bool output_state(sinsp_evt* evt, std::string& output)
+{
+	sinsp_threadinfo* tinfo = evt->get_thread_info();
+	sinsp_fdinfo_t* fdinfo = evt->get_fd_info();
+
+	if(evt->get_tid() < FIRST_TID || evt->get_type() == PPME_PROCINFO_E)
+	{
+		return false;
+	}
+
+	output = std::to_string(evt->get_ts()) + " " + std::to_string(evt->get_tid()) + " " + evt->get_name() +
+		 " " + (tinfo ? tinfo->m_comm + " " + std::to_string(tinfo->m_ptid) : "-") +
+		 " " + (fdinfo ? fdinfo->m_name : "-");
+	return true;
+}
+
+static std::vector<std::string> run_pipeline(const std::string& fname, uint32_t nworkers, bool ordered)
+{
+	sinsp source;
+	std::vector<std::string> outputs;
+	std::string output;
+
+	source.open(fname);
+
+	sinsp_pipeline pipeline(&source, nworkers, ordered);
+	pipeline.start(output_state);
+	while(pipeline.next(output))
+	{
+		outputs.push_back(output);
+	}
+	EXPECT_EQ(pipeline.getlasterr(), "");
+
+	return outputs;
+}
+
+// the shards together see the same events, with the same state, as a single
+// inspector
+TEST(sinsp_pipeline, same_output_as_inspector)
+{
+	std::string fname = testing::TempDir() + "sinsp_pipeline.scap";
+	std::vector<std::string> expected;
+	std::string output;
+
+	ASSERT_NO_FATAL_FAILURE(write_capture(fname));
+
+	{
+		sinsp inspector;
+		sinsp_evt* evt;
+
+		inspector.open(fname);
+		while(inspector.next(&evt) != SCAP_EOF)
+		{
+			if(output_state(evt, output))
+			{
+				expected.push_back(output);
+			}
+		}
+		inspector.close();
+	}
+	ASSERT_EQ(expected.size(), 2 + NPROCS + 60 * 6 + 2 + 4 * 4 + 1);
+
+	EXPECT_EQ(run_pipeline(fname, 4, true), expected);
+
+	std::vector<std::string> unordered = run_pipeline(fname, 3, false);
+	std::sort(unordered.begin(), unordered.end());
+	std::sort(expected.begin(), expected.end());
+	EXPECT_EQ(unordered, expected);
+
+	unlink(fname.c_str());
+}
+
+// an error of the output function stops the capture instead of escaping the
+// worker thread
+TEST(sinsp_pipeline, output_error)
+{
+	std::string fname = testing::TempDir() + "sinsp_pipeline_error.scap";
+	std::string output;
+
+	ASSERT_NO_FATAL_FAILURE(write_capture(fname));
+
+	{
+		sinsp source;
+		source.open(fname);
+
+		sinsp_pipeline pipeline(&source, 4, true);
+		pipeline.start([](sinsp_evt* evt, std::string& output) -> bool
+		{
+			throw std::runtime_error("output failed");
+		});
+		while(pipeline.next(output))
+		{
+		}
+		EXPECT_EQ(pipeline.getlasterr(), "output failed");
+	}
+
+	unlink(fname.c_str());
+}
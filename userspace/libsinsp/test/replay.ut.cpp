@@ -0,0 +1,163 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "replay.h"
+#include <gtest/gtest.h>
+#include "test_capture.h"
+#include <unistd.h>
+
+static const uint32_t NEVTS = 20000;
+
+// write NEVTS read exit events, 1us apart, with a checkpoint every
+// checkpoint_interval_ns if it's not 0
+static void write_capture(const std::string& fname, uint64_t checkpoint_interval_ns)
+{
+	scap_t* h;
+	scap_dumper_t* d;
+	uint8_t payload[16] = {};
+
+	ASSERT_NO_FATAL_FAILURE(open_test_capture(fname, &h, &d));
+	if(checkpoint_interval_ns != 0)
+	{
+		ASSERT_EQ(scap_dump_enable_index(h, d, checkpoint_interval_ns), SCAP_SUCCESS);
+	}
+
+	for(uint32_t j = 0; j < NEVTS; j++)
+	{
+		dump_evt(h, d, 1000000 + j * 1000, 100 + j % 7, PPME_SYSCALL_READ_X, 2,
+			 (int64_t)sizeof(payload), scap_const_sized_buffer{payload, sizeof(payload)});
+	}
+
+	close_test_capture(h, d);
+}
+
+static bool output_ts(sinsp_evt* evt, std::string& output)
+{
+	if(evt->get_type() != PPME_SYSCALL_READ_X)
+	{
+		return false;
+	}
+
+	output = std::to_string(evt->get_ts());
+	return true;
+}
+
+static std::vector<std::string> replay(const std::string& fname, uint32_t nworkers, uint32_t* nshards)
+{
+	std::vector<std::string> outputs;
+	std::string output;
+	sinsp_replay r(fname, nworkers);
+
+	r.start(output_ts);
+	while(r.next(output))
+	{
+		outputs.push_back(output);
+	}
+
+	EXPECT_EQ(r.getlasterr(), "");
+	*nshards = r.get_num_shards();
+	return outputs;
+}
+
+// the outputs of the shards come back in file order, the same as a
+// sequential read
+TEST(sinsp_replay, same_outputs_as_sequential)
+{
+	std::string fname = testing::TempDir() + "sinsp_replay.scap";
+	std::vector<std::string> expected;
+	uint32_t nshards;
+
+	write_capture(fname, 1000000);
+	for(uint32_t j = 0; j < NEVTS; j++)
+	{
+		expected.push_back(std::to_string(1000000 + j * 1000));
+	}
+
+	EXPECT_EQ(replay(fname, 1, &nshards), expected);
+	EXPECT_EQ(nshards, 20);
+	EXPECT_EQ(replay(fname, 4, &nshards), expected);
+
+	unlink(fname.c_str());
+	unlink((fname + ".idx").c_str());
+}
+
+TEST(sinsp_replay, no_index)
+{
+	std::string fname = testing::TempDir() + "sinsp_replay_noindex.scap";
+	uint32_t nshards;
+
+	write_capture(fname, 0);
+	EXPECT_EQ(replay(fname, 4, &nshards).size(), NEVTS);
+	EXPECT_EQ(nshards, 1);
+
+	unlink(fname.c_str());
+}
+
+// checkpoints that share a timestamp start their own shard, and the events
+// between them are replayed once
+TEST(sinsp_replay, checkpoints_with_same_ts)
+{
+	std::string fname = testing::TempDir() + "sinsp_replay_samets.scap";
+	std::vector<std::string> expected;
+	uint8_t payload[16] = {};
+	scap_t* h;
+	scap_dumper_t* d;
+	uint32_t nshards;
+
+	ASSERT_NO_FATAL_FAILURE(open_test_capture(fname, &h, &d));
+	ASSERT_EQ(scap_dump_enable_index(h, d, 0), SCAP_SUCCESS);
+	for(uint32_t j = 0; j < 300; j++)
+	{
+		uint64_t ts = 1000000 + std::min(j, 200u) * 1000;
+		if(j == 100 || j == 200 || j == 250)
+		{
+			ASSERT_EQ(scap_dump_checkpoint(h, d, ts), SCAP_SUCCESS);
+		}
+
+		dump_evt(h, d, ts, 100, PPME_SYSCALL_READ_X, 2,
+			 (int64_t)sizeof(payload), scap_const_sized_buffer{payload, sizeof(payload)});
+		expected.push_back(std::to_string(ts));
+	}
+	close_test_capture(h, d);
+
+	EXPECT_EQ(replay(fname, 2, &nshards), expected);
+	EXPECT_EQ(nshards, 4);
+
+	unlink(fname.c_str());
+	unlink((fname + ".idx").c_str());
+}
+
+TEST(sinsp_replay, output_error)
+{
+	std::string fname = testing::TempDir() + "sinsp_replay_error.scap";
+	std::string output;
+
+	write_capture(fname, 1000000);
+
+	sinsp_replay r(fname, 4);
+	r.start([](sinsp_evt* evt, std::string& output) -> bool
+	{
+		throw std::runtime_error("output failed");
+	});
+	while(r.next(output))
+	{
+	}
+	EXPECT_EQ(r.getlasterr(), "output failed");
+
+	unlink(fname.c_str());
+	unlink((fname + ".idx").c_str());
+}
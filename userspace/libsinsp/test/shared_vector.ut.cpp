@@ -0,0 +1,148 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include <gtest/gtest.h>
+#include "test_capture.h"
+#include <unistd.h>
+
+typedef std::vector<std::string> strvec_t;
+
+TEST(sinsp_intern_pool, intern)
+{
+	sinsp_intern_pool<std::string> pool;
+
+	sinsp_shared_vector<std::string> a = pool.intern(strvec_t{"a", "b"});
+	sinsp_shared_vector<std::string> b = pool.intern(strvec_t{"a", "b"});
+	sinsp_shared_vector<std::string> c = pool.intern(strvec_t{"ab"});
+	EXPECT_TRUE(a.shares(b));
+	EXPECT_FALSE(a.shares(c));
+	EXPECT_EQ(a.get(), strvec_t({"a", "b"}));
+	EXPECT_EQ(c[0], "ab");
+	EXPECT_EQ(pool.size(), 2);
+
+	// copies share the storage, until one of them is assigned
+	sinsp_shared_vector<std::string> d = a;
+	EXPECT_TRUE(d.shares(a));
+	d = strvec_t{"a"};
+	EXPECT_FALSE(d.shares(a));
+	EXPECT_EQ(a.size(), 2);
+
+	// the empty vector is never stored
+	sinsp_shared_vector<std::string> e = pool.intern(strvec_t());
+	EXPECT_TRUE(e.empty());
+	EXPECT_EQ(e.begin(), e.end());
+	EXPECT_EQ(pool.size(), 2);
+
+	// vectors nobody uses are dropped when found again
+	c.clear();
+	c = pool.intern(strvec_t{"ab"});
+	EXPECT_EQ(pool.size(), 2);
+}
+
+TEST(sinsp_intern_pool, purge)
+{
+	sinsp_intern_pool<std::pair<std::string, std::string>> pool;
+
+	for(uint32_t j = 0; j < 1000; j++)
+	{
+		pool.intern({{"cpu", "/" + std::to_string(j)}});
+	}
+	EXPECT_LT(pool.size(), 64);
+}
+
+static const int64_t FIRST_TID = 5000000;
+static const uint32_t NCHILDS = 4;
+
+static scap_const_sized_buffer strbuf(const char* str, size_t len)
+{
+	return scap_const_sized_buffer{str, len};
+}
+
+// A process that clones NCHILDS processes, the first two of which execve
+// the same program
+static void write_capture(const std::string& fname)
+{
+	scap_t* h;
+	scap_dumper_t* d;
+	uint64_t ts = 1000000;
+	scap_const_sized_buffer args = strbuf("-w\0" "4\0", 5);
+	scap_const_sized_buffer cgroups = strbuf("cpu=/pod\0" "memory=/pod\0", 21);
+
+	ASSERT_NO_FATAL_FAILURE(open_test_capture(fname, &h, &d));
+
+	for(uint32_t j = 0; j <= NCHILDS; j++)
+	{
+		int64_t tid = FIRST_TID + j;
+		int64_t ptid = j == 0 ? 1 : FIRST_TID;
+
+		dump_clone_evt(h, d, ts++, tid, ptid, "/usr/bin/worker", "worker", args, cgroups);
+	}
+
+	for(uint32_t j = 1; j <= 2; j++)
+	{
+		int64_t tid = FIRST_TID + j;
+
+		dump_evt(h, d, ts++, tid, PPME_SYSCALL_EXECVE_16_X, 16,
+			 (int64_t)0, "/bin/sh", strbuf("-c\0" "true\0", 8), tid, tid, FIRST_TID, "/",
+			 (uint64_t)1024, (uint64_t)0, (uint64_t)0, (uint32_t)0, (uint32_t)0, (uint32_t)0,
+			 "sh", cgroups, strbuf("HOME=/\0", 7));
+	}
+
+	close_test_capture(h, d);
+}
+
+// the children share the args and cgroups of their parent, until they
+// execve a different program
+TEST(sinsp_intern_pool, clone_and_execve)
+{
+	std::string fname = testing::TempDir() + "sinsp_shared_vector.scap";
+	sinsp inspector;
+	sinsp_evt* evt;
+
+	write_capture(fname);
+	inspector.open(fname);
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+	}
+
+	sinsp_threadinfo* parent = inspector.get_thread_ref(FIRST_TID, false, true).get();
+	ASSERT_NE(parent, nullptr);
+	EXPECT_EQ(parent->m_args.get(), strvec_t({"-w", "4"}));
+	ASSERT_EQ(parent->m_cgroups.size(), 2);
+	EXPECT_EQ(parent->m_cgroups[1].first, "memory");
+	EXPECT_EQ(parent->m_cgroups[1].second, "/pod");
+
+	sinsp_threadinfo* childs[NCHILDS + 1] = {};
+	for(uint32_t j = 1; j <= NCHILDS; j++)
+	{
+		childs[j] = inspector.get_thread_ref(FIRST_TID + j, false, true).get();
+		ASSERT_NE(childs[j], nullptr);
+		EXPECT_TRUE(childs[j]->m_cgroups.shares(parent->m_cgroups));
+	}
+
+	EXPECT_EQ(childs[1]->m_args.get(), strvec_t({"-c", "true"}));
+	EXPECT_EQ(childs[1]->get_env(), strvec_t({"HOME=/"}));
+	EXPECT_TRUE(childs[1]->m_args.shares(childs[2]->m_args));
+	EXPECT_TRUE(childs[1]->m_env.shares(childs[2]->m_env));
+	EXPECT_FALSE(childs[1]->m_args.shares(parent->m_args));
+	EXPECT_TRUE(childs[3]->m_args.shares(parent->m_args));
+	EXPECT_TRUE(childs[4]->m_args.shares(parent->m_args));
+
+	inspector.close();
+	unlink(fname.c_str());
+}
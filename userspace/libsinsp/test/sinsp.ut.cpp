@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "sinsp.h"
 #include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 using namespace libsinsp;
 
@@ -36,3 +38,102 @@ TEST(sinsp, external_event_processor_initialization)
 	EXPECT_EQ(my_sinsp.get_external_event_processor(), &processor);
 }
 
+
+// A lazy fd table has the fds an eager one gets at open time
+TEST(sinsp, lazy_fd_tables)
+{
+	int64_t pid = getpid();
+	int usock[2];
+	std::string eager_name;
+
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, usock), 0);
+
+	{
+		sinsp eager;
+		eager.open_nodriver();
+		sinsp_threadinfo* tinfo = eager.get_thread_ref(pid).get();
+		ASSERT_NE(tinfo, nullptr);
+		ASSERT_NE(tinfo->get_fd(usock[0]), nullptr);
+		eager_name = tinfo->get_fd(usock[0])->m_name;
+		eager.close();
+	}
+
+	sinsp lazy;
+	lazy.set_lazy_fd_tables(true, 0);
+	lazy.open_nodriver();
+	sinsp_threadinfo* tinfo = lazy.get_thread_ref(pid).get();
+	ASSERT_NE(tinfo, nullptr);
+
+	sinsp_fdinfo_t* fdinfo = tinfo->get_fd(usock[0]);
+	ASSERT_NE(fdinfo, nullptr);
+	EXPECT_EQ(fdinfo->m_type, SCAP_FD_UNIX_SOCK);
+	EXPECT_EQ(fdinfo->m_name, eager_name);
+	EXPECT_NE(tinfo->get_fd(usock[1]), nullptr);
+	EXPECT_GE(tinfo->get_fd_opencount(), 2);
+
+	lazy.close();
+	close(usock[0]);
+	close(usock[1]);
+}
+
+class test_helper
+{
+public:
+	static uint32_t count_lazy_fd_tables(sinsp& inspector)
+	{
+		uint32_t n = 0;
+		inspector.m_thread_manager->get_threads()->const_loop([&n](const sinsp_threadinfo& tinfo) {
+			if(tinfo.m_lazy_fdtable)
+			{
+				n++;
+			}
+			return true;
+		});
+		return n;
+	}
+
+	static void prefill_fd_tables(sinsp& inspector)
+	{
+		inspector.prefill_fd_tables();
+	}
+};
+
+// A prefill round reads at most prefill_batch lazy fd tables, and the
+// rounds that follow read the rest, sockets included
+TEST(sinsp, lazy_fd_tables_prefill)
+{
+	const uint32_t batch = 2;
+	int64_t pid = getpid();
+	int usock[2];
+
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, usock), 0);
+
+	sinsp lazy;
+	lazy.set_lazy_fd_tables(true, batch);
+	lazy.open_nodriver();
+
+	uint32_t nlazy = test_helper::count_lazy_fd_tables(lazy);
+	ASSERT_GT(nlazy, 0u);
+
+	test_helper::prefill_fd_tables(lazy);
+	uint32_t nleft = test_helper::count_lazy_fd_tables(lazy);
+	EXPECT_LT(nleft, nlazy);
+	EXPECT_GE(nleft + batch, nlazy);
+
+	for(uint32_t j = 0; j < nlazy && test_helper::count_lazy_fd_tables(lazy) > 0; j++)
+	{
+		test_helper::prefill_fd_tables(lazy);
+	}
+	EXPECT_EQ(test_helper::count_lazy_fd_tables(lazy), 0u);
+
+	sinsp_threadinfo* tinfo = lazy.get_thread_ref(pid).get();
+	ASSERT_NE(tinfo, nullptr);
+	sinsp_fdinfo_t* fdinfo = tinfo->get_fd(usock[0]);
+	ASSERT_NE(fdinfo, nullptr);
+	EXPECT_EQ(fdinfo->m_type, SCAP_FD_UNIX_SOCK);
+	EXPECT_NE(tinfo->get_fd(usock[1]), nullptr);
+
+	lazy.close();
+	close(usock[0]);
+	close(usock[1]);
+}
@@ -0,0 +1,169 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+//
+// Helpers writing the capture files used by the tests. The events are
+// built from their parameters, and the process table of the file is the
+// one of /proc when it's opened.
+//
+
+#include <sinsp.h>
+#include <gtest/gtest.h>
+#include <stdarg.h>
+#include <string>
+#include <vector>
+
+//
+// Open a capture file to write, use it with
+// ASSERT_NO_FATAL_FAILURE(open_test_capture(...))
+//
+inline void open_test_capture(const std::string& fname, scap_t** h, scap_dumper_t** d)
+{
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc;
+	scap_open_args oargs = {};
+
+	oargs.mode = SCAP_MODE_NODRIVER;
+	*h = scap_open(oargs, error, &rc);
+	ASSERT_NE(*h, nullptr) << error;
+
+	*d = scap_dump_open(*h, fname.c_str(), SCAP_COMPRESSION_NONE, true);
+	ASSERT_NE(*d, nullptr) << scap_getlasterr(*h);
+}
+
+inline void close_test_capture(scap_t* h, scap_dumper_t* d)
+{
+	scap_dump_close(d);
+	scap_close(h);
+}
+
+//
+// Write an event with the given parameters, see scap_event_encode_params()
+//
+inline void dump_evt(scap_t* h, scap_dumper_t* d, uint64_t ts, int64_t tid, ppm_event_type type, uint32_t n, ...)
+{
+	char error[SCAP_LASTERR_SIZE];
+	uint8_t buf[1024];
+	scap_sized_buffer evt_buf = {buf, sizeof(buf)};
+	size_t evt_size;
+	va_list args;
+
+	va_start(args, n);
+	ASSERT_EQ(scap_event_encode_params_v(evt_buf, &evt_size, error, type, n, args), SCAP_SUCCESS) << error;
+	va_end(args);
+
+	scap_evt* evt = (scap_evt*)buf;
+	evt->ts = ts;
+	evt->tid = tid;
+	ASSERT_EQ(scap_dump(h, d, evt, 0, 0), SCAP_SUCCESS);
+}
+
+//
+// Write the clone() exit event of the child of a new process tid, its
+// first event
+//
+inline void dump_clone_evt(scap_t* h, scap_dumper_t* d, uint64_t ts, int64_t tid, int64_t ptid,
+			   const char* exe, const char* comm,
+			   scap_const_sized_buffer args = scap_const_sized_buffer{"", 0},
+			   scap_const_sized_buffer cgroups = scap_const_sized_buffer{"", 0})
+{
+	dump_evt(h, d, ts, tid, PPME_SYSCALL_CLONE_20_X, 20,
+		 (int64_t)0, exe, args, tid, tid, ptid, "/", (int64_t)1024,
+		 (uint64_t)0, (uint64_t)0, (uint32_t)0, (uint32_t)0, (uint32_t)0,
+		 comm, cgroups, (uint32_t)0, (uint32_t)0, (uint32_t)0, tid, tid);
+}
+
+//
+// A capture where processes, cloned from init, take turns to open and close
+// files, see write_files_capture()
+//
+struct files_capture
+{
+	// The processes are first_tid, first_tid + 1... running /usr/bin/<comm>
+	int64_t first_tid = 0;
+	std::vector<std::string> comms;
+	// The file opened at each turn. Turn j is taken by the process
+	// j % comms.size(), with the fd 3 + j % nfds.
+	std::vector<std::string> names;
+	int64_t nfds = 4;
+	// The opens of the turns multiple of fail_every fail with ENOENT
+	int64_t fail_every = 3;
+	// If true the file is also read, 4 * j bytes at turn j
+	bool with_reads = false;
+};
+
+inline void write_files_capture(const std::string& fname, const files_capture& c)
+{
+	scap_t* h;
+	scap_dumper_t* d;
+	uint64_t ts = 1000000;
+	uint8_t payload[16] = {};
+	scap_const_sized_buffer data = {payload, sizeof(payload)};
+
+	ASSERT_NO_FATAL_FAILURE(open_test_capture(fname, &h, &d));
+
+	int64_t nprocs = (int64_t)c.comms.size();
+	int64_t nturns = (int64_t)c.names.size();
+
+	for(int64_t j = 0; j < nprocs; j++)
+	{
+		std::string exe = "/usr/bin/" + c.comms[j];
+		dump_clone_evt(h, d, ts++, c.first_tid + j, 1, exe.c_str(), c.comms[j].c_str());
+	}
+
+	for(int64_t j = 0; j < nturns; j++)
+	{
+		int64_t tid = c.first_tid + j % nprocs;
+		int64_t fd = 3 + j % c.nfds;
+		int64_t res = j % c.fail_every == 0 ? -2 : fd;
+		const char* name = c.names[j].c_str();
+
+		dump_evt(h, d, ts++, tid, PPME_SYSCALL_OPEN_E, 3, name, (uint32_t)0, (uint32_t)0);
+		dump_evt(h, d, ts++, tid, PPME_SYSCALL_OPEN_X, 5, res, name, (uint32_t)0, (uint32_t)0, (uint32_t)0);
+		if(c.with_reads)
+		{
+			dump_evt(h, d, ts++, tid, PPME_SYSCALL_READ_E, 2, fd, (uint32_t)sizeof(payload));
+			dump_evt(h, d, ts++, tid, PPME_SYSCALL_READ_X, 2, (int64_t)(j * 4), data);
+		}
+		dump_evt(h, d, ts++, tid, PPME_SYSCALL_CLOSE_E, 1, fd);
+		dump_evt(h, d, ts++, tid, PPME_SYSCALL_CLOSE_X, 1, (int64_t)0);
+	}
+
+	close_test_capture(h, d);
+}
+
+//
+// Two processes, bash and nginx, opening, reading and closing files in /etc
+// and /tmp, for the filter tests
+//
+inline files_capture filter_test_files(int64_t first_tid)
+{
+	files_capture c;
+
+	c.first_tid = first_tid;
+	c.comms = {"bash", "nginx"};
+	for(int64_t j = 0; j < 20; j++)
+	{
+		c.names.push_back((j % 3 ? "/etc/" : "/tmp/") + std::to_string(j));
+	}
+	c.nfds = 5;
+	c.fail_every = 7;
+	c.with_reads = true;
+	return c;
+}
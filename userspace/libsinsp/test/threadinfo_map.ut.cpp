@@ -0,0 +1,145 @@
+/*
+Copyright (C) 2022 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <unordered_set>
+
+static sinsp_threadinfo* new_thread(int64_t tid)
+{
+	sinsp_threadinfo* tinfo = new sinsp_threadinfo();
+	tinfo->m_tid = tid;
+	tinfo->m_pid = tid;
+	return tinfo;
+}
+
+static void check_same(threadinfo_map_t& map, const std::unordered_set<int64_t>& expected, int64_t max_tid)
+{
+	ASSERT_EQ(map.size(), expected.size());
+
+	for(int64_t tid = 0; tid < max_tid; tid++)
+	{
+		sinsp_threadinfo* tinfo = map.get(tid);
+		if(expected.count(tid))
+		{
+			ASSERT_NE(tinfo, nullptr) << "tid " << tid;
+			ASSERT_EQ(tinfo->m_tid, tid);
+		}
+		else
+		{
+			ASSERT_EQ(tinfo, nullptr) << "tid " << tid;
+		}
+	}
+
+	std::unordered_set<int64_t> visited;
+	map.const_loop([&](const sinsp_threadinfo& tinfo)
+	{
+		EXPECT_TRUE(visited.insert(tinfo.m_tid).second);
+		return true;
+	});
+	ASSERT_EQ(visited, expected);
+}
+
+TEST(threadinfo_map, put_get_erase)
+{
+	threadinfo_map_t map;
+
+	EXPECT_EQ(map.get(1), nullptr);
+	EXPECT_EQ(map.get_ref(1), nullptr);
+	map.erase(1);
+
+	map.put(new_thread(1));
+	map.put(new_thread(2));
+	EXPECT_EQ(map.size(), 2);
+	EXPECT_EQ(map.get(2)->m_tid, 2);
+
+	// putting a tid again replaces its thread
+	sinsp_threadinfo* tinfo = new_thread(1);
+	map.put(tinfo);
+	EXPECT_EQ(map.size(), 2);
+	EXPECT_EQ(map.get(1), tinfo);
+
+	// a reference keeps the thread alive after its removal
+	threadinfo_map_t::ptr_t ref = map.get_ref(1);
+	map.erase(1);
+	EXPECT_EQ(map.get(1), nullptr);
+	EXPECT_EQ(ref.get(), tinfo);
+	EXPECT_EQ(ref.use_count(), 1);
+
+	map.clear();
+	EXPECT_EQ(map.size(), 0);
+	EXPECT_EQ(map.get(2), nullptr);
+	map.put(new_thread(2));
+	EXPECT_EQ(map.get(2)->m_tid, 2);
+}
+
+TEST(threadinfo_map, loop_stops)
+{
+	threadinfo_map_t map;
+	uint32_t nvisited = 0;
+
+	for(int64_t tid = 1; tid <= 10; tid++)
+	{
+		map.put(new_thread(tid));
+	}
+
+	EXPECT_FALSE(map.loop([&](sinsp_threadinfo& tinfo)
+	{
+		return ++nvisited < 3;
+	}));
+	EXPECT_EQ(nvisited, 3);
+}
+
+// random churn, with the tids of a small range colliding in the index,
+// checked against a set
+TEST(threadinfo_map, churn)
+{
+	const int64_t max_tid = 4096;
+	threadinfo_map_t map;
+	std::unordered_set<int64_t> expected;
+	std::mt19937 rng(42);
+
+	for(uint32_t j = 0; j < 200000; j++)
+	{
+		int64_t tid = rng() % max_tid;
+
+		if(rng() % 3 == 0)
+		{
+			map.erase(tid);
+			expected.erase(tid);
+		}
+		else
+		{
+			map.put(new_thread(tid));
+			expected.insert(tid);
+		}
+
+		if(j % 20000 == 0)
+		{
+			check_same(map, expected, max_tid);
+		}
+	}
+
+	check_same(map, expected, max_tid);
+
+	for(int64_t tid = 0; tid < max_tid; tid++)
+	{
+		map.erase(tid);
+	}
+	EXPECT_EQ(map.size(), 0);
+}
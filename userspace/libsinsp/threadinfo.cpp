@@ -49,6 +49,10 @@ sinsp_threadinfo::sinsp_threadinfo(sinsp* inspector) :
 	m_inspector(inspector),
 	m_fdtable(inspector)
 {
+	if(inspector != NULL && inspector->m_thread_manager != NULL)
+	{
+		m_intern_pools = inspector->m_thread_manager->m_intern_pools;
+	}
 	init();
 }
 
@@ -82,7 +86,10 @@ void sinsp_threadinfo::init()
 	m_program_hash = 0;
 	m_program_hash_scripts = 0;
 	m_lastevent_data = NULL;
+	m_lastevent_data_size = 0;
+	m_lastevent_pool.reset();
 	m_parent_loop_detected = false;
+	m_lazy_fdtable = false;
 	m_tty = 0;
 	m_category = CAT_NONE;
 	m_blprogram = NULL;
@@ -105,9 +112,22 @@ sinsp_threadinfo::~sinsp_threadinfo()
 	}
 
 	m_private_state.clear();
+
+	//
+	// Give the enter event buffer back to the pool, so that it's not
+	// counted as used anymore. The thread may outlive the inspector, the
+	// pool is kept alive by the threads holding its buffers.
+	//
 	if(m_lastevent_data)
 	{
-		free(m_lastevent_data);
+		if(m_lastevent_pool)
+		{
+			m_lastevent_pool->release(m_lastevent_data, m_lastevent_data_size, 0);
+		}
+		else
+		{
+			free(m_lastevent_data);
+		}
 	}
 
 	if(m_tracer_parser)
@@ -118,36 +138,71 @@ sinsp_threadinfo::~sinsp_threadinfo()
 
 void sinsp_threadinfo::fix_sockets_coming_from_proc()
 {
-	unordered_map<int64_t, sinsp_fdinfo_t>::iterator it;
-
-	for(it = m_fdtable.m_table.begin(); it != m_fdtable.m_table.end(); it++)
+	m_fdtable.loop([this](int64_t fd, sinsp_fdinfo_t& fdi)
 	{
-		if(it->second.m_type == SCAP_FD_IPV4_SOCK)
+		if(fdi.m_type == SCAP_FD_IPV4_SOCK)
 		{
-			if(m_inspector->m_thread_manager->m_server_ports.find(it->second.m_sockinfo.m_ipv4info.m_fields.m_sport) !=
+			if(m_inspector->m_thread_manager->m_server_ports.find(fdi.m_sockinfo.m_ipv4info.m_fields.m_sport) !=
 				m_inspector->m_thread_manager->m_server_ports.end())
 			{
 				uint32_t tip;
 				uint16_t tport;
 
-				tip = it->second.m_sockinfo.m_ipv4info.m_fields.m_sip;
-				tport = it->second.m_sockinfo.m_ipv4info.m_fields.m_sport;
+				tip = fdi.m_sockinfo.m_ipv4info.m_fields.m_sip;
+				tport = fdi.m_sockinfo.m_ipv4info.m_fields.m_sport;
 
-				it->second.m_sockinfo.m_ipv4info.m_fields.m_sip = it->second.m_sockinfo.m_ipv4info.m_fields.m_dip;
-				it->second.m_sockinfo.m_ipv4info.m_fields.m_dip = tip;
-				it->second.m_sockinfo.m_ipv4info.m_fields.m_sport = it->second.m_sockinfo.m_ipv4info.m_fields.m_dport;
-				it->second.m_sockinfo.m_ipv4info.m_fields.m_dport = tport;
+				fdi.m_sockinfo.m_ipv4info.m_fields.m_sip = fdi.m_sockinfo.m_ipv4info.m_fields.m_dip;
+				fdi.m_sockinfo.m_ipv4info.m_fields.m_dip = tip;
+				fdi.m_sockinfo.m_ipv4info.m_fields.m_sport = fdi.m_sockinfo.m_ipv4info.m_fields.m_dport;
+				fdi.m_sockinfo.m_ipv4info.m_fields.m_dport = tport;
 
-				it->second.m_name = ipv4tuple_to_string(&it->second.m_sockinfo.m_ipv4info, m_inspector->m_hostname_and_port_resolution_enabled);
+				fdi.m_name = ipv4tuple_to_string(&fdi.m_sockinfo.m_ipv4info, m_inspector->m_hostname_and_port_resolution_enabled);
 
-				it->second.set_role_server();
+				fdi.set_role_server();
 			}
 			else
 			{
-				it->second.set_role_client();
+				fdi.set_role_client();
 			}
 		}
+		return true;
+	});
+}
+
+//
+// Read the fds of the process from /proc, for a table that was left
+// empty by the scan at open time. The fds that could be read are added
+// even if the process is gone in the middle, as the scan would do.
+//
+void sinsp_threadinfo::load_fdtable()
+{
+	scap_fdinfo *fdi;
+	scap_fdinfo *tfdi;
+	sinsp_fdinfo_t tfdinfo;
+
+	m_lazy_fdtable = false;
+
+	scap_threadinfo* sctinfo = scap_proc_alloc(m_inspector->m_h);
+	if(sctinfo == NULL)
+	{
+		return;
 	}
+	sctinfo->tid = m_tid;
+	sctinfo->pid = m_pid;
+
+	if(scap_proc_read_fds(m_inspector->m_h, sctinfo) != SCAP_SUCCESS)
+	{
+		g_logger.format(sinsp_logger::SEV_DEBUG, "Cannot load the fd table of process %" PRId64 ": %s",
+				m_pid, scap_getlasterr(m_inspector->m_h));
+	}
+
+	HASH_ITER(hh, sctinfo->fdlist, fdi, tfdi)
+	{
+		add_fd_from_scap(fdi, &tfdinfo);
+	}
+	fix_sockets_coming_from_proc();
+
+	scap_proc_free(m_inspector->m_h, sctinfo);
 }
 
 #define STR_AS_NUM_JAVA 0x6176616a
@@ -486,6 +541,7 @@ void sinsp_threadinfo::init(scap_threadinfo* pi)
 	}
 
 	m_lastevent_data = NULL;
+	m_lastevent_data_size = 0;
 
 	if(m_inspector->m_filter != NULL && m_inspector->m_filter_proc_table_when_saving)
 	{
@@ -579,16 +635,64 @@ std::string sinsp_threadinfo::get_exepath() const
 	return m_exepath;
 }
 
+// Whether buf holds exactly the NUL terminated strings of strs
+static bool strvec_equals(const vector<string>& strs, const char* buf, size_t len)
+{
+	size_t offset = 0;
+	for(const auto& str : strs)
+	{
+		if(offset + str.size() >= len ||
+		   memcmp(buf + offset, str.data(), str.size()) != 0 ||
+		   buf[offset + str.size()] != '\0')
+		{
+			return false;
+		}
+		offset += str.size() + 1;
+	}
+
+	return offset == len;
+}
+
+sinsp_shared_vector<string> sinsp_threadinfo::intern_strvec(vector<string>&& strs)
+{
+	if(m_intern_pools == nullptr)
+	{
+		return sinsp_shared_vector<string>(std::move(strs));
+	}
+
+	return m_intern_pools->m_strvec.intern(std::move(strs));
+}
+
+sinsp_shared_vector<pair<string, string>> sinsp_threadinfo::intern_cgroups(vector<pair<string, string>>&& cgroups)
+{
+	if(m_intern_pools == nullptr)
+	{
+		return sinsp_shared_vector<pair<string, string>>(std::move(cgroups));
+	}
+
+	return m_intern_pools->m_cgroups.intern(std::move(cgroups));
+}
+
 void sinsp_threadinfo::set_args(const char* args, size_t len)
 {
-	m_args.clear();
+	//
+	// A cloned thread gets the arguments of its parent, that are usually
+	// the ones in the event: keep sharing them
+	//
+	if(strvec_equals(m_args, args, len))
+	{
+		return;
+	}
 
+	vector<string> vargs;
 	size_t offset = 0;
 	while(offset < len)
 	{
-		m_args.push_back(args + offset);
-		offset += m_args.back().length() + 1;
+		vargs.push_back(args + offset);
+		offset += vargs.back().length() + 1;
 	}
+
+	m_args = intern_strvec(std::move(vargs));
 }
 
 void sinsp_threadinfo::set_env(const char* env, size_t len)
@@ -606,7 +710,12 @@ void sinsp_threadinfo::set_env(const char* env, size_t len)
 		}
 	}
 
-	m_env.clear();
+	if(strvec_equals(m_env, env, len))
+	{
+		return;
+	}
+
+	vector<string> venv;
 	size_t offset = 0;
 	while(offset < len)
 	{
@@ -620,14 +729,16 @@ void sinsp_threadinfo::set_env(const char* env, size_t len)
 			if(!memcmp(left, zero, sz))
 			{
 				free(zero);
-				return;
+				break;
 			}
 			free(zero);
 		}
-		m_env.push_back(left);
+		venv.push_back(left);
 
-		offset += m_env.back().length() + 1;
+		offset += venv.back().length() + 1;
 	}
+
+	m_env = intern_strvec(std::move(venv));
 }
 
 bool sinsp_threadinfo::set_env_from_proc() {
@@ -640,16 +751,17 @@ bool sinsp_threadinfo::set_env_from_proc() {
 		return false;
 	}
 
-	m_env.clear();
+	vector<string> venv;
 	while (environment) {
 		string env;
 		getline(environment, env, '\0');
 		if (!env.empty())
 		{
-			m_env.emplace_back(env);
+			venv.emplace_back(env);
 		}
 	}
 
+	m_env = intern_strvec(std::move(venv));
 	return true;
 }
 
@@ -657,7 +769,7 @@ const vector<string>& sinsp_threadinfo::get_env()
 {
 	if(is_main_thread())
 	{
-		return m_env;
+		return m_env.get();
 	}
 	else
 	{
@@ -671,7 +783,7 @@ const vector<string>& sinsp_threadinfo::get_env()
 			// it should never happen but provide a safe fallback just in case
 			// except during sinsp::scap_open() (see sinsp::get_thread()).
 			ASSERT(false);
-			return m_env;
+			return m_env.get();
 		}
 	}
 }
@@ -700,7 +812,7 @@ string sinsp_threadinfo::get_env(const string& name)
 
 void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
 {
-	m_cgroups.clear();
+	vector<pair<string, string>> vcgroups;
 
 	size_t offset = 0;
 	while(offset < len)
@@ -710,7 +822,7 @@ void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
 		if(sep == NULL)
 		{
 			ASSERT(false);
-			return;
+			break;
 		}
 
 		string subsys(str, sep - str);
@@ -739,8 +851,17 @@ void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
 			subsys = "blkio";
 		}
 
-		m_cgroups.push_back(std::make_pair(subsys, cgroup));
 		offset += subsys_length + 1 + cgroup.length() + 1;
+		vcgroups.push_back(std::make_pair(std::move(subsys), std::move(cgroup)));
+	}
+
+	//
+	// A cloned thread usually stays in the cgroups of its parent, keep
+	// sharing them
+	//
+	if(vcgroups != m_cgroups.get())
+	{
+		m_cgroups = intern_cgroups(std::move(vcgroups));
 	}
 }
 
@@ -768,50 +889,43 @@ void sinsp_threadinfo::remove_fd(int64_t fd)
 
 bool sinsp_threadinfo::is_bound_to_port(uint16_t number)
 {
-	unordered_map<int64_t, sinsp_fdinfo_t>::iterator it;
-
 	sinsp_fdtable* fdt = get_fd_table();
 
-	for(it = fdt->m_table.begin(); it != fdt->m_table.end(); ++it)
+	return !fdt->loop([number](int64_t fd, sinsp_fdinfo_t& fdi)
 	{
-		if(it->second.m_type == SCAP_FD_IPV4_SOCK)
+		if(fdi.m_type == SCAP_FD_IPV4_SOCK)
 		{
-			if(it->second.m_sockinfo.m_ipv4info.m_fields.m_dport == number)
+			if(fdi.m_sockinfo.m_ipv4info.m_fields.m_dport == number)
 			{
-				return true;
+				return false;
 			}
 		}
-		else if(it->second.m_type == SCAP_FD_IPV4_SERVSOCK)
+		else if(fdi.m_type == SCAP_FD_IPV4_SERVSOCK)
 		{
-			if(it->second.m_sockinfo.m_ipv4serverinfo.m_port == number)
+			if(fdi.m_sockinfo.m_ipv4serverinfo.m_port == number)
 			{
-				return true;
+				return false;
 			}
 		}
-	}
-
-	return false;
+		return true;
+	});
 }
 
 bool sinsp_threadinfo::uses_client_port(uint16_t number)
 {
-	unordered_map<int64_t, sinsp_fdinfo_t>::iterator it;
-
 	sinsp_fdtable* fdt = get_fd_table();
 
-	for(it = fdt->m_table.begin();
-		it != fdt->m_table.end(); ++it)
+	return !fdt->loop([number](int64_t fd, sinsp_fdinfo_t& fdi)
 	{
-		if(it->second.m_type == SCAP_FD_IPV4_SOCK)
+		if(fdi.m_type == SCAP_FD_IPV4_SOCK)
 		{
-			if(it->second.m_sockinfo.m_ipv4info.m_fields.m_sport == number)
+			if(fdi.m_sockinfo.m_ipv4info.m_fields.m_sport == number)
 			{
-				return true;
+				return false;
 			}
 		}
-	}
-
-	return false;
+		return true;
+	});
 }
 
 bool sinsp_threadinfo::is_lastevent_data_valid()
@@ -957,7 +1071,12 @@ double sinsp_threadinfo::get_fd_usage_pct_d()
 
 uint64_t sinsp_threadinfo::get_fd_opencount() const
 {
-	return get_main_thread()->m_fdtable.size();
+	sinsp_threadinfo* root = get_main_thread();
+	if(root->m_lazy_fdtable)
+	{
+		root->load_fdtable();
+	}
+	return root->m_fdtable.size();
 }
 
 uint64_t sinsp_threadinfo::get_fd_limit()
@@ -1289,7 +1408,8 @@ void sinsp_threadinfo::fd_to_scap(scap_fdinfo *dst, sinsp_fdinfo_t* src)
 // sinsp_thread_manager implementation
 ///////////////////////////////////////////////////////////////////////////////
 sinsp_thread_manager::sinsp_thread_manager(sinsp* inspector)
-	: m_max_thread_table_size(m_thread_table_absolute_max_size)
+	: m_max_thread_table_size(m_thread_table_absolute_max_size),
+	  m_intern_pools(std::make_shared<sinsp_thread_intern_pools>())
 {
 	m_inspector = inspector;
 	clear();
@@ -1297,7 +1417,16 @@ sinsp_thread_manager::sinsp_thread_manager(sinsp* inspector)
 
 void sinsp_thread_manager::clear()
 {
+	if(m_inspector->m_parser != NULL)
+	{
+		m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
+			m_inspector->m_parser->free_event_buffer(&tinfo);
+			return true;
+		});
+	}
 	m_threadtable.clear();
+	m_intern_pools->m_strvec.clear();
+	m_intern_pools->m_cgroups.clear();
 	m_last_tid = 0;
 	m_last_tinfo.reset();
 	m_last_flush_time_ns = 0;
@@ -1365,6 +1494,15 @@ bool sinsp_thread_manager::add_thread(sinsp_threadinfo *threadinfo, bool from_sc
 
 	threadinfo->compute_program_hash();
 	threadinfo->allocate_private_state();
+
+	//
+	// The thread being replaced gives back its enter event buffer
+	//
+	sinsp_threadinfo* old_tinfo = m_threadtable.get(threadinfo->m_tid);
+	if(old_tinfo != NULL && old_tinfo != threadinfo)
+	{
+		m_inspector->m_parser->free_event_buffer(old_tinfo);
+	}
 	m_threadtable.put(threadinfo);
 
 	return true;
@@ -1416,31 +1554,31 @@ void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 		}
 
 		//
-		// If this is the main thread of a process, erase all the FDs that the process owns
+		// If this is the main thread of a process, erase all the FDs that the process owns,
+		// unless its table is lazy and has never been used
 		//
-		if((tinfo->m_pid == tinfo->m_tid) || tinfo->m_flags & PPM_CL_IS_MAIN_THREAD)
+		if(((tinfo->m_pid == tinfo->m_tid) || tinfo->m_flags & PPM_CL_IS_MAIN_THREAD) &&
+		   !tinfo->m_lazy_fdtable)
 		{
-			unordered_map<int64_t, sinsp_fdinfo_t>* fdtable = &(tinfo->get_fd_table()->m_table);
-			unordered_map<int64_t, sinsp_fdinfo_t>::iterator fdit;
-
 			erase_fd_params eparams;
 			eparams.m_remove_from_table = false;
 			eparams.m_tinfo = tinfo;
 			eparams.m_ts = m_inspector->m_lastevent_ts;
 
-			for(fdit = fdtable->begin(); fdit != fdtable->end(); ++fdit)
+			tinfo->get_fd_table()->loop([&](int64_t fd, sinsp_fdinfo_t& fdi)
 			{
-				eparams.m_fd = fdit->first;
+				eparams.m_fd = fd;
 
 				//
 				// The canceled fd should always be deleted immediately, so if it appears
 				// here it means we have a problem.
 				//
 				ASSERT(eparams.m_fd != CANCELED_FD_NUMBER);
-				eparams.m_fdinfo = &(fdit->second);
+				eparams.m_fdinfo = &fdi;
 
 				m_inspector->m_parser->erase_fd(&eparams);
-			}
+				return true;
+			});
 		}
 
 		//
@@ -1453,6 +1591,7 @@ void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 		m_removed_threads->increment();
 #endif
 
+		m_inspector->m_parser->free_event_buffer(tinfo);
 		m_threadtable.erase(tid);
 
 		//
@@ -1480,10 +1619,10 @@ void sinsp_thread_manager::clear_thread_pointers(sinsp_threadinfo& tinfo)
 {
 	tinfo.m_main_thread.reset();
 
-	sinsp_fdtable* fdt = tinfo.get_fd_table();
-	if(fdt != NULL)
+	sinsp_threadinfo* root = tinfo.get_fd_table_owner();
+	if(root != NULL)
 	{
-		fdt->reset_cache();
+		root->m_fdtable.reset_cache();
 	}
 }
 
@@ -1531,7 +1670,7 @@ void sinsp_thread_manager::update_statistics()
 	m_inspector->m_stats.m_n_fds = 0;
 	for(threadinfo_map_iterator_t it = m_threadtable.begin(); it != m_threadtable.end(); it++)
 	{
-		m_inspector->m_stats.m_n_fds += it->second.get_fd_table()->size();
+		m_inspector->m_stats.m_n_fds += it->second.get_fd_table_owner()->m_fdtable.size();
 	}
 #endif
 }
@@ -1700,8 +1839,7 @@ void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper)
 			//
 			// Add the FDs
 			//
-			unordered_map<int64_t, sinsp_fdinfo_t>& fdtable = tinfo.get_fd_table()->m_table;
-			for(auto it = fdtable.begin(); it != fdtable.end(); ++it)
+			tinfo.get_fd_table()->loop([&](int64_t fd, sinsp_fdinfo_t& fdi)
 			{
 				//
 				// Allocate the scap fd info
@@ -1716,18 +1854,19 @@ void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper)
 				//
 				// Populate the fd info
 				//
-				scfdinfo->fd = it->first;
-				tinfo.fd_to_scap(scfdinfo, &it->second);
+				scfdinfo->fd = fd;
+				tinfo.fd_to_scap(scfdinfo, &fdi);
 
 				//
 				// Add the new fd to the scap table.
 				//
-				if(scap_fd_add(m_inspector->m_h, sctinfo, it->first, scfdinfo) != SCAP_SUCCESS)
+				if(scap_fd_add(m_inspector->m_h, sctinfo, fd, scfdinfo) != SCAP_SUCCESS)
 				{
 					scap_proc_free(m_inspector->m_h, sctinfo);
 					throw sinsp_exception("error calling scap_fd_add in sinsp_thread_manager::to_scap (" + string(scap_getlasterr(m_inspector->m_h)) + ")");
 				}
-			}
+				return true;
+			});
 		}
 
 		//
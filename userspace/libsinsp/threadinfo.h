@@ -33,10 +33,13 @@ struct iovec {
 #include <functional>
 #include <memory>
 #include <set>
+#include <vector>
 #include "fdinfo.h"
+#include "shared_vector.h"
 #include "internal_metrics.h"
 
 class sinsp_delays_info;
+class sinsp_evt_buffer_pool;
 class sinsp_tracerparser;
 class blprogram;
 
@@ -49,6 +52,18 @@ typedef struct erase_fd_params
 	uint64_t m_ts;
 }erase_fd_params;
 
+//
+// The args, environments and cgroups of the threads. Threads with the same
+// ones share a single copy. The threads share the ownership of the pools
+// with the thread manager, so they can still set them once the inspector is
+// gone.
+//
+struct sinsp_thread_intern_pools
+{
+	sinsp_intern_pool<std::string> m_strvec;
+	sinsp_intern_pool<std::pair<std::string, std::string>> m_cgroups;
+};
+
 /** @defgroup state State management
  *  @{
  */
@@ -257,9 +272,9 @@ public:
 	std::string m_exe; ///< argv[0] (e.g. "sshd: user@pts/4")
 	std::string m_exepath; ///< full executable path
 	bool m_exe_writable;
-	std::vector<std::string> m_args; ///< Command line arguments (e.g. "-d1")
-	std::vector<std::string> m_env; ///< Environment variables
-	std::vector<std::pair<std::string, std::string>> m_cgroups; ///< subsystem-cgroup pairs
+	sinsp_shared_vector<std::string> m_args; ///< Command line arguments (e.g. "-d1")
+	sinsp_shared_vector<std::string> m_env; ///< Environment variables
+	sinsp_shared_vector<std::pair<std::string, std::string>> m_cgroups; ///< subsystem-cgroup pairs
 	std::string m_container_id; ///< heuristic-based container id
 	uint32_t m_flags; ///< The thread flags. See the PPM_CL_* declarations in ppm_events_public.h.
 	int64_t m_fdlimit;  ///< The maximum number of FDs this thread can open
@@ -356,31 +371,41 @@ public: // types required for use in sets
 	};
 
 protected:
-	inline sinsp_fdtable* get_fd_table()
+	//
+	// The thread owning the fd table used by this one, that is this
+	// thread or its main thread. Its table is not loaded if it's lazy.
+	//
+	inline sinsp_threadinfo* get_fd_table_owner() const
 	{
 		if(!(m_flags & PPM_CL_CLONE_FILES))
 		{
-			return &m_fdtable;;
+			return const_cast<sinsp_threadinfo*>(this);
 		}
 		else
 		{
-			sinsp_threadinfo* root = get_main_thread();
-			return (root == nullptr) ? nullptr : &(root->m_fdtable);
+			return get_main_thread();
 		}
 	}
 
-#ifndef _WIN32
-	inline const sinsp_fdtable* get_fd_table() const
+	inline sinsp_fdtable* get_fd_table()
 	{
-		if(!(m_flags & PPM_CL_CLONE_FILES))
+		sinsp_threadinfo* root = get_fd_table_owner();
+		if(root == nullptr)
 		{
-			return &m_fdtable;;
+			return nullptr;
 		}
-		else
+
+		if(root->m_lazy_fdtable)
 		{
-			sinsp_threadinfo* root = get_main_thread();
-			return (root == nullptr) ? nullptr : &(root->m_fdtable);
+			root->load_fdtable();
 		}
+		return &(root->m_fdtable);
+	}
+
+#ifndef _WIN32
+	inline const sinsp_fdtable* get_fd_table() const
+	{
+		return const_cast<sinsp_threadinfo*>(this)->get_fd_table();
 	}
 #endif
 
@@ -390,6 +415,7 @@ VISIBILITY_PRIVATE
 	// return true if, based on the current inspector filter, this thread should be kept
 	void init(scap_threadinfo* pi);
 	void fix_sockets_coming_from_proc();
+	void load_fdtable();
 	sinsp_fdinfo_t* add_fd(int64_t fd, sinsp_fdinfo_t *fdinfo);
 	void add_fd_from_scap(scap_fdinfo *fdinfo, OUT sinsp_fdinfo_t *res);
 	void remove_fd(int64_t fd);
@@ -399,6 +425,8 @@ VISIBILITY_PRIVATE
 	void set_env(const char* env, size_t len);
 	bool set_env_from_proc();
 	void set_cgroups(const char* cgroups, size_t len);
+	sinsp_shared_vector<std::string> intern_strvec(std::vector<std::string>&& strs);
+	sinsp_shared_vector<std::pair<std::string, std::string>> intern_cgroups(std::vector<std::pair<std::string, std::string>>&& cgroups);
 	bool is_lastevent_data_valid();
 	inline void set_lastevent_data_validity(bool isvalid)
 	{
@@ -437,9 +465,13 @@ VISIBILITY_PRIVATE
 	// parent thread info
 	//
 	sinsp_fdtable m_fdtable; // The fd table of this thread
+	bool m_lazy_fdtable; // If true, m_fdtable is read from /proc on its first use
 	std::string m_cwd; // current working directory
 	mutable std::weak_ptr<sinsp_threadinfo> m_main_thread;
 	uint8_t* m_lastevent_data; // Used by some event parsers to store the last enter event
+	uint32_t m_lastevent_data_size; // Size of the m_lastevent_data buffer
+	std::shared_ptr<sinsp_evt_buffer_pool> m_lastevent_pool; // The pool m_lastevent_data comes from
+	std::shared_ptr<sinsp_thread_intern_pools> m_intern_pools; // Where m_args, m_env and m_cgroups are interned
 	std::vector<void*> m_private_state;
 
 	uint16_t m_lastevent_type;
@@ -458,10 +490,19 @@ VISIBILITY_PRIVATE
 	friend class sinsp_tracerparser;
 	friend class lua_cbacks;
 	friend class sinsp_baseliner;
+	friend class sinsp_pipeline;
+	friend class test_helper;
 };
 
 /*@}*/
 
+//
+// The thread table. The threads are kept in a dense vector, that loop() and
+// const_loop() walk in order, and are found by tid through an open
+// addressing index with linear probing, whose slots point into the vector.
+// A lookup usually reads a single cache line of the index, and get() returns
+// the raw pointer without touching the reference count.
+//
 class threadinfo_map_t
 {
 public:
@@ -469,46 +510,87 @@ public:
 	typedef std::function<bool(sinsp_threadinfo&)> visitor_t;
 	typedef std::shared_ptr<sinsp_threadinfo> ptr_t;
 
+	threadinfo_map_t():
+		m_shift(64)
+	{
+	}
+
 	inline void put(sinsp_threadinfo* tinfo)
 	{
-		m_threads[tinfo->m_tid] = ptr_t(tinfo);
+		ptr_t ptr(tinfo);
+		size_t slot = find(tinfo->m_tid);
+
+		if(slot != npos)
+		{
+			m_threads[m_index[slot].m_pos].swap(ptr);
+			return;
+		}
+
+		if((m_threads.size() + 1) * 2 > m_index.size())
+		{
+			grow();
+		}
+
+		insert(tinfo->m_tid, (uint32_t)m_threads.size());
+		m_threads.push_back(std::move(ptr));
 	}
 
 	inline sinsp_threadinfo* get(uint64_t tid)
 	{
-		auto it = m_threads.find(tid);
-		if (it == m_threads.end())
+		size_t slot = find(tid);
+		if (slot == npos)
 		{
 			return  nullptr;
 		}
-		return it->second.get();
+		return m_threads[m_index[slot].m_pos].get();
 	}
 
 	inline ptr_t get_ref(uint64_t tid)
 	{
-		auto it = m_threads.find(tid);
-		if (it == m_threads.end())
+		size_t slot = find(tid);
+		if (slot == npos)
 		{
 			return  nullptr;
 		}
-		return it->second;
+		return m_threads[m_index[slot].m_pos];
 	}
 
 	inline void erase(uint64_t tid)
 	{
-		m_threads.erase(tid);
+		size_t slot = find(tid);
+		if (slot == npos)
+		{
+			return;
+		}
+
+		//
+		// Fill the hole in the vector with its last thread, and
+		// destroy the erased one only once the table is consistent
+		// again
+		//
+		uint32_t pos = m_index[slot].m_pos;
+		ptr_t erased = std::move(m_threads[pos]);
+		if(pos != m_threads.size() - 1)
+		{
+			m_threads[pos] = std::move(m_threads.back());
+			m_index[find(m_threads[pos]->m_tid)].m_pos = pos;
+		}
+		m_threads.pop_back();
+		remove_slot(slot);
 	}
 
 	inline void clear()
 	{
 		m_threads.clear();
+		m_index.clear();
+		m_shift = 64;
 	}
 
 	bool const_loop(const_visitor_t callback) const
 	{
-		for (const auto& it : m_threads)
+		for (size_t j = 0; j < m_threads.size(); j++)
 		{
-			if (!callback(*it.second.get()))
+			if (!callback(*m_threads[j].get()))
 			{
 				return false;
 			}
@@ -518,9 +600,9 @@ public:
 
 	bool loop(visitor_t callback)
 	{
-		for (auto& it : m_threads)
+		for (size_t j = 0; j < m_threads.size(); j++)
 		{
-			if (!callback(*it.second.get()))
+			if (!callback(*m_threads[j].get()))
 			{
 				return false;
 			}
@@ -534,7 +616,97 @@ public:
 	}
 
 protected:
-	std::unordered_map<int64_t, ptr_t> m_threads;
+	struct slot_t
+	{
+		int64_t m_tid;
+		// Position of the thread in m_threads, or EMPTY_SLOT
+		uint32_t m_pos;
+	};
+
+	static const uint32_t EMPTY_SLOT = 0xffffffff;
+	static const size_t npos = (size_t)-1;
+	static const size_t MIN_INDEX_SIZE = 64;
+
+	inline size_t home(int64_t tid) const
+	{
+		// Fibonacci hashing, tids are often consecutive
+		return (size_t)(((uint64_t)tid * 0x9e3779b97f4a7c15ULL) >> m_shift);
+	}
+
+	inline size_t find(int64_t tid) const
+	{
+		if(m_threads.empty())
+		{
+			return npos;
+		}
+
+		size_t mask = m_index.size() - 1;
+		for(size_t j = home(tid); ; j = (j + 1) & mask)
+		{
+			const slot_t& s = m_index[j];
+			if(s.m_pos == EMPTY_SLOT)
+			{
+				return npos;
+			}
+			if(s.m_tid == tid)
+			{
+				return j;
+			}
+		}
+	}
+
+	inline void insert(int64_t tid, uint32_t pos)
+	{
+		size_t mask = m_index.size() - 1;
+		size_t j = home(tid);
+		while(m_index[j].m_pos != EMPTY_SLOT)
+		{
+			j = (j + 1) & mask;
+		}
+		m_index[j].m_tid = tid;
+		m_index[j].m_pos = pos;
+	}
+
+	//
+	// Empty a slot, moving back the entries of its probe sequence that
+	// can take its place, so that lookups never need tombstones
+	//
+	void remove_slot(size_t hole)
+	{
+		size_t mask = m_index.size() - 1;
+		for(size_t j = (hole + 1) & mask; m_index[j].m_pos != EMPTY_SLOT; j = (j + 1) & mask)
+		{
+			size_t h = home(m_index[j].m_tid);
+			// Move the entry if its home is not in (hole, j]
+			if(((j - h) & mask) >= ((j - hole) & mask))
+			{
+				m_index[hole] = m_index[j];
+				hole = j;
+			}
+		}
+		m_index[hole].m_pos = EMPTY_SLOT;
+	}
+
+	void grow()
+	{
+		size_t size = m_index.empty() ? MIN_INDEX_SIZE : m_index.size() * 2;
+
+		m_shift = 64;
+		for(size_t j = size; j > 1; j >>= 1)
+		{
+			m_shift--;
+		}
+
+		m_index.assign(size, slot_t{0, EMPTY_SLOT});
+		for(size_t j = 0; j < m_threads.size(); j++)
+		{
+			insert(m_threads[j]->m_tid, (uint32_t)j);
+		}
+	}
+
+	std::vector<ptr_t> m_threads;
+	std::vector<slot_t> m_index;
+	uint32_t m_shift;
 };
 
 
@@ -665,9 +837,13 @@ private:
 	INTERNAL_COUNTER(m_added_threads);
 	INTERNAL_COUNTER(m_removed_threads);
 
+	// Shared with the threads, see sinsp_thread_intern_pools
+	std::shared_ptr<sinsp_thread_intern_pools> m_intern_pools;
+
 	friend class sinsp_parser;
 	friend class sinsp_analyzer;
 	friend class sinsp;
 	friend class sinsp_threadinfo;
 	friend class sinsp_baseliner;
+	friend class sinsp_pipeline;
 };